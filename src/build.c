@@ -139,7 +139,7 @@ static gboolean broadcast_iofunc(GIOChannel *ioc, GIOCondition cond, gpointer da
 
 static gboolean build_create_shellscript(const gchar *fname, const gchar *cmd, gboolean autoclose, GError **error);
 static GPid build_spawn_cmd(GeanyDocument *doc, const gchar *cmd, const gchar *dir);
-static GPid build_compile_project_spawn_cmd(GeanyProject *project);
+static GPid build_compile_project_spawn_cmd(GeanyProject *project, gboolean *cache_hit);
 static void update_run_button(gboolean stop);
 static void update_broadcast_button(gboolean stop);
 static void update_debug_button(gboolean stop);
@@ -150,8 +150,11 @@ static void on_build_next_error(GtkWidget *menuitem, gpointer user_data);
 static void on_build_previous_error(GtkWidget *menuitem, gpointer user_data);
 static void kill_process(GPid *pid);
 static void show_build_result_message(gboolean failure);
-static void process_build_output_line(const gchar *line, gint color);
+static void process_build_output_line(gchar *msg, gint color);
+static void build_reset_error_files(void);
+static void build_flush_error_indicators(void);
 static void process_debug_output_line(const gchar *line, gint color);
+static void build_run_after_compile(void);
 static void show_build_commands_dialog(void);
 static void on_build_menu_item(GtkWidget *w, gpointer user_data);
 
@@ -674,6 +677,8 @@ static void clear_all_errors(void)
 	{
 		editor_indicator_clear_errors(documents[i]->editor);
 	}
+
+	build_reset_error_files();
 }
 
 
@@ -708,6 +713,7 @@ static void parse_build_output(const gchar **output, gint status)
 		}
 	}
 
+	build_flush_error_indicators();
 	show_build_result_message(status != 0);
 	//utils_beep();
 
@@ -1014,16 +1020,215 @@ void build_apply_prefs(void)
 	build_prefs.agk_compiler_use64bit = gtk_toggle_button_get_active( GTK_TOGGLE_BUTTON(windows_64bit_check) );
 }
 
+/* Compile cache.
+ * A fingerprint is built from main.agc, every file it pulls in with #include or #insert,
+ * the compiler binary and the compiler options. When it matches the one recorded after the
+ * last successful compile and the bytecode is still in place the compiler is not run again. */
+
+static gchar *compile_cache_pending = NULL; /* fingerprint of the compile currently running */
+
+static void compile_cache_add_source(GChecksum *sum, GHashTable *visited, const gchar *base_path,
+		const gchar *rel_path, gint depth)
+{
+	gchar *key, *full_path, *contents = NULL;
+	gchar *line, *next;
+	gchar len_str[32];
+	gsize length = 0;
+
+	if ( depth > 64 ) return;
+
+	// the compiler treats paths case insensitively and accepts both slash types
+	key = g_ascii_strdown(rel_path, -1);
+	utils_str_replace_char(key, '\\', '/');
+	if ( g_hash_table_lookup(visited, key) )
+	{
+		g_free(key);
+		return;
+	}
+	g_hash_table_insert(visited, key, GINT_TO_POINTER(1));
+	g_checksum_update(sum, (const guchar*) key, strlen(key) + 1);
+
+	full_path = g_build_filename(base_path, rel_path, NULL);
+	if ( !g_file_get_contents(full_path, &contents, &length, NULL) )
+	{
+		// still part of the fingerprint so that creating the file later forces a compile
+		g_checksum_update(sum, (const guchar*) "<missing>", 10);
+		g_free(full_path);
+		return;
+	}
+	g_free(full_path);
+
+	g_snprintf(len_str, sizeof(len_str), "%" G_GSIZE_FORMAT "|", length);
+	g_checksum_update(sum, (const guchar*) len_str, strlen(len_str));
+	g_checksum_update(sum, (const guchar*) contents, length);
+
+	// follow #include and #insert, these are resolved relative to the project folder
+	line = contents;
+	while ( line && *line )
+	{
+		next = strchr(line, '\n');
+		while ( *line == ' ' || *line == '\t' ) line++;
+		if ( *line == '#' && (g_ascii_strncasecmp(line, "#include", 8) == 0 || g_ascii_strncasecmp(line, "#insert", 7) == 0) )
+		{
+			gchar *start = strchr(line, '"');
+			gchar *end = start ? strchr(start + 1, '"') : NULL;
+			if ( end && (!next || end < next) )
+			{
+				gchar *include = g_strndup(start + 1, end - start - 1);
+				compile_cache_add_source(sum, visited, base_path, include, depth + 1);
+				g_free(include);
+			}
+		}
+		line = next ? next + 1 : NULL;
+	}
+
+	g_free(contents);
+}
+
+static gchar *compile_cache_get_fingerprint(GeanyProject *project, const gchar *compiler_path, const gchar *options)
+{
+	GChecksum *sum = g_checksum_new(G_CHECKSUM_SHA1);
+	GHashTable *visited = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	struct stat st;
+	gchar *identity;
+	gchar *fingerprint;
+
+	// the compiler is identified by its path, size and modification time
+	if ( g_stat(compiler_path, &st) == 0 )
+		identity = g_strdup_printf("%s|%" G_GINT64_FORMAT "|%" G_GINT64_FORMAT "|%s|", compiler_path,
+			(gint64) st.st_size, (gint64) st.st_mtime, options);
+	else
+		identity = g_strdup_printf("%s|||%s|", compiler_path, options);
+	g_checksum_update(sum, (const guchar*) identity, strlen(identity));
+	g_free(identity);
+
+	compile_cache_add_source(sum, visited, project->base_path, "main.agc", 0);
+
+	fingerprint = g_strdup(g_checksum_get_string(sum));
+	g_hash_table_destroy(visited);
+	g_checksum_free(sum);
+	return fingerprint;
+}
+
+static gchar *compile_cache_get_record_path(GeanyProject *project)
+{
+	gchar *name = g_compute_checksum_for_string(G_CHECKSUM_SHA1, project->base_path, -1);
+	gchar *path = g_build_filename(app->configdir, "compilecache", name, NULL);
+	g_free(name);
+	return path;
+}
+
+// size and modification time of the bytecode, so a replaced or deleted file is noticed
+static gchar *compile_cache_get_bytecode_stamp(GeanyProject *project)
+{
+	gchar *bytecode_path = g_build_filename(project->base_path, "media", "bytecode.byc", NULL);
+	gchar *stamp = NULL;
+	struct stat st;
+
+	if ( g_stat(bytecode_path, &st) == 0 )
+		stamp = g_strdup_printf("%" G_GINT64_FORMAT ":%" G_GINT64_FORMAT, (gint64) st.st_size, (gint64) st.st_mtime);
+
+	g_free(bytecode_path);
+	return stamp;
+}
+
+static gboolean compile_cache_lookup(GeanyProject *project, const gchar *fingerprint)
+{
+	GKeyFile *config = g_key_file_new();
+	gchar *record_path = compile_cache_get_record_path(project);
+	gboolean hit = FALSE;
+
+	if ( g_key_file_load_from_file(config, record_path, G_KEY_FILE_NONE, NULL) )
+	{
+		gchar *stored = utils_get_setting_string(config, "compile", "fingerprint", "");
+		gchar *stored_stamp = utils_get_setting_string(config, "compile", "bytecode", "");
+		gchar *stamp = compile_cache_get_bytecode_stamp(project);
+
+		hit = stamp && strcmp(stored, fingerprint) == 0 && strcmp(stored_stamp, stamp) == 0;
+
+		g_free(stamp);
+		g_free(stored_stamp);
+		g_free(stored);
+	}
+
+	g_free(record_path);
+	g_key_file_free(config);
+	return hit;
+}
+
+static void compile_cache_clear(GeanyProject *project)
+{
+	gchar *record_path = compile_cache_get_record_path(project);
+	if ( g_file_test(record_path, G_FILE_TEST_EXISTS) )
+		g_unlink(record_path);
+	g_free(record_path);
+}
+
+static void compile_cache_store(GeanyProject *project, const gchar *fingerprint)
+{
+	GKeyFile *config;
+	gchar *record_path;
+	gchar *cache_dir;
+	gchar *data;
+	gchar *stamp = compile_cache_get_bytecode_stamp(project);
+
+	if ( !stamp ) return;
+
+	cache_dir = g_build_filename(app->configdir, "compilecache", NULL);
+	utils_mkdir(cache_dir, TRUE);
+	g_free(cache_dir);
+
+	config = g_key_file_new();
+	g_key_file_set_string(config, "compile", "project", project->base_path);
+	g_key_file_set_string(config, "compile", "fingerprint", fingerprint);
+	g_key_file_set_string(config, "compile", "bytecode", stamp);
+	data = g_key_file_to_data(config, NULL, NULL);
+
+	record_path = compile_cache_get_record_path(project);
+	utils_write_file(record_path, data);
+
+	g_free(record_path);
+	g_free(data);
+	g_free(stamp);
+	g_key_file_free(config);
+}
+
 GPid build_run_project_spawn_cmd(GeanyProject *project);
 
-/* compile a project using the standard compiler for that project */
-GPid build_compile_project_spawn_cmd(GeanyProject *project)
+/* Timeline phase that completes with the next line of output from the process just spawned,
+ * e.g. the broadcaster reporting back after connecting, and whether that ends the run. */
+static const gchar *timeline_output_phase = NULL;
+static gboolean timeline_output_finishes = FALSE;
+
+static void build_timeline_expect_output(const gchar *phase, gboolean finishes)
+{
+	timeline_output_phase = phase;
+	timeline_output_finishes = finishes;
+}
+
+static void build_timeline_output_seen(const gchar *line)
+{
+	gchar *detail;
+
+	if ( !timeline_output_phase ) return;
+
+	detail = g_strchomp(g_strdup(line));
+	msgwin_timeline_mark(timeline_output_phase, "%s", detail);
+	timeline_output_phase = NULL;
+	if ( timeline_output_finishes ) msgwin_timeline_finish(TRUE);
+	g_free(detail);
+}
+
+/* compile a project using the standard compiler for that project, returns 0 with cache_hit set
+ * if the bytecode is already up to date, nothing is spawned then and the caller finishes the build */
+GPid build_compile_project_spawn_cmd(GeanyProject *project, gboolean *cache_hit)
 {
 	GError *error = NULL;
 	gchar **argv;
 	gchar *working_dir;
 	gchar *utf8_working_dir;
 	gchar *utf8_cmd_string;
+	gchar *fingerprint;
 //#ifdef SYNC_SPAWN
 	gchar *output[2];
 	gint status;
@@ -1115,6 +1320,32 @@ GPid build_compile_project_spawn_cmd(GeanyProject *project)
 	if ( strlen(utf8_working_dir) > 0 ) utf8_working_dir[ strlen(utf8_working_dir)-1 ] = 0; // remove trailing slash, this causes an error
 	working_dir = utils_get_locale_from_utf8(utf8_working_dir);
 
+#ifdef G_OS_WIN32
+	fingerprint = compile_cache_get_fingerprint(project, path, build_prefs.agk_compiler_use64bit ? "-agk -64" : "-agk");
+#else
+	fingerprint = compile_cache_get_fingerprint(project, path, "-agk");
+#endif
+	if ( compile_cache_lookup(project, fingerprint) )
+	{
+		gtk_list_store_clear(msgwindow.store_compiler);
+		gtk_notebook_set_current_page(GTK_NOTEBOOK(msgwindow.notebook), MSG_COMPILER);
+		msgwin_compiler_add(COLOR_BLUE, _("Bytecode is up to date, skipping compile (in directory: %s)"), utf8_working_dir);
+
+		g_free(fingerprint);
+		g_free(utf8_working_dir);
+		g_free(utf8_cmd_string);
+		g_strfreev(argv);
+		g_free(working_dir);
+		g_free(path);
+
+		*cache_hit = TRUE;
+		return (GPid) 0;
+	}
+
+	// the compiler will overwrite the bytecode, only record it again if it succeeds
+	compile_cache_clear(project);
+	SETPTR(compile_cache_pending, fingerprint);
+
 	gtk_list_store_clear(msgwindow.store_compiler);
 	gtk_notebook_set_current_page(GTK_NOTEBOOK(msgwindow.notebook), MSG_COMPILER);
 	msgwin_compiler_add(COLOR_BLUE, _("Running %s (in directory: %s)"), utf8_cmd_string, utf8_working_dir);
@@ -1171,12 +1402,15 @@ GPid build_compile_project_spawn_cmd(GeanyProject *project)
 			g_error_free(error);
 			g_free(working_dir);
 			g_free(path);
+			SETPTR(compile_cache_pending, NULL);
 			error = NULL;
 			return (GPid) 0;
 		}
 
 		if (build_pid != 0)
 		{
+			msgwin_timeline_mark("compile_spawn", NULL);
+			build_timeline_expect_output("compile_first_output", FALSE);
 			ui_progress_bar_start(NULL);
 			g_child_watch_add(build_pid, (GChildWatchFunc) agk_build_exit_cb, NULL);
 			update_build_menu3();
@@ -1207,10 +1441,159 @@ GPid build_compile_project_spawn_cmd(GeanyProject *project)
 	}
 }
 
+/* Interpreter launch.
+ * Once the local interpreter has been spawned for a run or a debug session the launch is
+ * followed from the main loop until the interpreter is ready: on macOS when it shows up as a
+ * running application that can be brought to the front, on Windows when it is waiting for
+ * input, and everywhere when it writes its first line of output. The child watch ends the
+ * launch if the interpreter exits first, and a timeout ends it if it never reports back. */
+
+#define AGK_LAUNCH_POLL_INTERVAL 20		/* milliseconds */
+#define AGK_LAUNCH_TIMEOUT 10000		/* milliseconds */
+
+typedef enum
+{
+	LAUNCH_IDLE,
+	LAUNCH_WAITING,
+	LAUNCH_READY,
+	LAUNCH_TIMED_OUT,
+	LAUNCH_EXITED
+} LaunchState;
+
+static struct
+{
+	LaunchState state;
+	GPid *pid;					/* &local_pid or &debug_pid2 */
+	gboolean owns_timeline;		/* whether becoming ready ends the timeline run */
+	guint serial;				/* tells output of an earlier launch apart */
+	guint source_id;
+	GTimer *timer;
+} interpreter_launch = { LAUNCH_IDLE, NULL, FALSE, 0, 0, NULL };
+
+static void interpreter_launch_set_state(LaunchState state, const gchar *detail)
+{
+	gdouble elapsed;
+
+	if ( interpreter_launch.state != LAUNCH_WAITING ) return;
+
+	interpreter_launch.state = state;
+	if ( interpreter_launch.source_id )
+	{
+		g_source_remove(interpreter_launch.source_id);
+		interpreter_launch.source_id = 0;
+	}
+	elapsed = g_timer_elapsed(interpreter_launch.timer, NULL) * 1000.0;
+
+	switch( state )
+	{
+		case LAUNCH_READY:
+			msgwin_timeline_mark("interpreter_ready", "%s", detail);
+			ui_set_statusbar(FALSE, _("Interpreter ready after %.0f ms"), elapsed);
+			break;
+
+		case LAUNCH_TIMED_OUT:
+			msgwin_timeline_mark("interpreter_ready", "no reply after %d ms", AGK_LAUNCH_TIMEOUT);
+			ui_set_statusbar(FALSE, _("Interpreter started, it did not report back within %.0f ms"), elapsed);
+			break;
+
+		case LAUNCH_EXITED:
+			msgwin_timeline_mark("interpreter_exit", "exited before it was ready");
+			ui_set_statusbar(TRUE, _("Interpreter exited %.0f ms after it was started"), elapsed);
+			break;
+
+		default: break;
+	}
+
+	if ( interpreter_launch.owns_timeline ) msgwin_timeline_finish(state != LAUNCH_EXITED);
+}
+
+static gboolean interpreter_launch_poll(gpointer data)
+{
+	GPid pid = *interpreter_launch.pid;
+
+#ifdef __APPLE__
+	NSRunningApplication *running_app = [NSRunningApplication runningApplicationWithProcessIdentifier:pid];
+	if ( running_app )
+	{
+		[ running_app activateWithOptions:NSApplicationActivateAllWindows ];
+		interpreter_launch.source_id = 0;
+		interpreter_launch_set_state(LAUNCH_READY, "activated");
+		return FALSE;
+	}
+#elif defined(G_OS_WIN32)
+	if ( WaitForInputIdle( pid, 0 ) == 0 )
+	{
+		interpreter_launch.source_id = 0;
+		interpreter_launch_set_state(LAUNCH_READY, "waiting for input");
+		return FALSE;
+	}
+#endif
+
+	if ( g_timer_elapsed(interpreter_launch.timer, NULL) * 1000.0 >= AGK_LAUNCH_TIMEOUT )
+	{
+		interpreter_launch.source_id = 0;
+		interpreter_launch_set_state(LAUNCH_TIMED_OUT, NULL);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+// the first line of output means the interpreter is up, anything after that is discarded
+static gboolean interpreter_launch_iofunc(GIOChannel *ioc, GIOCondition cond, gpointer data)
+{
+	if (cond & (G_IO_IN | G_IO_PRI))
+	{
+		gchar *msg;
+		GIOStatus st;
+
+		st = g_io_channel_read_line(ioc, &msg, NULL, NULL, NULL);
+		if ( msg )
+		{
+			if ( st == G_IO_STATUS_NORMAL && GPOINTER_TO_UINT(data) == interpreter_launch.serial )
+				interpreter_launch_set_state(LAUNCH_READY, g_strchomp(msg));
+
+			g_free(msg);
+		}
+
+		if (st == G_IO_STATUS_ERROR || st == G_IO_STATUS_EOF) return FALSE;
+	}
+
+	if (cond & (G_IO_ERR | G_IO_HUP | G_IO_NVAL))
+		return FALSE;
+
+	return TRUE;
+}
+
+static void interpreter_launch_begin(GPid *pid, gint stdout_fd, gboolean owns_timeline)
+{
+	if ( interpreter_launch.source_id ) g_source_remove(interpreter_launch.source_id);
+
+	interpreter_launch.state = LAUNCH_WAITING;
+	interpreter_launch.pid = pid;
+	interpreter_launch.owns_timeline = owns_timeline;
+	interpreter_launch.serial++;
+	interpreter_launch.source_id = g_timeout_add(AGK_LAUNCH_POLL_INTERVAL, interpreter_launch_poll, NULL);
+
+	if ( !interpreter_launch.timer ) interpreter_launch.timer = g_timer_new();
+	else g_timer_start(interpreter_launch.timer);
+
+	if ( stdout_fd >= 0 )
+		utils_set_up_io_channel(stdout_fd, G_IO_IN | G_IO_PRI | G_IO_ERR | G_IO_HUP | G_IO_NVAL, TRUE,
+			interpreter_launch_iofunc, GUINT_TO_POINTER(interpreter_launch.serial));
+}
+
+// called from the child watch, the launch can't complete once the interpreter has gone
+static void interpreter_launch_exited(GPid *pid)
+{
+	if ( interpreter_launch.pid == pid ) interpreter_launch_set_state(LAUNCH_EXITED, NULL);
+}
+
 GPid build_run_project_spawn_cmd(GeanyProject *project)
 {
 	gchar *working_dir;
 	GError *error = NULL;
+	gint stdout_fd = -1;
 
 	if ( local_pid ) 
 	{
@@ -1289,7 +1672,8 @@ GPid build_run_project_spawn_cmd(GeanyProject *project)
 	else
 	*/
 	{
-		if (! g_spawn_async(working_dir, argv, NULL, G_SPAWN_DO_NOT_REAP_CHILD, NULL, NULL, &local_pid, &error))
+		if (! g_spawn_async_with_pipes(working_dir, argv, NULL, G_SPAWN_DO_NOT_REAP_CHILD, NULL, NULL, &local_pid,
+									   NULL, &stdout_fd, NULL, &error))
 		{
 			geany_debug(_("g_spawn_async() failed: %s"), error->message);
 			ui_set_statusbar(TRUE, _("Process failed (%s)"), error->message);
@@ -1300,24 +1684,10 @@ GPid build_run_project_spawn_cmd(GeanyProject *project)
 
 		if (local_pid != 0)
 		{
+			msgwin_timeline_mark("interpreter_start", NULL);
 			g_child_watch_add(local_pid, (GChildWatchFunc) agk_run_exit_cb, (gpointer)&local_pid);
 			update_build_menu3();
-            
-#ifdef __APPLE__
-            int loopcounter = 0;
-            while( local_pid && loopcounter < 200 )
-            {
-                NSRunningApplication *app = [NSRunningApplication runningApplicationWithProcessIdentifier:local_pid];
-                if ( app )
-                {
-                    [ app activateWithOptions:NSApplicationActivateAllWindows ];
-                    break;
-                }
-                
-                loopcounter++;
-                g_usleep( 20 * 1000 ); // 20 milliseconds
-            }
-#endif
+			interpreter_launch_begin(&local_pid, stdout_fd, TRUE);
 		}
 
 		g_free(name);
@@ -1332,6 +1702,273 @@ GPollFD gdb_in = { -1, G_IO_OUT | G_IO_ERR, 0 };
 GPollFD gdb_out = { -1, G_IO_IN | G_IO_HUP | G_IO_ERR, 0 };
 GPollFD gdb_err = { -1, G_IO_IN | G_IO_HUP | G_IO_ERR, 0 };
 
+/* Broadcasting to several devices at once.
+ * When more than one device IP is set in the preferences each device gets its own broadcaster
+ * process, pipes and output, all of them sharing the compile that has just finished.
+ * broadcast_pid stays set to one of the running broadcasters until the last one exits.
+ * A device is referenced by the list and by its child watch and both pipe watches, the pipes can
+ * still have output to read after the last broadcaster has exited and the list has gone. */
+
+typedef struct BroadcastDevice
+{
+	gchar *ip;
+	GPid pid;
+	gint in_fd;
+	GTimer *timer;
+	gboolean replied;
+	gint refs;
+} BroadcastDevice;
+
+static GPtrArray *broadcast_devices = NULL;
+static gint broadcast_devices_running = 0;
+static gint broadcast_devices_failed = 0;
+static gint broadcast_devices_replied = 0;
+
+static void broadcast_device_unref(gpointer data)
+{
+	BroadcastDevice *device = data;
+
+	if ( --device->refs > 0 ) return;
+
+	g_free(device->ip);
+	g_timer_destroy(device->timer);
+	g_free(device);
+}
+
+static void broadcast_devices_free(void)
+{
+	guint i;
+
+	for( i = 0; i < broadcast_devices->len; i++ )
+	{
+		BroadcastDevice *device = g_ptr_array_index(broadcast_devices, i);
+		// late output is still shown but no longer counts towards this broadcast
+		device->replied = TRUE;
+		broadcast_device_unref(device);
+	}
+	g_ptr_array_free(broadcast_devices, TRUE);
+	broadcast_devices = NULL;
+}
+
+// returns the device IPs from the preferences, separated by semicolons, commas or spaces
+static gchar **build_get_broadcast_ips(void)
+{
+	gchar **ips = g_strsplit_set(FALLBACK(build_prefs.agk_broadcast_ip, ""), ";, \t", -1);
+	gint i, count = 0;
+
+	for( i = 0; ips[i]; i++ )
+	{
+		if ( *ips[i] ) ips[count++] = ips[i];
+		else g_free(ips[i]);
+	}
+	ips[count] = NULL;
+
+	return ips;
+}
+
+static gboolean build_exit_status_failed(gint status)
+{
+#ifdef G_OS_WIN32
+	return status != 0;
+#else
+	if (WIFEXITED(status))
+		return WEXITSTATUS(status) != EXIT_SUCCESS;
+	return TRUE;
+#endif
+}
+
+static void broadcast_devices_update_status(void)
+{
+	ui_set_statusbar(FALSE, _("Broadcasting to %d devices, %d running, %d failed"),
+		broadcast_devices->len, broadcast_devices_running, broadcast_devices_failed);
+}
+
+static gboolean broadcast_device_iofunc(GIOChannel *ioc, GIOCondition cond, gpointer data)
+{
+	BroadcastDevice *device = data;
+
+	if (cond & (G_IO_IN | G_IO_PRI))
+	{
+		gchar *msg;
+		GIOStatus st;
+
+		st = g_io_channel_read_line(ioc, &msg, NULL, NULL, NULL);
+		if ( msg )
+		{
+			g_strchomp(msg);
+			if ( st == G_IO_STATUS_NORMAL && *msg )
+			{
+				gint color = (strncmp(msg, "Error", 5) == 0) ? COLOR_RED : COLOR_BLACK;
+				msgwin_compiler_add(color, "[%s] %s", device->ip, msg);
+
+				if ( !device->replied )
+				{
+					device->replied = TRUE;
+					msgwin_timeline_mark("broadcaster_connect", "[%s] %s", device->ip, msg);
+					if ( ++broadcast_devices_replied == (gint) broadcast_devices->len )
+						msgwin_timeline_finish(TRUE);
+				}
+			}
+			g_free(msg);
+		}
+
+		if (st == G_IO_STATUS_ERROR || st == G_IO_STATUS_EOF) return FALSE;
+	}
+
+	if (cond & (G_IO_ERR | G_IO_HUP | G_IO_NVAL))
+		return FALSE;
+
+	return TRUE;
+}
+
+static void broadcast_device_exit_cb(GPid child_pid, gint status, gpointer user_data)
+{
+	BroadcastDevice *device = user_data;
+	gdouble elapsed = g_timer_elapsed(device->timer, NULL);
+	guint i;
+
+	g_spawn_close_pid(child_pid);
+	if ( device->in_fd >= 0 ) close(device->in_fd);
+	device->in_fd = -1;
+	device->pid = 0;
+
+	if ( build_exit_status_failed(status) )
+	{
+		broadcast_devices_failed++;
+		msgwin_compiler_add(COLOR_RED, _("[%s] Broadcaster exited with an error after %.1f seconds"), device->ip, elapsed);
+	}
+	else
+		msgwin_compiler_add(COLOR_BLUE, _("[%s] Finished after %.1f seconds"), device->ip, elapsed);
+
+	broadcast_devices_running--;
+	if ( broadcast_devices_running > 0 )
+	{
+		// keep broadcast_pid pointing at a broadcaster that is still alive
+		for( i = 0; i < broadcast_devices->len; i++ )
+		{
+			BroadcastDevice *other = g_ptr_array_index(broadcast_devices, i);
+			if ( other->pid ) broadcast_pid = other->pid;
+		}
+		broadcast_devices_update_status();
+		return;
+	}
+
+	msgwin_compiler_add(COLOR_BLUE, _("Broadcast finished on %d devices, %d failed"),
+		broadcast_devices->len, broadcast_devices_failed);
+	msgwin_timeline_finish(broadcast_devices_failed == 0);
+	ui_set_statusbar(FALSE, _("Broadcast finished on %d devices, %d failed"),
+		broadcast_devices->len, broadcast_devices_failed);
+
+	broadcast_devices_free();
+	broadcast_pid = 0;
+	ui_progress_bar_stop();
+	update_build_menu3();
+}
+
+static gboolean broadcast_device_send(BroadcastDevice *device, const gchar *cmd)
+{
+	gssize len = (gssize) strlen(cmd);
+
+	if ( write(device->in_fd, cmd, len) == len ) return TRUE;
+
+	msgwin_compiler_add(COLOR_RED, _("[%s] Failed to send commands to the broadcaster (%s)"), device->ip, g_strerror(errno));
+	return FALSE;
+}
+
+static void broadcast_devices_stop(void)
+{
+	guint i;
+
+	for( i = 0; i < broadcast_devices->len; i++ )
+	{
+		BroadcastDevice *device = g_ptr_array_index(broadcast_devices, i);
+		if ( device->pid && device->in_fd >= 0 && !broadcast_device_send(device, "stop\ndisconnectall\nexit\n") )
+		{
+			// closing its input is the only other way left to tell the broadcaster to exit
+			close(device->in_fd);
+			device->in_fd = -1;
+		}
+	}
+}
+
+static GPid build_broadcast_to_devices(GeanyProject *project, const gchar *broadcaster_path, gchar **ips)
+{
+	GError *error = NULL;
+	gchar *argv[3];
+	gint i;
+
+	argv[0] = (gchar*) broadcaster_path;
+	argv[1] = "-nowindow";
+	argv[2] = NULL;
+
+	broadcast_devices = g_ptr_array_new();
+	broadcast_devices_running = 0;
+	broadcast_devices_failed = 0;
+	broadcast_devices_replied = 0;
+	broadcast_pid = 0;
+
+	gtk_notebook_set_current_page(GTK_NOTEBOOK(msgwindow.notebook), MSG_COMPILER);
+
+	for( i = 0; ips[i]; i++ )
+	{
+		BroadcastDevice *device = g_new0(BroadcastDevice, 1);
+		gint out_fd, err_fd;
+		gchar *cmdline;
+
+		device->ip = g_strdup(ips[i]);
+		device->in_fd = -1;
+		device->timer = g_timer_new();
+		device->refs = 1;
+		g_ptr_array_add(broadcast_devices, device);
+
+		if (! g_spawn_async_with_pipes(NULL, argv, NULL, G_SPAWN_DO_NOT_REAP_CHILD, NULL, NULL, &device->pid,
+									   &device->in_fd, &out_fd, &err_fd, &error))
+		{
+			msgwin_compiler_add(COLOR_RED, _("[%s] Failed to start broadcaster (%s)"), device->ip, error->message);
+			g_error_free(error);
+			error = NULL;
+			device->pid = 0;
+			device->in_fd = -1;
+			broadcast_devices_failed++;
+			continue;
+		}
+
+		broadcast_devices_running++;
+		broadcast_pid = device->pid;
+		device->refs += 3;
+		g_child_watch_add_full(G_PRIORITY_DEFAULT, device->pid, (GChildWatchFunc) broadcast_device_exit_cb, device, broadcast_device_unref);
+		utils_set_up_io_channel_full(out_fd, G_IO_IN | G_IO_PRI | G_IO_ERR | G_IO_HUP | G_IO_NVAL, TRUE, broadcast_device_iofunc, device, broadcast_device_unref);
+		utils_set_up_io_channel_full(err_fd, G_IO_IN | G_IO_PRI | G_IO_ERR | G_IO_HUP | G_IO_NVAL, TRUE, broadcast_device_iofunc, device, broadcast_device_unref);
+
+		// no connectall here, otherwise every broadcaster would pick up every device on the network
+		cmdline = g_strconcat( "setproject ", project->base_path, "\nconnect ", device->ip, "\nrun\n", NULL );
+		if ( !broadcast_device_send(device, cmdline) )
+		{
+			// the broadcaster exits once its input is closed, it never got a project to run
+			close(device->in_fd);
+			device->in_fd = -1;
+			g_free(cmdline);
+			continue;
+		}
+		g_free(cmdline);
+
+		msgwin_compiler_add(COLOR_BLUE, _("[%s] Broadcasting"), device->ip);
+		msgwin_timeline_mark("broadcaster_start", "%s", device->ip);
+	}
+
+	if ( broadcast_devices_running == 0 )
+	{
+		ui_set_statusbar(TRUE, _("Failed to broadcast project, no broadcaster could be started"));
+		broadcast_devices_free();
+		return (GPid) 0;
+	}
+
+	broadcast_devices_update_status();
+	update_build_menu3();
+	ui_progress_bar_start(_("Broadcasting"));
+	return broadcast_pid;
+}
+
 GPid build_broadcast_project_spawn_cmd(GeanyProject *project)
 {
 	gchar *working_dir;
@@ -1376,9 +2013,19 @@ GPid build_broadcast_project_spawn_cmd(GeanyProject *project)
 	{
 		dialogs_show_msgbox(GTK_MESSAGE_WARNING, _("Failed to broadcast project, broadcaster program not found"));
 		ui_set_statusbar(TRUE, _("Failed to broadcast project, broadcaster program not found"));
+		g_free(main_path);
 		return (GPid) 0;
 	}
 
+	gchar **ips = build_get_broadcast_ips();
+	if ( g_strv_length(ips) > 1 )
+	{
+		build_broadcast_to_devices(project, main_path, ips);
+		g_strfreev(ips);
+		g_free(main_path);
+		return broadcast_pid;
+	}
+
 	//working_dir = g_strdup( project->base_path );
 	
 	gchar **argv = NULL;
@@ -1400,6 +2047,8 @@ GPid build_broadcast_project_spawn_cmd(GeanyProject *project)
 
 	if (broadcast_pid != 0)
 	{
+		msgwin_timeline_mark("broadcaster_start", "%s", FALLBACK(ips[0], "all devices"));
+		build_timeline_expect_output("broadcaster_connect", TRUE);
 		g_child_watch_add(broadcast_pid, (GChildWatchFunc) agk_run_exit_cb, (gpointer)&broadcast_pid);
 		update_build_menu3();
 		ui_progress_bar_start("Broadcasting");
@@ -1408,9 +2057,9 @@ GPid build_broadcast_project_spawn_cmd(GeanyProject *project)
 	utils_set_up_io_channel(gdb_out.fd, G_IO_IN | G_IO_PRI | G_IO_ERR | G_IO_HUP | G_IO_NVAL, TRUE, broadcast_iofunc, GINT_TO_POINTER(0));
 	utils_set_up_io_channel(gdb_err.fd, G_IO_IN | G_IO_PRI | G_IO_ERR | G_IO_HUP | G_IO_NVAL, TRUE, broadcast_iofunc, GINT_TO_POINTER(1));
 
-	if ( build_prefs.agk_broadcast_ip && *build_prefs.agk_broadcast_ip )
+	if ( ips[0] )
 	{
-		gchar *cmdline = g_strconcat( "setproject ", project->base_path, "\nconnect ", build_prefs.agk_broadcast_ip, "\nconnectall\nrun\n", NULL );
+		gchar *cmdline = g_strconcat( "setproject ", project->base_path, "\nconnect ", ips[0], "\nconnectall\nrun\n", NULL );
 		write(gdb_in.fd, cmdline, strlen(cmdline) );
 		g_free(cmdline);
 	}
@@ -1427,6 +2076,7 @@ GPid build_broadcast_project_spawn_cmd(GeanyProject *project)
 	MessageBox( NULL, output, "info", 0 );
 	*/
 	
+	g_strfreev(ips);
 	g_strfreev(argv);
 	g_free(main_path);
 	//g_free(working_dir);
@@ -1509,6 +2159,8 @@ GPid build_debug_project_spawn_cmd(GeanyProject *project)
 
 	if (debug_pid != 0)
 	{
+		msgwin_timeline_mark("debugger_start", NULL);
+		build_timeline_expect_output("debugger_connect", TRUE);
 		g_child_watch_add(debug_pid, (GChildWatchFunc) agk_run_exit_cb, (gpointer)&debug_pid);
 		update_build_menu3();
 		ui_progress_bar_start("Debugging");
@@ -1566,13 +2218,15 @@ GPid build_debug_project_spawn_cmd(GeanyProject *project)
 		}
 
 		gchar **argv = NULL;
+		gint stdout_fd = -1;
 		argv = g_new0(gchar *, 2);
 		argv[0] = g_strdup(path1);
 		argv[1] = NULL;
 
 		g_free(path1);
 
-		if (! g_spawn_async(NULL, argv, NULL, G_SPAWN_DO_NOT_REAP_CHILD, NULL, NULL, &debug_pid2, &error))
+		if (! g_spawn_async_with_pipes(NULL, argv, NULL, G_SPAWN_DO_NOT_REAP_CHILD, NULL, NULL, &debug_pid2,
+									   NULL, &stdout_fd, NULL, &error))
 		{
 			dialogs_show_msgbox(GTK_MESSAGE_WARNING, _("Failed to debug project locally, interpreter failed to run"));
 			geany_debug(_("g_spawn_async() failed: %s"), error->message);
@@ -1585,23 +2239,10 @@ GPid build_debug_project_spawn_cmd(GeanyProject *project)
 
 		if (debug_pid != 0)
 		{
+			msgwin_timeline_mark("interpreter_start", NULL);
 			g_child_watch_add(debug_pid2, (GChildWatchFunc) agk_run_exit_cb, (gpointer)&debug_pid2);
-
-#ifdef __APPLE__
-            int loopcounter = 0;
-            while( debug_pid2 && loopcounter < 200 )
-            {
-                NSRunningApplication *app = [NSRunningApplication runningApplicationWithProcessIdentifier:debug_pid2];
-                if ( app )
-                {
-                    [ app activateWithOptions:NSApplicationActivateAllWindows ];
-                    break;
-                }
-                
-                loopcounter++;
-                g_usleep( 20 * 1000 ); // 20 milliseconds
-            }
-#endif
+			// the debug session itself is timed until the debugger connects
+			interpreter_launch_begin(&debug_pid2, stdout_fd, FALSE);
 		}
 		else
 		{
@@ -1881,69 +2522,239 @@ static GPid build_run_cmd(GeanyDocument *doc, guint cmdindex)
 }
 
 
-static void process_build_output_line(const gchar *str, gint color)
+/* Compiler output matching.
+ * Every line printed by the compiler goes through build_match_output_line() once. The fixed
+ * messages in build_output_patterns are found through a first byte table built on first use
+ * and errors of the form "file:line: message" are recognised in the same pass, the line
+ * itself is never copied. */
+
+typedef enum
 {
-	gchar *msg, *tmp;
-	gchar *filename;
+	BUILD_LINE_TEXT,
+	BUILD_LINE_IGNORE,
+	BUILD_LINE_STEAM_WEEKEND,
+	BUILD_LINE_ERROR
+}
+BuildLineKind;
+
+static const struct
+{
+	const gchar *text;
+	gboolean at_start;	/* only matches at the start of the line */
+	BuildLineKind kind;
+}
+build_output_patterns[] =
+{
+	{ "Setting breakpad minidump AppID", TRUE, BUILD_LINE_IGNORE },
+	{ "Steam_SetMinidumpSteamID", TRUE, BUILD_LINE_IGNORE },
+	{ "Steam free weekend has finished", FALSE, BUILD_LINE_STEAM_WEEKEND },
+	{ "free weekend version must be launched from within Steam", FALSE, BUILD_LINE_STEAM_WEEKEND }
+};
+
+static guint8 build_output_first_byte[256]; /* bit n is set when pattern n starts with this byte */
+static gsize build_output_pattern_len[G_N_ELEMENTS(build_output_patterns)];
+static gboolean build_output_matcher_ready = FALSE;
+
+typedef struct BuildLineMatch
+{
+	BuildLineKind kind;
+	const gchar *file;	/* points into the matched line, not NUL terminated */
+	gsize file_len;
 	gint line;
+}
+BuildLineMatch;
 
-	msg = g_strdup(str);
+static void build_output_matcher_init(void)
+{
+	guint i;
 
-	g_strchomp(msg);
+	G_STATIC_ASSERT(G_N_ELEMENTS(build_output_patterns) <= 8);
 
-	if (EMPTY(msg))
+	for( i = 0; i < G_N_ELEMENTS(build_output_patterns); i++ )
 	{
-		g_free(msg);
-		return;
+		build_output_pattern_len[i] = strlen(build_output_patterns[i].text);
+		build_output_first_byte[(guint8) build_output_patterns[i].text[0]] |= 1 << i;
 	}
+	build_output_matcher_ready = TRUE;
+}
 
-	if ( strncmp( msg, "Setting breakpad minidump AppID", strlen("Setting breakpad minidump AppID") ) == 0 )
-	{
-		g_free(msg);
-		return;
-	}
+static void build_match_output_line(const gchar *str, gsize len, BuildLineMatch *match)
+{
+	gboolean colon_seen = FALSE;
+	gsize i, start = 0;
 
-	if ( strncmp( msg, "Steam_SetMinidumpSteamID", strlen("Steam_SetMinidumpSteamID") ) == 0 )
-	{
-		g_free(msg);
-		return;
-	}
+	match->kind = BUILD_LINE_TEXT;
+	match->file = NULL;
+	match->file_len = 0;
+	match->line = -1;
 
-	if ( strstr( msg, "Steam free weekend has finished" ) )
+	if ( !build_output_matcher_ready ) build_output_matcher_init();
+
+	while ( start < len && g_ascii_isspace(str[start]) ) start++;
+
+	for( i = 0; i < len; i++ )
 	{
-		on_show_weekend_end_dialog();
+		guint8 candidates = build_output_first_byte[(guint8) str[i]];
+
+		if ( candidates )
+		{
+			guint p;
+			for( p = 0; p < G_N_ELEMENTS(build_output_patterns); p++ )
+			{
+				if ( !(candidates & (1 << p)) ) continue;
+				if ( build_output_patterns[p].at_start && i != 0 ) continue;
+				if ( build_output_pattern_len[p] <= len - i
+					&& memcmp(str + i, build_output_patterns[p].text, build_output_pattern_len[p]) == 0 )
+				{
+					match->kind = build_output_patterns[p].kind;
+					return;
+				}
+			}
+		}
+
+		// the file name ends at the first colon, except for a drive letter such as C:\ or C:/
+		if ( str[i] == ':' && !colon_seen && i > start )
+		{
+			gsize j = i + 1;
+			gint line = 0;
+
+			if ( i == start + 1 && g_ascii_isalpha(str[start]) && j < len && (str[j] == '\\' || str[j] == '/') )
+				continue;
+			colon_seen = TRUE;
+
+			while ( j < len && str[j] == ' ' ) j++;
+			if ( j == len || !g_ascii_isdigit(str[j]) ) continue;
+			while ( j < len && g_ascii_isdigit(str[j]) ) line = line * 10 + (str[j++] - '0');
+			if ( j == len || str[j] != ':' ) continue;
+
+			match->kind = BUILD_LINE_ERROR;
+			match->file = str + start;
+			match->file_len = i - start;
+			match->line = line;
+			return;
+		}
 	}
+}
+
+/* Files named in error messages, resolved once per build and mapped to their open document.
+ * Error lines are collected here and marked in one go by build_flush_error_indicators(). */
+typedef struct BuildErrorFile
+{
+	gchar *filename;
+	GeanyDocument *doc;
+	GArray *lines;
+}
+BuildErrorFile;
 
-	if ( strstr( msg, "free weekend version must be launched from within Steam" ) )
+static GHashTable *build_error_files = NULL;
+
+static void build_error_file_free(gpointer data)
+{
+	BuildErrorFile *error_file = data;
+
+	g_free(error_file->filename);
+	g_array_free(error_file->lines, TRUE);
+	g_free(error_file);
+}
+
+static void build_reset_error_files(void)
+{
+	if ( build_error_files ) g_hash_table_destroy(build_error_files);
+	build_error_files = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, build_error_file_free);
+}
+
+static BuildErrorFile *build_lookup_error_file(const gchar *file, gsize file_len)
+{
+	BuildErrorFile *error_file;
+	gchar *key;
+
+	if ( !build_error_files ) build_reset_error_files();
+
+	key = g_strndup(file, file_len);
+	error_file = g_hash_table_lookup(build_error_files, key);
+	if ( error_file )
 	{
-		on_show_weekend_end_dialog();
+		g_free(key);
+		return error_file;
 	}
 
-	if (build_parse_make_dir(msg, &tmp))
+	error_file = g_new0(BuildErrorFile, 1);
+	if ( utils_is_absolute_path(key) || !build_info.dir )
+		error_file->filename = g_strdup(key);
+	else
+		error_file->filename = g_build_filename(build_info.dir, strncmp(key, "./", 2) == 0 ? key + 2 : key, NULL);
+	error_file->doc = document_find_by_filename(error_file->filename);
+	error_file->lines = g_array_new(FALSE, FALSE, sizeof(gint));
+
+	g_hash_table_insert(build_error_files, key, error_file);
+	return error_file;
+}
+
+static void build_flush_error_indicators(void)
+{
+	GHashTableIter iter;
+	gpointer value;
+
+	if ( !build_error_files ) return;
+
+	g_hash_table_iter_init(&iter, build_error_files);
+	while ( g_hash_table_iter_next(&iter, NULL, &value) )
 	{
-		SETPTR(current_dir_entered, tmp);
+		BuildErrorFile *error_file = value;
+
+		if ( error_file->lines->len > 0 && error_file->doc && error_file->doc->is_valid )
+		{
+			editor_indicator_set_on_lines(error_file->doc->editor, GEANY_INDICATOR_ERROR,
+				(const gint*) error_file->lines->data, error_file->lines->len);
+		}
+		g_array_set_size(error_file->lines, 0);
 	}
-	msgwin_parse_compiler_error_line(msg, current_dir_entered, &filename, &line);
+}
+
+// msg is modified, trailing whitespace is removed
+static void process_build_output_line(gchar *msg, gint color)
+{
+	BuildLineMatch match;
+	gsize len;
 
-	if (line != -1 && filename != NULL)
+	g_strchomp(msg);
+	len = strlen(msg);
+	if ( len == 0 ) return;
+
+	build_match_output_line(msg, len, &match);
+
+	switch( match.kind )
 	{
-		GeanyDocument *doc = document_find_by_filename(filename);
+		case BUILD_LINE_IGNORE: return;
 
-		/* limit number of indicators */
-		if (doc && editor_prefs.use_indicators &&
-			build_info.message_count < GEANY_BUILD_ERR_HIGHLIGHT_MAX)
+		case BUILD_LINE_STEAM_WEEKEND:
 		{
-			if (line > 0) /* some compilers, like pdflatex report errors on line 0 */
-				line--;   /* so only adjust the line number if it is greater than 0 */
-			editor_indicator_set_on_line(doc->editor, GEANY_INDICATOR_ERROR, line);
+			on_show_weekend_end_dialog();
+			break;
 		}
-		build_info.message_count++;
-		color = COLOR_RED;	/* error message parsed on the line */
+
+		case BUILD_LINE_ERROR:
+		{
+			BuildErrorFile *error_file = build_lookup_error_file(match.file, match.file_len);
+
+			/* limit number of indicators */
+			if ( error_file->doc && editor_prefs.use_indicators &&
+				build_info.message_count < GEANY_BUILD_ERR_HIGHLIGHT_MAX )
+			{
+				gint line = match.line;
+				if (line > 0) /* some compilers, like pdflatex report errors on line 0 */
+					line--;   /* so only adjust the line number if it is greater than 0 */
+				g_array_append_val(error_file->lines, line);
+			}
+			build_info.message_count++;
+			color = COLOR_RED;	/* error message parsed on the line */
+			break;
+		}
+
+		default: break;
 	}
-	g_free(filename);
 
 	msgwin_compiler_add_string(color, msg);
-	g_free(msg);
 }
 
 static void process_debug_output_line(const gchar *str, gint color)
@@ -2121,7 +2932,10 @@ static gboolean build_iofunc(GIOChannel *ioc, GIOCondition cond, gpointer data)
 		if ( msg )
 		{
 			if ( st == G_IO_STATUS_NORMAL && *msg )
+			{
+				build_timeline_output_seen(msg);
 				process_build_output_line(msg, color);
+			}
 
 			g_free(msg);
 		}
@@ -2148,7 +2962,10 @@ static gboolean debug_iofunc(GIOChannel *ioc, GIOCondition cond, gpointer data)
 		if ( msg )
 		{
 			if ( st == G_IO_STATUS_NORMAL && *msg )
+			{
+				build_timeline_output_seen(msg);
 				process_debug_output_line(msg, color);
+			}
 
 			g_free(msg);
 		}
@@ -2175,6 +2992,9 @@ static gboolean broadcast_iofunc(GIOChannel *ioc, GIOCondition cond, gpointer da
 		st = g_io_channel_read_line(ioc, &msg, NULL, NULL, NULL);
 		if ( msg )
 		{
+			if ( st == G_IO_STATUS_NORMAL && *msg )
+				build_timeline_output_seen(msg);
+
 			// discard broadcast error messages, user will have to debug to get them
 			g_free(msg);
 		}
@@ -2283,6 +3103,7 @@ static void build_exit_cb(GPid child_pid, gint status, gpointer user_data)
 		failure = TRUE;
 	}
 #endif
+	build_flush_error_indicators();
 	show_build_result_message(failure);
 
 	utils_beep();
@@ -2316,19 +3137,21 @@ static void agk_build_exit_cb(GPid child_pid, gint status, gpointer user_data)
 		failure = TRUE;
 	}
 #endif
+	build_flush_error_indicators();
 	show_build_result_message(failure);
 
+	build_timeline_expect_output(NULL, FALSE);
+	msgwin_timeline_mark("compile_exit", failure ? "failed" : NULL);
+	if ( failure || g_run_mode == 0 ) msgwin_timeline_finish(!failure);
+
 	g_spawn_close_pid(child_pid);
 	ui_progress_bar_stop();
 
-	if ( !failure )
-	{
-		//if ( build_prefs.agk_enable_local ) build_run_project_spawn_cmd(app->project);
-		//if ( build_prefs.agk_enable_broadcast ) build_broadcast_project_spawn_cmd(app->project);
-		if ( g_run_mode == 1 ) build_run_project_spawn_cmd(app->project);
-		else if ( g_run_mode == 2 ) build_broadcast_project_spawn_cmd(app->project);
-		else if ( g_run_mode == 3 ) build_debug_project_spawn_cmd(app->project);
-	}
+	if ( !failure && compile_cache_pending && app->project )
+		compile_cache_store(app->project, compile_cache_pending);
+	SETPTR(compile_cache_pending, NULL);
+
+	if ( !failure ) build_run_after_compile();
 
 	build_pid = 0;
 	/* enable build items again */
@@ -2337,6 +3160,26 @@ static void agk_build_exit_cb(GPid child_pid, gint status, gpointer user_data)
 //#endif
 
 
+static void build_run_after_compile(void)
+{
+	//if ( build_prefs.agk_enable_local ) build_run_project_spawn_cmd(app->project);
+	//if ( build_prefs.agk_enable_broadcast ) build_broadcast_project_spawn_cmd(app->project);
+	GPid pid = (GPid) 0;
+
+	if ( g_run_mode == 1 ) pid = build_run_project_spawn_cmd(app->project);
+	else if ( g_run_mode == 2 ) pid = build_broadcast_project_spawn_cmd(app->project);
+	else if ( g_run_mode == 3 ) pid = build_debug_project_spawn_cmd(app->project);
+	else
+	{
+		msgwin_timeline_finish(TRUE);
+		return;
+	}
+
+	// a local run is done once the interpreter launch completes, broadcast and debug wait for the first reply
+	if ( pid == (GPid) 0 ) msgwin_timeline_finish(FALSE);
+}
+
+
 static void run_exit_cb(GPid child_pid, gint status, gpointer user_data)
 {
 	RunInfo *run_info_data = user_data;
@@ -2355,6 +3198,15 @@ static void agk_run_exit_cb(GPid child_pid, gint status, gpointer user_data)
 	g_spawn_close_pid(child_pid);
 	if ( *pid == 0 ) return;
 
+	interpreter_launch_exited(pid);
+
+	if ( (pid == &broadcast_pid || pid == &debug_pid) && timeline_output_phase )
+	{
+		// exited before it reported anything
+		build_timeline_expect_output(NULL, FALSE);
+		msgwin_timeline_finish(FALSE);
+	}
+
 	if ( pid == &debug_pid || pid == &debug_pid2 )
 	{
 		gtk_tree_store_clear(store_debug_callstack);
@@ -4103,7 +4955,12 @@ void build_init(void)
 // compiles the current project
 int build_compile_project(gint run)
 {
+	static const gchar *run_names[] = { "Compile", "Run", "Broadcast", "Debug" };
+	gboolean cache_hit = FALSE;
+	GPid pid;
+
 	g_run_mode = run;
+	msgwin_timeline_start(run_names[CLAMP(run, 0, 3)]);
 
 	// save all files
 	guint i, max = (guint) gtk_notebook_get_n_pages(GTK_NOTEBOOK(main_widgets.notebook));
@@ -4125,10 +4982,21 @@ int build_compile_project(gint run)
 	/* saving may have changed window title, sidebar for another doc, so update */
 	sidebar_update_tag_list(cur_doc, TRUE);
 	ui_set_window_title(cur_doc);
+	msgwin_timeline_mark("save", ngettext("%d file saved", "%d files saved", count), count);
 
 	// start compiler
 	//dialogs_show_msgbox(GTK_MESSAGE_ERROR, "Compile Project %s", app->project ? app->project->name : "NULL");
-	return (int) build_compile_project_spawn_cmd(app->project);
+	pid = build_compile_project_spawn_cmd(app->project, &cache_hit);
+	if ( cache_hit )
+	{
+		// finish the build the way the compiler's exit callback would
+		show_build_result_message(FALSE);
+		msgwin_timeline_mark("compile_cached", NULL);
+		build_run_after_compile();
+		return 1;
+	}
+	if ( pid == (GPid) 0 ) msgwin_timeline_finish(FALSE);
+	return (int) pid;
 }
 
 // compiles and runs the current project
@@ -4153,7 +5021,8 @@ void build_broadcast_project( gint deviceID )
 #else
 	if (broadcast_pid > (GPid) 0)
 	{
-		if ( broadcast_pid > (GPid) 0 ) 
+		if ( broadcast_devices ) broadcast_devices_stop();
+		else if ( broadcast_pid > (GPid) 0 ) 
 		{
 			write(gdb_in.fd, "stop\ndisconnectall\nexit\n", strlen("stop\ndisconnectall\nexit\n") );
 			//kill_process(&broadcast_pid);
@@ -139,6 +139,13 @@ G_MODULE_EXPORT gboolean on_exit_clicked(GtkWidget *widget, gpointer gdata)
 		return TRUE;
 	}
 
+	if ( project_export_running() )
+	{
+		dialogs_show_msgbox(GTK_MESSAGE_WARNING, _("Cannot quit whilst an export is in progress, please wait for it to finish or cancel it"));
+		main_status.quitting = FALSE;
+		return TRUE;
+	}
+
 	main_status.quitting = TRUE;
 
 	if (! check_no_unsaved())
@@ -2237,6 +2244,11 @@ G_MODULE_EXPORT void on_project_export_html5_activate(GtkMenuItem *menuitem, gpo
 #endif
 }
 
+G_MODULE_EXPORT void on_project_export_size_report_activate(GtkMenuItem *menuitem, gpointer user_data)
+{
+	project_export_size_report();
+}
+
 G_MODULE_EXPORT void on_project_export_apk_activate(GtkMenuItem *menuitem, gpointer user_data)
 {
 #ifdef AGK_FREE_VERSION
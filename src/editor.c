@@ -4151,6 +4151,39 @@ void editor_indicator_set_on_line(GeanyEditor *editor, gint indic, gint line)
 }
 
 
+/* Sets indicator @a indic on each of the @a count lines in @a lines, skipping whitespace at
+ * the start and end of each line like editor_indicator_set_on_line(). The indicator is only
+ * selected once and no line text is copied, used to mark all build errors of a document at once. */
+void editor_indicator_set_on_lines(GeanyEditor *editor, gint indic, const gint *lines, guint count)
+{
+	ScintillaObject *sci;
+	gint line_count;
+	guint i;
+
+	g_return_if_fail(editor != NULL);
+
+	sci = editor->sci;
+	line_count = sci_get_line_count(sci);
+	sci_indicator_set(sci, indic);
+
+	for (i = 0; i < count; i++)
+	{
+		gint start, end;
+
+		if (lines[i] < 0 || lines[i] >= line_count)
+			continue;
+
+		start = sci_get_line_indent_position(sci, lines[i]);
+		end = sci_get_line_end_position(sci, lines[i]);
+		while (end > start && isspace((guchar) sci_get_char_at(sci, end - 1)))
+			end--;
+
+		if (start < end)
+			sci_indicator_fill(sci, start, end - start);
+	}
+}
+
+
 /**
  *  Sets an indicator on the range specified by @a start and @a end.
  *  No error checking or whitespace removal is performed, this should be done by the calling
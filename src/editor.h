@@ -264,6 +264,8 @@ void editor_set_font(GeanyEditor *editor, const gchar *font);
 
 void editor_indicator_set_on_line(GeanyEditor *editor, gint indic, gint line);
 
+void editor_indicator_set_on_lines(GeanyEditor *editor, gint indic, const gint *lines, guint count);
+
 void editor_indicator_clear_errors(GeanyEditor *editor);
 
 void editor_indicator_set_on_range(GeanyEditor *editor, gint indic, gint start, gint end);
@@ -41,6 +41,13 @@
   #include <time.h>
 #endif
 
+#ifdef MINIZ_NO_TIME
+  typedef struct mz_dummy_time_t_tag { int m_dummy; } mz_dummy_time_t;
+  #define MZ_TIME_T mz_dummy_time_t
+#else
+  #define MZ_TIME_T time_t
+#endif
+
 #if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__i386) || defined(__i486__) || defined(__i486) || defined(i386) || defined(__ia64__) || defined(__x86_64__)
 // MINIZ_X86_OR_X64_CPU is only used to help set the below macros.
 #define MINIZ_X86_OR_X64_CPU 1
@@ -382,6 +389,8 @@ typedef struct mz_zip_archive_tag
   mz_zip_mode m_zip_mode;
 
   mz_uint m_file_offset_alignment;
+  // If more than 1, the data of entries stored without compression is aligned to this by padding the local header's extra field (like zipalign). Can be changed between adds, must be less than 65536.
+  mz_uint m_stored_data_alignment;
 
   mz_alloc_func m_pAlloc;
   mz_free_func m_pFree;
@@ -485,6 +494,8 @@ mz_bool mz_zip_writer_init_from_reader(mz_zip_archive *pZip, const char *pFilena
 // level_and_flags - compression level (0-10, see MZ_BEST_SPEED, MZ_BEST_COMPRESSION, etc.) logically OR'd with zero or more mz_zip_flags, or just set to MZ_DEFAULT_COMPRESSION.
 mz_bool mz_zip_writer_add_mem(mz_zip_archive *pZip, const char *pArchive_name, const void *pBuf, size_t buf_size, mz_uint level_and_flags);
 mz_bool mz_zip_writer_add_mem_ex(mz_zip_archive *pZip, const char *pArchive_name, const void *pBuf, size_t buf_size, const void *pComment, mz_uint16 comment_size, mz_uint level_and_flags, mz_uint64 uncomp_size, mz_uint32 uncomp_crc32);
+// Same as mz_zip_writer_add_mem_ex(), but records *last_modified instead of the current time if last_modified isn't NULL.
+mz_bool mz_zip_writer_add_mem_ex_v2(mz_zip_archive *pZip, const char *pArchive_name, const void *pBuf, size_t buf_size, const void *pComment, mz_uint16 comment_size, mz_uint level_and_flags, mz_uint64 uncomp_size, mz_uint32 uncomp_crc32, const MZ_TIME_T *last_modified);
 
 #ifndef MINIZ_NO_STDIO
 // Adds the contents of a disk file to an archive. This function also records the disk file's modified time into the archive.
@@ -47,8 +47,10 @@
 #include <string.h>
 #include <stdlib.h>
 #include <time.h>
+#include <errno.h>
 
 #include <gdk/gdkkeysyms.h>
+#include <glib/gstdio.h>
 
 
 /* used for parse_file_line */
@@ -69,6 +71,8 @@ static void prepare_msg_tree_view(void);
 static void prepare_status_tree_view(void);
 static void prepare_compiler_tree_view(void);
 static void prepare_debug_tree_view(void);
+static void prepare_timeline_tree_view(void);
+static void prepare_sizes_tree_view(void);
 static GtkWidget *create_message_popup_menu(gint type);
 static gboolean on_msgwin_button_press_event(GtkWidget *widget, GdkEventButton *event,
 																			gpointer user_data);
@@ -108,6 +112,8 @@ void msgwin_init(void)
 	prepare_msg_tree_view();
 	prepare_compiler_tree_view();
 	prepare_debug_tree_view();
+	prepare_timeline_tree_view();
+	prepare_sizes_tree_view();
 	msgwindow.popup_status_menu = create_message_popup_menu(MSG_STATUS);
 	msgwindow.popup_msg_menu = create_message_popup_menu(MSG_MESSAGE);
 	msgwindow.popup_compiler_menu = create_message_popup_menu(MSG_COMPILER);
@@ -120,6 +126,7 @@ void msgwin_init(void)
 
 void msgwin_finalize(void)
 {
+	msgwin_timeline_finish(FALSE);
 	g_free(msgwindow.messages_dir);
 }
 
@@ -273,6 +280,175 @@ static void prepare_debug_tree_view(void)
 	/*g_signal_connect(selection, "changed", G_CALLBACK(on_msg_tree_selection_changed), NULL);*/
 }
 
+enum
+{
+	TIMELINE_COLUMN_COLOR,
+	TIMELINE_COLUMN_PHASE,
+	TIMELINE_COLUMN_AT,
+	TIMELINE_COLUMN_DELTA,
+	TIMELINE_COLUMN_DETAIL,
+	TIMELINE_N_COLUMNS
+};
+
+static void timeline_ms_cell_data_func(GtkTreeViewColumn *column, GtkCellRenderer *cell,
+									   GtkTreeModel *model, GtkTreeIter *iter, gpointer data)
+{
+	gdouble ms;
+	gchar text[32];
+
+	gtk_tree_model_get(model, iter, GPOINTER_TO_INT(data), &ms, -1);
+	if (ms < 0)
+		text[0] = '\0';
+	else
+		g_snprintf(text, sizeof(text), "%.1f ms", ms);
+	g_object_set(cell, "text", text, NULL);
+}
+
+static void prepare_timeline_tree_view(void)
+{
+	static const gchar *titles[] = { N_("Phase"), N_("Time"), N_("Duration"), N_("Details") };
+	GtkCellRenderer *renderer;
+	GtkTreeViewColumn *column;
+	GtkWidget *scroll;
+	gint i;
+
+	msgwindow.store_timeline = gtk_list_store_new(TIMELINE_N_COLUMNS, GDK_TYPE_COLOR,
+		G_TYPE_STRING, G_TYPE_DOUBLE, G_TYPE_DOUBLE, G_TYPE_STRING);
+	msgwindow.tree_timeline = gtk_tree_view_new_with_model(GTK_TREE_MODEL(msgwindow.store_timeline));
+	g_object_unref(msgwindow.store_timeline);
+
+	for (i = 0; i < (gint) G_N_ELEMENTS(titles); i++)
+	{
+		gint col = TIMELINE_COLUMN_PHASE + i;
+
+		renderer = gtk_cell_renderer_text_new();
+		column = gtk_tree_view_column_new();
+		gtk_tree_view_column_set_title(column, _(titles[i]));
+		gtk_tree_view_column_pack_start(column, renderer, TRUE);
+		gtk_tree_view_column_add_attribute(column, renderer, "foreground-gdk", TIMELINE_COLUMN_COLOR);
+		if (col == TIMELINE_COLUMN_AT || col == TIMELINE_COLUMN_DELTA)
+		{
+			g_object_set(renderer, "xalign", 1.0, NULL);
+			gtk_tree_view_column_set_cell_data_func(column, renderer,
+				timeline_ms_cell_data_func, GINT_TO_POINTER(col), NULL);
+		}
+		else
+			gtk_tree_view_column_add_attribute(column, renderer, "text", col);
+		gtk_tree_view_column_set_resizable(column, TRUE);
+		gtk_tree_view_append_column(GTK_TREE_VIEW(msgwindow.tree_timeline), column);
+	}
+
+	gtk_tree_view_set_enable_search(GTK_TREE_VIEW(msgwindow.tree_timeline), FALSE);
+	ui_widget_modify_font_from_string(msgwindow.tree_timeline, interface_prefs.msgwin_font);
+
+	scroll = gtk_scrolled_window_new(NULL, NULL);
+	gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scroll),
+		GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
+	gtk_scrolled_window_set_shadow_type(GTK_SCROLLED_WINDOW(scroll), GTK_SHADOW_IN);
+	gtk_container_add(GTK_CONTAINER(scroll), msgwindow.tree_timeline);
+	gtk_widget_show_all(scroll);
+
+	gtk_notebook_insert_page(GTK_NOTEBOOK(msgwindow.notebook), scroll,
+		gtk_label_new(_("Timeline")), MSG_TIMELINE);
+}
+
+enum
+{
+	SIZES_COLUMN_COLOR,
+	SIZES_COLUMN_NAME,
+	SIZES_COLUMN_FILES,
+	SIZES_COLUMN_SIZE,
+	SIZES_COLUMN_COMPRESSED,
+	SIZES_COLUMN_RATIO,
+	SIZES_COLUMN_DUPLICATE,
+	SIZES_N_COLUMNS
+};
+
+static void sizes_cell_data_func(GtkTreeViewColumn *column, GtkCellRenderer *cell,
+								 GtkTreeModel *model, GtkTreeIter *iter, gpointer data)
+{
+	gint col = GPOINTER_TO_INT(data);
+	gchar *text = NULL;
+
+	if (col == SIZES_COLUMN_RATIO)
+	{
+		gdouble ratio;
+
+		gtk_tree_model_get(model, iter, col, &ratio, -1);
+		text = g_strdup_printf("%.0f%%", ratio * 100);
+	}
+	else if (col == SIZES_COLUMN_FILES)
+	{
+		gint files;
+
+		/* only the extension rows count files */
+		gtk_tree_model_get(model, iter, col, &files, -1);
+		if (files > 0)
+			text = g_strdup_printf("%d", files);
+	}
+	else
+	{
+		guint64 size;
+
+		gtk_tree_model_get(model, iter, col, &size, -1);
+		text = utils_make_human_readable_str(size, 1, 0);
+	}
+	g_object_set(cell, "text", FALLBACK(text, ""), NULL);
+	g_free(text);
+}
+
+static void prepare_sizes_tree_view(void)
+{
+	static const gchar *titles[] = { N_("File"), N_("Files"), N_("Size"), N_("Compressed"),
+		N_("Ratio"), N_("Duplicate of") };
+	GtkCellRenderer *renderer;
+	GtkTreeViewColumn *column;
+	GtkWidget *scroll;
+	gint i;
+
+	msgwindow.store_sizes = gtk_tree_store_new(SIZES_N_COLUMNS, GDK_TYPE_COLOR, G_TYPE_STRING,
+		G_TYPE_INT, G_TYPE_UINT64, G_TYPE_UINT64, G_TYPE_DOUBLE, G_TYPE_STRING);
+	msgwindow.tree_sizes = gtk_tree_view_new_with_model(GTK_TREE_MODEL(msgwindow.store_sizes));
+	g_object_unref(msgwindow.store_sizes);
+
+	for (i = 0; i < (gint) G_N_ELEMENTS(titles); i++)
+	{
+		gint col = SIZES_COLUMN_NAME + i;
+
+		renderer = gtk_cell_renderer_text_new();
+		column = gtk_tree_view_column_new();
+		gtk_tree_view_column_set_title(column, _(titles[i]));
+		gtk_tree_view_column_pack_start(column, renderer, TRUE);
+		gtk_tree_view_column_add_attribute(column, renderer, "foreground-gdk", SIZES_COLUMN_COLOR);
+		if (col == SIZES_COLUMN_NAME || col == SIZES_COLUMN_DUPLICATE)
+			gtk_tree_view_column_add_attribute(column, renderer, "text", col);
+		else
+		{
+			g_object_set(renderer, "xalign", 1.0, NULL);
+			gtk_tree_view_column_set_cell_data_func(column, renderer,
+				sizes_cell_data_func, GINT_TO_POINTER(col), NULL);
+		}
+		/* clicking a header sorts the extensions and the files within them */
+		gtk_tree_view_column_set_sort_column_id(column, col);
+		gtk_tree_view_column_set_resizable(column, TRUE);
+		gtk_tree_view_append_column(GTK_TREE_VIEW(msgwindow.tree_sizes), column);
+	}
+
+	gtk_tree_view_set_enable_search(GTK_TREE_VIEW(msgwindow.tree_sizes), FALSE);
+	ui_widget_modify_font_from_string(msgwindow.tree_sizes, interface_prefs.msgwin_font);
+
+	scroll = gtk_scrolled_window_new(NULL, NULL);
+	gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scroll),
+		GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
+	gtk_scrolled_window_set_shadow_type(GTK_SCROLLED_WINDOW(scroll), GTK_SHADOW_IN);
+	gtk_container_add(GTK_CONTAINER(scroll), msgwindow.tree_sizes);
+	gtk_widget_show_all(scroll);
+
+	gtk_notebook_insert_page(GTK_NOTEBOOK(msgwindow.notebook), scroll,
+		gtk_label_new(_("Export Size")), MSG_SIZES);
+}
+
+
 static const GdkColor color_error_dark = {0, 53000, 0, 0};
 static const GdkColor color_error_light = {0, 65535, 32768, 32768};
 
@@ -1138,6 +1314,8 @@ void msgwin_switch_tab(gint tabnum, gboolean show)
 		case MSG_SCRATCH: widget = msgwindow.scribble; break;
 		case MSG_COMPILER: widget = msgwindow.tree_compiler; break;
 		case MSG_DEBUG: widget = msgwindow.tree_debug_log; break;
+		case MSG_TIMELINE: widget = msgwindow.tree_timeline; break;
+		case MSG_SIZES: widget = msgwindow.tree_sizes; break;
 		case MSG_STATUS: widget = msgwindow.tree_status; break;
 		case MSG_MESSAGE: widget = msgwindow.tree_msg; break;
 #ifdef HAVE_VTE
@@ -1183,6 +1361,12 @@ void msgwin_clear_tab(gint tabnum)
 			gtk_list_store_clear(msgwindow.store_debug_log);
 			return;
 
+		case MSG_TIMELINE: store = msgwindow.store_timeline; break;
+
+		case MSG_SIZES:
+			gtk_tree_store_clear(msgwindow.store_sizes);
+			return;
+
 		case MSG_STATUS: store = msgwindow.store_status; break;
 		default: return;
 	}
@@ -1190,3 +1374,321 @@ void msgwin_clear_tab(gint tabnum)
 		return;
 	gtk_list_store_clear(store);
 }
+
+
+/* Phase timeline of the current compile, run or export.
+ * Callers start a run, mark each phase as it completes and finish it; the phases
+ * are shown in the Timeline tab and the finished run is appended as one JSON
+ * object per line to timeline.log in the config directory. */
+typedef struct
+{
+	gchar	*phase;
+	gchar	*detail;
+	gdouble	 at_ms;		/* since the start of the run */
+	gdouble	 delta_ms;	/* since the previous mark */
+}
+TimelineEvent;
+
+static struct
+{
+	gboolean	 running;
+	gchar		*name;
+	GTimeVal	 started;	/* wall clock, only for the log */
+	gdouble		 start_ms;	/* monotonic */
+	gdouble		 last_ms;
+	GArray		*events;
+}
+timeline = { FALSE, NULL, { 0, 0 }, 0, 0, NULL };
+
+
+static gdouble timeline_now_ms(void)
+{
+#if GLIB_CHECK_VERSION(2, 28, 0)
+	return g_get_monotonic_time() / 1000.0;
+#else
+	static GTimer *timer = NULL;
+
+	if (timer == NULL)
+		timer = g_timer_new();
+	return g_timer_elapsed(timer, NULL) * 1000.0;
+#endif
+}
+
+
+static void timeline_add_row(gint msg_color, const gchar *phase, gdouble at_ms, gdouble delta_ms,
+							 const gchar *detail)
+{
+	GtkTreeIter iter;
+	GtkTreePath *path;
+
+	gtk_list_store_append(msgwindow.store_timeline, &iter);
+	gtk_list_store_set(msgwindow.store_timeline, &iter,
+		TIMELINE_COLUMN_COLOR, get_color(msg_color),
+		TIMELINE_COLUMN_PHASE, phase,
+		TIMELINE_COLUMN_AT, at_ms,
+		TIMELINE_COLUMN_DELTA, delta_ms,
+		TIMELINE_COLUMN_DETAIL, FALLBACK(detail, ""), -1);
+
+	path = gtk_tree_model_get_path(GTK_TREE_MODEL(msgwindow.store_timeline), &iter);
+	gtk_tree_view_scroll_to_cell(GTK_TREE_VIEW(msgwindow.tree_timeline), path, NULL, FALSE, 0, 0);
+	gtk_tree_path_free(path);
+}
+
+
+static void timeline_append_json_string(GString *str, const gchar *text)
+{
+	const gchar *p;
+
+	g_string_append_c(str, '"');
+	for (p = FALLBACK(text, ""); *p; p++)
+	{
+		switch (*p)
+		{
+			case '"': g_string_append(str, "\\\""); break;
+			case '\\': g_string_append(str, "\\\\"); break;
+			case '\n': g_string_append(str, "\\n"); break;
+			case '\r': g_string_append(str, "\\r"); break;
+			case '\t': g_string_append(str, "\\t"); break;
+			default:
+				if ((guchar) *p < 0x20)
+					g_string_append_printf(str, "\\u%04x", (guint) (guchar) *p);
+				else
+					g_string_append_c(str, *p);
+		}
+	}
+	g_string_append_c(str, '"');
+}
+
+
+static void timeline_append_json_ms(GString *str, const gchar *key, gdouble ms)
+{
+	gchar buf[G_ASCII_DTOSTR_BUF_SIZE];
+
+	g_string_append_printf(str, "\"%s\":%s", key, g_ascii_formatd(buf, sizeof(buf), "%.3f", ms));
+}
+
+
+static void timeline_write_log(gboolean success, gdouble total_ms)
+{
+	GString *str = g_string_sized_new(512);
+	gchar *started = g_time_val_to_iso8601(&timeline.started);
+	gchar *filename;
+	FILE *fp;
+	guint i;
+
+	g_string_append(str, "{\"ide\":");
+	timeline_append_json_string(str, AGK_VERSION);
+	g_string_append(str, ",\"run\":");
+	timeline_append_json_string(str, timeline.name);
+	g_string_append(str, ",\"started\":");
+	timeline_append_json_string(str, started);
+	g_string_append_printf(str, ",\"success\":%s,", success ? "true" : "false");
+	timeline_append_json_ms(str, "total_ms", total_ms);
+	g_string_append(str, ",\"phases\":[");
+	for (i = 0; i < timeline.events->len; i++)
+	{
+		TimelineEvent *event = &g_array_index(timeline.events, TimelineEvent, i);
+
+		g_string_append(str, i ? ",{\"phase\":" : "{\"phase\":");
+		timeline_append_json_string(str, event->phase);
+		g_string_append_c(str, ',');
+		timeline_append_json_ms(str, "at_ms", event->at_ms);
+		g_string_append_c(str, ',');
+		timeline_append_json_ms(str, "delta_ms", event->delta_ms);
+		if (!EMPTY(event->detail))
+		{
+			g_string_append(str, ",\"detail\":");
+			timeline_append_json_string(str, event->detail);
+		}
+		g_string_append_c(str, '}');
+	}
+	g_string_append(str, "]}\n");
+
+	filename = g_build_filename(app->configdir, "timeline.log", NULL);
+	fp = g_fopen(filename, "a");
+	if (fp != NULL)
+	{
+		fwrite(str->str, 1, str->len, fp);
+		fclose(fp);
+	}
+	else
+		geany_debug("Could not append to %s: %s", filename, g_strerror(errno));
+
+	g_free(filename);
+	g_free(started);
+	g_string_free(str, TRUE);
+}
+
+
+static void timeline_free_events(void)
+{
+	guint i;
+
+	if (timeline.events == NULL)
+		return;
+
+	for (i = 0; i < timeline.events->len; i++)
+	{
+		TimelineEvent *event = &g_array_index(timeline.events, TimelineEvent, i);
+
+		g_free(event->phase);
+		g_free(event->detail);
+	}
+	g_array_set_size(timeline.events, 0);
+}
+
+
+/* Starts timing a new run called @a name, e.g. "Run" or "Android export", and clears the
+ * Timeline tab. A run that is still active is finished as failed first. */
+void msgwin_timeline_start(const gchar *name)
+{
+	msgwin_timeline_finish(FALSE);
+
+	if (timeline.events == NULL)
+		timeline.events = g_array_new(FALSE, FALSE, sizeof(TimelineEvent));
+
+	SETPTR(timeline.name, g_strdup(name));
+	g_get_current_time(&timeline.started);
+	timeline.start_ms = timeline_now_ms();
+	timeline.last_ms = timeline.start_ms;
+	timeline.running = TRUE;
+
+	msgwin_clear_tab(MSG_TIMELINE);
+	timeline_add_row(COLOR_BLUE, name, 0, -1, NULL);
+}
+
+
+/* Records that @a phase has just completed, @a format is an optional printf-style detail.
+ * Does nothing when no run is active. */
+void msgwin_timeline_mark(const gchar *phase, const gchar *format, ...)
+{
+	TimelineEvent event;
+	gdouble now;
+
+	if (!timeline.running)
+		return;
+
+	now = timeline_now_ms();
+	event.phase = g_strdup(phase);
+	event.detail = NULL;
+	event.at_ms = now - timeline.start_ms;
+	event.delta_ms = now - timeline.last_ms;
+	timeline.last_ms = now;
+
+	if (format != NULL)
+	{
+		va_list args;
+
+		va_start(args, format);
+		event.detail = g_strdup_vprintf(format, args);
+		va_end(args);
+	}
+	g_array_append_val(timeline.events, event);
+
+	timeline_add_row(COLOR_BLACK, event.phase, event.at_ms, event.delta_ms, event.detail);
+}
+
+
+/* Ends the active run and appends it to the log, does nothing when no run is active. */
+void msgwin_timeline_finish(gboolean success)
+{
+	gdouble total_ms;
+
+	if (!timeline.running)
+		return;
+
+	timeline.running = FALSE;
+	total_ms = timeline_now_ms() - timeline.start_ms;
+
+	timeline_add_row(success ? COLOR_BLUE : COLOR_RED, success ? _("Finished") : _("Failed"),
+		total_ms, -1, NULL);
+	timeline_write_log(success, total_ms);
+	timeline_free_events();
+}
+
+
+gboolean msgwin_timeline_is_running(void)
+{
+	return timeline.running;
+}
+
+
+/* Export size report, one row per file extension with its files below it.
+ * Callers start a report, add each file and finish it; the rows are then sorted by
+ * compressed size so the biggest contributors come first. */
+static GHashTable *sizes_groups = NULL;	/* extension -> GtkTreeIter of its row */
+
+
+/* Clears the Export Size tab for a new report. */
+void msgwin_sizes_start(void)
+{
+	if (sizes_groups == NULL)
+		sizes_groups = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+			(GDestroyNotify) gtk_tree_iter_free);
+	else
+		g_hash_table_remove_all(sizes_groups);
+
+	/* rows are added unsorted, msgwin_sizes_finish() sorts them once */
+	gtk_tree_sortable_set_sort_column_id(GTK_TREE_SORTABLE(msgwindow.store_sizes),
+		GTK_TREE_SORTABLE_UNSORTED_SORT_COLUMN_ID, GTK_SORT_DESCENDING);
+	msgwin_clear_tab(MSG_SIZES);
+}
+
+
+/* Adds @a file, as it is named in the export, under the row for its extension.
+ * @a duplicate_of is the file with the same contents that was added first, or NULL. */
+void msgwin_sizes_add(const gchar *file, guint64 size, guint64 compressed, const gchar *duplicate_of)
+{
+	const gchar *name = strrchr(file, '/');
+	const gchar *ext = strrchr(name ? name : file, '.');
+	GtkTreeIter *group;
+	GtkTreeIter iter;
+	gint files;
+	guint64 group_size, group_compressed;
+
+	g_return_if_fail(sizes_groups != NULL);
+
+	if (ext == NULL)
+		ext = _("(none)");
+
+	group = g_hash_table_lookup(sizes_groups, ext);
+	if (group == NULL)
+	{
+		gtk_tree_store_append(msgwindow.store_sizes, &iter, NULL);
+		gtk_tree_store_set(msgwindow.store_sizes, &iter,
+			SIZES_COLUMN_COLOR, get_color(COLOR_BLUE),
+			SIZES_COLUMN_NAME, ext, SIZES_COLUMN_FILES, 0,
+			SIZES_COLUMN_SIZE, (guint64) 0, SIZES_COLUMN_COMPRESSED, (guint64) 0,
+			SIZES_COLUMN_RATIO, 1.0, SIZES_COLUMN_DUPLICATE, "", -1);
+		group = gtk_tree_iter_copy(&iter);
+		g_hash_table_insert(sizes_groups, g_strdup(ext), group);
+	}
+
+	gtk_tree_model_get(GTK_TREE_MODEL(msgwindow.store_sizes), group,
+		SIZES_COLUMN_FILES, &files, SIZES_COLUMN_SIZE, &group_size,
+		SIZES_COLUMN_COMPRESSED, &group_compressed, -1);
+	files++;
+	group_size += size;
+	group_compressed += compressed;
+	gtk_tree_store_set(msgwindow.store_sizes, group, SIZES_COLUMN_FILES, files,
+		SIZES_COLUMN_SIZE, group_size, SIZES_COLUMN_COMPRESSED, group_compressed,
+		SIZES_COLUMN_RATIO, group_size ? (gdouble) group_compressed / group_size : 1.0, -1);
+
+	gtk_tree_store_append(msgwindow.store_sizes, &iter, group);
+	gtk_tree_store_set(msgwindow.store_sizes, &iter,
+		SIZES_COLUMN_COLOR, get_color(duplicate_of ? COLOR_DARK_RED : COLOR_BLACK),
+		SIZES_COLUMN_NAME, file, SIZES_COLUMN_FILES, 0,
+		SIZES_COLUMN_SIZE, size, SIZES_COLUMN_COMPRESSED, compressed,
+		SIZES_COLUMN_RATIO, size ? (gdouble) compressed / size : 1.0,
+		SIZES_COLUMN_DUPLICATE, FALLBACK(duplicate_of, ""), -1);
+}
+
+
+/* Sorts the report by compressed size, biggest first. */
+void msgwin_sizes_finish(void)
+{
+	gtk_tree_sortable_set_sort_column_id(GTK_TREE_SORTABLE(msgwindow.store_sizes),
+		SIZES_COLUMN_COMPRESSED, GTK_SORT_DESCENDING);
+	if (sizes_groups != NULL)
+		g_hash_table_remove_all(sizes_groups);
+}
@@ -45,6 +45,8 @@ typedef enum
 	MSG_MESSAGE,	/**< Index of the messages tab */
 	MSG_SCRATCH,	/**< Index of the scratch tab */
 	MSG_DEBUG,
+	MSG_TIMELINE,	/**< Index of the build/export timeline tab */
+	MSG_SIZES,		/**< Index of the export size report tab */
 	MSG_VTE			/**< Index of the VTE tab */
 } MessageWindowTabNum;
 
@@ -56,8 +58,12 @@ typedef struct
 	GtkListStore	*store_msg;
 	GtkListStore	*store_compiler;
 	GtkListStore	*store_debug_log;
+	GtkListStore	*store_timeline;
+	GtkTreeStore	*store_sizes;
 	GtkWidget		*tree_compiler;
 	GtkWidget		*tree_debug_log;
+	GtkWidget		*tree_timeline;
+	GtkWidget		*tree_sizes;
 	GtkWidget		*tree_status;
 	GtkWidget		*tree_msg;
 	GtkWidget		*scribble;
@@ -107,6 +113,22 @@ void msgwin_parse_compiler_error_line(const gchar *string, const gchar *dir,
 
 gboolean msgwin_goto_messages_file_line(gboolean focus_editor);
 
+
+void msgwin_timeline_start(const gchar *name);
+
+void msgwin_timeline_mark(const gchar *phase, const gchar *format, ...) G_GNUC_PRINTF (2, 3);
+
+void msgwin_timeline_finish(gboolean success);
+
+gboolean msgwin_timeline_is_running(void);
+
+
+void msgwin_sizes_start(void);
+
+void msgwin_sizes_add(const gchar *file, guint64 size, guint64 compressed, const gchar *duplicate_of);
+
+void msgwin_sizes_finish(void);
+
 G_END_DECLS
 
 #endif
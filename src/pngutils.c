@@ -0,0 +1,111 @@
+/*
+ *      pngutils.c - this file is part of Geany, a fast and lightweight IDE
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License along
+ *      with this program; if not, write to the Free Software Foundation, Inc.,
+ *      51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * PNG encoding that miniz doesn't do itself. Only needs GLib and miniz, so tests/png can
+ * check it without GTK.
+ */
+
+#include <string.h>
+#include <glib.h>
+
+#include "miniz.h"
+#include "pngutils.h"
+
+
+static void pngutils_put_uint32( guint8 *dst, guint32 value )
+{
+	dst[0] = (value >> 24) & 0xFF;
+	dst[1] = (value >> 16) & 0xFF;
+	dst[2] = (value >> 8) & 0xFF;
+	dst[3] = value & 0xFF;
+}
+
+
+static void pngutils_put_chunk( GByteArray *png, const gchar *type, const guint8 *data, guint32 length )
+{
+	guint8 buf[4];
+	mz_ulong crc = mz_crc32( MZ_CRC32_INIT, (const guint8*) type, 4 );
+
+	pngutils_put_uint32( buf, length );
+	g_byte_array_append( png, buf, 4 );
+	g_byte_array_append( png, (const guint8*) type, 4 );
+	if ( length > 0 )
+	{
+		g_byte_array_append( png, data, length );
+		crc = mz_crc32( crc, data, length );
+	}
+	pngutils_put_uint32( buf, (guint32) crc );
+	g_byte_array_append( png, buf, 4 );
+}
+
+
+/* Apple's CgBI variant of PNG, the same as "pngcrush -iphone" writes. A CgBI chunk comes before
+ * IHDR, pixels are premultiplied BGRA, and the image data is raw deflate without the zlib header
+ * and checksum. Returns memory to be freed with g_free. */
+void *pngutils_write_cgbi_in_memory( const guint8 *pixels, gint width, gint height, gint channels, gint rowstride, size_t *png_size )
+{
+	static const guint8 signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	static const guint8 cgbi[4] = { 0x50, 0x00, 0x20, 0x06 };
+	guint8 ihdr[13] = { 0 };
+	gsize row_size = 1 + (gsize) width * 4;
+	guint8 *raw;
+	void *idat;
+	size_t idat_size = 0;
+	GByteArray *png;
+	gint x, y;
+
+	raw = g_try_malloc( row_size * height );
+	if ( !raw ) return NULL;
+
+	for( y = 0; y < height; y++ )
+	{
+		const guint8 *src = pixels + (gsize) y * rowstride;
+		guint8 *dst = raw + (gsize) y * row_size;
+
+		*dst++ = 0; // no filter
+		for( x = 0; x < width; x++, src += channels, dst += 4 )
+		{
+			guint alpha = (channels == 4) ? src[3] : 255;
+			dst[0] = (src[2] * alpha + 127) / 255;
+			dst[1] = (src[1] * alpha + 127) / 255;
+			dst[2] = (src[0] * alpha + 127) / 255;
+			dst[3] = alpha;
+		}
+	}
+
+	idat = tdefl_compress_mem_to_heap( raw, row_size * height, &idat_size, tdefl_create_comp_flags_from_zip_params( MZ_BEST_COMPRESSION, -15, MZ_DEFAULT_STRATEGY ) );
+	g_free( raw );
+	if ( !idat ) return NULL;
+
+	pngutils_put_uint32( ihdr, width );
+	pngutils_put_uint32( ihdr + 4, height );
+	ihdr[8] = 8; // bit depth
+	ihdr[9] = 6; // RGBA
+
+	png = g_byte_array_sized_new( idat_size + 64 );
+	g_byte_array_append( png, signature, sizeof(signature) );
+	pngutils_put_chunk( png, "CgBI", cgbi, sizeof(cgbi) );
+	pngutils_put_chunk( png, "IHDR", ihdr, sizeof(ihdr) );
+	pngutils_put_chunk( png, "IDAT", idat, idat_size );
+	pngutils_put_chunk( png, "IEND", NULL, 0 );
+	mz_free( idat );
+
+	*png_size = png->len;
+	return g_byte_array_free( png, FALSE );
+}
@@ -0,0 +1,29 @@
+/*
+ *      pngutils.h - this file is part of Geany, a fast and lightweight IDE
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License along
+ *      with this program; if not, write to the Free Software Foundation, Inc.,
+ *      51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef GEANY_PNGUTILS_H
+#define GEANY_PNGUTILS_H 1
+
+G_BEGIN_DECLS
+
+void *pngutils_write_cgbi_in_memory( const guint8 *pixels, gint width, gint height, gint channels, gint rowstride, size_t *png_size );
+
+G_END_DECLS
+
+#endif
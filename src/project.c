@@ -28,6 +28,8 @@
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
+/* gstdio.h also includes sys/stat.h */
+#include <glib/gstdio.h>
 
 #include "project.h"
 
@@ -101,6 +103,7 @@ static void init_stash_prefs(void);
 static gint ios_exporting_player = 0;
 
 #define AGK_CLEAR_STR(dst) if((dst)) g_free((dst)); (dst)
+#define AGK_AAPT2_CACHE_MAX_SIZE G_GINT64_CONSTANT(256*1024*1024)
 
 /* TODO: this should be ported to Glade like the project preferences dialog,
  * then we can get rid of the PropertyDialogElements struct altogether as
@@ -459,397 +462,774 @@ void project_import(void)
 	}
 }
 
-static void on_html5_dialog_response(GtkDialog *dialog, gint response, gpointer user_data)
+// An export running on a worker thread. The worker reports its current stage, progress and completed
+// stages through the task, and the main thread polls it to update the status bar and the timeline,
+// so the editor stays usable. Cancelling only sets a flag that the worker checks between steps.
+typedef struct ExportTask ExportTask;
+typedef gboolean (*ExportTaskFunc)( ExportTask *task, gpointer data );
+typedef void (*ExportTaskDoneFunc)( ExportTask *task, gboolean success, gpointer data );
+
+typedef struct ExportTaskMark
 {
-	static int running = 0;
-	if ( running ) return;
+	gchar *phase;
+	gchar *detail;
+} ExportTaskMark;
 
-	running = 1;
+struct ExportTask
+{
+	gchar *name;
+	ExportTaskFunc func;
+	ExportTaskDoneFunc done_func;
+	gpointer data;
+	volatile gint cancel;
+	GtkWidget *label; // optional, also shows the progress, set by the caller on the main thread
+
+	// written by the worker and read by the main thread
+	GMutex *mutex;
+	gchar *stage;
+	guint64 stage_done;
+	guint64 stage_total; // 0 if the stage doesn't know its size
+	GQueue *marks; // ExportTaskMark, stages finished since the last poll
+	gboolean finished;
+	gboolean success;
+	gchar *error; // first error
+};
+
+static guint export_tasks_running = 0;
+static ExportTask *export_timeline_task = NULL; // exports can overlap, only the first one started is timed
+
+static void export_task_free( ExportTask *task )
+{
+	ExportTaskMark *mark;
 
-	// save current values
-	if ( app->project )
+	while ( (mark = g_queue_pop_head( task->marks )) )
 	{
-		GtkWidget *widget;
-		widget = ui_lookup_widget(ui_widgets.html5_dialog, "html5_commands_combo");
-		app->project->html5_settings.commands_used = gtk_combo_box_get_active(GTK_COMBO_BOX_TEXT(widget));
-		
-		widget = ui_lookup_widget(ui_widgets.html5_dialog, "html5_dynamic_memory");
-		app->project->html5_settings.dynamic_memory = gtk_toggle_button_get_active( GTK_TOGGLE_BUTTON(widget) );
-				
-		// output
-		widget = ui_lookup_widget(ui_widgets.html5_dialog, "html5_output_file_entry");
-		AGK_CLEAR_STR(app->project->html5_settings.output_path) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+		g_free( mark->phase );
+		g_free( mark->detail );
+		g_free( mark );
 	}
+	g_queue_free( task->marks );
+	g_mutex_free( task->mutex );
+	g_free( task->name );
+	g_free( task->stage );
+	g_free( task->error );
+	g_free( task );
+}
 
-	if ( response != 1 )
+// only the first error is kept, later ones are usually caused by it
+static void export_task_error( ExportTask *task, const gchar *format, ... ) G_GNUC_PRINTF(2, 3);
+static void export_task_error( ExportTask *task, const gchar *format, ... )
+{
+	va_list args;
+	gchar *error;
+
+	va_start( args, format );
+	error = g_strdup_vprintf( format, args );
+	va_end( args );
+
+	g_mutex_lock( task->mutex );
+	if ( !task->error ) task->error = error;
+	else g_free( error );
+	g_mutex_unlock( task->mutex );
+}
+
+static gboolean export_task_cancelled( ExportTask *task )
+{
+	return g_atomic_int_get( &task->cancel ) != 0;
+}
+
+// called from the dialog, the worker stops at its next check
+static void export_task_cancel( ExportTask *task )
+{
+	g_atomic_int_set( &task->cancel, 1 );
+}
+
+// sets the current stage, NULL keeps the stage and only updates the progress
+static void export_task_progress( ExportTask *task, const gchar *stage, guint64 done, guint64 total )
+{
+	g_mutex_lock( task->mutex );
+	if ( stage && g_strcmp0( stage, task->stage ) != 0 ) SETPTR( task->stage, g_strdup( stage ) );
+	task->stage_done = done;
+	task->stage_total = total;
+	g_mutex_unlock( task->mutex );
+}
+
+// records a completed stage, added to the timeline when the main thread next polls
+static void export_task_mark( ExportTask *task, const gchar *phase, const gchar *format, ... ) G_GNUC_PRINTF(3, 4);
+static void export_task_mark( ExportTask *task, const gchar *phase, const gchar *format, ... )
+{
+	ExportTaskMark *mark = g_new0( ExportTaskMark, 1 );
+
+	mark->phase = g_strdup( phase );
+	if ( format )
 	{
-		gtk_widget_hide(GTK_WIDGET(dialog));
+		va_list args;
+
+		va_start( args, format );
+		mark->detail = g_strdup_vprintf( format, args );
+		va_end( args );
 	}
-	else
+
+	g_mutex_lock( task->mutex );
+	g_queue_push_tail( task->marks, mark );
+	g_mutex_unlock( task->mutex );
+}
+
+static gpointer export_task_thread( gpointer data )
+{
+	ExportTask *task = data;
+	gboolean success = task->func( task, task->data );
+
+	g_mutex_lock( task->mutex );
+	task->success = success;
+	task->finished = TRUE;
+	g_mutex_unlock( task->mutex );
+	return NULL;
+}
+
+static gboolean export_task_poll( gpointer data )
+{
+	ExportTask *task = data;
+	GtkProgressBar *bar = GTK_PROGRESS_BAR(main_widgets.progressbar);
+	ExportTaskMark *mark;
+	gchar *text = NULL;
+	gdouble fraction = -1;
+	gboolean finished;
+
+	g_mutex_lock( task->mutex );
+	while ( (mark = g_queue_pop_head( task->marks )) )
 	{
-		int i;
-		GtkWidget *widget;
+		if ( task == export_timeline_task )
+		{
+			if ( mark->detail ) msgwin_timeline_mark( mark->phase, "%s", mark->detail );
+			else msgwin_timeline_mark( mark->phase, NULL );
+		}
+		g_free( mark->phase );
+		g_free( mark->detail );
+		g_free( mark );
+	}
 
-		gtk_widget_set_sensitive( ui_lookup_widget(ui_widgets.html5_dialog, "html5_export1"), FALSE );
-		gtk_widget_set_sensitive( ui_lookup_widget(ui_widgets.html5_dialog, "button12"), FALSE );
-		
-		while (gtk_events_pending())
-			gtk_main_iteration();
+	if ( task->stage_total > 0 )
+	{
+		fraction = MIN( 1.0, (gdouble) task->stage_done / task->stage_total );
+		text = g_strdup_printf( "%s: %s (%d%%)", task->name, task->stage, (gint) (fraction * 100) );
+	}
+	else if ( task->stage ) text = g_strdup_printf( "%s: %s", task->name, task->stage );
+	else text = g_strdup( task->name );
+	finished = task->finished;
+	g_mutex_unlock( task->mutex );
 
-		// app details
-		widget = ui_lookup_widget(ui_widgets.html5_dialog, "html5_commands_combo");
-		int html5_command_int = gtk_combo_box_get_active(GTK_COMBO_BOX_TEXT(widget));
-		int commands_mode = -1;
-		if ( html5_command_int == 1 ) commands_mode = 1;
-		else if ( html5_command_int == 0 ) commands_mode = 0;
+	if ( !finished )
+	{
+		gtk_progress_bar_set_text( bar, text );
+		if ( task->label ) gtk_label_set_text( GTK_LABEL(task->label), text );
+		if ( fraction >= 0 ) gtk_progress_bar_set_fraction( bar, fraction );
+		else gtk_progress_bar_pulse( bar );
+		g_free( text );
+		return TRUE;
+	}
+	g_free( text );
 
-		widget = ui_lookup_widget(ui_widgets.html5_dialog, "html5_dynamic_memory");
-		int dynamic_memory = gtk_toggle_button_get_active( GTK_TOGGLE_BUTTON(widget) );
-				
-		// output
-		widget = ui_lookup_widget(ui_widgets.html5_dialog, "html5_output_file_entry");
-		gchar *output_file = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+	// the thread has finished with the task, nothing else writes to it
+	export_tasks_running--;
+	if ( export_tasks_running == 0 ) gtk_widget_hide( GTK_WIDGET(bar) );
 
-		// START CHECKS
+	if ( !task->success && !task->error )
+		task->error = g_strdup( export_task_cancelled( task ) ? _("Export cancelled") : _("Export failed") );
+	if ( task == export_timeline_task )
+	{
+		msgwin_timeline_finish( task->success );
+		export_timeline_task = NULL;
+	}
 
-		if ( !output_file || !*output_file ) { SHOW_ERR(_("You must choose an output location to save your HTML5 files")); goto html5_dialog_clean_up; }
-		if ( commands_mode < 0 ) { SHOW_ERR(_("Unrecognised choice for 'commands used' drop down box")); goto html5_dialog_clean_up; }
+	if ( task->done_func ) task->done_func( task, task->success, task->data );
+	export_task_free( task );
+	return FALSE;
+}
 
-		goto html5_dialog_continue;
+// runs func( task, data ) on a new thread, done_func is then called on the main thread
+static ExportTask *export_task_start( const gchar *name, ExportTaskFunc func, ExportTaskDoneFunc done_func, gpointer data )
+{
+	ExportTask *task = g_new0( ExportTask, 1 );
+	GError *error = NULL;
 
-html5_dialog_clean_up:
-		if ( output_file ) g_free(output_file);
+	task->name = g_strdup( name );
+	task->func = func;
+	task->done_func = done_func;
+	task->data = data;
+	task->mutex = g_mutex_new();
+	task->marks = g_queue_new();
 
-		gtk_widget_set_sensitive( ui_lookup_widget(ui_widgets.html5_dialog, "html5_export1"), TRUE );
-		gtk_widget_set_sensitive( ui_lookup_widget(ui_widgets.html5_dialog, "button12"), TRUE );
-		running = 0;
-		return;
+	if ( !export_timeline_task )
+	{
+		export_timeline_task = task;
+		msgwin_timeline_start( name );
+	}
+	export_tasks_running++;
+	if ( interface_prefs.statusbar_visible ) gtk_widget_show( main_widgets.progressbar );
 
-html5_dialog_continue:
+	if ( !g_thread_create( export_task_thread, task, FALSE, &error ) )
+	{
+		// finish it on the main thread instead, failing
+		task->error = g_strdup_printf( "g_thread_create() failed: %s", error->message );
+		task->finished = TRUE;
+		g_error_free( error );
+	}
 
-		while (gtk_events_pending())
-			gtk_main_iteration();
+	g_timeout_add( 100, export_task_poll, task );
+	return task;
+}
 
-		// CHECKS COMPLETE, START EXPORT
+/* Returns TRUE while an export is running on a worker thread, the application must not quit until
+ * it has finished as the worker still uses the configuration folders. */
+gboolean project_export_running( void )
+{
+	return export_tasks_running > 0;
+}
 
-		// make temporary folder
-		gchar* tmp_folder = g_build_filename( app->project->base_path, "build_tmp", NULL );
-		utils_str_replace_char( tmp_folder, '\\', '/' );
-		
-		const gchar *szCommandsFolder = "";
-		if ( dynamic_memory ) szCommandsFolder = commands_mode ? "3Ddynamic" : "2Ddynamic";
-		else szCommandsFolder = commands_mode ? "3D" : "2D";
+// exports of a project share its build_tmp folders, so only one of them can run at a time
+static GHashTable *export_busy_paths = NULL; // project base path -> number of jobs exporting it
 
-		gchar* src_folder = g_build_path( "/", app->datadir, "html5", szCommandsFolder, NULL );
-		utils_str_replace_char( src_folder, '\\', '/' );
+static gboolean export_project_busy( const gchar *base_path )
+{
+	return base_path && export_busy_paths && g_hash_table_lookup( export_busy_paths, base_path );
+}
 
-		// decalrations
-		gchar sztemp[30];
-		gchar *newcontents = 0;
-		gchar *load_package_string = g_new0( gchar, 200000 );
-		gchar *additional_folders_string = g_new0( gchar, 200000 );
-		gchar* agkplayer_file = NULL;
-		gchar* html5data_file = NULL;
-		gchar *contents = NULL;
-		gchar *contents2 = NULL;
-		gchar *contents3 = NULL;
-		gsize length = 0;
-		GError *error = NULL;
-		FILE *pHTML5File = 0;
-		gchar *media_folder = 0;
-
-		mz_zip_archive zip_archive;
-		memset(&zip_archive, 0, sizeof(zip_archive));
-		gchar *str_out = NULL;
-				
-		if ( !utils_copy_folder( src_folder, tmp_folder, TRUE, NULL ) )
-		{
-			SHOW_ERR( _("Failed to copy source folder") );
-			goto html5_dialog_cleanup2;
-		}
+static void export_project_claim( const gchar *base_path )
+{
+	if ( !base_path ) return;
+	if ( !export_busy_paths ) export_busy_paths = g_hash_table_new_full( g_str_hash, g_str_equal, g_free, NULL );
+	g_hash_table_insert( export_busy_paths, g_strdup( base_path ),
+		GINT_TO_POINTER( GPOINTER_TO_INT( g_hash_table_lookup( export_busy_paths, base_path ) ) + 1 ) );
+}
 
-		while (gtk_events_pending())
-			gtk_main_iteration();
+static void export_project_release( const gchar *base_path )
+{
+	gint count;
 
-		// create HTML5 data file that we'll add all the media files to
-		html5data_file = g_build_path( "/", tmp_folder, "AGKPlayer.data", NULL );
-		pHTML5File = fopen( html5data_file, "wb" );
-		if ( !pHTML5File )
-		{
-			SHOW_ERR( _("Failed to open HTML5 data file for writing") );
-			goto html5_dialog_cleanup2;
-		}
+	if ( !base_path || !export_busy_paths ) return;
+	count = GPOINTER_TO_INT( g_hash_table_lookup( export_busy_paths, base_path ) ) - 1;
+	if ( count > 0 ) g_hash_table_insert( export_busy_paths, g_strdup( base_path ), GINT_TO_POINTER( count ) );
+	else g_hash_table_remove( export_busy_paths, base_path );
+}
 
-		// start the load package string that will store the list of files, it will be built at the same time as adding the media files
-		strcpy( load_package_string, "loadPackage({\"files\":[" );
-		strcpy( additional_folders_string, "Module[\"FS_createPath\"](\"/\", \"media\", true, true);" );
-		media_folder = g_build_path( "/", app->project->base_path, "media", NULL );
-		int currpos = 0;
+// reports the progress of copying or deleting a folder, and stops it if the export was cancelled
+static gboolean export_folder_progress( const gchar *path, guint done, guint total, gpointer user_data )
+{
+	ExportTask *task = user_data;
 
-		if ( g_file_test (media_folder, G_FILE_TEST_EXISTS) )
-		{
-			// add the media files and construct the load package string, currpos will have the total data size afterwards
-			if ( !utils_add_folder_to_html5_data_file( pHTML5File, media_folder, "/media", load_package_string, additional_folders_string, &currpos ) )
-			{
-				fclose( pHTML5File );
-				pHTML5File = 0;
+	if ( !task ) return TRUE;
 
-				SHOW_ERR( _("Failed to write HTML5 data file") );
-				goto html5_dialog_cleanup2;
-			}
-		}
+	export_task_progress( task, NULL, done, total );
+	return !export_task_cancelled( task );
+}
 
-		fclose( pHTML5File );
-		pHTML5File = 0;
+// deflated media shared by every export of every project, so each file is only compressed once whatever
+// the number of targets and variants it goes into, kept for the whole session and on disk for the next one
+static UtilsBlobStore *export_blob_store( void )
+{
+	static gsize store = 0;
 
-		// remove the final comma that was added
-		if ( *load_package_string && load_package_string[strlen(load_package_string)-1] == ',' ) load_package_string[ strlen(load_package_string) - 1 ] = 0;
+	if ( g_once_init_enter( &store ) )
+	{
+		gchar *folder = g_build_filename( app->configdir, "exportcache", "blobs", NULL );
+		g_once_init_leave( &store, (gsize) utils_blob_store_new( folder ) );
+		g_free( folder );
+	}
+	return (UtilsBlobStore*) store;
+}
 
-		// finsh the load package string 
-		strcat( load_package_string, "],\"remote_package_size\":" );
-		sprintf( sztemp, "%d", currpos );
-		strcat( load_package_string, sztemp );
-		strcat( load_package_string, ",\"package_uuid\":\"e3c8dd30-b68a-4332-8c93-d0cf8f9d28a0\"})" );
+// the fingerprint of an export's inputs, recorded beside its output so an unchanged export can be skipped
+static UtilsFingerprint *export_fingerprint_new( const gchar *output )
+{
+	UtilsFingerprint *fingerprint;
+	gchar *record_file = g_strdup( output );
+	gsize length = strlen( record_file );
 
-		
-		// edit AGKplayer.js to add our load package string
-		agkplayer_file = g_build_path( "/", tmp_folder, "AGKPlayer.js", NULL );
+	// a folder gets its record beside it rather than in it
+	while ( length > 1 && (record_file[length-1] == '/' || record_file[length-1] == '\\') ) record_file[--length] = 0;
+	SETPTR( record_file, g_strconcat( record_file, ".fingerprint", NULL ) );
 
-		if ( !g_file_get_contents( agkplayer_file, &contents, &length, &error ) )
-		{
-			SHOW_ERR1( _("Failed to read AGKPlayer.js file: %s"), error->message );
-			g_error_free(error);
-			error = NULL;
-			goto html5_dialog_cleanup2;
-		}
+	fingerprint = utils_fingerprint_new( record_file );
+	// the player templates ship with the IDE, each export adds their files as well
+	utils_fingerprint_add_string( fingerprint, "version", AGK_VERSION_TEXT );
 
-		newcontents = g_new0( gchar, length + 400000 );
+	g_free( record_file );
+	return fingerprint;
+}
 
-		contents2 = contents;
-		contents3 = 0;
+// what changed since the last export, for the timeline
+static gchar *export_fingerprint_describe( UtilsFingerprint *fingerprint )
+{
+	gchar **changes = utils_fingerprint_get_changes( fingerprint );
+	GString *text;
+	guint count, i;
 
-		// the order of these relacements is important (if more than one), they must occur in the same order as they occur in the file
+	if ( !changes ) return g_strdup( _("no previous export") );
 
-		// replace %%ADDITIONALFOLDERS%%
-		contents3 = strstr( contents2, "%%ADDITIONALFOLDERS%%" );
-		if ( contents3 )
-		{
-			*contents3 = 0;
-			contents3 += strlen("%%ADDITIONALFOLDERS%%");
+	count = g_strv_length( changes );
+	if ( count == 0 )
+	{
+		g_strfreev( changes );
+		return g_strdup( _("the previous output was changed") );
+	}
 
-			strcat( newcontents, contents2 );
-			strcat( newcontents, additional_folders_string );
-						
-			contents2 = contents3;
-		}
-		else
-		{
-			SHOW_ERR( _("AGKPlayer.js is corrupt, it is missing the %%ADDITIONALFOLDERS%% variable") );
-			goto html5_dialog_cleanup2;
-		}
+	text = g_string_new( NULL );
+	g_string_append_printf( text, ngettext( "%u input changed", "%u inputs changed", count ), count );
+	for ( i = 0; i < count && i < 5; i++ ) g_string_append_printf( text, "%s%s", i ? ", " : ": ", changes[i] );
+	if ( count > 5 ) g_string_append( text, ", ..." );
 
-		// replace %%LOADPACKAGE%%
-		contents3 = strstr( contents2, "%%LOADPACKAGE%%" );
-		if ( contents3 )
-		{
-			*contents3 = 0;
-			contents3 += strlen("%%LOADPACKAGE%%");
+	g_strfreev( changes );
+	return g_string_free( text, FALSE );
+}
 
-			strcat( newcontents, contents2 );
-			strcat( newcontents, load_package_string );
-						
-			contents2 = contents3;
-		}
-		else
+// everything an HTML5 export needs, read up front so the export itself doesn't touch any widgets
+typedef struct Html5ExportJob
+{
+	gchar *base_path;
+	gchar *project_name;
+	gchar *output_file;
+	int commands_mode; // 0 = 2D, 1 = 3D
+	int dynamic_memory;
+	int gzip_output;
+	gboolean unchanged; // set by the export if the output was already up to date
+} Html5ExportJob;
+
+// the export started from the HTML5 dialog, NULL when it isn't exporting
+static ExportTask *html5_export_task = NULL;
+
+static void html5_export_job_free( Html5ExportJob *job )
+{
+	g_free( job->base_path );
+	g_free( job->project_name );
+	g_free( job->output_file );
+	g_free( job );
+}
+
+// adds a file written to folder to the fingerprint, along with its compressed copy
+static void html5_export_add_output( UtilsFingerprint *fingerprint, const gchar *folder, const gchar *name, gboolean gzip )
+{
+	gchar *path = g_build_path( "/", folder, name, NULL );
+
+	utils_fingerprint_add_output( fingerprint, path );
+	if ( gzip )
+	{
+		SETPTR( path, g_strconcat( path, ".gz", NULL ) );
+		utils_fingerprint_add_output( fingerprint, path );
+	}
+	g_free( path );
+}
+
+static gboolean html5_export_task_run( ExportTask *task, gpointer data )
+{
+	Html5ExportJob *job = data;
+	const gchar *output_file = job->output_file;
+	gboolean success = FALSE;
+	int i;
+
+	const gchar *szCommandsFolder = "";
+	if ( job->dynamic_memory ) szCommandsFolder = job->commands_mode ? "3Ddynamic" : "2Ddynamic";
+	else szCommandsFolder = job->commands_mode ? "3D" : "2D";
+
+	gchar* src_folder = g_build_path( "/", app->datadir, "html5", szCommandsFolder, NULL );
+	utils_str_replace_char( src_folder, '\\', '/' );
+
+	// decalrations
+	GString *newcontents = NULL;
+	GString *load_package_string = g_string_sized_new( 65536 );
+	GString *additional_folders_string = g_string_sized_new( 4096 );
+	gchar* agkplayer_file = NULL;
+	gchar* html5data_file = NULL;
+	gchar *data_file = NULL;
+	gchar *data_tmp_file = NULL; // AGKPlayer.data until the player that loads it has been written
+	gchar *contents = NULL;
+	UtilsTemplate *player_template = NULL;
+	gsize length = 0;
+	GError *error = NULL;
+	FILE *pHTML5File = 0;
+	gchar *media_folder = 0;
+	// the player template is read in place, only AGKPlayer.js is changed
+	UtilsOverlay *overlay = utils_overlay_new( src_folder );
+	const gchar *player_files[] = { "AGKPlayer.asm.js", "AGKPlayer.js", "AGKPlayer.html.mem", "background.jpg", "made-with-appgamekit.png", NULL };
+
+	mz_zip_archive zip_archive;
+	memset(&zip_archive, 0, sizeof(zip_archive));
+	gchar *str_out = NULL;
+	UtilsFingerprint *fingerprint = NULL;
+	gchar *changes = NULL;
+
+	// nothing to do if the output was made from exactly these inputs
+	export_task_progress( task, "fingerprint", 0, 0 );
+	media_folder = g_build_path( "/", job->base_path, "media", NULL );
+	fingerprint = export_fingerprint_new( output_file );
+	utils_fingerprint_add_string( fingerprint, "setting/project_name", job->project_name );
+	utils_fingerprint_add_int( fingerprint, "setting/commands_mode", job->commands_mode );
+	utils_fingerprint_add_int( fingerprint, "setting/dynamic_memory", job->dynamic_memory );
+	utils_fingerprint_add_int( fingerprint, "setting/gzip_output", job->gzip_output );
+	utils_fingerprint_add_folder( fingerprint, "template", src_folder );
+	utils_fingerprint_add_folder( fingerprint, "media", media_folder );
+	if ( utils_fingerprint_matches( fingerprint ) )
+	{
+		export_task_mark( task, "fingerprint", "%s", _("unchanged") );
+		job->unchanged = TRUE;
+		success = TRUE;
+		goto html5_dialog_cleanup2;
+	}
+	changes = export_fingerprint_describe( fingerprint );
+	export_task_mark( task, "fingerprint", "%s", changes );
+	if ( export_task_cancelled( task ) ) goto html5_dialog_cleanup2;
+
+	utils_mkdir( output_file, TRUE );
+	export_task_progress( task, "data", 0, 0 );
+
+	// create HTML5 data file that we'll add all the media files to, next to the one it replaces
+	data_file = g_build_path( "/", output_file, "AGKPlayer.data", NULL );
+	data_tmp_file = g_strconcat( data_file, ".tmp", NULL );
+	pHTML5File = fopen( data_tmp_file, "wb" );
+	if ( !pHTML5File )
+	{
+		export_task_error( task, _("Failed to open HTML5 data file for writing") );
+		goto html5_dialog_cleanup2;
+	}
+
+	// start the load package string that will store the list of files, it will be built at the same time as adding the media files
+	g_string_append( load_package_string, "loadPackage({\"files\":[" );
+	g_string_append( additional_folders_string, "Module[\"FS_createPath\"](\"/\", \"media\", true, true);" );
+	gint64 currpos = 0;
+
+	if ( g_file_test (media_folder, G_FILE_TEST_EXISTS) )
+	{
+		// add the media files and construct the load package string, currpos will have the total data size afterwards
+		if ( !utils_add_folder_to_html5_data_file( pHTML5File, media_folder, "/media", load_package_string, additional_folders_string, &currpos ) )
 		{
-			SHOW_ERR( _("AGKPlayer.js is corrupt, it is missing the %%LOADPACKAGE%% variable") );
+			fclose( pHTML5File );
+			pHTML5File = 0;
+
+			export_task_error( task, _("Failed to write HTML5 data file") );
 			goto html5_dialog_cleanup2;
 		}
+	}
+
+	fclose( pHTML5File );
+	pHTML5File = 0;
+	export_task_mark( task, "data", "%" G_GINT64_FORMAT " bytes", currpos );
+	if ( export_task_cancelled( task ) ) goto html5_dialog_cleanup2;
+
+	// remove the final comma that was added
+	if ( load_package_string->len > 0 && load_package_string->str[load_package_string->len-1] == ',' ) g_string_truncate( load_package_string, load_package_string->len - 1 );
+
+	// finsh the load package string 
+	g_string_append_printf( load_package_string, "],\"remote_package_size\":%" G_GINT64_FORMAT, currpos );
+	g_string_append( load_package_string, ",\"package_uuid\":\"e3c8dd30-b68a-4332-8c93-d0cf8f9d28a0\"})" );
 
-		// write the rest of the file
-		strcat( newcontents, contents2 );
 	
-		// write new AGKPlayer.js file
-		if ( !g_file_set_contents( agkplayer_file, newcontents, strlen(newcontents), &error ) )
-		{
-			SHOW_ERR1( _("Failed to write AGKPlayer.js file: %s"), error->message );
-			g_error_free(error);
-			error = NULL;
-			goto html5_dialog_cleanup2;
-		}
+	// edit AGKplayer.js to add our load package string
+	export_task_progress( task, "player", 0, 0 );
+	if ( !utils_overlay_get_contents( overlay, "AGKPlayer.js", &contents, &length, &error ) )
+	{
+		export_task_error( task, _("Failed to read AGKPlayer.js file: %s"), error->message );
+		g_error_free(error);
+		error = NULL;
+		goto html5_dialog_cleanup2;
+	}
 
-		while (gtk_events_pending())
-			gtk_main_iteration();
+	newcontents = g_string_sized_new( length + load_package_string->len + additional_folders_string->len );
 
-		// reuse variables
-		if ( html5data_file ) g_free(html5data_file);
-		if ( agkplayer_file ) g_free(agkplayer_file);
+	player_template = utils_template_new();
+	utils_template_add_key( player_template, "%%ADDITIONALFOLDERS%%" );
+	utils_template_add_key( player_template, "%%LOADPACKAGE%%" );
+	utils_template_compile( player_template, contents, length );
 
-		// create zip file
-		/*
-		if ( !mz_zip_writer_init_file( &zip_archive, output_file, 0 ) )
-		{
-			SHOW_ERR( "Failed to initialise zip file for writing" );
-			goto html5_dialog_cleanup2;
-		}
+	if ( !utils_template_contains( player_template, "%%ADDITIONALFOLDERS%%" ) )
+	{
+		export_task_error( task, _("AGKPlayer.js is corrupt, it is missing the %%ADDITIONALFOLDERS%% variable") );
+		goto html5_dialog_cleanup2;
+	}
 
-		// copy files to zip
-		html5data_file = g_build_path( "/", tmp_folder, "AGKPlayer.asm.js", NULL );
-		mz_zip_writer_add_file( &zip_archive, "AGKPlayer.asm.js", html5data_file, NULL, 0, 9 );
-		g_free( html5data_file );
+	if ( !utils_template_contains( player_template, "%%LOADPACKAGE%%" ) )
+	{
+		export_task_error( task, _("AGKPlayer.js is corrupt, it is missing the %%LOADPACKAGE%% variable") );
+		goto html5_dialog_cleanup2;
+	}
 
-		html5data_file = g_build_path( "/", tmp_folder, "AGKPlayer.js", NULL );
-		mz_zip_writer_add_file( &zip_archive, "AGKPlayer.js", html5data_file, NULL, 0, 9 );
-		g_free( html5data_file );
+	utils_template_set( player_template, "%%ADDITIONALFOLDERS%%", additional_folders_string->str );
+	utils_template_set( player_template, "%%LOADPACKAGE%%", load_package_string->str );
+	utils_template_render( player_template, newcontents );
 
-		html5data_file = g_build_path( "/", tmp_folder, "AGKPlayer.data", NULL );
-		mz_zip_writer_add_file( &zip_archive, "AGKPlayer.data", html5data_file, NULL, 0, 9 );
-		g_free( html5data_file );
+	utils_overlay_set_contents( overlay, "AGKPlayer.js", newcontents->str, newcontents->len );
+	export_task_mark( task, "player", NULL );
+	if ( export_task_cancelled( task ) ) goto html5_dialog_cleanup2;
 
-		html5data_file = g_build_path( "/", tmp_folder, "AGKPlayer.html.mem", NULL );
-		mz_zip_writer_add_file( &zip_archive, "AGKPlayer.html.mem", html5data_file, NULL, 0, 9 );
-		g_free( html5data_file );
+	// create zip file
+	/*
+	if ( !mz_zip_writer_init_file( &zip_archive, output_file, 0 ) )
+	{
+		SHOW_ERR( "Failed to initialise zip file for writing" );
+		goto html5_dialog_cleanup2;
+	}
 
-		// create main html5 file with project name so it stands out as the file to run
-		agkplayer_file = g_new0( gchar, 1024 );
-		strcpy( agkplayer_file, app->project->name );
-		utils_str_replace_char( agkplayer_file, ' ', '_' );
-		strcat( agkplayer_file, ".html" );
-		html5data_file = g_build_path( "/", tmp_folder, "AGKPlayer.html", NULL );
-		mz_zip_writer_add_file( &zip_archive, agkplayer_file, html5data_file, NULL, 0, 9 );
-		*/
+	// copy files to zip
+	html5data_file = g_build_path( "/", tmp_folder, "AGKPlayer.asm.js", NULL );
+	mz_zip_writer_add_file( &zip_archive, "AGKPlayer.asm.js", html5data_file, NULL, 0, 9 );
+	g_free( html5data_file );
+
+	html5data_file = g_build_path( "/", tmp_folder, "AGKPlayer.js", NULL );
+	mz_zip_writer_add_file( &zip_archive, "AGKPlayer.js", html5data_file, NULL, 0, 9 );
+	g_free( html5data_file );
+
+	html5data_file = g_build_path( "/", tmp_folder, "AGKPlayer.data", NULL );
+	mz_zip_writer_add_file( &zip_archive, "AGKPlayer.data", html5data_file, NULL, 0, 9 );
+	g_free( html5data_file );
+
+	html5data_file = g_build_path( "/", tmp_folder, "AGKPlayer.html.mem", NULL );
+	mz_zip_writer_add_file( &zip_archive, "AGKPlayer.html.mem", html5data_file, NULL, 0, 9 );
+	g_free( html5data_file );
+
+	// create main html5 file with project name so it stands out as the file to run
+	agkplayer_file = g_new0( gchar, 1024 );
+	strcpy( agkplayer_file, app->project->name );
+	utils_str_replace_char( agkplayer_file, ' ', '_' );
+	strcat( agkplayer_file, ".html" );
+	html5data_file = g_build_path( "/", tmp_folder, "AGKPlayer.html", NULL );
+	mz_zip_writer_add_file( &zip_archive, agkplayer_file, html5data_file, NULL, 0, 9 );
+	*/
 
-		utils_mkdir( output_file, TRUE );
-
-		// copy files to folder
-		html5data_file = g_build_path( "/", tmp_folder, "AGKPlayer.asm.js", NULL );
-		agkplayer_file = g_build_path( "/", output_file, "AGKPlayer.asm.js", NULL );
-		utils_copy_file( html5data_file, agkplayer_file, TRUE, NULL );
-		g_free( agkplayer_file );
-		g_free( html5data_file );
-
-		html5data_file = g_build_path( "/", tmp_folder, "AGKPlayer.js", NULL );
-		agkplayer_file = g_build_path( "/", output_file, "AGKPlayer.js", NULL );
-		utils_copy_file( html5data_file, agkplayer_file, TRUE, NULL );
-		g_free( agkplayer_file );
-		g_free( html5data_file );
-
-		html5data_file = g_build_path( "/", tmp_folder, "AGKPlayer.data", NULL );
-		agkplayer_file = g_build_path( "/", output_file, "AGKPlayer.data", NULL );
-		utils_copy_file( html5data_file, agkplayer_file, TRUE, NULL );
-		g_free( agkplayer_file );
-		g_free( html5data_file );
-
-		html5data_file = g_build_path( "/", tmp_folder, "AGKPlayer.html.mem", NULL );
-		agkplayer_file = g_build_path( "/", output_file, "AGKPlayer.html.mem", NULL );
-		utils_copy_file( html5data_file, agkplayer_file, TRUE, NULL );
-		g_free( agkplayer_file );
-		g_free( html5data_file );
-
-		html5data_file = g_build_path( "/", tmp_folder, "background.jpg", NULL );
-		agkplayer_file = g_build_path( "/", output_file, "background.jpg", NULL );
-		utils_copy_file( html5data_file, agkplayer_file, TRUE, NULL );
-		g_free( agkplayer_file );
-		g_free( html5data_file );
-
-		html5data_file = g_build_path( "/", tmp_folder, "made-with-appgamekit.png", NULL );
-		agkplayer_file = g_build_path( "/", output_file, "made-with-appgamekit.png", NULL );
-		utils_copy_file( html5data_file, agkplayer_file, TRUE, NULL );
-		g_free( agkplayer_file );
-		g_free( html5data_file );
-
-		// create main html5 file with project name so it stands out as the file to run
-		html5data_file = g_new0( gchar, 1024 );
-		strcpy( html5data_file, app->project->name );
-		utils_str_replace_char( html5data_file, ' ', '_' );
-		strcat( html5data_file, ".html" );
-		agkplayer_file = g_build_path( "/", output_file, html5data_file, NULL );
-		g_free( html5data_file );
-		html5data_file = g_build_path( "/", tmp_folder, "AGKPlayer.html", NULL );
-		utils_copy_file( html5data_file, agkplayer_file, TRUE, NULL );
-
-		while (gtk_events_pending())
-			gtk_main_iteration();
+	// write the player files, AGKPlayer.data only replaces the previous one once they are all there
+	export_task_progress( task, "output", 0, 0 );
+	for( i = 0; player_files[i]; i++ )
+	{
+		// not every template has every file
+		SETPTR( html5data_file, g_build_path( "/", src_folder, player_files[i], NULL ) );
+		if ( !g_file_test( html5data_file, G_FILE_TEST_IS_REGULAR ) ) continue;
 
-		/*
-		if ( !mz_zip_writer_finalize_archive( &zip_archive ) )
+		SETPTR( agkplayer_file, g_build_path( "/", output_file, player_files[i], NULL ) );
+		if ( !utils_overlay_write( overlay, player_files[i], agkplayer_file, &error ) )
 		{
-			SHOW_ERR( _("Failed to finalize zip file") );
+			export_task_error( task, _("Failed to write %s (%s)"), agkplayer_file, error->message );
 			goto html5_dialog_cleanup2;
 		}
-		if ( !mz_zip_writer_end( &zip_archive ) )
+	}
+
+	// create main html5 file with project name so it stands out as the file to run
+	SETPTR( html5data_file, g_strconcat( job->project_name, ".html", NULL ) );
+	utils_str_replace_char( html5data_file, ' ', '_' );
+	SETPTR( agkplayer_file, g_build_path( "/", output_file, html5data_file, NULL ) );
+	if ( !utils_overlay_write( overlay, "AGKPlayer.html", agkplayer_file, &error ) )
+	{
+		export_task_error( task, _("Failed to write %s (%s)"), agkplayer_file, error->message );
+		goto html5_dialog_cleanup2;
+	}
+
+	if ( g_rename( data_tmp_file, data_file ) != 0 )
+	{
+		// Windows won't rename over an existing file
+		g_unlink( data_file );
+		if ( g_rename( data_tmp_file, data_file ) != 0 )
 		{
-			SHOW_ERR( _("Failed to end zip file") );
+			export_task_error( task, _("Failed to write %s (%s)"), data_file, g_strerror( errno ) );
 			goto html5_dialog_cleanup2;
 		}
-		*/
+	}
+	g_free( data_tmp_file );
+	data_tmp_file = NULL;
+	export_task_mark( task, "output", NULL );
 
-		while (gtk_events_pending())
-			gtk_main_iteration();
+	if ( job->gzip_output )
+	{
+		// side by side .gz copies for servers that send pre-compressed files
+		const gchar *gzip_files[] = { "AGKPlayer.data", "AGKPlayer.js", "AGKPlayer.asm.js", "AGKPlayer.html.mem", NULL };
 
-		gtk_widget_hide(GTK_WIDGET(dialog));
+		export_task_progress( task, "gzip", 0, 0 );
 
-html5_dialog_cleanup2:
-        
-        gtk_widget_set_sensitive( ui_lookup_widget(ui_widgets.html5_dialog, "html5_export1"), TRUE );
-		gtk_widget_set_sensitive( ui_lookup_widget(ui_widgets.html5_dialog, "button12"), TRUE );
+		for( i = 0; gzip_files[i]; i++ )
+		{
+			SETPTR( html5data_file, g_build_path( "/", output_file, gzip_files[i], NULL ) );
+			SETPTR( agkplayer_file, g_strconcat( html5data_file, ".gz", NULL ) );
+			if ( g_file_test( html5data_file, G_FILE_TEST_IS_REGULAR ) && !utils_write_gzip_file( html5data_file, agkplayer_file ) )
+			{
+				export_task_error( task, _("Failed to write %s"), agkplayer_file );
+				goto html5_dialog_cleanup2;
+			}
+		}
+		export_task_mark( task, "gzip", NULL );
+	}
 
-		utils_remove_folder_recursive( tmp_folder );
+	/*
+	if ( !mz_zip_writer_finalize_archive( &zip_archive ) )
+	{
+		SHOW_ERR( _("Failed to finalize zip file") );
+		goto html5_dialog_cleanup2;
+	}
+	if ( !mz_zip_writer_end( &zip_archive ) )
+	{
+		SHOW_ERR( _("Failed to end zip file") );
+		goto html5_dialog_cleanup2;
+	}
+	*/
 
-		if ( newcontents ) g_free(newcontents);
-		if ( contents ) g_free(contents);
-		if ( load_package_string ) g_free(load_package_string);
-		if ( additional_folders_string ) g_free(additional_folders_string);
-		if ( agkplayer_file ) g_free(agkplayer_file);
-		if ( html5data_file ) g_free(html5data_file);
-		if ( media_folder ) g_free(media_folder);
-		if ( pHTML5File ) fclose(pHTML5File);
+	// record the files written for the next export, the fingerprint leaves out copies that weren't made
+	for( i = 0; player_files[i]; i++ ) html5_export_add_output( fingerprint, output_file, player_files[i], job->gzip_output );
+	html5_export_add_output( fingerprint, output_file, "AGKPlayer.data", job->gzip_output );
+	SETPTR( html5data_file, g_strdup( job->project_name ) );
+	utils_str_replace_char( html5data_file, ' ', '_' );
+	SETPTR( html5data_file, g_strconcat( html5data_file, ".html", NULL ) );
+	html5_export_add_output( fingerprint, output_file, html5data_file, FALSE );
+	utils_fingerprint_save( fingerprint );
 
-		if ( error ) g_error_free(error);
-		
-		if ( tmp_folder ) g_free(tmp_folder);
-		if ( src_folder ) g_free(src_folder);
-		if ( output_file ) g_free(output_file);
+	success = TRUE;
+
+html5_dialog_cleanup2:
+	utils_overlay_free( overlay );
+	utils_template_free( player_template );
+
+	if ( newcontents ) g_string_free(newcontents, TRUE);
+	if ( contents ) g_free(contents);
+	if ( load_package_string ) g_string_free(load_package_string, TRUE);
+	if ( additional_folders_string ) g_string_free(additional_folders_string, TRUE);
+	if ( agkplayer_file ) g_free(agkplayer_file);
+	if ( html5data_file ) g_free(html5data_file);
+	if ( media_folder ) g_free(media_folder);
+	if ( pHTML5File ) fclose(pHTML5File);
+	if ( data_tmp_file )
+	{
+		// a failed or cancelled export leaves the previous output as it was
+		g_unlink( data_tmp_file );
+		g_free( data_tmp_file );
 	}
+	g_free( data_file );
 
-	running = 0;
+	if ( error ) g_error_free(error);
+	
+	if ( src_folder ) g_free(src_folder);
+	utils_fingerprint_free( fingerprint );
+	g_free( changes );
+	return success;
 }
 
-void project_export_html5()
+static void html5_export_task_done( ExportTask *task, gboolean success, gpointer data )
 {
-	static gchar *last_proj_path = 0;
-
-	if ( !app->project ) 
-	{
-		SHOW_ERR( _("You must have a project open to export it") );
-		return;
-	}
+	Html5ExportJob *job = data;
 
-	// make sure the project is up to date
-	build_compile_project(0);
+	html5_export_task = NULL;
+	gtk_widget_set_sensitive( ui_lookup_widget(ui_widgets.html5_dialog, "html5_export1"), TRUE );
 
-	if (ui_widgets.html5_dialog == NULL)
-	{
-		ui_widgets.html5_dialog = create_html5_dialog();
-		gtk_widget_set_name(ui_widgets.html5_dialog, _("Export HTML5"));
-		gtk_window_set_transient_for(GTK_WINDOW(ui_widgets.html5_dialog), GTK_WINDOW(main_widgets.window));
+	if ( success ) gtk_widget_hide( ui_widgets.html5_dialog );
+	else if ( !export_task_cancelled( task ) ) SHOW_ERR1( "%s", task->error );
 
-		g_signal_connect(ui_widgets.html5_dialog, "response", G_CALLBACK(on_html5_dialog_response), NULL);
-        g_signal_connect(ui_widgets.html5_dialog, "delete-event", G_CALLBACK(gtk_widget_hide_on_delete), NULL);
+	if ( success && job->unchanged )
+		ui_set_statusbar( TRUE, _("Nothing has changed since the last HTML5 export, %s is up to date."), job->output_file );
 
-		//ui_setup_open_button_callback_html5(ui_lookup_widget(ui_widgets.html5_dialog, "html5_app_icon_path"), NULL,
-		//	GTK_FILE_CHOOSER_ACTION_OPEN, GTK_ENTRY(ui_lookup_widget(ui_widgets.html5_dialog, "html5_app_icon_entry")));
-		
-		ui_setup_open_button_callback_html5(ui_lookup_widget(ui_widgets.html5_dialog, "html5_output_file_path"), NULL,
-			GTK_FILE_CHOOSER_ACTION_SELECT_FOLDER, GTK_ENTRY(ui_lookup_widget(ui_widgets.html5_dialog, "html5_output_file_entry")));
+	html5_export_job_free( data );
+}
 
-		gtk_combo_box_set_active( GTK_COMBO_BOX(ui_lookup_widget(ui_widgets.html5_dialog, "html5_commands_combo")), 0 );
+static void on_html5_dialog_response(GtkDialog *dialog, gint response, gpointer user_data)
+{
+	// while exporting the close button cancels the export
+	if ( html5_export_task )
+	{
+		if ( response != 1 ) export_task_cancel( html5_export_task );
+		return;
 	}
 
-	if ( strcmp( FALLBACK(last_proj_path,""), FALLBACK(app->project->file_name,"") ) != 0 )
+	// save current values
+	if ( app->project )
 	{
-		if ( last_proj_path ) g_free(last_proj_path);
-		last_proj_path = g_strdup( FALLBACK(app->project->file_name,"") );
+		GtkWidget *widget;
+		widget = ui_lookup_widget(ui_widgets.html5_dialog, "html5_commands_combo");
+		app->project->html5_settings.commands_used = gtk_combo_box_get_active(GTK_COMBO_BOX_TEXT(widget));
+		
+		widget = ui_lookup_widget(ui_widgets.html5_dialog, "html5_dynamic_memory");
+		app->project->html5_settings.dynamic_memory = gtk_toggle_button_get_active( GTK_TOGGLE_BUTTON(widget) );
+
+		widget = ui_lookup_widget(ui_widgets.html5_dialog, "html5_gzip_output");
+		app->project->html5_settings.gzip_output = gtk_toggle_button_get_active( GTK_TOGGLE_BUTTON(widget) );
+				
+		// output
+		widget = ui_lookup_widget(ui_widgets.html5_dialog, "html5_output_file_entry");
+		AGK_CLEAR_STR(app->project->html5_settings.output_path) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+	}
+
+	if ( response != 1 )
+	{
+		gtk_widget_hide(GTK_WIDGET(dialog));
+	}
+	else
+	{
+		GtkWidget *widget;
+		Html5ExportJob *job;
+
+		// app details
+		widget = ui_lookup_widget(ui_widgets.html5_dialog, "html5_commands_combo");
+		int html5_command_int = gtk_combo_box_get_active(GTK_COMBO_BOX_TEXT(widget));
+		int commands_mode = -1;
+		if ( html5_command_int == 1 ) commands_mode = 1;
+		else if ( html5_command_int == 0 ) commands_mode = 0;
+
+		widget = ui_lookup_widget(ui_widgets.html5_dialog, "html5_dynamic_memory");
+		int dynamic_memory = gtk_toggle_button_get_active( GTK_TOGGLE_BUTTON(widget) );
+
+		widget = ui_lookup_widget(ui_widgets.html5_dialog, "html5_gzip_output");
+		int gzip_output = gtk_toggle_button_get_active( GTK_TOGGLE_BUTTON(widget) );
+				
+		// output
+		widget = ui_lookup_widget(ui_widgets.html5_dialog, "html5_output_file_entry");
+		gchar *output_file = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+
+		// START CHECKS
+
+		if ( !output_file || !*output_file ) { SHOW_ERR(_("You must choose an output location to save your HTML5 files")); g_free(output_file); return; }
+		if ( commands_mode < 0 ) { SHOW_ERR(_("Unrecognised choice for 'commands used' drop down box")); g_free(output_file); return; }
+
+		// CHECKS COMPLETE, START EXPORT
+		job = g_new0( Html5ExportJob, 1 );
+		job->base_path = g_strdup( app->project->base_path );
+		job->project_name = g_strdup( app->project->name );
+		job->output_file = output_file;
+		job->commands_mode = commands_mode;
+		job->dynamic_memory = dynamic_memory;
+		job->gzip_output = gzip_output;
+
+		// the close button stays enabled so the export can be cancelled
+		gtk_widget_set_sensitive( ui_lookup_widget(ui_widgets.html5_dialog, "html5_export1"), FALSE );
+		html5_export_task = export_task_start( "HTML5 export", html5_export_task_run, html5_export_task_done, job );
+	}
+}
+
+void project_export_html5()
+{
+	static gchar *last_proj_path = 0;
+
+	if ( !app->project ) 
+	{
+		SHOW_ERR( _("You must have a project open to export it") );
+		return;
+	}
+
+	// make sure the project is up to date
+	build_compile_project(0);
+
+	if (ui_widgets.html5_dialog == NULL)
+	{
+		ui_widgets.html5_dialog = create_html5_dialog();
+		gtk_widget_set_name(ui_widgets.html5_dialog, _("Export HTML5"));
+		gtk_window_set_transient_for(GTK_WINDOW(ui_widgets.html5_dialog), GTK_WINDOW(main_widgets.window));
+
+		g_signal_connect(ui_widgets.html5_dialog, "response", G_CALLBACK(on_html5_dialog_response), NULL);
+        g_signal_connect(ui_widgets.html5_dialog, "delete-event", G_CALLBACK(gtk_widget_hide_on_delete), NULL);
+
+		//ui_setup_open_button_callback_html5(ui_lookup_widget(ui_widgets.html5_dialog, "html5_app_icon_path"), NULL,
+		//	GTK_FILE_CHOOSER_ACTION_OPEN, GTK_ENTRY(ui_lookup_widget(ui_widgets.html5_dialog, "html5_app_icon_entry")));
+		
+		ui_setup_open_button_callback_html5(ui_lookup_widget(ui_widgets.html5_dialog, "html5_output_file_path"), NULL,
+			GTK_FILE_CHOOSER_ACTION_SELECT_FOLDER, GTK_ENTRY(ui_lookup_widget(ui_widgets.html5_dialog, "html5_output_file_entry")));
+
+		gtk_combo_box_set_active( GTK_COMBO_BOX(ui_lookup_widget(ui_widgets.html5_dialog, "html5_commands_combo")), 0 );
+	}
+
+	if ( strcmp( FALLBACK(last_proj_path,""), FALLBACK(app->project->file_name,"") ) != 0 )
+	{
+		if ( last_proj_path ) g_free(last_proj_path);
+		last_proj_path = g_strdup( FALLBACK(app->project->file_name,"") );
 	
 		GtkWidget *widget;
 
@@ -859,6 +1239,9 @@ void project_export_html5()
 
 		widget = ui_lookup_widget(ui_widgets.html5_dialog, "html5_dynamic_memory");
 		gtk_toggle_button_set_active( GTK_TOGGLE_BUTTON(widget), app->project->html5_settings.dynamic_memory ? 1 : 0 );
+
+		widget = ui_lookup_widget(ui_widgets.html5_dialog, "html5_gzip_output");
+		gtk_toggle_button_set_active( GTK_TOGGLE_BUTTON(widget), app->project->html5_settings.gzip_output ? 1 : 0 );
 		
 		if ( !app->project->html5_settings.output_path || !*app->project->html5_settings.output_path )
 		{
@@ -877,854 +1260,1138 @@ void project_export_html5()
 	gtk_window_present(GTK_WINDOW(ui_widgets.html5_dialog));
 }
 
-static void on_android_dialog_response(GtkDialog *dialog, gint response, gpointer user_data)
+// adds an icon in resOrig/folder to the set, and its path to the resources aapt2 has to compile
+static void android_add_icon( UtilsIconSet *icon_set, GPtrArray *compile_inputs, const gchar *tmp_folder, const gchar *folder, const gchar *filename, gint width, gint height )
 {
-	static int running = 0;
-	if ( running ) return;
+	gchar *image_filename = g_build_path( "/", tmp_folder, "resOrig", folder, filename, NULL );
+	utils_icon_set_add( icon_set, width, height, image_filename );
+	g_free( image_filename );
 
-	running = 1;
-    
-#ifdef __APPLE__
-    gchar* android_path = g_build_path( "/", app->configdir, "AndroidExport", "aapt2", NULL );
-    if ( !g_file_test(android_path, G_FILE_TEST_EXISTS) )
-    {
-        g_free( android_path);
-        if ( m_connection ) SHOW_ERR( "Android export files have not finished downloading, please wait and try again" );
-        else SHOW_ERR( "Android export files not found. Please close the export dialog and reopen it to try downloading again" );
-        return;
-    }
-    g_free( android_path);
-#endif
+	g_ptr_array_add( compile_inputs, g_strconcat( folder, "/", filename, NULL ) );
+}
 
-	// save default settings
-	if ( app->project && user_data == 0 )
+// name aapt2 gives the compiled form of resOrig/<input>, e.g. values/values.xml becomes values_values.arsc.flat
+static gchar *android_flat_name( const gchar *input )
+{
+	gchar *folder = g_path_get_dirname( input );
+	gchar *filename = g_path_get_basename( input );
+	gchar *flat_name;
+
+	if ( strcmp( folder, "values" ) == 0 || strncmp( folder, "values-", 7 ) == 0 )
 	{
-		GtkWidget *widget;
+		gchar *ext = strrchr( filename, '.' );
+		if ( ext ) *ext = 0;
+		flat_name = g_strconcat( folder, "_", filename, ".arsc.flat", NULL );
+	}
+	else flat_name = g_strconcat( folder, "_", filename, ".flat", NULL );
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_app_name_entry");
-		AGK_CLEAR_STR(app->project->apk_settings.app_name) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-		
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_package_name_entry");
-		AGK_CLEAR_STR(app->project->apk_settings.package_name) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+	g_free( folder );
+	g_free( filename );
+	return flat_name;
+}
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_app_icon_entry");
-		AGK_CLEAR_STR(app->project->apk_settings.app_icon_path) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+// location of the cached compile of resOrig/<input>, keyed by the aapt2 build, the resource path and its contents
+// so identical icons are only compiled once across exports and projects, returns NULL if the input can't be read
+static gchar *android_flat_cache_path( const gchar *aapt2_stamp, const gchar *tmp_folder, const gchar *input )
+{
+	gchar *input_path = g_build_path( "/", tmp_folder, "resOrig", input, NULL );
+	gchar *contents = NULL;
+	gsize length = 0;
+	GChecksum *checksum;
+	gchar *cache_name;
+	gchar *cache_path;
+
+	if ( !g_file_get_contents( input_path, &contents, &length, NULL ) )
+	{
+		g_free( input_path );
+		return NULL;
+	}
+	g_free( input_path );
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_notif_icon_entry");
-		AGK_CLEAR_STR(app->project->apk_settings.notif_icon_path) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+	checksum = g_checksum_new( G_CHECKSUM_SHA1 );
+	g_checksum_update( checksum, (const guchar*) aapt2_stamp, strlen(aapt2_stamp) + 1 );
+	g_checksum_update( checksum, (const guchar*) input, strlen(input) + 1 );
+	g_checksum_update( checksum, (const guchar*) contents, length );
+	g_free( contents );
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_ouya_icon_entry");
-		AGK_CLEAR_STR(app->project->apk_settings.ouya_icon_path) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+	cache_name = g_strconcat( g_checksum_get_string( checksum ), ".flat", NULL );
+	cache_path = g_build_filename( app->configdir, "aapt2cache", cache_name, NULL );
+	g_checksum_free( checksum );
+	g_free( cache_name );
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_firebase_config_entry");
-		AGK_CLEAR_STR(app->project->apk_settings.firebase_config_path) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+	return cache_path;
+}
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_orientation_combo");
-		app->project->apk_settings.orientation = gtk_combo_box_get_active(GTK_COMBO_BOX_TEXT(widget));
-		
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_arcore_combo");
-		app->project->apk_settings.arcore = gtk_combo_box_get_active(GTK_COMBO_BOX_TEXT(widget));
-		
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_sdk_combo");
-		gchar *app_sdk = gtk_combo_box_text_get_active_text(GTK_COMBO_BOX_TEXT(widget));
-		app->project->apk_settings.sdk_version = 1; // 4.1
-		if ( strncmp(app_sdk,"4.2",3) == 0 ) app->project->apk_settings.sdk_version = 2;
-		if ( strncmp(app_sdk,"4.3",3) == 0 ) app->project->apk_settings.sdk_version = 3;
-		if ( strncmp(app_sdk,"4.4",3) == 0 ) app->project->apk_settings.sdk_version = 4;
-		if ( strncmp(app_sdk,"5.0",3) == 0 ) app->project->apk_settings.sdk_version = 5;
-		if ( strncmp(app_sdk,"5.1",3) == 0 ) app->project->apk_settings.sdk_version = 6;
-		if ( strncmp(app_sdk,"6.0",3) == 0 ) app->project->apk_settings.sdk_version = 7;
-		if ( strncmp(app_sdk,"7.0",3) == 0 ) app->project->apk_settings.sdk_version = 8;
-		if ( strncmp(app_sdk,"7.1",3) == 0 ) app->project->apk_settings.sdk_version = 9;
-		if ( strncmp(app_sdk,"8.0",3) == 0 ) app->project->apk_settings.sdk_version = 10;
-		if ( strncmp(app_sdk,"8.1",3) == 0 ) app->project->apk_settings.sdk_version = 11;
-		if ( strncmp(app_sdk,"9.0",3) == 0 ) app->project->apk_settings.sdk_version = 12;
-		if ( strncmp(app_sdk,"10.0",3) == 0 ) app->project->apk_settings.sdk_version = 13;
-		g_free(app_sdk);
-				
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_url_scheme");
-		AGK_CLEAR_STR(app->project->apk_settings.url_scheme) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+// everything an APK export needs, read up front so the export itself doesn't touch any widgets
+typedef struct AndroidExportJob
+{
+	gchar *name;
+	gchar *base_path;
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_deep_link");
-		AGK_CLEAR_STR(app->project->apk_settings.deep_link) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+	gchar *app_name;
+	gchar *package_name;
+	gchar *app_icon;
+	gchar *notif_icon;
+	gchar *ouya_icon;
+	gchar *firebase_config;
+	gchar *url_scheme;
+	gchar *deep_link;
+	gchar *google_play_app_id;
+	gchar *admob_app_id;
+	gchar *snapchat_client_id;
+	gchar *keystore_file;
+	gchar *keystore_password;
+	gchar *version_number;
+	gchar *alias_name;
+	gchar *alias_password;
+	gchar *output_file;
+	gchar *output_type;
+	gchar *compression; // the project's level overrides, see utils_zip_queue_set_levels()
+
+	int app_type; // 0 = Google, 1 = Amazon, 2 = Ouya
+	int orientation; // index of the orientation combo
+	int arcore_mode;
+	int sdk; // minimum API level
+	int build_number;
+	guint permission_flags;
+
+	ExportTask *task; // reports progress and stages for a single export, NULL for Export All
+	volatile gint *cancel;
+	gchar *error; // first error, NULL if the export succeeded
+	gboolean unchanged; // set by the export if the APK was already up to date
+} AndroidExportJob;
+
+// tool locations shared by every job of an export
+typedef struct AndroidExportTools
+{
+	gchar *path_to_aapt2;
+	gchar *path_to_android_jar;
+	gchar *path_to_jarsigner;
+	gchar *path_to_zipalign;
+	gchar *android_folder;
+	gchar *aapt2_stamp; // size and time of the aapt2 binary, compiled resources are cached per aapt2 build
+} AndroidExportTools;
+
+// API levels in the order of the SDK combo
+static const int android_sdk_levels[] = { 16, 17, 18, 19, 21, 22, 23, 24, 25, 26, 27, 28, 29 };
+static const gchar *android_store_names[] = { "Google", "Amazon", "Ouya" };
+static const gchar *android_source_folders[] = { "sourceGoogle", "sourceAmazon", "sourceOuya" };
+static const gchar *android_tmp_folders[] = { "build_tmp", "build_tmp_amazon", "build_tmp_ouya" };
+
+static AndroidExportTools *android_export_tools_new( void )
+{
+	AndroidExportTools *tools = g_new0( AndroidExportTools, 1 );
+	const char* androidJar = "android29.jar";
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_google_play_app_id");
-		AGK_CLEAR_STR(app->project->apk_settings.play_app_id) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+#if defined(G_OS_WIN32)
+	tools->path_to_aapt2 = g_build_path( "\\", app->datadir, "android", "aapt2.exe", NULL );
+	tools->path_to_android_jar = g_build_path( "\\", app->datadir, "android", androidJar, NULL );
+	tools->path_to_jarsigner = g_build_path( "\\", app->datadir, "android", "jre", "bin", "jarsigner.exe", NULL );
+	tools->path_to_zipalign = g_build_path( "\\", app->datadir, "android", "zipalign.exe", NULL );
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_admob_app_id");
-		AGK_CLEAR_STR(app->project->apk_settings.admob_app_id) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+	// convert forward slashes to backward slashes for parameters that will be passed to aapt2
+	utils_str_replace_char( tools->path_to_android_jar, '/', '\\' );
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_snapchat_client_id");
-		AGK_CLEAR_STR(app->project->apk_settings.snapchat_client_id) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+	tools->android_folder = g_build_filename( app->datadir, "android", NULL );
+#elif defined(__APPLE__)
+	tools->path_to_aapt2 = g_build_path( "/", app->configdir, "AndroidExport", "aapt2", NULL );
+	tools->path_to_android_jar = g_build_path( "/", app->configdir, "AndroidExport", androidJar, NULL );
+	tools->path_to_jarsigner = g_strdup( "/usr/bin/jarsigner" );
+	tools->path_to_zipalign = g_build_path( "/", app->configdir, "AndroidExport", "zipalign", NULL );
 
-		// permissions
-		app->project->apk_settings.permission_flags = 0;
+	tools->android_folder = g_build_filename( app->configdir, "AndroidExport", NULL );
+#else
+	tools->path_to_aapt2 = g_build_path( "/", app->datadir, "android", "aapt2", NULL );
+	tools->path_to_android_jar = g_build_path( "/", app->datadir, "android", androidJar, NULL );
+	tools->path_to_jarsigner = g_build_path( "/", app->datadir, "android", "jre", "bin", "jarsigner", NULL );
+	tools->path_to_zipalign = g_build_path( "/", app->datadir, "android", "zipalign", NULL );
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_external_storage");
-		if ( gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widget)) ) app->project->apk_settings.permission_flags |= AGK_ANDROID_PERMISSION_WRITE;
+	tools->android_folder = g_build_filename( app->datadir, "android", NULL );
+#endif
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_location_fine");
-		if ( gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widget)) ) app->project->apk_settings.permission_flags |= AGK_ANDROID_PERMISSION_GPS;
+	utils_str_replace_char( tools->android_folder, '\\', '/' );
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_location_coarse");
-		if ( gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widget)) ) app->project->apk_settings.permission_flags |= AGK_ANDROID_PERMISSION_LOCATION;
+	{
+		struct stat st;
+		if ( g_stat( tools->path_to_aapt2, &st ) == 0 )
+			tools->aapt2_stamp = g_strdup_printf( "%lu-%lu", (gulong) st.st_size, (gulong) st.st_mtime );
+		else
+			tools->aapt2_stamp = g_strdup( "" );
+	}
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_internet");
-		if ( gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widget)) ) app->project->apk_settings.permission_flags |= AGK_ANDROID_PERMISSION_INTERNET;
+	return tools;
+}
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_wake");
-		if ( gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widget)) ) app->project->apk_settings.permission_flags |= AGK_ANDROID_PERMISSION_WAKE;
+static void android_export_tools_free( AndroidExportTools *tools )
+{
+	g_free( tools->path_to_aapt2 );
+	g_free( tools->path_to_android_jar );
+	g_free( tools->path_to_jarsigner );
+	g_free( tools->path_to_zipalign );
+	g_free( tools->android_folder );
+	g_free( tools->aapt2_stamp );
+	g_free( tools );
+}
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_billing");
-		if ( gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widget)) ) app->project->apk_settings.permission_flags |= AGK_ANDROID_PERMISSION_IAP;
+static void android_export_job_free( AndroidExportJob *job )
+{
+	g_free( job->name );
+	g_free( job->base_path );
+	g_free( job->app_name );
+	g_free( job->package_name );
+	g_free( job->app_icon );
+	g_free( job->notif_icon );
+	g_free( job->ouya_icon );
+	g_free( job->firebase_config );
+	g_free( job->url_scheme );
+	g_free( job->deep_link );
+	g_free( job->google_play_app_id );
+	g_free( job->admob_app_id );
+	g_free( job->snapchat_client_id );
+	g_free( job->keystore_file );
+	g_free( job->keystore_password );
+	g_free( job->version_number );
+	g_free( job->alias_name );
+	g_free( job->alias_password );
+	g_free( job->output_file );
+	g_free( job->output_type );
+	g_free( job->compression );
+	g_free( job->error );
+	g_free( job );
+}
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_push_notifications");
-		if ( gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widget)) ) app->project->apk_settings.permission_flags |= AGK_ANDROID_PERMISSION_PUSH;
+// only the first error is kept, later ones are usually caused by it
+static void android_export_job_error( AndroidExportJob *job, const gchar *format, ... ) G_GNUC_PRINTF(2, 3);
+static void android_export_job_error( AndroidExportJob *job, const gchar *format, ... )
+{
+	va_list args;
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_camera");
-		if ( gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widget)) ) app->project->apk_settings.permission_flags |= AGK_ANDROID_PERMISSION_CAMERA;
+	if ( job->error ) return;
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_expansion");
-		if (gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widget)) ) app->project->apk_settings.permission_flags |= AGK_ANDROID_PERMISSION_EXPANSION;
+	va_start( args, format );
+	job->error = g_strdup_vprintf( format, args );
+	va_end( args );
+}
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_vibrate");
-		if (gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widget)) ) app->project->apk_settings.permission_flags |= AGK_ANDROID_PERMISSION_VIBRATE;
+static gboolean android_export_job_cancelled( AndroidExportJob *job )
+{
+	if ( !job->cancel || !g_atomic_int_get( job->cancel ) ) return FALSE;
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_record_audio");
-		if (gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widget)) ) app->project->apk_settings.permission_flags |= AGK_ANDROID_PERMISSION_RECORD_AUDIO;
+	android_export_job_error( job, "%s", _("Export cancelled") );
+	return TRUE;
+}
 
-		// signing
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_keystore_file_entry");
-		AGK_CLEAR_STR(app->project->apk_settings.keystore_path) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-		
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_version_number_entry");
-		AGK_CLEAR_STR(app->project->apk_settings.version_name) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-		
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_build_number_entry");
-		int build_number = atoi(gtk_entry_get_text(GTK_ENTRY(widget)));
-		app->project->apk_settings.version_number = build_number;
+// the step the job is starting, shown with its progress if it has any
+static void android_export_job_stage( AndroidExportJob *job, const gchar *stage )
+{
+	if ( job->task ) export_task_progress( job->task, stage, 0, 0 );
+}
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_alias_entry");
-		AGK_CLEAR_STR(app->project->apk_settings.alias) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+static void android_export_job_mark( AndroidExportJob *job, const gchar *phase )
+{
+	if ( job->task ) export_task_mark( job->task, phase, NULL );
+}
 
-		// output
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_output_file_entry");
-		AGK_CLEAR_STR(app->project->apk_settings.output_path) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+static gboolean android_export_zip_progress( const gchar *archive_name, guint64 done, guint64 total, gpointer user_data )
+{
+	AndroidExportJob *job = user_data;
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_output_type_combo");
-		app->project->apk_settings.app_type = gtk_combo_box_get_active(GTK_COMBO_BOX_TEXT(widget));
-	}
+	if ( job->task ) export_task_progress( job->task, NULL, done, total );
+	return !android_export_job_cancelled( job );
+}
 
-	if ( response != 1 )
+#ifdef __APPLE__
+static ExportTask *android_unpack_task = NULL; // extracting the downloaded export files
+#endif
+
+// the Mac version downloads the export files separately
+static gboolean android_export_files_ready( void )
+{
+#ifdef __APPLE__
+	gchar* android_path = g_build_path( "/", app->configdir, "AndroidExport", "aapt2", NULL );
+	gboolean exists = g_file_test( android_path, G_FILE_TEST_EXISTS );
+	g_free( android_path );
+
+	// the largest files are extracted first so aapt2 can exist before the rest
+	if ( android_unpack_task )
 	{
-		if ( dialog ) gtk_widget_hide(GTK_WIDGET(dialog));
+		SHOW_ERR( "Android export files are still being extracted, please wait and try again" );
+		return FALSE;
 	}
-	else
+
+	if ( !exists )
 	{
-		int i;
-		GtkWidget *widget;
+		if ( m_connection ) SHOW_ERR( "Android export files have not finished downloading, please wait and try again" );
+		else SHOW_ERR( "Android export files not found. Please close the export dialog and reopen it to try downloading again" );
+		return FALSE;
+	}
+#endif
+	return TRUE;
+}
 
-		gtk_widget_set_sensitive( ui_lookup_widget(ui_widgets.android_dialog, "android_export1"), FALSE );
-		gtk_widget_set_sensitive( ui_lookup_widget(ui_widgets.android_dialog, "button7"), FALSE );
-		
-		while (gtk_events_pending())
-			gtk_main_iteration();
+static AndroidExportJob *android_export_job_from_dialog( void )
+{
+	AndroidExportJob *job = g_new0( AndroidExportJob, 1 );
+	GtkWidget *widget;
+	int i;
 
-		// app details
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_app_name_entry");
-		gchar *app_name = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-		
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_package_name_entry");
-		gchar *package_name = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+	job->name = g_strdup( app->project->name );
+	job->base_path = g_strdup( app->project->base_path );
+	job->compression = g_strdup( app->project->apk_settings.compression );
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_app_icon_entry");
-		gchar *app_icon = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+	// app details
+	widget = ui_lookup_widget(ui_widgets.android_dialog, "android_app_name_entry");
+	job->app_name = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_notif_icon_entry");
-		gchar *notif_icon = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+	widget = ui_lookup_widget(ui_widgets.android_dialog, "android_package_name_entry");
+	job->package_name = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_ouya_icon_entry");
-		gchar *ouya_icon = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+	widget = ui_lookup_widget(ui_widgets.android_dialog, "android_app_icon_entry");
+	job->app_icon = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_firebase_config_entry");
-		gchar *firebase_config = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+	widget = ui_lookup_widget(ui_widgets.android_dialog, "android_notif_icon_entry");
+	job->notif_icon = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_orientation_combo");
-		int app_orientation_int = gtk_combo_box_get_active(GTK_COMBO_BOX_TEXT(widget));
-		int orientation = 10;
-		if ( app_orientation_int == 0 ) orientation = 6;
-		else if ( app_orientation_int == 1 ) orientation = 7;
-		gchar szOrientation[ 20 ];
-		sprintf( szOrientation, "%d", orientation );
+	widget = ui_lookup_widget(ui_widgets.android_dialog, "android_ouya_icon_entry");
+	job->ouya_icon = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_arcore_combo");
-		int arcore_mode = gtk_combo_box_get_active(GTK_COMBO_BOX_TEXT(widget));
-				
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_sdk_combo");
-		gchar *app_sdk = gtk_combo_box_text_get_active_text(GTK_COMBO_BOX_TEXT(widget));
-		int sdk = 16;
-		if ( strncmp(app_sdk,"4.2",3) == 0 ) sdk = 17;
-		if ( strncmp(app_sdk,"4.3",3) == 0 ) sdk = 18;
-		if ( strncmp(app_sdk,"4.4",3) == 0 ) sdk = 19;
-		if ( strncmp(app_sdk,"5.0",3) == 0 ) sdk = 21;
-		if ( strncmp(app_sdk,"5.1",3) == 0 ) sdk = 22;
-		if ( strncmp(app_sdk,"6.0",3) == 0 ) sdk = 23;
-		if ( strncmp(app_sdk,"7.0",3) == 0 ) sdk = 24;
-		if ( strncmp(app_sdk,"7.1",3) == 0 ) sdk = 25;
-		if ( strncmp(app_sdk,"8.0",3) == 0 ) sdk = 26;
-		if ( strncmp(app_sdk,"8.1",3) == 0 ) sdk = 27;
-		if ( strncmp(app_sdk,"9.0",3) == 0 ) sdk = 28;
-		if ( strncmp(app_sdk,"10.0",3) == 0 ) sdk = 29;
-		g_free(app_sdk);
-		gchar szSDK[ 20 ];
-		sprintf( szSDK, "%d", sdk );
-		
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_url_scheme");
-		gchar *url_scheme = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_deep_link");
-		gchar *deep_link = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_google_play_app_id");
-		gchar *google_play_app_id = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_admob_app_id");
-		gchar *admob_app_id = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_snapchat_client_id");
-		gchar *snapchat_client_id = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+	widget = ui_lookup_widget(ui_widgets.android_dialog, "android_firebase_config_entry");
+	job->firebase_config = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-		// permissions
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_external_storage");
-		int permission_external_storage = gtk_toggle_button_get_active( GTK_TOGGLE_BUTTON(widget) );
+	widget = ui_lookup_widget(ui_widgets.android_dialog, "android_orientation_combo");
+	job->orientation = gtk_combo_box_get_active(GTK_COMBO_BOX_TEXT(widget));
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_location_fine");
-		int permission_location_fine = gtk_toggle_button_get_active( GTK_TOGGLE_BUTTON(widget) );
+	widget = ui_lookup_widget(ui_widgets.android_dialog, "android_arcore_combo");
+	job->arcore_mode = gtk_combo_box_get_active(GTK_COMBO_BOX_TEXT(widget));
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_location_coarse");
-		int permission_location_coarse = gtk_toggle_button_get_active( GTK_TOGGLE_BUTTON(widget) );
+	widget = ui_lookup_widget(ui_widgets.android_dialog, "android_sdk_combo");
+	gchar *app_sdk = gtk_combo_box_text_get_active_text(GTK_COMBO_BOX_TEXT(widget));
+	job->sdk = 16;
+	if ( strncmp(app_sdk,"4.2",3) == 0 ) job->sdk = 17;
+	if ( strncmp(app_sdk,"4.3",3) == 0 ) job->sdk = 18;
+	if ( strncmp(app_sdk,"4.4",3) == 0 ) job->sdk = 19;
+	if ( strncmp(app_sdk,"5.0",3) == 0 ) job->sdk = 21;
+	if ( strncmp(app_sdk,"5.1",3) == 0 ) job->sdk = 22;
+	if ( strncmp(app_sdk,"6.0",3) == 0 ) job->sdk = 23;
+	if ( strncmp(app_sdk,"7.0",3) == 0 ) job->sdk = 24;
+	if ( strncmp(app_sdk,"7.1",3) == 0 ) job->sdk = 25;
+	if ( strncmp(app_sdk,"8.0",3) == 0 ) job->sdk = 26;
+	if ( strncmp(app_sdk,"8.1",3) == 0 ) job->sdk = 27;
+	if ( strncmp(app_sdk,"9.0",3) == 0 ) job->sdk = 28;
+	if ( strncmp(app_sdk,"10.0",3) == 0 ) job->sdk = 29;
+	g_free(app_sdk);
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_internet");
-		int permission_internet = gtk_toggle_button_get_active( GTK_TOGGLE_BUTTON(widget) );
+	widget = ui_lookup_widget(ui_widgets.android_dialog, "android_url_scheme");
+	job->url_scheme = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_wake");
-		int permission_wake = gtk_toggle_button_get_active( GTK_TOGGLE_BUTTON(widget) );
+	widget = ui_lookup_widget(ui_widgets.android_dialog, "android_deep_link");
+	job->deep_link = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_billing");
-		int permission_billing = gtk_toggle_button_get_active( GTK_TOGGLE_BUTTON(widget) );
+	widget = ui_lookup_widget(ui_widgets.android_dialog, "android_google_play_app_id");
+	job->google_play_app_id = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_push_notifications");
-		int permission_push = gtk_toggle_button_get_active( GTK_TOGGLE_BUTTON(widget) );
+	widget = ui_lookup_widget(ui_widgets.android_dialog, "android_admob_app_id");
+	job->admob_app_id = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_camera");
-		int permission_camera = gtk_toggle_button_get_active( GTK_TOGGLE_BUTTON(widget) );
+	widget = ui_lookup_widget(ui_widgets.android_dialog, "android_snapchat_client_id");
+	job->snapchat_client_id = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_expansion");
-		int permission_expansion = gtk_toggle_button_get_active( GTK_TOGGLE_BUTTON(widget) );
+	// permissions
+	{
+		const gchar *permission_widgets[] = { "android_permission_external_storage", "android_permission_location_fine",
+			"android_permission_location_coarse", "android_permission_internet", "android_permission_wake",
+			"android_permission_billing", "android_permission_push_notifications", "android_permission_camera",
+			"android_permission_expansion", "android_permission_vibrate", "android_permission_record_audio" };
+		const guint permission_flags[] = { AGK_ANDROID_PERMISSION_WRITE, AGK_ANDROID_PERMISSION_GPS,
+			AGK_ANDROID_PERMISSION_LOCATION, AGK_ANDROID_PERMISSION_INTERNET, AGK_ANDROID_PERMISSION_WAKE,
+			AGK_ANDROID_PERMISSION_IAP, AGK_ANDROID_PERMISSION_PUSH, AGK_ANDROID_PERMISSION_CAMERA,
+			AGK_ANDROID_PERMISSION_EXPANSION, AGK_ANDROID_PERMISSION_VIBRATE, AGK_ANDROID_PERMISSION_RECORD_AUDIO };
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_vibrate");
-		int permission_vibrate = gtk_toggle_button_get_active( GTK_TOGGLE_BUTTON(widget) );
+		for( i = 0; i < (int) G_N_ELEMENTS(permission_widgets); i++ )
+		{
+			widget = ui_lookup_widget(ui_widgets.android_dialog, permission_widgets[i]);
+			if ( gtk_toggle_button_get_active( GTK_TOGGLE_BUTTON(widget) ) ) job->permission_flags |= permission_flags[i];
+		}
+	}
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_record_audio");
-		int permission_record_audio = gtk_toggle_button_get_active( GTK_TOGGLE_BUTTON(widget) );
+	// signing
+	widget = ui_lookup_widget(ui_widgets.android_dialog, "android_keystore_file_entry");
+	job->keystore_file = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-		// signing
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_keystore_file_entry");
-		gchar *keystore_file = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-		
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_keystore_password_entry");
-		gchar *keystore_password = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+	widget = ui_lookup_widget(ui_widgets.android_dialog, "android_keystore_password_entry");
+	job->keystore_password = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_version_number_entry");
-		gchar *version_number = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-		if ( !*version_number ) SETPTR( version_number, g_strdup("1.0.0") );
+	widget = ui_lookup_widget(ui_widgets.android_dialog, "android_version_number_entry");
+	job->version_number = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+	if ( !*job->version_number ) SETPTR( job->version_number, g_strdup("1.0.0") );
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_build_number_entry");
-		int build_number = atoi(gtk_entry_get_text(GTK_ENTRY(widget)));
-		if ( build_number == 0 ) build_number = 1;
-		gchar szBuildNum[ 20 ];
-		sprintf( szBuildNum, "%d", build_number );
+	widget = ui_lookup_widget(ui_widgets.android_dialog, "android_build_number_entry");
+	job->build_number = atoi(gtk_entry_get_text(GTK_ENTRY(widget)));
+	if ( job->build_number == 0 ) job->build_number = 1;
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_alias_entry");
-		gchar *alias_name = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+	widget = ui_lookup_widget(ui_widgets.android_dialog, "android_alias_entry");
+	job->alias_name = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_alias_password_entry");
-		gchar *alias_password = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+	widget = ui_lookup_widget(ui_widgets.android_dialog, "android_alias_password_entry");
+	job->alias_password = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-		// output
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_output_file_entry");
-		gchar *output_file = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+	// output
+	widget = ui_lookup_widget(ui_widgets.android_dialog, "android_output_file_entry");
+	job->output_file = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_output_type_combo");
-		gchar *output_type = gtk_combo_box_text_get_active_text(GTK_COMBO_BOX_TEXT(widget));
-		int app_type = gtk_combo_box_get_active(GTK_COMBO_BOX_TEXT(widget));
-				
-		gchar *percent = 0;
-		while ( (percent = strchr(output_file, '%')) != 0 )
-		{
-			if ( strncmp( percent+1, "[version]", strlen("[version]") ) == 0 )
-			{
-				*percent = 0;
-				percent += strlen("[version]") + 1;
-				gchar *new_output = g_strconcat( output_file, szBuildNum, percent, NULL );
-				g_free(output_file);
-				output_file = new_output;
-				continue;
-			}
+	widget = ui_lookup_widget(ui_widgets.android_dialog, "android_output_type_combo");
+	job->output_type = gtk_combo_box_text_get_active_text(GTK_COMBO_BOX_TEXT(widget));
+	job->app_type = gtk_combo_box_get_active(GTK_COMBO_BOX_TEXT(widget));
 
-			if ( strncmp( percent+1, "[type]", strlen("[type]") ) == 0 )
-			{
-				*percent = 0;
-				percent += strlen("[type]") + 1;
-				gchar *new_output = g_strconcat( output_file, output_type, percent, NULL );
-				g_free(output_file);
-				output_file = new_output;
-				continue;
-			}
+	return job;
+}
 
-			break;
-		}
+// builds a job from a project's saved settings, as used by Export All
+static AndroidExportJob *android_export_job_from_project( GeanyProject *project, int app_type, const gchar *keystore_password,
+                                                          const gchar *version_number, int build_number, const gchar *output_folder )
+{
+	AndroidExportJob *job = g_new0( AndroidExportJob, 1 );
+	int sdk_version = project->apk_settings.sdk_version;
+	gchar *filename;
 
-		g_free(output_type);
+	job->name = g_strdup( project->name );
+	job->base_path = g_strdup( project->base_path );
+	job->compression = g_strdup( project->apk_settings.compression );
+
+	job->app_name = g_strdup( FALLBACK(project->apk_settings.app_name, "") );
+	job->package_name = g_strdup( FALLBACK(project->apk_settings.package_name, "") );
+	job->app_icon = g_strdup( FALLBACK(project->apk_settings.app_icon_path, "") );
+	job->notif_icon = g_strdup( FALLBACK(project->apk_settings.notif_icon_path, "") );
+	job->ouya_icon = g_strdup( FALLBACK(project->apk_settings.ouya_icon_path, "") );
+	job->firebase_config = g_strdup( FALLBACK(project->apk_settings.firebase_config_path, "") );
+	job->url_scheme = g_strdup( FALLBACK(project->apk_settings.url_scheme, "") );
+	job->deep_link = g_strdup( FALLBACK(project->apk_settings.deep_link, "") );
+	job->google_play_app_id = g_strdup( FALLBACK(project->apk_settings.play_app_id, "") );
+	job->admob_app_id = g_strdup( FALLBACK(project->apk_settings.admob_app_id, "") );
+	job->snapchat_client_id = g_strdup( FALLBACK(project->apk_settings.snapchat_client_id, "") );
+
+	job->orientation = project->apk_settings.orientation;
+	job->arcore_mode = project->apk_settings.arcore;
+	if ( sdk_version < 1 ) sdk_version = 1;
+	if ( sdk_version > (int) G_N_ELEMENTS(android_sdk_levels) ) sdk_version = G_N_ELEMENTS(android_sdk_levels);
+	job->sdk = android_sdk_levels[ sdk_version - 1 ];
+	job->permission_flags = project->apk_settings.permission_flags;
+
+	// the export all dialog has one password for both the keystore and the alias
+	job->keystore_file = g_strdup( FALLBACK(project->apk_settings.keystore_path, "") );
+	job->keystore_password = g_strdup( keystore_password );
+	job->alias_name = g_strdup( FALLBACK(project->apk_settings.alias, "") );
+	job->alias_password = g_strdup( keystore_password );
+	job->version_number = g_strdup( version_number );
+	job->build_number = build_number ? build_number : 1;
+
+	job->app_type = app_type;
+	job->output_type = g_strdup( android_store_names[app_type] );
+	filename = g_strconcat( project->name, "-", android_store_names[app_type], "-", version_number, ".apk", NULL );
+	job->output_file = g_build_filename( output_folder, filename, NULL );
+	g_free( filename );
+
+	return job;
+}
 
-		// START CHECKS
 
-		if ( !output_file || !*output_file ) { SHOW_ERR(_("You must choose an output location to save your APK")); goto android_dialog_clean_up; }
-		if ( strchr(output_file, '.') == 0 ) { SHOW_ERR(_("The output location must be a file not a directory")); goto android_dialog_clean_up; }
+// validates the job's settings before anything is written, also fills in the output file name
+static gboolean android_export_job_check( AndroidExportJob *job )
+{
+	int i;
+	gchar szBuildNum[ 20 ];
+	sprintf( szBuildNum, "%d", job->build_number );
 
-		// check app name
-		if ( !app_name || !*app_name ) { SHOW_ERR(_("You must enter an app name")); goto android_dialog_clean_up; }
-		if ( strlen(app_name) > 30 ) { SHOW_ERR(_("App name must be less than 30 characters")); goto android_dialog_clean_up; }
-		for( i = 0; i < strlen(app_name); i++ )
+	gchar *percent = 0;
+	while ( (percent = strchr(job->output_file, '%')) != 0 )
+	{
+		if ( strncmp( percent+1, "[version]", strlen("[version]") ) == 0 )
 		{
-			/*
-			if ( (app_name[i] < 97 || app_name[i] > 122)
-			  && (app_name[i] < 65 || app_name[i] > 90) 
-			  && (app_name[i] < 48 || app_name[i] > 57) 
-			  && app_name[i] != 32 
-			  && app_name[i] != 45
-			  && app_name[i] != 95 ) 
-			{ 
-				SHOW_ERR(_("App name contains invalid characters, must be A-Z, 0-9, dash, spaces, and undersore only")); 
-				goto android_dialog_clean_up; 
-			}
-			*/
-			//switch to black list
-			if ( app_name[i] == 34 || app_name[i] == 60 || app_name[i] == 62 || app_name[i] == 39 )
-			{
-				SHOW_ERR(_("App name contains invalid characters, it must not contain quotes or < > characters.")); 
-				goto android_dialog_clean_up; 
-			}
+			*percent = 0;
+			percent += strlen("[version]") + 1;
+			gchar *new_output = g_strconcat( job->output_file, szBuildNum, percent, NULL );
+			g_free(job->output_file);
+			job->output_file = new_output;
+			continue;
 		}
-		
-		// check package name
-		if ( !package_name || !*package_name ) { SHOW_ERR(_("You must enter a package name")); goto android_dialog_clean_up; }
-		if ( strlen(package_name) > 100 ) { SHOW_ERR(_("Package name must be less than 100 characters")); goto android_dialog_clean_up; }
-		if ( strchr(package_name,'.') == NULL ) { SHOW_ERR(_("Package name must contain at least one dot character")); goto android_dialog_clean_up; }
-		if ( (package_name[0] < 65 || package_name[0] > 90) && (package_name[0] < 97 || package_name[0] > 122) ) { SHOW_ERR(_("Package name must begin with a letter")); goto android_dialog_clean_up; }
-		if ( package_name[strlen(package_name)-1] == '.' ) { SHOW_ERR(_("Package name must not end with a dot")); goto android_dialog_clean_up; }
 
-		gchar last = 0;
-		for( i = 0; i < strlen(package_name); i++ )
+		if ( strncmp( percent+1, "[type]", strlen("[type]") ) == 0 )
 		{
-			if ( last == '.' && (package_name[i] < 65 || package_name[i] > 90) && (package_name[i] < 97 || package_name[i] > 122) )
-			{
-				SHOW_ERR(_("Package name invalid, a dot must be followed by a letter"));
-				goto android_dialog_clean_up; 
-			}
+			*percent = 0;
+			percent += strlen("[type]") + 1;
+			gchar *new_output = g_strconcat( job->output_file, job->output_type, percent, NULL );
+			g_free(job->output_file);
+			job->output_file = new_output;
+			continue;
+		}
 
-			if ( (package_name[i] < 97 || package_name[i] > 122) // a-z
-			  && (package_name[i] < 65 || package_name[i] > 90) // A-Z
-			  && (package_name[i] < 48 || package_name[i] > 57) //0-9
-			  && package_name[i] != 46 // .
-			  && package_name[i] != 95 ) // _
-			{ 
-				SHOW_ERR(_("Package name contains invalid characters, must be A-Z 0-9 . and undersore only")); 
-				goto android_dialog_clean_up; 
-			}
+		break;
+	}
 
-			last = package_name[i];
+	const gchar *output_file = job->output_file;
+	const gchar *app_name = job->app_name;
+	const gchar *package_name = job->package_name;
+	const gchar *app_icon = job->app_icon;
+	const gchar *notif_icon = job->notif_icon;
+	const gchar *ouya_icon = job->ouya_icon;
+	const gchar *firebase_config = job->firebase_config;
+	const gchar *url_scheme = job->url_scheme;
+	const gchar *deep_link = job->deep_link;
+	const gchar *keystore_file = job->keystore_file;
+	const gchar *keystore_password = job->keystore_password;
+	const gchar *version_number = job->version_number;
+	const gchar *alias_name = job->alias_name;
+	const gchar *alias_password = job->alias_password;
+	int app_type = job->app_type;
+
+	if ( !output_file || !*output_file ) { android_export_job_error( job, "%s", _("You must choose an output location to save your APK") ); return FALSE; }
+	if ( strchr(output_file, '.') == 0 ) { android_export_job_error( job, "%s", _("The output location must be a file not a directory") ); return FALSE; }
+
+	// check app name
+	if ( !app_name || !*app_name ) { android_export_job_error( job, "%s", _("You must enter an app name") ); return FALSE; }
+	if ( strlen(app_name) > 30 ) { android_export_job_error( job, "%s", _("App name must be less than 30 characters") ); return FALSE; }
+	for( i = 0; i < strlen(app_name); i++ )
+	{
+		/*
+		if ( (app_name[i] < 97 || app_name[i] > 122)
+		  && (app_name[i] < 65 || app_name[i] > 90) 
+		  && (app_name[i] < 48 || app_name[i] > 57) 
+		  && app_name[i] != 32 
+		  && app_name[i] != 45
+		  && app_name[i] != 95 ) 
+		{ 
+			android_export_job_error( job, "%s", _("App name contains invalid characters, must be A-Z, 0-9, dash, spaces, and undersore only") ); 
+			return FALSE; 
 		}
-
-		if ( url_scheme && *url_scheme )
+		*/
+		//switch to black list
+		if ( app_name[i] == 34 || app_name[i] == 60 || app_name[i] == 62 || app_name[i] == 39 )
 		{
-			if ( strchr(url_scheme, ':') || strchr(url_scheme, '/') )
-			{
-				SHOW_ERR(_("URL scheme must not contain : or /"));
-				goto android_dialog_clean_up; 
-			}
+			android_export_job_error( job, "%s", _("App name contains invalid characters, it must not contain quotes or < > characters.") ); 
+			return FALSE; 
 		}
-
-		if ( deep_link && *deep_link )
+	}
+	
+	// check package name
+	if ( !package_name || !*package_name ) { android_export_job_error( job, "%s", _("You must enter a package name") ); return FALSE; }
+	if ( strlen(package_name) > 100 ) { android_export_job_error( job, "%s", _("Package name must be less than 100 characters") ); return FALSE; }
+	if ( strchr(package_name,'.') == NULL ) { android_export_job_error( job, "%s", _("Package name must contain at least one dot character") ); return FALSE; }
+	if ( (package_name[0] < 65 || package_name[0] > 90) && (package_name[0] < 97 || package_name[0] > 122) ) { android_export_job_error( job, "%s", _("Package name must begin with a letter") ); return FALSE; }
+	if ( package_name[strlen(package_name)-1] == '.' ) { android_export_job_error( job, "%s", _("Package name must not end with a dot") ); return FALSE; }
+
+	gchar last = 0;
+	for( i = 0; i < strlen(package_name); i++ )
+	{
+		if ( last == '.' && (package_name[i] < 65 || package_name[i] > 90) && (package_name[i] < 97 || package_name[i] > 122) )
 		{
-			if ( strncmp( deep_link, "https://", strlen("https://") ) != 0 && strncmp( deep_link, "http://", strlen("http://") ) != 0 )
-			{
-				SHOW_ERR(_("Deep link must start with http:// or https://"));
-				goto android_dialog_clean_up; 
-			}
-
-			if ( strcmp( deep_link, "https://" ) == 0 || strcmp( deep_link, "http://" ) == 0 )
-			{
-				SHOW_ERR(_("Deep link must have a domain after http:// or https://"));
-				goto android_dialog_clean_up; 
-			}
+			android_export_job_error( job, "%s", _("Package name invalid, a dot must be followed by a letter") );
+			return FALSE; 
 		}
 
-		// check icon
-		//if ( !app_icon || !*app_icon ) { SHOW_ERR(_("You must select an app icon")); goto android_dialog_clean_up; }
-		if ( app_icon && *app_icon )
-		{
-			if ( !strrchr( app_icon, '.' ) || utils_str_casecmp( strrchr( app_icon, '.' ), ".png" ) != 0 ) { SHOW_ERR(_("App icon must be a PNG file")); goto android_dialog_clean_up; }
-			if ( !g_file_test( app_icon, G_FILE_TEST_EXISTS ) ) { SHOW_ERR(_("Could not find app icon location")); goto android_dialog_clean_up; }
+		if ( (package_name[i] < 97 || package_name[i] > 122) // a-z
+		  && (package_name[i] < 65 || package_name[i] > 90) // A-Z
+		  && (package_name[i] < 48 || package_name[i] > 57) //0-9
+		  && package_name[i] != 46 // .
+		  && package_name[i] != 95 ) // _
+		{ 
+			android_export_job_error( job, "%s", _("Package name contains invalid characters, must be A-Z 0-9 . and undersore only") ); 
+			return FALSE; 
 		}
 
-		if ( notif_icon && *notif_icon )
-		{
-			if ( !strrchr( notif_icon, '.' ) || utils_str_casecmp( strrchr( notif_icon, '.' ), ".png" ) != 0 ) { SHOW_ERR(_("Notification icon must be a PNG file")); goto android_dialog_clean_up; }
-			if ( !g_file_test( notif_icon, G_FILE_TEST_EXISTS ) ) { SHOW_ERR(_("Could not find notification icon location")); goto android_dialog_clean_up; }
-		}
+		last = package_name[i];
+	}
 
-		if ( app_type == 2 )
+	if ( url_scheme && *url_scheme )
+	{
+		if ( strchr(url_scheme, ':') || strchr(url_scheme, '/') )
 		{
-			//if ( !ouya_icon || !*ouya_icon ) { SHOW_ERR(_("You must select an Ouya large icon")); goto android_dialog_clean_up; }
-			if ( ouya_icon && *ouya_icon )
-			{
-				if ( !strrchr( ouya_icon, '.' ) || utils_str_casecmp( strrchr( ouya_icon, '.' ), ".png" ) != 0 ) { SHOW_ERR(_("Ouya large icon must be a PNG file")); goto android_dialog_clean_up; }
-				if ( !g_file_test( ouya_icon, G_FILE_TEST_EXISTS ) ) { SHOW_ERR(_("Could not find ouya large icon location")); goto android_dialog_clean_up; }
-			}
+			android_export_job_error( job, "%s", _("URL scheme must not contain : or /") );
+			return FALSE; 
 		}
+	}
 
-		// check firebase config file
-		if ( firebase_config && *firebase_config )
-		{
-			if ( !strrchr( firebase_config, '.' ) || utils_str_casecmp( strrchr( firebase_config, '.' ), ".json" ) != 0 ) { SHOW_ERR(_("Google services config file must be a .json file")); goto android_dialog_clean_up; }
-			if ( !g_file_test( firebase_config, G_FILE_TEST_EXISTS ) ) { SHOW_ERR(_("Could not find Google services config file")); goto android_dialog_clean_up; }
-		}
-				
-		// check version
-		if ( version_number && *version_number )
+	if ( deep_link && *deep_link )
+	{
+		if ( strncmp( deep_link, "https://", strlen("https://") ) != 0 && strncmp( deep_link, "http://", strlen("http://") ) != 0 )
 		{
-			for( i = 0; i < strlen(version_number); i++ )
-			{
-				if ( (version_number[i] < 48 || version_number[i] > 57) && version_number[i] != 46 ) 
-				{ 
-					SHOW_ERR(_("Version name contains invalid characters, must be 0-9 and . only")); 
-					goto android_dialog_clean_up; 
-				}
-			}
+			android_export_job_error( job, "%s", _("Deep link must start with http:// or https://") );
+			return FALSE; 
 		}
 
-		// check keystore
-		if ( keystore_file && *keystore_file )
+		if ( strcmp( deep_link, "https://" ) == 0 || strcmp( deep_link, "http://" ) == 0 )
 		{
-			if ( !g_file_test( keystore_file, G_FILE_TEST_EXISTS ) ) { SHOW_ERR(_("Could not find keystore file location")); goto android_dialog_clean_up; }
+			android_export_job_error( job, "%s", _("Deep link must have a domain after http:// or https://") );
+			return FALSE; 
 		}
+	}
 
-		// check passwords
-		if ( keystore_password && strchr(keystore_password,'"') ) { SHOW_ERR(_("Keystore password cannot contain double quotes")); goto android_dialog_clean_up; }
-		if ( alias_password && strchr(alias_password,'"') ) { SHOW_ERR(_("Alias password cannot contain double quotes")); goto android_dialog_clean_up; }
+	// check icon
+	//if ( !app_icon || !*app_icon ) { android_export_job_error( job, "%s", _("You must select an app icon") ); return FALSE; }
+	if ( app_icon && *app_icon )
+	{
+		if ( !strrchr( app_icon, '.' ) || utils_str_casecmp( strrchr( app_icon, '.' ), ".png" ) != 0 ) { android_export_job_error( job, "%s", _("App icon must be a PNG file") ); return FALSE; }
+		if ( !g_file_test( app_icon, G_FILE_TEST_EXISTS ) ) { android_export_job_error( job, "%s", _("Could not find app icon location") ); return FALSE; }
+	}
+
+	if ( notif_icon && *notif_icon )
+	{
+		if ( !strrchr( notif_icon, '.' ) || utils_str_casecmp( strrchr( notif_icon, '.' ), ".png" ) != 0 ) { android_export_job_error( job, "%s", _("Notification icon must be a PNG file") ); return FALSE; }
+		if ( !g_file_test( notif_icon, G_FILE_TEST_EXISTS ) ) { android_export_job_error( job, "%s", _("Could not find notification icon location") ); return FALSE; }
+	}
 
-		if ( keystore_file && *keystore_file )
+	if ( app_type == 2 )
+	{
+		//if ( !ouya_icon || !*ouya_icon ) { android_export_job_error( job, "%s", _("You must select an Ouya large icon") ); return FALSE; }
+		if ( ouya_icon && *ouya_icon )
 		{
-			if ( !keystore_password || !*keystore_password ) { SHOW_ERR(_("You must enter your keystore password when using your own keystore")); goto android_dialog_clean_up; }
+			if ( !strrchr( ouya_icon, '.' ) || utils_str_casecmp( strrchr( ouya_icon, '.' ), ".png" ) != 0 ) { android_export_job_error( job, "%s", _("Ouya large icon must be a PNG file") ); return FALSE; }
+			if ( !g_file_test( ouya_icon, G_FILE_TEST_EXISTS ) ) { android_export_job_error( job, "%s", _("Could not find ouya large icon location") ); return FALSE; }
 		}
+	}
 
-		if ( alias_name && *alias_name )
+	// check firebase config file
+	if ( firebase_config && *firebase_config )
+	{
+		if ( !strrchr( firebase_config, '.' ) || utils_str_casecmp( strrchr( firebase_config, '.' ), ".json" ) != 0 ) { android_export_job_error( job, "%s", _("Google services config file must be a .json file") ); return FALSE; }
+		if ( !g_file_test( firebase_config, G_FILE_TEST_EXISTS ) ) { android_export_job_error( job, "%s", _("Could not find Google services config file") ); return FALSE; }
+	}
+			
+	// check version
+	if ( version_number && *version_number )
+	{
+		for( i = 0; i < strlen(version_number); i++ )
 		{
-			if ( !alias_password || !*alias_password ) { SHOW_ERR(_("You must enter your alias password when using a custom alias")); goto android_dialog_clean_up; }
+			if ( (version_number[i] < 48 || version_number[i] > 57) && version_number[i] != 46 ) 
+			{ 
+				android_export_job_error( job, "%s", _("Version name contains invalid characters, must be 0-9 and . only") ); 
+				return FALSE; 
+			}
 		}
+	}
 
-		int includeFirebase = (firebase_config && *firebase_config && (app_type == 0 || app_type == 1)) ? 1 : 0;
-		int includePushNotify = (permission_push && app_type == 0) ? 1 : 0;
-		int includeGooglePlay = (google_play_app_id && *google_play_app_id && app_type == 0) ? 1 : 0;
-		int includeAdMob = (admob_app_id && *admob_app_id && app_type == 0) ? 1 : 0;
+	// check keystore
+	if ( keystore_file && *keystore_file )
+	{
+		if ( !g_file_test( keystore_file, G_FILE_TEST_EXISTS ) ) { android_export_job_error( job, "%s", _("Could not find keystore file location") ); return FALSE; }
+	}
 
-		if ( includePushNotify && !includeFirebase )
-		{
-			SHOW_ERR( _("Push Notifications on Android now use Firebase, so you must include a Firebase config file to use them") );
-			goto android_dialog_clean_up;
-		}
+	// check passwords
+	if ( keystore_password && strchr(keystore_password,'"') ) { android_export_job_error( job, "%s", _("Keystore password cannot contain double quotes") ); return FALSE; }
+	if ( alias_password && strchr(alias_password,'"') ) { android_export_job_error( job, "%s", _("Alias password cannot contain double quotes") ); return FALSE; }
 
-		goto android_dialog_continue;
+	if ( keystore_file && *keystore_file )
+	{
+		if ( !keystore_password || !*keystore_password ) { android_export_job_error( job, "%s", _("You must enter your keystore password when using your own keystore") ); return FALSE; }
+	}
 
-android_dialog_clean_up:
-		if ( app_name ) g_free(app_name);
-		if ( package_name ) g_free(package_name);
-		if ( app_icon ) g_free(app_icon);
-		if ( ouya_icon ) g_free(ouya_icon);
-		if ( notif_icon ) g_free(notif_icon);
-		if ( firebase_config ) g_free(firebase_config);
-		if ( url_scheme ) g_free(url_scheme);
-		if ( deep_link ) g_free(deep_link);
-		if ( google_play_app_id ) g_free(google_play_app_id);
-		if ( admob_app_id ) g_free(admob_app_id);
-		if ( snapchat_client_id ) g_free(snapchat_client_id);
+	if ( alias_name && *alias_name )
+	{
+		if ( !alias_password || !*alias_password ) { android_export_job_error( job, "%s", _("You must enter your alias password when using a custom alias") ); return FALSE; }
+	}
 
-		if ( keystore_file ) g_free(keystore_file);
-		if ( keystore_password ) g_free(keystore_password);
-		if ( version_number ) g_free(version_number);
-		if ( alias_name ) g_free(alias_name);
-		if ( alias_password ) g_free(alias_password);
+	int includeFirebase = (firebase_config && *firebase_config && (app_type == 0 || app_type == 1)) ? 1 : 0;
+	int includePushNotify = ((job->permission_flags & AGK_ANDROID_PERMISSION_PUSH) && app_type == 0) ? 1 : 0;
+	
+	if ( includePushNotify && !includeFirebase )
+	{
+		android_export_job_error( job, "%s", _("Push Notifications on Android now use Firebase, so you must include a Firebase config file to use them") );
+		return FALSE;
+	}
 
-		if ( output_file ) g_free(output_file);
+	return TRUE;
+}
 
-		gtk_widget_set_sensitive( ui_lookup_widget(ui_widgets.android_dialog, "android_export1"), TRUE );
-		gtk_widget_set_sensitive( ui_lookup_widget(ui_widgets.android_dialog, "button7"), TRUE );
-		running = 0;
-		return;
 
-android_dialog_continue:
+// entries of values.xml that the export fills in, by name
+static const struct
+{
+	const gchar *name;
+	const gchar *open;
+} android_values_entries[] = 
+{
+	{ "app_name", "<string name=\"app_name\">" },
+	{ "games_app_id", "<string name=\"games_app_id\">" },
+	{ "admob_app_id", "<string name=\"admob_app_id\">" },
+	{ "snap_chat_id", "<string name=\"snap_chat_id\">" },
+	{ "gcm_defaultSenderId", "<string name=\"gcm_defaultSenderId\" translatable=\"false\">" },
+	{ "firebase_database_url", "<string name=\"firebase_database_url\" translatable=\"false\">" },
+	{ "google_app_id", "<string name=\"google_app_id\" translatable=\"false\">" },
+	{ "google_api_key", "<string name=\"google_api_key\" translatable=\"false\">" },
+	{ "google_crash_reporting_api_key", "<string name=\"google_crash_reporting_api_key\" translatable=\"false\">" }
+};
+
+// sets the value of a values.xml entry, fails the job if the template doesn't have it
+static gboolean android_values_set( AndroidExportJob *job, UtilsTemplate *values, const gchar *name, const gchar *value )
+{
+	guint i;
 
-		while (gtk_events_pending())
-			gtk_main_iteration();
+	for( i = 0; i < G_N_ELEMENTS(android_values_entries); i++ )
+	{
+		if ( strcmp( android_values_entries[i].name, name ) != 0 ) continue;
 
-		// CHECKS COMPLETE, START EXPORT
+		if ( !utils_template_contains( values, android_values_entries[i].open ) ) break;
+		utils_template_set( values, android_values_entries[i].open, value );
+		return TRUE;
+	}
 
-		const char* androidJar = "android29.jar";
+	android_export_job_error( job, _("Could not find %s entry in values.xml file"), name );
+	return FALSE;
+}
 
-#if defined(G_OS_WIN32)
-		gchar* path_to_aapt2 = g_build_path( "\\", app->datadir, "android", "aapt2.exe", NULL );
-		gchar* path_to_android_jar = g_build_path( "\\", app->datadir, "android", androidJar, NULL );
-		gchar* path_to_jarsigner = g_build_path( "\\", app->datadir, "android", "jre", "bin", "jarsigner.exe", NULL );
-		gchar* path_to_zipalign = g_build_path( "\\", app->datadir, "android", "zipalign.exe", NULL );
+// copy of the first "name": "value" string in a Firebase config at or after from, end is set to its closing quote
+static gchar *android_firebase_value( const gchar *from, const gchar *name, const gchar **end )
+{
+	gchar *key = g_strconcat( "\"", name, "\": \"", NULL );
+	const gchar *value = strstr( from, key );
+	const gchar *value_end = NULL;
 
-		// convert forward slashes to backward slashes for parameters that will be passed to aapt2
-		gchar *pathPtr = path_to_android_jar;
-		while( *pathPtr ) { if ( *pathPtr == '/' ) *pathPtr = '\\'; pathPtr++; }
+	if ( value )
+	{
+		value += strlen( key );
+		value_end = strchr( value, '"' );
+	}
+	g_free( key );
 
-		pathPtr = output_file;
-		while( *pathPtr ) { if ( *pathPtr == '/' ) *pathPtr = '\\'; pathPtr++; }
-        
-        gchar* android_folder = g_build_filename( app->datadir, "android", NULL );
-        gchar* src_folder;
-        if ( app_type == 2 ) src_folder = g_build_path( "/", app->datadir, "android", "sourceOuya", NULL );
-        else if ( app_type == 1 ) src_folder = g_build_path( "/", app->datadir, "android", "sourceAmazon", NULL );
-        else src_folder = g_build_path( "/", app->datadir, "android", "sourceGoogle", NULL );
-#elif defined(__APPLE__)
-        gchar* path_to_aapt2 = g_build_path( "/", app->configdir, "AndroidExport", "aapt2", NULL );
-        gchar* path_to_android_jar = g_build_path( "/", app->configdir, "AndroidExport", androidJar, NULL );
-        gchar* path_to_jarsigner = g_strdup( "/usr/bin/jarsigner" );
-        gchar* path_to_zipalign = g_build_path( "/", app->configdir, "AndroidExport", "zipalign", NULL );
-        
-        gchar* android_folder = g_build_filename( app->configdir, "AndroidExport", NULL );
-        gchar* src_folder;
-        if ( app_type == 2 ) src_folder = g_build_path( "/", app->configdir, "AndroidExport", "sourceOuya", NULL );
-        else if ( app_type == 1 ) src_folder = g_build_path( "/", app->configdir, "AndroidExport", "sourceAmazon", NULL );
-        else src_folder = g_build_path( "/", app->configdir, "AndroidExport", "sourceGoogle", NULL );
-#else
-		gchar* path_to_aapt2 = g_build_path( "/", app->datadir, "android", "aapt2", NULL );
-		gchar* path_to_android_jar = g_build_path( "/", app->datadir, "android", androidJar, NULL );
-        gchar* path_to_jarsigner = g_build_path( "/", app->datadir, "android", "jre", "bin", "jarsigner", NULL );
-		gchar* path_to_zipalign = g_build_path( "/", app->datadir, "android", "zipalign", NULL );
-        
-        gchar* android_folder = g_build_filename( app->datadir, "android", NULL );
-        gchar* src_folder;
-        if ( app_type == 2 ) src_folder = g_build_path( "/", app->datadir, "android", "sourceOuya", NULL );
-        else if ( app_type == 1 ) src_folder = g_build_path( "/", app->datadir, "android", "sourceAmazon", NULL );
-        else src_folder = g_build_path( "/", app->datadir, "android", "sourceGoogle", NULL );
+	if ( !value_end ) return NULL;
+	if ( end ) *end = value_end;
+	return g_strndup( value, value_end - value );
+}
+
+// everything the APK is made from except the passwords, keystore and alias are the ones actually used
+static UtilsFingerprint *android_export_fingerprint_new( AndroidExportJob *job, const AndroidExportTools *tools,
+	const gchar *src_folder, const gchar *keystore_file, const gchar *alias_name )
+{
+	UtilsFingerprint *fingerprint = export_fingerprint_new( job->output_file );
+	gchar *path;
+
+	utils_fingerprint_add_string( fingerprint, "setting/app_name", job->app_name );
+	utils_fingerprint_add_string( fingerprint, "setting/package_name", job->package_name );
+	utils_fingerprint_add_string( fingerprint, "setting/url_scheme", job->url_scheme );
+	utils_fingerprint_add_string( fingerprint, "setting/deep_link", job->deep_link );
+	utils_fingerprint_add_string( fingerprint, "setting/google_play_app_id", job->google_play_app_id );
+	utils_fingerprint_add_string( fingerprint, "setting/admob_app_id", job->admob_app_id );
+	utils_fingerprint_add_string( fingerprint, "setting/snapchat_client_id", job->snapchat_client_id );
+	utils_fingerprint_add_string( fingerprint, "setting/version_number", job->version_number );
+	utils_fingerprint_add_string( fingerprint, "setting/alias_name", alias_name );
+	utils_fingerprint_add_string( fingerprint, "setting/compression", job->compression );
+	utils_fingerprint_add_int( fingerprint, "setting/app_type", job->app_type );
+	utils_fingerprint_add_int( fingerprint, "setting/orientation", job->orientation );
+	utils_fingerprint_add_int( fingerprint, "setting/arcore_mode", job->arcore_mode );
+	utils_fingerprint_add_int( fingerprint, "setting/sdk", job->sdk );
+	utils_fingerprint_add_int( fingerprint, "setting/build_number", job->build_number );
+	utils_fingerprint_add_int( fingerprint, "setting/permission_flags", (gint) job->permission_flags );
+
+	utils_fingerprint_add_file( fingerprint, "file/app_icon", job->app_icon );
+	utils_fingerprint_add_file( fingerprint, "file/notif_icon", job->notif_icon );
+	utils_fingerprint_add_file( fingerprint, "file/ouya_icon", job->ouya_icon );
+	utils_fingerprint_add_file( fingerprint, "file/firebase_config", job->firebase_config );
+	utils_fingerprint_add_file( fingerprint, "file/keystore", keystore_file );
+
+	// the template and the player libraries, the rest of the android folder is tools
+	utils_fingerprint_add_folder( fingerprint, "template", src_folder );
+	path = g_build_path( "/", tools->android_folder, "lib", NULL );
+	utils_fingerprint_add_folder( fingerprint, "lib", path );
+	SETPTR( path, g_build_path( "/", tools->android_folder, "assets", NULL ) );
+	utils_fingerprint_add_folder( fingerprint, "assets", path );
+	SETPTR( path, g_build_path( "/", job->base_path, "media", NULL ) );
+	utils_fingerprint_add_folder( fingerprint, "media", path );
+	g_free( path );
+
+	utils_fingerprint_add_stamp( fingerprint, "tool/aapt2", tools->path_to_aapt2 );
+	utils_fingerprint_add_stamp( fingerprint, "tool/android_jar", tools->path_to_android_jar );
+	utils_fingerprint_add_stamp( fingerprint, "tool/jarsigner", tools->path_to_jarsigner );
+	utils_fingerprint_add_stamp( fingerprint, "tool/zipalign", tools->path_to_zipalign );
+
+	return fingerprint;
+}
+
+// runs an export that has passed android_export_job_check(), without any dialogs so it can run on any thread
+static gboolean android_export_job_run( AndroidExportJob *job, const AndroidExportTools *tools )
+{
+	int i;
+	gboolean result = FALSE;
+
+	gchar *app_name = g_strdup( job->app_name );
+	gchar *package_name = g_strdup( job->package_name );
+	gchar *app_icon = g_strdup( job->app_icon );
+	gchar *notif_icon = g_strdup( job->notif_icon );
+	gchar *ouya_icon = g_strdup( job->ouya_icon );
+	gchar *firebase_config = g_strdup( job->firebase_config );
+	gchar *url_scheme = g_strdup( job->url_scheme );
+	gchar *deep_link = g_strdup( job->deep_link );
+	gchar *google_play_app_id = g_strdup( job->google_play_app_id );
+	gchar *admob_app_id = g_strdup( job->admob_app_id );
+	gchar *snapchat_client_id = g_strdup( job->snapchat_client_id );
+	gchar *keystore_file = g_strdup( job->keystore_file );
+	gchar *keystore_password = g_strdup( job->keystore_password );
+	gchar *version_number = g_strdup( job->version_number );
+	gchar *alias_name = g_strdup( job->alias_name );
+	gchar *alias_password = g_strdup( job->alias_password );
+	gchar *output_file = g_strdup( job->output_file );
+	int app_type = job->app_type;
+	int arcore_mode = job->arcore_mode;
+
+	int orientation = 10;
+	if ( job->orientation == 0 ) orientation = 6;
+	else if ( job->orientation == 1 ) orientation = 7;
+
+	gchar szSDK[ 20 ];
+	sprintf( szSDK, "%d", job->sdk );
+
+	gchar szBuildNum[ 20 ];
+	sprintf( szBuildNum, "%d", job->build_number );
+
+	int permission_external_storage = (job->permission_flags & AGK_ANDROID_PERMISSION_WRITE) ? 1 : 0;
+	int permission_location_fine = (job->permission_flags & AGK_ANDROID_PERMISSION_GPS) ? 1 : 0;
+	int permission_location_coarse = (job->permission_flags & AGK_ANDROID_PERMISSION_LOCATION) ? 1 : 0;
+	int permission_internet = (job->permission_flags & AGK_ANDROID_PERMISSION_INTERNET) ? 1 : 0;
+	int permission_wake = (job->permission_flags & AGK_ANDROID_PERMISSION_WAKE) ? 1 : 0;
+	int permission_billing = (job->permission_flags & AGK_ANDROID_PERMISSION_IAP) ? 1 : 0;
+	int permission_push = (job->permission_flags & AGK_ANDROID_PERMISSION_PUSH) ? 1 : 0;
+	int permission_camera = (job->permission_flags & AGK_ANDROID_PERMISSION_CAMERA) ? 1 : 0;
+	int permission_expansion = (job->permission_flags & AGK_ANDROID_PERMISSION_EXPANSION) ? 1 : 0;
+	int permission_vibrate = (job->permission_flags & AGK_ANDROID_PERMISSION_VIBRATE) ? 1 : 0;
+	int permission_record_audio = (job->permission_flags & AGK_ANDROID_PERMISSION_RECORD_AUDIO) ? 1 : 0;
+
+	int includeFirebase = (firebase_config && *firebase_config && (app_type == 0 || app_type == 1)) ? 1 : 0;
+	int includePushNotify = (permission_push && app_type == 0) ? 1 : 0;
+	int includeGooglePlay = (google_play_app_id && *google_play_app_id && app_type == 0) ? 1 : 0;
+	int includeAdMob = (admob_app_id && *admob_app_id && app_type == 0) ? 1 : 0;
+
+	const gchar *path_to_aapt2 = tools->path_to_aapt2;
+	const gchar *path_to_android_jar = tools->path_to_android_jar;
+	const gchar *path_to_jarsigner = tools->path_to_jarsigner;
+	const gchar *path_to_zipalign = tools->path_to_zipalign;
+	const gchar *android_folder = tools->android_folder;
+	gchar *src_folder = g_build_path( "/", android_folder, android_source_folders[app_type], NULL );
+
+#ifdef G_OS_WIN32
+	// convert forward slashes to backward slashes for parameters that will be passed to aapt2
+	utils_str_replace_char( output_file, '/', '\\' );
 #endif
 
-		// make temporary folder
-		gchar* tmp_folder = g_build_filename( app->project->base_path, "build_tmp", NULL );
+	// make temporary folder, each store gets its own folder so both variants of a project can be exported at the same time
+	gchar* tmp_folder = g_build_filename( job->base_path, android_tmp_folders[app_type], NULL );
 
-		utils_str_replace_char( android_folder, '\\', '/' );
-		utils_str_replace_char( tmp_folder, '\\', '/' );
-		utils_str_replace_char( src_folder, '\\', '/' );
+	utils_str_replace_char( tmp_folder, '\\', '/' );
+	utils_str_replace_char( src_folder, '\\', '/' );
 
-		gchar *output_file_zip = g_strdup( output_file );
-		gchar *ext = strrchr( output_file_zip, '.' );
-		if ( ext ) *ext = 0;
-		SETPTR( output_file_zip, g_strconcat( output_file_zip, ".zip", NULL ) );
+	gchar *output_file_zip = g_strdup( output_file );
+	gchar *ext = strrchr( output_file_zip, '.' );
+	if ( ext ) *ext = 0;
+	SETPTR( output_file_zip, g_strconcat( output_file_zip, ".zip", NULL ) );
 
-		if ( !keystore_file || !*keystore_file )
-		{
-			if ( keystore_file ) g_free(keystore_file);
-			if ( keystore_password ) g_free(keystore_password);
+	if ( !keystore_file || !*keystore_file )
+	{
+		if ( keystore_file ) g_free(keystore_file);
+		if ( keystore_password ) g_free(keystore_password);
 
-			keystore_file = g_build_path( "/", android_folder, "debug.keystore", NULL );
-			keystore_password = g_strdup("android");
+		keystore_file = g_build_path( "/", android_folder, "debug.keystore", NULL );
+		keystore_password = g_strdup("android");
+
+		if ( alias_name ) g_free(alias_name);
+		if ( alias_password ) g_free(alias_password);
 
+		alias_name = g_strdup("androiddebugkey");
+		alias_password = g_strdup("android");
+	}
+	else
+	{
+		if ( !alias_name || !*alias_name )
+		{
 			if ( alias_name ) g_free(alias_name);
 			if ( alias_password ) g_free(alias_password);
 
-			alias_name = g_strdup("androiddebugkey");
-			alias_password = g_strdup("android");
+			alias_name = g_strdup("mykeystore");
+			alias_password = g_strdup(keystore_password);
 		}
-		else
+	}
+
+	// declarations
+	GString *manifest = NULL;
+	GString *values = NULL;
+	UtilsTemplate *manifest_template = NULL;
+	UtilsTemplate *values_template = NULL;
+	const gchar *manifest_file = "AndroidManifest.xml";
+	gchar *contents = NULL;
+	gchar *contentsOther = NULL;
+	gchar *firebase_value = NULL;
+	gsize length = 0;
+	const gchar *resources_file = "resOrig/values/values.xml";
+	GError *error = NULL;
+	UtilsIconSet *icon_set = NULL;
+	GPtrArray *compile_inputs = NULL;
+	GPtrArray *compile_misses = NULL;
+	GString *aapt2_commands = NULL;
+	gchar *image_filename = NULL;
+	gchar **argv = NULL;
+	gchar **argv2 = NULL;
+	gchar **argv3 = NULL;
+	gint status = 0;
+	mz_zip_archive zip_archive;
+	memset(&zip_archive, 0, sizeof(zip_archive));
+	UtilsZipQueue *zip_queue = NULL;
+	gboolean zip_result = FALSE;
+	gint j;
+	gchar *zip_add_file = 0;
+	gchar *str_out = NULL;
+	gsize resLength = 0;
+	GPid aapt2_pid = 0;
+	UtilsFingerprint *fingerprint = NULL;
+	gchar *changes = NULL;
+	// the template is read in place, tmp_folder only gets the files aapt2 has to compile
+	UtilsOverlay *overlay = utils_overlay_new( src_folder );
+	gchar *res_folder = NULL;
+	GDir *res_dir = NULL;
+	const gchar *res_name;
+
+	// nothing to do if the APK was made from exactly these inputs
+	android_export_job_stage( job, "fingerprint" );
+	fingerprint = android_export_fingerprint_new( job, tools, src_folder, keystore_file, alias_name );
+	if ( utils_fingerprint_matches( fingerprint ) )
+	{
+		if ( job->task ) export_task_mark( job->task, "fingerprint", "%s", _("unchanged") );
+		job->unchanged = TRUE;
+		result = TRUE;
+		goto android_dialog_cleanup2;
+	}
+	changes = export_fingerprint_describe( fingerprint );
+	if ( job->task ) export_task_mark( job->task, "fingerprint", "%s", changes );
+	if ( android_export_job_cancelled( job ) ) goto android_dialog_cleanup2;
+
+	res_folder = g_build_path( "/", src_folder, "resOrig", NULL );
+	res_dir = g_dir_open( res_folder, 0, NULL );
+
+	// icons are saved into the drawable folders so they need to exist
+	if ( res_dir )
+	{
+		foreach_dir( res_name, res_dir )
 		{
-			if ( !alias_name || !*alias_name )
+			gchar *res_path = g_build_path( "/", res_folder, res_name, NULL );
+			if ( g_file_test( res_path, G_FILE_TEST_IS_DIR ) )
 			{
-				if ( alias_name ) g_free(alias_name);
-				if ( alias_password ) g_free(alias_password);
-
-				alias_name = g_strdup("mykeystore");
-				alias_password = g_strdup(keystore_password);
+				SETPTR( res_path, g_build_path( "/", tmp_folder, "resOrig", res_name, NULL ) );
+				utils_mkdir( res_path, TRUE );
 			}
+			g_free( res_path );
 		}
+		g_dir_close( res_dir );
+	}
+	g_free( res_folder );
 
-#define AGK_NEW_CONTENTS_SIZE 1000000
-
-		// declarations
-		gchar *newcontents = g_new0( gchar, AGK_NEW_CONTENTS_SIZE );
-		gchar *newcontents2 = g_new0( gchar, AGK_NEW_CONTENTS_SIZE );
-		gchar* manifest_file = NULL;
-		gchar *contents = NULL;
-		gchar *contents2 = NULL;
-		gchar *contents3 = NULL;
-		gchar *contentsOther = NULL;
-		gchar *contentsOther2 = NULL;
-		gchar *contentsOther3 = NULL;
-		gsize length = 0;
-		gchar* resources_file = NULL;
-		GError *error = NULL;
-		GdkPixbuf *icon_image = NULL;
-		gchar *image_filename = NULL;
-		GdkPixbuf *icon_scaled_image = NULL;
-		gchar **argv = NULL;
-		gchar **argv2 = NULL;
-		gchar **argv3 = NULL;
-		gint status = 0;
-		mz_zip_archive zip_archive;
-		memset(&zip_archive, 0, sizeof(zip_archive));
-		gchar *zip_add_file = 0;
-		gchar *str_out = NULL;
-		gsize resLength = 0;
-		gint package_count = 0;
-		gint package_index = 0;
-
-		if ( !utils_copy_folder( src_folder, tmp_folder, TRUE, NULL ) )
-		{
-			SHOW_ERR1( _("Failed to copy source folder %s"), src_folder );
-			goto android_dialog_cleanup2;
-		}
-
-		while (gtk_events_pending())
-			gtk_main_iteration();
-		
-		// edit AndroidManifest.xml
-		manifest_file = g_build_path( "/", tmp_folder, "AndroidManifest.xml", NULL );
+	// the precompiled resources are linked from tmp_folder along with the ones compiled below
+	res_folder = g_build_path( "/", src_folder, "resMerged", NULL );
+	utils_mkdir( tmp_folder, TRUE );
+	if ( g_file_test( res_folder, G_FILE_TEST_IS_DIR ) )
+	{
+		gchar *res_dst = g_build_path( "/", tmp_folder, "resMerged", NULL );
+		gboolean copied;
 
-		if ( !g_file_get_contents( manifest_file, &contents, &length, NULL ) )
+		android_export_job_stage( job, "copy" );
+		copied = utils_copy_folder_full( res_folder, res_dst, TRUE, export_folder_progress, job->task, NULL );
+		g_free( res_dst );
+		if ( !copied )
 		{
-			SHOW_ERR( _("Failed to read AndroidManifest.xml file") );
+			android_export_job_error( job, _("Failed to copy source folder %s"), res_folder );
+			g_free( res_folder );
 			goto android_dialog_cleanup2;
 		}
+	}
+	else
+	{
+		SETPTR( res_folder, g_build_path( "/", tmp_folder, "resMerged", NULL ) );
+		utils_mkdir( res_folder, TRUE );
+	}
+	g_free( res_folder );
+	android_export_job_mark( job, "copy" );
+	if ( android_export_job_cancelled( job ) ) goto android_dialog_cleanup2;
+
+	// edit AndroidManifest.xml
+	if ( !utils_overlay_get_contents( overlay, manifest_file, &contents, &length, NULL ) )
+	{
+		android_export_job_error( job, "%s", _("Failed to read AndroidManifest.xml file") );
+		goto android_dialog_cleanup2;
+	}
 
-		strcpy( newcontents, "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n\
+	manifest = g_string_sized_new( length + 8192 );
+	g_string_append( manifest, "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n\
 <manifest xmlns:android=\"http://schemas.android.com/apk/res/android\"\n\
       android:versionCode=\"" );
-		strcat( newcontents, szBuildNum );
-		strcat( newcontents, "\"\n      android:versionName=\"" );
-		strcat( newcontents, version_number );
-		strcat( newcontents, "\" package=\"" );
-		strcat( newcontents, package_name );
-		strcat( newcontents, "\"" );
-		strcat( newcontents, " android:installLocation=\"auto\">\n\
+	g_string_append( manifest, szBuildNum );
+	g_string_append( manifest, "\"\n      android:versionName=\"" );
+	g_string_append( manifest, version_number );
+	g_string_append( manifest, "\" package=\"" );
+	g_string_append( manifest, package_name );
+	g_string_append( manifest, "\"" );
+	g_string_append( manifest, " android:installLocation=\"auto\">\n\
     <uses-feature android:glEsVersion=\"0x00020000\"></uses-feature>\n\
     <uses-sdk android:minSdkVersion=\"" );
+	
+	g_string_append( manifest, szSDK );
 		
-		strcat( newcontents, szSDK );
-			
-		strcat( newcontents, "\" android:targetSdkVersion=\"" );
-		if ( app_type == 0 ) // Google
-			strcat( newcontents, "29" );
-		else if ( app_type == 1 ) // amazon
-			strcat( newcontents, "22" );
-		else // Ouya (legacy)
-			strcat( newcontents, "16" );
-		strcat( newcontents, "\" />\n\n" );
-
-		if ( permission_external_storage ) strcat( newcontents, "    <uses-permission android:name=\"android.permission.WRITE_EXTERNAL_STORAGE\"></uses-permission>\n" );
-		if ( permission_internet ) 
-		{
-			strcat( newcontents, "    <uses-permission android:name=\"android.permission.INTERNET\"></uses-permission>\n" );
-			strcat( newcontents, "    <uses-permission android:name=\"android.permission.ACCESS_NETWORK_STATE\"></uses-permission>\n" );
-			strcat( newcontents, "    <uses-permission android:name=\"android.permission.ACCESS_WIFI_STATE\"></uses-permission>\n" );
-		}
-		if ( permission_wake ) strcat( newcontents, "    <uses-permission android:name=\"android.permission.WAKE_LOCK\"></uses-permission>\n" );
-		if ( permission_location_coarse && app_type == 0 ) strcat( newcontents, "    <uses-permission android:name=\"android.permission.ACCESS_COARSE_LOCATION\"></uses-permission>\n" );
-		if ( permission_location_fine && app_type == 0 ) strcat( newcontents, "    <uses-permission android:name=\"android.permission.ACCESS_FINE_LOCATION\"></uses-permission>\n" );
-		if ( permission_billing && app_type == 0 ) strcat( newcontents, "    <uses-permission android:name=\"com.android.vending.BILLING\"></uses-permission>\n" );
-		if ( permission_camera ) strcat( newcontents, "    <uses-permission android:name=\"android.permission.CAMERA\"></uses-permission>\n" );
-		if ( ((google_play_app_id && *google_play_app_id) || permission_push) && app_type == 0 ) strcat( newcontents, "    <uses-permission android:name=\"com.google.android.c2dm.permission.RECEIVE\" />\n" );
-		if ( permission_push && app_type == 0 ) 
-		{
-			strcat( newcontents, "    <permission android:name=\"" );
-			strcat( newcontents, package_name );
-			strcat( newcontents, ".permission.C2D_MESSAGE\" android:protectionLevel=\"signature\" />\n" );
-			strcat( newcontents, "    <uses-permission android:name=\"" );
-			strcat( newcontents, package_name );
-			strcat( newcontents, ".permission.C2D_MESSAGE\" />\n" );
-		}
-		if ( permission_expansion && app_type == 0 ) 
-		{
-			//strcat( newcontents, "    <uses-permission android:name=\"android.permission.GET_ACCOUNTS\"></uses-permission>\n" );
-			strcat( newcontents, "    <uses-permission android:name=\"com.android.vending.CHECK_LICENSE\"></uses-permission>\n" );
-			strcat( newcontents, "    <uses-permission android:name=\"android.permission.FOREGROUND_SERVICE\"></uses-permission>\n" );
-		}
-		if ( permission_vibrate ) strcat( newcontents, "    <uses-permission android:name=\"android.permission.VIBRATE\"></uses-permission>\n" );
-		if ( permission_record_audio ) strcat( newcontents, "    <uses-permission android:name=\"android.permission.RECORD_AUDIO\"></uses-permission>\n" );
-		
-		// supports FireTV
-		if ( 0 )
-		{
-			strcat( newcontents, "    <uses-feature android:name=\"android.hardware.touchscreen\" android:required=\"false\" />\n" );
-		}
-
-		// if ARCore required
-		if ( arcore_mode == 2 )
-		{
-			strcat( newcontents, "    <uses-feature android:name=\"android.hardware.camera.ar\" android:required=\"true\" />" );
-		}
-
-		contents2 = contents;
-		contents3 = 0;
-
-		// the order of these relacements is important, they must occur in the same order as they occur in the file
+	g_string_append( manifest, "\" android:targetSdkVersion=\"" );
+	if ( app_type == 0 ) // Google
+		g_string_append( manifest, "29" );
+	else if ( app_type == 1 ) // amazon
+		g_string_append( manifest, "22" );
+	else // Ouya (legacy)
+		g_string_append( manifest, "16" );
+	g_string_append( manifest, "\" />\n\n" );
+
+	if ( permission_external_storage ) g_string_append( manifest, "    <uses-permission android:name=\"android.permission.WRITE_EXTERNAL_STORAGE\"></uses-permission>\n" );
+	if ( permission_internet ) 
+	{
+		g_string_append( manifest, "    <uses-permission android:name=\"android.permission.INTERNET\"></uses-permission>\n" );
+		g_string_append( manifest, "    <uses-permission android:name=\"android.permission.ACCESS_NETWORK_STATE\"></uses-permission>\n" );
+		g_string_append( manifest, "    <uses-permission android:name=\"android.permission.ACCESS_WIFI_STATE\"></uses-permission>\n" );
+	}
+	if ( permission_wake ) g_string_append( manifest, "    <uses-permission android:name=\"android.permission.WAKE_LOCK\"></uses-permission>\n" );
+	if ( permission_location_coarse && app_type == 0 ) g_string_append( manifest, "    <uses-permission android:name=\"android.permission.ACCESS_COARSE_LOCATION\"></uses-permission>\n" );
+	if ( permission_location_fine && app_type == 0 ) g_string_append( manifest, "    <uses-permission android:name=\"android.permission.ACCESS_FINE_LOCATION\"></uses-permission>\n" );
+	if ( permission_billing && app_type == 0 ) g_string_append( manifest, "    <uses-permission android:name=\"com.android.vending.BILLING\"></uses-permission>\n" );
+	if ( permission_camera ) g_string_append( manifest, "    <uses-permission android:name=\"android.permission.CAMERA\"></uses-permission>\n" );
+	if ( ((google_play_app_id && *google_play_app_id) || permission_push) && app_type == 0 ) g_string_append( manifest, "    <uses-permission android:name=\"com.google.android.c2dm.permission.RECEIVE\" />\n" );
+	if ( permission_push && app_type == 0 ) 
+	{
+		g_string_append( manifest, "    <permission android:name=\"" );
+		g_string_append( manifest, package_name );
+		g_string_append( manifest, ".permission.C2D_MESSAGE\" android:protectionLevel=\"signature\" />\n" );
+		g_string_append( manifest, "    <uses-permission android:name=\"" );
+		g_string_append( manifest, package_name );
+		g_string_append( manifest, ".permission.C2D_MESSAGE\" />\n" );
+	}
+	if ( permission_expansion && app_type == 0 ) 
+	{
+		//g_string_append( manifest, "    <uses-permission android:name=\"android.permission.GET_ACCOUNTS\"></uses-permission>\n" );
+		g_string_append( manifest, "    <uses-permission android:name=\"com.android.vending.CHECK_LICENSE\"></uses-permission>\n" );
+		g_string_append( manifest, "    <uses-permission android:name=\"android.permission.FOREGROUND_SERVICE\"></uses-permission>\n" );
+	}
+	if ( permission_vibrate ) g_string_append( manifest, "    <uses-permission android:name=\"android.permission.VIBRATE\"></uses-permission>\n" );
+	if ( permission_record_audio ) g_string_append( manifest, "    <uses-permission android:name=\"android.permission.RECORD_AUDIO\"></uses-permission>\n" );
+	
+	// supports FireTV
+	if ( 0 )
+	{
+		g_string_append( manifest, "    <uses-feature android:name=\"android.hardware.touchscreen\" android:required=\"false\" />\n" );
+	}
 
-		// replace orientation
-		contents3 = strstr( contents2, "screenOrientation=\"fullSensor\"" );
-		if ( contents3 )
-		{
-			*contents3 = 0;
-			contents3 += strlen("screenOrientation=\"fullSensor");
+	// if ARCore required
+	if ( arcore_mode == 2 )
+	{
+		g_string_append( manifest, "    <uses-feature android:name=\"android.hardware.camera.ar\" android:required=\"true\" />" );
+	}
 
-			strcat( newcontents, contents2 );
+	// the template's own placeholders, in any order
+	manifest_template = utils_template_new();
+	utils_template_add_key( manifest_template, "screenOrientation=\"fullSensor\"" );
+	utils_template_add_key( manifest_template, "<!--ADDITIONAL_INTENT_FILTERS-->" );
+	utils_template_add_key( manifest_template, "YOUR_PACKAGE_NAME_HERE" );
+	utils_template_add_key( manifest_template, "${applicationId}" );
+	utils_template_compile( manifest_template, contents, length );
 
-			switch( orientation )
-			{
-				case 6: strcat( newcontents, "screenOrientation=\"sensorLandscape" ); break;
-				case 7: 
-				{
-					// all now use API 23 with correct spelling
-					strcat( newcontents, "screenOrientation=\"sensorPortrait" ); 
-					break;
-				}
-				default: strcat( newcontents, "screenOrientation=\"fullSensor" ); break;
-			}
+	// replace orientation
+	switch( orientation )
+	{
+		case 6: utils_template_set( manifest_template, "screenOrientation=\"fullSensor\"", "screenOrientation=\"sensorLandscape\"" ); break;
+		// all now use API 23 with correct spelling
+		case 7: utils_template_set( manifest_template, "screenOrientation=\"fullSensor\"", "screenOrientation=\"sensorPortrait\"" ); break;
+		default: break;
+	}
 
-			contents2 = contents3;
-		}
+	// add intent filters
+	{
+		GString *intent_filters = g_string_new( "" );
 
-		// add intent filters
-		contents3 = strstr( contents2, "<!--ADDITIONAL_INTENT_FILTERS-->" );
-		if ( contents3 )
+		if ( url_scheme && *url_scheme )
 		{
-			*contents3 = 0;
-			contents3 += strlen("<!--ADDITIONAL_INTENT_FILTERS-->");
-
-			strcat( newcontents, contents2 );
-
-			if ( url_scheme && *url_scheme )
-			{
-				strcat( newcontents, "<intent-filter>\n\
+			g_string_append( intent_filters, "<intent-filter>\n\
 			<action android:name=\"android.intent.action.VIEW\" />\n\
 			<category android:name=\"android.intent.category.DEFAULT\" />\n\
 			<category android:name=\"android.intent.category.BROWSABLE\" />\n\
 			<data android:scheme=\"" );
-			
-				strcat( newcontents, url_scheme );
-				strcat( newcontents, "\" />\n    </intent-filter>\n" );
-			}
+		
+			g_string_append( intent_filters, url_scheme );
+			g_string_append( intent_filters, "\" />\n    </intent-filter>\n" );
+		}
 
-			if ( deep_link && *deep_link )
+		if ( deep_link && *deep_link )
+		{
+			gchar *szScheme = 0;
+			gchar *szHost = 0;
+			gchar *szPath = 0;
+			gchar *szTemp = strstr( deep_link, "://" );
+			if ( szTemp )
 			{
-				gchar *szScheme = 0;
-				gchar *szHost = 0;
-				gchar *szPath = 0;
-				gchar *szTemp = strstr( deep_link, "://" );
-				if ( szTemp )
-				{
-					*szTemp = 0;
-					szScheme = g_strdup( deep_link );
-					*szTemp = ':';
+				*szTemp = 0;
+				szScheme = g_strdup( deep_link );
+				*szTemp = ':';
 
-					szTemp += 3;
-					gchar *szTemp2 = strstr( szTemp, "/" );
-					if ( szTemp2 )
-					{
-						szPath = g_strdup( szTemp2 );
-						*szTemp2 = 0;
-						szHost = g_strdup( szTemp );
-						*szTemp2 = '/';
-					}
-					else szHost = g_strdup( szTemp );
+				szTemp += 3;
+				gchar *szTemp2 = strstr( szTemp, "/" );
+				if ( szTemp2 )
+				{
+					szPath = g_strdup( szTemp2 );
+					*szTemp2 = 0;
+					szHost = g_strdup( szTemp );
+					*szTemp2 = '/';
 				}
+				else szHost = g_strdup( szTemp );
+			}
 
-				if ( szScheme && *szScheme )
-				{
-					strcat( newcontents, "<intent-filter>\n\
+			if ( szScheme && *szScheme )
+			{
+				g_string_append( intent_filters, "<intent-filter>\n\
 			<action android:name=\"android.intent.action.VIEW\" />\n\
 			<category android:name=\"android.intent.category.DEFAULT\" />\n\
 			<category android:name=\"android.intent.category.BROWSABLE\" />\n\
 			<data android:scheme=\"" );
-			
-					strcat( newcontents, szScheme );
-					if ( szHost && *szHost )
-					{
-						strcat( newcontents, "\" android:host=\"" );
-						strcat( newcontents, szHost );
+		
+				g_string_append( intent_filters, szScheme );
+				if ( szHost && *szHost )
+				{
+					g_string_append( intent_filters, "\" android:host=\"" );
+					g_string_append( intent_filters, szHost );
 
-						if ( szPath && *szPath )
-						{
-							strcat( newcontents, "\" android:pathPrefix=\"" );
-							strcat( newcontents, szPath );
-						}
+					if ( szPath && *szPath )
+					{
+						g_string_append( intent_filters, "\" android:pathPrefix=\"" );
+						g_string_append( intent_filters, szPath );
 					}
-			
-					strcat( newcontents, "\" />\n    </intent-filter>\n" );
 				}
-				
-
-				if ( szScheme ) g_free( szScheme );
-				if ( szHost ) g_free( szHost );
-				if ( szPath ) g_free( szPath );
+		
+				g_string_append( intent_filters, "\" />\n    </intent-filter>\n" );
 			}
+			
 
-			contents2 = contents3;
-		}
-
-		// replace package name
-		contents3 = strstr( contents2, "YOUR_PACKAGE_NAME_HERE" );
-		if ( contents3 )
-		{
-			*contents3 = 0;
-			contents3 += strlen("YOUR_PACKAGE_NAME_HERE");
-
-			strcat( newcontents, contents2 );
-			strcat( newcontents, package_name );
-			contents2 = contents3;
+			if ( szScheme ) g_free( szScheme );
+			if ( szHost ) g_free( szHost );
+			if ( szPath ) g_free( szPath );
 		}
 
-		// replace application ID
-		contents3 = strstr( contents2, "${applicationId}" );
-		while ( contents3 )
-		{
-			*contents3 = 0;
-			contents3 += strlen("${applicationId}");
+		utils_template_set( manifest_template, "<!--ADDITIONAL_INTENT_FILTERS-->", intent_filters->str );
+		g_string_free( intent_filters, TRUE );
+	}
 
-			strcat( newcontents, contents2 );
-			strcat( newcontents, package_name );
-			contents2 = contents3;
-			contents3 = strstr( contents2, "${applicationId}" );
-		}
+	// replace package name and application ID
+	utils_template_set( manifest_template, "YOUR_PACKAGE_NAME_HERE", package_name );
+	utils_template_set( manifest_template, "${applicationId}", package_name );
 
-		// write the rest of the manifest file
-		strcat( newcontents, contents2 );
+	// write the manifest file after the generated header
+	utils_template_render( manifest_template, manifest );
 
-		if ( permission_expansion && app_type == 0 ) 
-		{
-			strcat( newcontents, "\n\
+	if ( permission_expansion && app_type == 0 ) 
+	{
+		g_string_append( manifest, "\n\
 		<service android:name=\"com.google.android.vending.expansion.downloader.impl.DownloaderService\"\n\
             android:enabled=\"true\"/>\n\
         <receiver android:name=\"com.google.android.vending.expansion.downloader.impl.DownloaderService$AlarmReceiver\"\n\
             android:enabled=\"true\"/>" );
-		}
+	}
 
-		// Google sign in
-		if ( app_type == 0 )
-		{
-			strcat( newcontents, "\n\
+	// Google sign in
+	if ( app_type == 0 )
+	{
+		g_string_append( manifest, "\n\
 		<activity android:name=\"com.google.android.gms.auth.api.signin.internal.SignInHubActivity\"\n\
             android:excludeFromRecents=\"true\"\n\
             android:exported=\"false\"\n\
@@ -1732,40 +2399,40 @@ android_dialog_continue:
         <service android:name=\"com.google.android.gms.auth.api.signin.RevocationBoundService\"\n\
             android:exported=\"true\"\n\
             android:permission=\"com.google.android.gms.auth.api.signin.permission.REVOCATION_NOTIFICATION\" />\n" );
-		}
+	}
 
-		// IAP Purchase Activity
-		if ( permission_billing && app_type == 0 )
-		{
-			strcat( newcontents, "\n\
+	// IAP Purchase Activity
+	if ( permission_billing && app_type == 0 )
+	{
+		g_string_append( manifest, "\n\
         <activity android:name=\"com.google.android.gms.ads.purchase.InAppPurchaseActivity\" \n\
                   android:theme=\"@style/Theme.IAPTheme\" />" );
-		}
+	}
 
-		// Google API Activity - for Game Services
-		if ( includeGooglePlay )
-		{
-			strcat( newcontents, "\n\
+	// Google API Activity - for Game Services
+	if ( includeGooglePlay )
+	{
+		g_string_append( manifest, "\n\
         <activity android:name=\"com.google.android.gms.common.api.GoogleApiActivity\" \n\
                   android:exported=\"false\" \n\
                   android:theme=\"@android:style/Theme.Translucent.NoTitleBar\" />" );
-		}
+	}
 
-		// Firebase Init Provider - for Game Services and Firebase
-		if ( includeGooglePlay || includeFirebase || includePushNotify )
-		{
-			strcat( newcontents, "\n        <provider android:authorities=\"" );
-			strcat( newcontents, package_name );
-			strcat( newcontents, ".firebaseinitprovider\"\n\
+	// Firebase Init Provider - for Game Services and Firebase
+	if ( includeGooglePlay || includeFirebase || includePushNotify )
+	{
+		g_string_append( manifest, "\n        <provider android:authorities=\"" );
+		g_string_append( manifest, package_name );
+		g_string_append( manifest, ".firebaseinitprovider\"\n\
                   android:name=\"com.google.firebase.provider.FirebaseInitProvider\"\n\
                   android:exported=\"false\"\n\
                   android:initOrder=\"100\" />\n" );
-		}
+	}
 
-		// Firebase activities
-		if ( includeFirebase )
-		{
-			strcat( newcontents, "\n\
+	// Firebase activities
+	if ( includeFirebase )
+	{
+		g_string_append( manifest, "\n\
         <receiver\n\
             android:name=\"com.google.android.gms.measurement.AppMeasurementReceiver\"\n\
             android:enabled=\"true\"\n\
@@ -1790,11 +2457,11 @@ android_dialog_continue:
                 android:name=\"com.google.firebase.components:com.google.firebase.iid.Registrar\"\n\
                 android:value=\"com.google.firebase.components.ComponentRegistrar\" />\n\
         </service>" );
-		}
+	}
 
-		if ( includeFirebase || includePushNotify )
-		{
-			strcat( newcontents, "\n\
+	if ( includeFirebase || includePushNotify )
+	{
+		g_string_append( manifest, "\n\
         <receiver android:name=\"com.google.firebase.iid.FirebaseInstanceIdReceiver\" \n\
                   android:exported=\"true\" \n\
                   android:permission=\"com.google.android.c2dm.permission.SEND\" > \n\
@@ -1802,11 +2469,11 @@ android_dialog_continue:
                 <action android:name=\"com.google.android.c2dm.intent.RECEIVE\" /> \n\
             </intent-filter> \n\
         </receiver>" );
-		}
+	}
 
-		if ( includePushNotify )
-		{
-			strcat( newcontents, "\n\
+	if ( includePushNotify )
+	{
+		g_string_append( manifest, "\n\
 		<meta-data android:name=\"com.google.firebase.messaging.default_notification_icon\"\n\
             android:resource=\"@drawable/icon_white\" />\n\
 		<service android:name=\"com.google.firebase.messaging.FirebaseMessagingService\" \n\
@@ -1815,28 +2482,28 @@ android_dialog_continue:
                 <action android:name=\"com.google.firebase.MESSAGING_EVENT\" /> \n\
             </intent-filter> \n\
         </service>" );
-		}
+	}
 
-		if ( includeAdMob )
-		{
-			strcat( newcontents, "\n\
+	if ( includeAdMob )
+	{
+		g_string_append( manifest, "\n\
         <provider\n\
             android:name=\"com.google.android.gms.ads.MobileAdsInitProvider\"\n\
             android:authorities=\"" );
-			strcat( newcontents, package_name );
-			strcat( newcontents, ".mobileadsinitprovider\"\n\
+		g_string_append( manifest, package_name );
+		g_string_append( manifest, ".mobileadsinitprovider\"\n\
             android:exported=\"false\"\n\
             android:initOrder=\"100\" />" );
-		}
+	}
 
-		// arcore activity
-		if ( arcore_mode > 0 )
-		{
-			strcat( newcontents, "\n\
+	// arcore activity
+	if ( arcore_mode > 0 )
+	{
+		g_string_append( manifest, "\n\
 		<meta-data android:name=\"com.google.ar.core\" android:value=\"");
-			if ( arcore_mode == 1 ) strcat( newcontents, "optional" );
-			else strcat( newcontents, "required" );
-			strcat( newcontents, "\" />\n\
+		if ( arcore_mode == 1 ) g_string_append( manifest, "optional" );
+		else g_string_append( manifest, "required" );
+		g_string_append( manifest, "\" />\n\
 		<meta-data android:name=\"com.google.ar.core.min_apk_version\" android:value=\"190519000\" />\n\
         <activity\n\
             android:name=\"com.google.ar.core.InstallActivity\"\n\
@@ -1845,1144 +2512,884 @@ android_dialog_continue:
             android:exported=\"false\"\n\
             android:launchMode=\"singleTop\"\n\
             android:theme=\"@android:style/Theme.Material.Light.Dialog.Alert\" />" );
-		}
+	}
 
 
-		strcat( newcontents, "\n    </application>\n</manifest>\n" );
-	
-		// write new Android Manifest.xml file
-		if ( !g_file_set_contents( manifest_file, newcontents, strlen(newcontents), &error ) )
-		{
-			SHOW_ERR1( _("Failed to write AndroidManifest.xml file: %s"), error->message );
-			g_error_free(error);
-			error = NULL;
-			goto android_dialog_cleanup2;
-		}
+	g_string_append( manifest, "\n    </application>\n</manifest>\n" );
 
-		if ( contents ) g_free(contents);
-		contents = 0;
+	// write new Android Manifest.xml file, aapt2 reads it from tmp_folder
+	utils_overlay_set_contents( overlay, manifest_file, manifest->str, manifest->len );
+	if ( !utils_overlay_materialize( overlay, manifest_file, tmp_folder, &error ) )
+	{
+		android_export_job_error( job, _("Failed to write AndroidManifest.xml file: %s"), error->message );
+		g_error_free(error);
+		error = NULL;
+		goto android_dialog_cleanup2;
+	}
+
+	if ( contents ) g_free(contents);
+	contents = 0;
+	android_export_job_mark( job, "manifest" );
+
+	// read resources file
+	if ( !utils_overlay_get_contents( overlay, resources_file, &contents, &resLength, &error ) )
+	{
+		android_export_job_error( job, _("Failed to read resource values.xml file: %s"), error->message );
+		g_error_free(error);
+		error = NULL;
+		goto android_dialog_cleanup2;
+	}
+
+	// the values.xml entries the export fills in, in any order
+	values_template = utils_template_new();
+	for( i = 0; i < (int) G_N_ELEMENTS(android_values_entries); i++ )
+		utils_template_add_element( values_template, android_values_entries[i].open, "</string>" );
+	utils_template_compile( values_template, contents, resLength );
+
+	if ( !android_values_set( job, values_template, "app_name", app_name ) ) goto android_dialog_cleanup2;
+
+	if ( app_type == 0 && google_play_app_id && *google_play_app_id )
+	{
+		if ( !android_values_set( job, values_template, "games_app_id", google_play_app_id ) ) goto android_dialog_cleanup2;
+	}
+
+	// admob app id
+	if ( app_type == 0 && admob_app_id && *admob_app_id )
+	{
+		if ( !android_values_set( job, values_template, "admob_app_id", admob_app_id ) ) goto android_dialog_cleanup2;
+	}
+
+	// snapchat client id
+	if ( app_type == 0 && snapchat_client_id && *snapchat_client_id )
+	{
+		if ( !android_values_set( job, values_template, "snap_chat_id", snapchat_client_id ) ) goto android_dialog_cleanup2;
+	}
+
+	// firebase
+	if ( firebase_config && *firebase_config && (app_type == 0 || app_type == 1) ) // Google and Amazon only
+	{
+		// json values and the values.xml entries they go in
+		const gchar *firebase_entries[][2] = { { "project_number", "gcm_defaultSenderId" }, { "firebase_url", "firebase_database_url" }, 
+											   { "current_key", "google_api_key" }, { "current_key", "google_crash_reporting_api_key" } };
+		const gchar *app_id;
 
-		// read resources file
-		resources_file = g_build_path( "/", tmp_folder, "resOrig", "values", "values.xml", NULL );
-		if ( !g_file_get_contents( resources_file, &contents, &resLength, &error ) )
+		// read json values
+		if ( !g_file_get_contents( firebase_config, &contentsOther, &resLength, &error ) )
 		{
-			SHOW_ERR1( _("Failed to read resource values.xml file: %s"), error->message );
+			android_export_job_error( job, _("Failed to read firebase config file: %s"), error->message );
 			g_error_free(error);
 			error = NULL;
 			goto android_dialog_cleanup2;
 		}
 
-		contents2 = strstr( contents, "<string name=\"app_name\">" );
-		if ( !contents2 )
+		for( i = 0; i < (int) G_N_ELEMENTS(firebase_entries); i++ )
 		{
-			SHOW_ERR( _("Could not find app name entry in values.xml file") );
-			goto android_dialog_cleanup2;
+			SETPTR( firebase_value, android_firebase_value( contentsOther, firebase_entries[i][0], NULL ) );
+			if ( !firebase_value )
+			{
+				android_export_job_error( job, _("Could not find %s entry in Firebase config file"), firebase_entries[i][0] );
+				goto android_dialog_cleanup2;
+			}
+			if ( !android_values_set( job, values_template, firebase_entries[i][1], firebase_value ) ) goto android_dialog_cleanup2;
 		}
 
-		contents2 += strlen("<string name=\"app_name\"");
-		*contents2 = 0;
-		contents3 = contents2;
-		contents3++;
-		contents3 = strstr( contents3, "</string>" );
-		if ( !contents3 )
+		// find mobilesdk_app_id value
+		// if the config file contains multiple Android apps then there will be multiple mobilesdk_app_id's, and only the corect one will work
+		// look for the corresponding package_name that matches this export
+		app_id = contentsOther;
+		SETPTR( firebase_value, NULL );
+		while( !firebase_value && (app_id = strstr( app_id, "\"mobilesdk_app_id\": \"" )) )
 		{
-			SHOW_ERR( _("Could not find end of app name entry in values.xml file") );
-			goto android_dialog_cleanup2;
-		}
-
-		// write resources file
-		strcpy( newcontents, contents );
-		strcat( newcontents, ">" );
-		strcat( newcontents, app_name );
-		strcat( newcontents, contents3 );
-
-		// repair original file
-		*contents2 = '>';
+			const gchar *app_id_end = NULL;
+			gchar *app_package;
 
-		if ( app_type == 0 && google_play_app_id && *google_play_app_id )
-		{
-			memcpy( newcontents2, newcontents, AGK_NEW_CONTENTS_SIZE );
-			contents2 = strstr( newcontents2, "<string name=\"games_app_id\">" );
-			if ( !contents2 )
+			SETPTR( firebase_value, android_firebase_value( app_id, "mobilesdk_app_id", &app_id_end ) );
+			if ( !firebase_value )
 			{
-				SHOW_ERR( _("Could not find games_app_id entry in values.xml file") );
+				android_export_job_error( job, "%s", _("Could not find end of mobilesdk_app_id entry in Firebase config file") );
 				goto android_dialog_cleanup2;
 			}
 
-			contents2 += strlen("<string name=\"games_app_id\"");
-			*contents2 = 0;
-			contents3 = contents2;
-			contents3++;
-			contents3 = strstr( contents3, "</string>" );
-			if ( !contents3 )
+			// look for the package_name for this mobilesdk_app_id
+			app_package = android_firebase_value( app_id_end, "package_name", NULL );
+			if ( !app_package )
 			{
-				SHOW_ERR( _("Could not find end of games_app_id entry in values.xml file") );
+				android_export_job_error( job, "%s", _("Could not find package_name for mobilesdk_app_id entry in Firebase config file") );
 				goto android_dialog_cleanup2;
 			}
+			if ( strcmp( app_package, package_name ) != 0 ) SETPTR( firebase_value, NULL );
+			g_free( app_package );
+			app_id = app_id_end;
+		}
+
+		if ( !firebase_value )
+		{
+			android_export_job_error( job, _("Could not find mobilesdk_app_id for android package_name \"%s\" in the Firebase config file"), package_name );
+			goto android_dialog_cleanup2;
+		}
+		if ( !android_values_set( job, values_template, "google_app_id", firebase_value ) ) goto android_dialog_cleanup2;
+
+		if ( contentsOther ) g_free(contentsOther);
+		contentsOther = 0;
+	}
+
+	values = g_string_sized_new( resLength + 1024 );
+	utils_template_render( values_template, values );
+	utils_overlay_set_contents( overlay, resources_file, values->str, values->len );
+	if ( !utils_overlay_materialize( overlay, resources_file, tmp_folder, &error ) )
+	{
+		android_export_job_error( job, _("Failed to write resource values.xml file: %s"), error->message );
+		g_error_free(error);
+		error = NULL;
+		goto android_dialog_cleanup2;
+	}
+
+	if ( contents ) g_free(contents);
+	contents = 0;
+	android_export_job_mark( job, "resources" );
+	if ( android_export_job_cancelled( job ) ) goto android_dialog_cleanup2;
+
+	// start packaging app
+	if ( !g_file_test( path_to_aapt2, G_FILE_TEST_EXISTS ) )
+	{
+		android_export_job_error( job, "%s", _("Failed to export project, AAPT2 program not found") );
+		goto android_dialog_cleanup2;
+	}
 
-			// write resources file
-			strcpy( newcontents, newcontents2 );
-			strcat( newcontents, ">" );
-			strcat( newcontents, google_play_app_id );
-			strcat( newcontents, contents3 );
+	// resources that need compiling, relative to resOrig
+	compile_inputs = g_ptr_array_new();
+	g_ptr_array_add( compile_inputs, g_strdup( "values/values.xml" ) );
+	
+	// scale the icons and save them, aapt2 is only told about them once they all exist
+	android_export_job_stage( job, "icons" );
+	if ( app_icon && *app_icon )
+	{
+		// the two biggest sizes aren't used by Ouya, which needs -v4 folders
+		const gchar* icon_folders[] = { "drawable-xxxhdpi", "drawable-xxhdpi", "drawable-xhdpi", "drawable-hdpi", "drawable-mdpi", "drawable-ldpi" };
+		const gint icon_sizes[] = { 192, 144, 96, 72, 48, 36 };
+		const gchar* szMainIcon = (app_type == 2) ? "app_icon.png" : "icon.png";
 
-			// repair original file
-			*contents2 = '>';
+		icon_set = utils_icon_set_new( app_icon );
+		for( i = (app_type == 2) ? 2 : 0; i < (int) G_N_ELEMENTS(icon_sizes); i++ )
+		{
+			gchar *folder = (app_type == 2) ? g_strconcat( icon_folders[i], "-v4", NULL ) : g_strdup( icon_folders[i] );
+			android_add_icon( icon_set, compile_inputs, tmp_folder, folder, szMainIcon, icon_sizes[i], icon_sizes[i] );
+			g_free( folder );
 		}
 
-		// admob app id
-		if ( app_type == 0 && admob_app_id && *admob_app_id )
+		if ( !utils_icon_set_write( icon_set, &error ) )
 		{
-			memcpy( newcontents2, newcontents, AGK_NEW_CONTENTS_SIZE );
-			contents2 = strstr( newcontents2, "<string name=\"admob_app_id\">" );
-			if ( !contents2 )
-			{
-				SHOW_ERR( _("Could not find admob_app_id entry in values.xml file") );
-				goto android_dialog_cleanup2;
-			}
+			android_export_job_error( job, _("Failed to save app icons: %s"), error->message );
+			g_error_free(error);
+			error = NULL;
+			goto android_dialog_cleanup2;
+		}
+		utils_icon_set_free( icon_set );
+		icon_set = NULL;
+	}
 
-			contents2 += strlen("<string name=\"admob_app_id\"");
-			*contents2 = 0;
-			contents3 = contents2;
-			contents3++;
-			contents3 = strstr( contents3, "</string>" );
-			if ( !contents3 )
-			{
-				SHOW_ERR( _("Could not find end of admob_app_id entry in values.xml file") );
-				goto android_dialog_cleanup2;
-			}
+	// notification icon file
+	if ( notif_icon && *notif_icon && (app_type == 0 || app_type == 1) )
+	{
+		const gchar* icon_folders[] = { "drawable-xxxhdpi", "drawable-xxhdpi", "drawable-xhdpi", "drawable-hdpi", "drawable-mdpi", "drawable-ldpi" };
+		const gint icon_sizes[] = { 96, 72, 48, 36, 24, 24 };
+
+		icon_set = utils_icon_set_new( notif_icon );
+		for( i = 0; i < (int) G_N_ELEMENTS(icon_sizes); i++ )
+			android_add_icon( icon_set, compile_inputs, tmp_folder, icon_folders[i], "icon_white.png", icon_sizes[i], icon_sizes[i] );
+
+		if ( !utils_icon_set_write( icon_set, &error ) )
+		{
+			android_export_job_error( job, _("Failed to save notification icons: %s"), error->message );
+			g_error_free(error);
+			error = NULL;
+			goto android_dialog_cleanup2;
+		}
+		utils_icon_set_free( icon_set );
+		icon_set = NULL;
+	}
 
-			// write resources file
-			strcpy( newcontents, newcontents2 );
-			strcat( newcontents, ">" );
-			strcat( newcontents, admob_app_id );
-			strcat( newcontents, contents3 );
+	// check ouya icon size
+	if ( app_type == 2 && ouya_icon && *ouya_icon )
+	{
+		gint ouya_width = 0, ouya_height = 0;
 
-			// repair original file
-			*contents2 = '>';
+		if ( !gdk_pixbuf_get_file_info( ouya_icon, &ouya_width, &ouya_height ) )
+		{
+			android_export_job_error( job, "%s", _("Failed to load Ouya large icon") );
+			goto android_dialog_cleanup2;
 		}
 
-		// snapchat client id
-		if ( app_type == 0 && snapchat_client_id && *snapchat_client_id )
+		if ( ouya_width != 732 || ouya_height != 412 )
 		{
-			memcpy( newcontents2, newcontents, AGK_NEW_CONTENTS_SIZE );
-			contents2 = strstr( newcontents2, "<string name=\"snap_chat_id\">" );
-			if ( !contents2 )
-			{
-				SHOW_ERR( _("Could not find snap_chat_id entry in values.xml file") );
-				goto android_dialog_cleanup2;
-			}
+			android_export_job_error( job, "%s", _("Ouya large icon must be 732x412 pixels") );
+			goto android_dialog_cleanup2;
+		}
 
-			contents2 += strlen("<string name=\"snap_chat_id\"");
-			*contents2 = 0;
-			contents3 = contents2;
-			contents3++;
-			contents3 = strstr( contents3, "</string>" );
-			if ( !contents3 )
-			{
-				SHOW_ERR( _("Could not find end of snap_chat_id entry in values.xml file") );
-				goto android_dialog_cleanup2;
-			}
+		// copy it to the res folder
+		image_filename = g_build_path( "/", tmp_folder, "resOrig", "drawable-xhdpi-v4", "ouya_icon.png", NULL );
+		utils_copy_file( ouya_icon, image_filename, TRUE, NULL );
+		g_free( image_filename );
+		image_filename = NULL;
 
-			// write resources file
-			strcpy( newcontents, newcontents2 );
-			strcat( newcontents, ">" );
-			strcat( newcontents, snapchat_client_id );
-			strcat( newcontents, contents3 );
+		g_ptr_array_add( compile_inputs, g_strdup( "drawable-xhdpi-v4/ouya_icon.png" ) );
 
-			// repair original file
-			*contents2 = '>';
+		// 320x180
+		icon_set = utils_icon_set_new( ouya_icon );
+		android_add_icon( icon_set, compile_inputs, tmp_folder, "drawable", "icon.png", 320, 180 );
+		if ( !utils_icon_set_write( icon_set, &error ) )
+		{
+			android_export_job_error( job, _("Failed to save lean back icon: %s"), error->message );
+			g_error_free(error);
+			error = NULL;
+			goto android_dialog_cleanup2;
 		}
+		utils_icon_set_free( icon_set );
+		icon_set = NULL;
+	}
+
+
+	android_export_job_mark( job, "icons" );
+	if ( android_export_job_cancelled( job ) ) goto android_dialog_cleanup2;
+
+	// reuse compiled resources from earlier exports, only the ones that changed go to aapt2
+	android_export_job_stage( job, "aapt2" );
+	{
+		gchar *cache_folder = g_build_filename( app->configdir, "aapt2cache", NULL );
+		utils_mkdir( cache_folder, TRUE );
+		g_free( cache_folder );
+	}
+
+	aapt2_commands = g_string_new( "" );
+	compile_misses = g_ptr_array_new();
+	for( i = 0; i < (int) compile_inputs->len; i++ )
+	{
+		const gchar *input = g_ptr_array_index( compile_inputs, i );
+		gchar *cache_path = android_flat_cache_path( tools->aapt2_stamp, tmp_folder, input );
+		gchar *flat_name = android_flat_name( input );
+		gchar *flat_path = g_build_path( "/", tmp_folder, "resMerged", flat_name, NULL );
 
-		// firebase
-		if ( firebase_config && *firebase_config && (app_type == 0 || app_type == 1) ) // Google and Amazon only
+		if ( cache_path && g_file_test( cache_path, G_FILE_TEST_IS_REGULAR ) && utils_copy_file( cache_path, flat_path, TRUE, NULL ) )
 		{
-			// read json values
-			if ( !g_file_get_contents( firebase_config, &contentsOther, &resLength, &error ) )
+			utils_cache_touch( cache_path );
+			g_free( cache_path );
+		}
+		else
+		{
+			g_string_append_printf( aapt2_commands, "compile\n-o\nresMerged\nresOrig/%s\n\n", input );
+			// pairs of flat name and cache path, stored in the cache once aapt2 has finished
+			if ( cache_path )
 			{
-				SHOW_ERR1( _("Failed to read firebase config file: %s"), error->message );
-				g_error_free(error);
-				error = NULL;
-				goto android_dialog_cleanup2;
+				g_ptr_array_add( compile_misses, g_strdup( flat_name ) );
+				g_ptr_array_add( compile_misses, cache_path );
 			}
+		}
 
-			memcpy( newcontents2, newcontents, AGK_NEW_CONTENTS_SIZE );
+		g_free( flat_path );
+		g_free( flat_name );
+	}
 
-			// find project_number value
-			{
-				contentsOther2 = strstr( contentsOther, "\"project_number\": \"" );
-				if ( !contentsOther2 )
-				{
-					SHOW_ERR( _("Could not find project_number entry in Firebase config file") );
-					goto android_dialog_cleanup2;
-				}
+	g_string_append_printf( aapt2_commands, "l\n-I\n%s\n--manifest\n%s/AndroidManifest.xml\n-o\n%s\n--auto-add-overlay\n--no-version-vectors\n", 
+							path_to_android_jar, tmp_folder, output_file );
 
-				contentsOther2 += strlen("\"project_number\": \"");
-				contentsOther3 = strstr( contentsOther2, "\"" );
-				if ( !contentsOther3 )
-				{
-					SHOW_ERR( _("Could not find end of project_number entry in Firebase config file") );
-					goto android_dialog_cleanup2;
-				}
-				*contentsOther3 = 0;
+	// link everything in resMerged, which doesn't contain the resources being compiled in this session yet
+	{
+		GHashTable *flat_names = g_hash_table_new_full( g_str_hash, g_str_equal, g_free, NULL );
+		gchar *res_merged_path = g_build_filename( tmp_folder, "resMerged", NULL );
+		GDir *dir = g_dir_open( res_merged_path, 0, NULL );
+		const gchar *filename;
 
-				// find entry in newcontents2
-				contents2 = strstr( newcontents2, "<string name=\"gcm_defaultSenderId\" translatable=\"false\"" );
-				if ( !contents2 )
-				{
-					SHOW_ERR( _("Could not find gcm_defaultSenderId entry in values.xml file") );
-					goto android_dialog_cleanup2;
-				}
+		foreach_dir(filename, dir)
+		{
+			gchar *fullsrcpath = g_build_filename( res_merged_path, filename, NULL );
+			if ( g_file_test( fullsrcpath, G_FILE_TEST_IS_REGULAR ) )
+				g_hash_table_insert( flat_names, g_strdup( filename ), NULL );
+			g_free( fullsrcpath );
+		}
+		if ( dir ) g_dir_close( dir );
 
-				contents2 += strlen("<string name=\"gcm_defaultSenderId\" translatable=\"false\"");
-				*contents2 = 0;
-				contents3 = contents2;
-				contents3++;
-				contents3 = strstr( contents3, "</string>" );
-				if ( !contents3 )
-				{
-					SHOW_ERR( _("Could not find end of gcm_defaultSenderId entry in values.xml file") );
-					goto android_dialog_cleanup2;
-				}
+		for( i = 0; i < (int) compile_inputs->len; i++ )
+			g_hash_table_insert( flat_names, android_flat_name( g_ptr_array_index( compile_inputs, i ) ), NULL );
 
-				// write resources file
-				strcpy( newcontents, newcontents2 );
-				strcat( newcontents, ">" );
-				strcat( newcontents, contentsOther2 );
-				strcat( newcontents, contents3 );
+		// sorted so the link order doesn't depend on the file system
+		GList *names = g_list_sort( g_hash_table_get_keys( flat_names ), (GCompareFunc) strcmp );
+		GList *node;
+		for( node = names; node; node = node->next )
+			g_string_append_printf( aapt2_commands, "-R\n%s/%s\n", res_merged_path, (const gchar*) node->data );
 
-				*contents2 = '>'; // repair file
-				*contentsOther3 = '"'; // repair file
-				memcpy( newcontents2, newcontents, AGK_NEW_CONTENTS_SIZE );
-			}
-			
-			// find firebase_url value
-			{
-				contentsOther2 = strstr( contentsOther, "\"firebase_url\": \"" );
-				if ( !contentsOther2 )
-				{
-					SHOW_ERR( _("Could not find firebase_url entry in Firebase config file") );
-					goto android_dialog_cleanup2;
-				}
+		g_list_free( names );
+		g_hash_table_destroy( flat_names );
+		g_free( res_merged_path );
+	}
 
-				contentsOther2 += strlen("\"firebase_url\": \"");
-				contentsOther3 = strstr( contentsOther2, "\"" );
-				if ( !contentsOther3 )
-				{
-					SHOW_ERR( _("Could not find end of firebase_url entry in Firebase config file") );
-					goto android_dialog_cleanup2;
-				}
-				*contentsOther3 = 0;
+	g_string_append( aapt2_commands, "\nquit\n\n" );
 
-				// find entry in newcontents2
-				contents2 = strstr( newcontents2, "<string name=\"firebase_database_url\" translatable=\"false\"" );
-				if ( !contents2 )
-				{
-					SHOW_ERR( _("Could not find firebase_database_url entry in values.xml file") );
-					goto android_dialog_cleanup2;
-				}
+#ifdef G_OS_WIN32
+	utils_str_replace_char( aapt2_commands->str, '/', '\\' );
+#endif
 
-				contents2 += strlen("<string name=\"firebase_database_url\" translatable=\"false\"");
-				*contents2 = 0;
-				contents3 = contents2;
-				contents3++;
-				contents3 = strstr( contents3, "</string>" );
-				if ( !contents3 )
-				{
-					SHOW_ERR( _("Could not find end of firebase_database_url entry in values.xml file") );
-					goto android_dialog_cleanup2;
-				}
+	argv = g_new0(gchar *, 3);
+	argv[0] = g_strdup(path_to_aapt2);
+	argv[1] = g_strdup("m"); // open for stdin commands
+	argv[2] = NULL;
 
-				// write resources file
-				strcpy( newcontents, newcontents2 );
-				strcat( newcontents, ">" );
-				strcat( newcontents, contentsOther2 );
-				strcat( newcontents, contents3 );
+	GPollFD aapt2_in = { -1, G_IO_OUT | G_IO_ERR, 0 };
+	if (! g_spawn_async_with_pipes(tmp_folder, argv, NULL, G_SPAWN_DO_NOT_REAP_CHILD | G_SPAWN_STDERR_TO_DEV_NULL | G_SPAWN_STDOUT_TO_DEV_NULL, NULL, NULL, &aapt2_pid, 
+								   &aapt2_in.fd, NULL, NULL, &error))
+	{
+		android_export_job_error( job, "g_spawn_async() failed: %s", error->message );
+		g_error_free(error);
+		error = NULL;
+		goto android_dialog_cleanup2;
+	}
 
-				*contents2 = '>'; // repair file
-				*contentsOther3 = '"'; // repair file
-				memcpy( newcontents2, newcontents, AGK_NEW_CONTENTS_SIZE );
-			}
+	if ( aapt2_pid == 0 )
+	{
+		android_export_job_error( job, "%s", _("Failed to start packaging tool") );
+		goto android_dialog_cleanup2;
+	}
 
-			// find mobilesdk_app_id value
-			// if the config file contains multiple Android apps then there will be multiple mobilesdk_app_id's, and only the corect one will work
-			// look for the corresponding package_name that matches this export
-			{
-				package_count = 0;
-				contentsOther2 = contentsOther;
-				while( *contentsOther2 && (contentsOther2 = strstr( contentsOther2, "\"mobilesdk_app_id\": \"" )) )
-				{
-					package_count++;
-					contentsOther2 += strlen("\"mobilesdk_app_id\": \"");
-					contentsOther3 = strstr( contentsOther2, "\"" );
-					if ( !contentsOther3 )
-					{
-						SHOW_ERR( _("Could not find end of mobilesdk_app_id entry in Firebase config file") );
-						goto android_dialog_cleanup2;
-					}
-					*contentsOther3 = 0;
+	// the whole session goes in one write, aapt2 runs the compiles and the link in order
+	write(aapt2_in.fd, aapt2_commands->str, aapt2_commands->len );
 
-					// look for the package_name for this mobilesdk_app_id
-					gchar* contentsOther4 = strstr( contentsOther3+1, "\"package_name\": \"" );
-					if ( !contentsOther4 )
-					{
-						SHOW_ERR( _("Could not find package_name for mobilesdk_app_id entry in Firebase config file") );
-						goto android_dialog_cleanup2;
-					}
-					contentsOther4 += strlen("\"package_name\": \"");
-					if ( strncmp( contentsOther4, package_name, strlen(package_name) ) == 0 )
-					{
-						contentsOther4 += strlen(package_name);
-						if ( *contentsOther4 == '\"' ) 
-						{
-							break;
-						}
-					}
-
-					*contentsOther3 = '"'; // repair file
-				}
-				
-				if ( !contentsOther2 || !*contentsOther2 )
-				{
-					SHOW_ERR1( _("Could not find mobilesdk_app_id for android package_name \"%s\" in the Firebase config file"), package_name );
-					goto android_dialog_cleanup2;
-				}
+#ifdef G_OS_WIN32
+	WaitForProcess( aapt2_pid );
+#else
+	waitpid( aapt2_pid, &status, 0 );
+#endif
+	aapt2_pid = 0;
 
-				// find entry in newcontents2
-				contents2 = strstr( newcontents2, "<string name=\"google_app_id\" translatable=\"false\"" );
-				if ( !contents2 )
-				{
-					SHOW_ERR( _("Could not find google_app_id entry in values.xml file") );
-					goto android_dialog_cleanup2;
-				}
+	// keep the new compiles for later exports, written atomically since other jobs may be reading them
+	for( i = 0; i + 1 < (int) compile_misses->len; i += 2 )
+	{
+		const gchar *cache_path = g_ptr_array_index( compile_misses, i + 1 );
+		gchar *flat_path = g_build_path( "/", tmp_folder, "resMerged", g_ptr_array_index( compile_misses, i ), NULL );
+		gchar *flat_contents = NULL;
+		gsize flat_length = 0;
+
+		if ( g_file_get_contents( flat_path, &flat_contents, &flat_length, NULL ) && flat_length > 0 )
+			g_file_set_contents( cache_path, flat_contents, flat_length, NULL );
+		g_free( flat_contents );
+		g_free( flat_path );
+	}
+	if ( compile_misses->len > 0 )
+	{
+		// keep the compiles used most recently, the cache would otherwise grow with every edited resource
+		gchar *cache_folder = g_build_filename( app->configdir, "aapt2cache", NULL );
+		utils_cache_prune( cache_folder, AGK_AAPT2_CACHE_MAX_SIZE );
+		g_free( cache_folder );
+	}
 
-				contents2 += strlen("<string name=\"google_app_id\" translatable=\"false\"");
-				*contents2 = 0;
-				contents3 = contents2;
-				contents3++;
-				contents3 = strstr( contents3, "</string>" );
-				if ( !contents3 )
-				{
-					SHOW_ERR( _("Could not find end of google_app_id entry in values.xml file") );
-					goto android_dialog_cleanup2;
-				}
+	// if we have previously called g_spawn_async then g_spawn_sync will never return the correct exit status due to ECHILD being returned from waitpid()
+	
+	// check the file was created instead
+	if ( !g_file_test( output_file, G_FILE_TEST_EXISTS ) )
+	{
+		android_export_job_error( job, "%s", _("Failed to write output files, check that your project directory is not in a write protected location") );
+		goto android_dialog_cleanup2;
+	}
+	android_export_job_mark( job, "aapt2" );
+	if ( android_export_job_cancelled( job ) ) goto android_dialog_cleanup2;
+	
 
-				// write resources file
-				strcpy( newcontents, newcontents2 );
-				strcat( newcontents, ">" );
-				strcat( newcontents, contentsOther2 );
-				strcat( newcontents, contents3 );
+	g_rename( output_file, output_file_zip );
 
-				*contents2 = '>'; // repair file
-				*contentsOther3 = '"'; // repair file
-				memcpy( newcontents2, newcontents, AGK_NEW_CONTENTS_SIZE );
-			}
+	// open APK as a zip file
+	if ( !mz_zip_reader_init_file( &zip_archive, output_file_zip, 0 ) )
+	{
+		android_export_job_error( job, "%s", _("Failed to initialise zip file for reading") );
+		goto android_dialog_cleanup2;
+	}
+	if ( !mz_zip_writer_init_from_reader( &zip_archive, output_file_zip ) )
+	{
+		android_export_job_error( job, "%s", _("Failed to open zip file for writing") );
+		goto android_dialog_cleanup2;
+	}
 
-			// find current_key value
-			{
-				contentsOther2 = strstr( contentsOther, "\"current_key\": \"" );
-				if ( !contentsOther2 )
-				{
-					SHOW_ERR( _("Could not find current_key entry in Firebase config file") );
-					goto android_dialog_cleanup2;
-				}
+	// copy in extra files, everything is compressed in parallel and written in this order
+	zip_queue = utils_zip_queue_new( &zip_archive );
+	utils_zip_queue_set_alignment( zip_queue, 4, 4096 );
+	utils_zip_queue_set_progress( zip_queue, android_export_zip_progress, job );
+	utils_zip_queue_set_levels( zip_queue, job->compression );
+	utils_zip_queue_set_blob_store( zip_queue, export_blob_store() );
+	android_export_job_stage( job, "zip" );
+	{
+		gchar *cache_name = g_compute_checksum_for_string( G_CHECKSUM_SHA1, job->base_path, -1 );
+		gchar *cache_file;
+
+		SETPTR( cache_name, g_strconcat( cache_name, "-android-", android_store_names[app_type], ".zip", NULL ) );
+		cache_file = g_build_filename( app->configdir, "exportcache", cache_name, NULL );
+		// each variant used to keep its compressed entries in an archive of its own, the blob store replaced it
+		g_unlink( cache_file );
+		SETPTR( cache_name, g_strconcat( cache_file, ".idx", NULL ) );
+		g_unlink( cache_name );
+		// the level picked for each file and why
+		SETPTR( cache_file, g_strconcat( cache_file, ".levels.txt", NULL ) );
+		utils_zip_queue_set_log( zip_queue, cache_file );
+		g_free( cache_file );
+		g_free( cache_name );
+	}
 
-				contentsOther2 += strlen("\"current_key\": \"");
-				contentsOther3 = strstr( contentsOther2, "\"" );
-				if ( !contentsOther3 )
-				{
-					SHOW_ERR( _("Could not find end of current_key entry in Firebase config file") );
-					goto android_dialog_cleanup2;
-				}
-				*contentsOther3 = 0;
+	zip_add_file = g_build_path( "/", src_folder, "classes.dex", NULL );
+	utils_zip_queue_add_file( zip_queue, "classes.dex", zip_add_file, 9 );
 
-				// find entry in newcontents2
-				contents2 = strstr( newcontents2, "<string name=\"google_api_key\" translatable=\"false\"" );
-				if ( !contents2 )
-				{
-					SHOW_ERR( _("Could not find google_api_key entry in values.xml file") );
-					goto android_dialog_cleanup2;
-				}
+	for( i = 0; i < 2; i++ )
+	{
+		const gchar *abi = i ? "armeabi-v7a" : "arm64-v8a";
+		const gchar *libs[] = { "libandroid_player.so", NULL, NULL };
 
-				contents2 += strlen("<string name=\"google_api_key\" translatable=\"false\"");
-				*contents2 = 0;
-				contents3 = contents2;
-				contents3++;
-				contents3 = strstr( contents3, "</string>" );
-				if ( !contents3 )
-				{
-					SHOW_ERR( _("Could not find end of google_api_key entry in values.xml file") );
-					goto android_dialog_cleanup2;
-				}
+		// use real ARCore lib
+		if ( arcore_mode > 0 ) libs[1] = "libarcore_sdk.so";
+		if ( snapchat_client_id && *snapchat_client_id ) libs[ libs[1] ? 2 : 1 ] = "libpruneau.so";
 
-				// write resources file
-				strcpy( newcontents, newcontents2 );
-				strcat( newcontents, ">" );
-				strcat( newcontents, contentsOther2 );
-				strcat( newcontents, contents3 );
+		for( j = 0; j < 3 && libs[j]; j++ )
+		{
+			gchar *lib_name = g_strconcat( "lib/", abi, "/", libs[j], NULL );
 
-				*contents2 = '>'; // repair file
-				memcpy( newcontents2, newcontents, AGK_NEW_CONTENTS_SIZE );
+			g_free( zip_add_file );
+			zip_add_file = g_build_path( "/", android_folder, "lib", abi, libs[j], NULL );
+			// a missing lib was always skipped
+			if ( g_file_test( zip_add_file, G_FILE_TEST_IS_REGULAR ) )
+				utils_zip_queue_add_file( zip_queue, lib_name, zip_add_file, 9 );
+			g_free( lib_name );
+		}
+	}
 
-				// also copy it to google_crash_reporting_api_key
-				contents2 = strstr( newcontents2, "<string name=\"google_crash_reporting_api_key\" translatable=\"false\"" );
-				if ( !contents2 )
-				{
-					SHOW_ERR( _("Could not find google_crash_reporting_api_key entry in values.xml file") );
-					goto android_dialog_cleanup2;
-				}
+	if ( app_type != 2 )
+	{
+		// copy assets for Google and Amazon
+		g_free( zip_add_file );
+		zip_add_file = g_build_path( "/", android_folder, "assets", NULL );
+		if ( !utils_zip_queue_add_folder( zip_queue, zip_add_file, "assets", TRUE, TRUE ) )
+		{
+			android_export_job_error( job, "%s", _("Failed to add media files to APK") );
+			goto android_dialog_cleanup2;
+		}
+	}
 
-				contents2 += strlen("<string name=\"google_crash_reporting_api_key\" translatable=\"false\"");
-				*contents2 = 0;
-				contents3 = contents2;
-				contents3++;
-				contents3 = strstr( contents3, "</string>" );
-				if ( !contents3 )
-				{
-					SHOW_ERR( _("Could not find end of google_crash_reporting_api_key entry in values.xml file") );
-					goto android_dialog_cleanup2;
-				}
+	// copy in media files
+	g_free( zip_add_file );
+	zip_add_file = g_build_path( "/", job->base_path, "media", NULL );
+	if ( !utils_zip_queue_add_folder( zip_queue, zip_add_file, "assets/media", TRUE, TRUE ) )
+	{
+		android_export_job_error( job, "%s", _("Failed to add media files to APK") );
+		goto android_dialog_cleanup2;
+	}
 
-				// write resources file
-				strcpy( newcontents, newcontents2 );
-				strcat( newcontents, ">" );
-				strcat( newcontents, contentsOther2 );
-				strcat( newcontents, contents3 );
+	zip_result = utils_zip_queue_finish( zip_queue );
+	zip_queue = NULL;
+	if ( !zip_result )
+	{
+		android_export_job_error( job, "%s", _("Failed to add media files to APK") );
+		goto android_dialog_cleanup2;
+	}
 
-				*contents2 = '>'; // repair file
-				*contentsOther3 = '"'; // repair file
-				memcpy( newcontents2, newcontents, AGK_NEW_CONTENTS_SIZE );
-			}
+	if ( !mz_zip_writer_finalize_archive( &zip_archive ) )
+	{
+		android_export_job_error( job, "%s", _("Failed to add finalize zip file") );
+		goto android_dialog_cleanup2;
+	}
+	if ( !mz_zip_writer_end( &zip_archive ) )
+	{
+		android_export_job_error( job, "%s", _("Failed to end zip file") );
+		goto android_dialog_cleanup2;
+	}
+	android_export_job_mark( job, "zip" );
+	if ( android_export_job_cancelled( job ) ) goto android_dialog_cleanup2;
+
+
+	// sign apk
+	android_export_job_stage( job, "sign" );
+	argv2 = g_new0( gchar*, 14 );
+	argv2[0] = g_strdup( path_to_jarsigner );
+	argv2[1] = g_strdup("-sigalg");
+	argv2[2] = g_strdup("MD5withRSA");
+	argv2[3] = g_strdup("-digestalg");
+	argv2[4] = g_strdup("SHA1");
+	argv2[5] = g_strdup("-storepass");
+#ifdef G_OS_WIN32
+	argv2[6] = g_strconcat( "\"", keystore_password, "\"", NULL );
+#else
+	argv2[6] = g_strdup( keystore_password );
+#endif
+	argv2[7] = g_strdup("-keystore");
+	argv2[8] = g_strdup(keystore_file);
+	argv2[9] = g_strdup(output_file_zip);
+	argv2[10] = g_strdup(alias_name);
+	argv2[11] = g_strdup("-keypass");
+#ifdef G_OS_WIN32
+	argv2[12] = g_strconcat( "\"", alias_password, "\"", NULL );
+#else
+	argv2[12] = g_strdup( alias_password );
+#endif
+	argv2[13] = NULL;
 
-			if ( contentsOther ) g_free(contentsOther);
-			contentsOther = 0;
-		}
+	if ( !utils_spawn_sync( tmp_folder, argv2, NULL, 0, NULL, NULL, &str_out, NULL, &status, &error) )
+	{
+		android_export_job_error( job, _("Failed to run signing tool: %s"), error->message );
+		g_error_free(error);
+		error = NULL;
+		goto android_dialog_cleanup2;
+	}
+	
+	if ( status != 0 && str_out && *str_out && strstr(str_out,"jar signed.") == 0 )
+	{
+		android_export_job_error( job, _("Failed to sign APK, is your keystore password and alias correct? (error: %s)"), str_out );
+		goto android_dialog_cleanup2;
+	}
 
-		if ( !g_file_set_contents( resources_file, newcontents, strlen(newcontents), &error ) )
-		{
-			SHOW_ERR1( _("Failed to write resource values.xml file: %s"), error->message );
-			g_error_free(error);
-			error = NULL;
-			goto android_dialog_cleanup2;
-		}
+	if ( str_out ) g_free(str_out);
+	str_out = 0;
+	android_export_job_mark( job, "sign" );
+	if ( android_export_job_cancelled( job ) ) goto android_dialog_cleanup2;
 
-		if ( contents ) g_free(contents);
-		contents = 0;
 
-		// start packaging app
-		gchar *aaptcommand = g_new0( gchar*, 1000000 );
-		if ( !g_file_test( path_to_aapt2, G_FILE_TEST_EXISTS ) )
+	// align apk, the stored entries were written aligned so this is only needed if signing moved them
+	android_export_job_stage( job, "zipalign" );
+	if ( utils_zip_check_alignment( output_file_zip, 4, 0, NULL ) )
+	{
+		if ( g_rename( output_file_zip, output_file ) != 0 )
 		{
-			SHOW_ERR( _("Failed to export project, AAPT2 program not found") );
+			android_export_job_error( job, "%s", _("Failed to write output files, check that your project directory is not in a write protected location") );
 			goto android_dialog_cleanup2;
 		}
+		android_export_job_mark( job, "aligned" );
+	}
+	else
+	{
+		argv3 = g_new0( gchar*, 5 );
+		argv3[0] = g_strdup( path_to_zipalign );
+		argv3[1] = g_strdup("4");
+		argv3[2] = g_strdup(output_file_zip);
+		argv3[3] = g_strdup(output_file);
+		argv3[4] = NULL;
 
-		argv = g_new0(gchar *, 3);
-		argv[0] = g_strdup(path_to_aapt2);
-		argv[1] = g_strdup("m"); // open for stdin commands
-		argv[2] = NULL;
-
-		GPid aapt2_pid = 0;
-		GPollFD aapt2_in = { -1, G_IO_OUT | G_IO_ERR, 0 };
-		if (! g_spawn_async_with_pipes(tmp_folder, argv, NULL, G_SPAWN_DO_NOT_REAP_CHILD | G_SPAWN_STDERR_TO_DEV_NULL | G_SPAWN_STDOUT_TO_DEV_NULL, NULL, NULL, &aapt2_pid, 
-									   &aapt2_in.fd, NULL, NULL, &error))
+		if ( !utils_spawn_sync( tmp_folder, argv3, NULL, 0, NULL, NULL, &str_out, NULL, &status, &error) )
 		{
-			SHOW_ERR1("g_spawn_async() failed: %s", error->message);
+			android_export_job_error( job, _("Failed to run zipalign tool: %s"), error->message );
 			g_error_free(error);
 			error = NULL;
 			goto android_dialog_cleanup2;
 		}
-
-		if ( aapt2_pid == 0 )
+		
+		if ( status != 0 && str_out && *str_out )
 		{
-			SHOW_ERR( _("Failed to start packaging tool") );
+			android_export_job_error( job, _("Zip align tool returned error: %s"), str_out );
 			goto android_dialog_cleanup2;
 		}
+		android_export_job_mark( job, "zipalign" );
+	}
+
+	// for the next export, failing to record it only means that one can't be skipped
+	utils_fingerprint_add_output( fingerprint, output_file );
+	utils_fingerprint_save( fingerprint );
+	result = TRUE;
 
-		// compile values.xml file
+
+android_dialog_cleanup2:
+	if ( !result ) android_export_job_error( job, "%s", _("Failed to export APK") );
+
+	if ( aapt2_pid ) 
+	{
 	#ifdef G_OS_WIN32
-		strcpy( aaptcommand, "compile\n-o\nresMerged\nresOrig\\values\\values.xml\n\n" );
+		TerminateProcess(aapt2_pid, 0);
 	#else
-		strcpy( aaptcommand, "compile\n-o\nresMerged\nresOrig/values/values.xml\n\n" );
+		kill(aapt2_pid, SIGTERM);
 	#endif
-		write(aapt2_in.fd, aaptcommand, strlen(aaptcommand) );
-
-		if ( error )
-		{
-			g_error_free(error);
-			error = NULL;
-		}
-		
-		// load icon file
-		if ( app_icon && *app_icon )
-		{
-			if ( icon_image ) gdk_pixbuf_unref(icon_image);
-			icon_image = gdk_pixbuf_new_from_file( app_icon, &error );
-			if ( !icon_image || error )
-			{
-				SHOW_ERR1( _("Failed to load image icon: %s"), error->message );
-				g_error_free(error);
-				error = NULL;
-				goto android_dialog_cleanup2;
-			}
+	}
 
-			// scale it and save it
-			if ( app_type == 0 || app_type == 1 )
-			{
-				// 192x192
-				image_filename = g_build_path( "/", tmp_folder, "resOrig", "drawable-xxxhdpi", "icon.png", NULL );
-				icon_scaled_image = gdk_pixbuf_scale_simple( icon_image, 192, 192, GDK_INTERP_HYPER );
-				if ( !gdk_pixbuf_save( icon_scaled_image, image_filename, "png", &error, "compression", "9", NULL ) )
-				{
-					SHOW_ERR1( _("Failed to save xxxhdpi icon: %s"), error->message );
-					g_error_free(error);
-					error = NULL;
-					goto android_dialog_cleanup2;
-				}
-				gdk_pixbuf_unref( icon_scaled_image );
-				g_free( image_filename );
+	g_unlink( output_file_zip );
+	utils_remove_folder_full( tmp_folder, export_folder_progress, NULL );
+
+	if ( zip_queue ) utils_zip_queue_free( zip_queue );
+	if ( zip_add_file ) g_free(zip_add_file);
+	utils_overlay_free( overlay );
+	utils_fingerprint_free( fingerprint );
+	g_free( changes );
+	if ( manifest ) g_string_free( manifest, TRUE );
+	if ( values ) g_string_free( values, TRUE );
+	utils_template_free( manifest_template );
+	utils_template_free( values_template );
+	if ( firebase_value ) g_free(firebase_value);
+	if ( contents ) g_free(contents);
+	if ( contentsOther ) g_free(contentsOther);
+	if ( error ) g_error_free(error);
+	utils_icon_set_free( icon_set );
+	if ( compile_inputs )
+	{
+		g_ptr_array_foreach( compile_inputs, (GFunc) g_free, NULL );
+		g_ptr_array_free( compile_inputs, TRUE );
+	}
+	if ( compile_misses )
+	{
+		g_ptr_array_foreach( compile_misses, (GFunc) g_free, NULL );
+		g_ptr_array_free( compile_misses, TRUE );
+	}
+	if ( aapt2_commands ) g_string_free( aapt2_commands, TRUE );
+	if ( image_filename ) g_free(image_filename);
+	if ( argv ) g_strfreev(argv);
+	if ( argv2 ) g_strfreev(argv2);
+	if ( argv3 ) g_strfreev(argv3);
+	
+	if ( output_file_zip ) g_free(output_file_zip);
+	if ( tmp_folder ) g_free(tmp_folder);
+	if ( src_folder ) g_free(src_folder);
+	if ( str_out ) g_free(str_out);
+
+	if ( output_file ) g_free(output_file);
+	if ( app_name ) g_free(app_name);
+	if ( package_name ) g_free(package_name);
+	if ( app_icon ) g_free(app_icon);
+	if ( ouya_icon ) g_free(ouya_icon);
+	if ( firebase_config ) g_free(firebase_config);
+	if ( url_scheme ) g_free(url_scheme);
+	if ( deep_link ) g_free(deep_link);
+	if ( google_play_app_id ) g_free(google_play_app_id);
+	if ( admob_app_id ) g_free(admob_app_id);
+	if ( snapchat_client_id ) g_free(snapchat_client_id);
+
+	if ( keystore_file ) g_free(keystore_file);
+	if ( keystore_password ) g_free(keystore_password);
+	if ( version_number ) g_free(version_number);
+	if ( alias_name ) g_free(alias_name);
+	if ( alias_password ) g_free(alias_password);
+
+	return result;
+}
 
-			#ifdef G_OS_WIN32
-				strcpy( aaptcommand, "compile\n-o\nresMerged\nresOrig\\drawable-xxxhdpi\\icon.png\n\n" );
-			#else
-				strcpy( aaptcommand, "compile\n-o\nresMerged\nresOrig/drawable-xxxhdpi/icon.png\n\n" );
-			#endif
-				write(aapt2_in.fd, aaptcommand, strlen(aaptcommand) );
-
-				// 144x144
-				image_filename = g_build_path( "/", tmp_folder, "resOrig", "drawable-xxhdpi", "icon.png", NULL );
-				icon_scaled_image = gdk_pixbuf_scale_simple( icon_image, 144, 144, GDK_INTERP_HYPER );
-				if ( !gdk_pixbuf_save( icon_scaled_image, image_filename, "png", &error, "compression", "9", NULL ) )
-				{
-					SHOW_ERR1( _("Failed to save xxhdpi icon: %s"), error->message );
-					g_error_free(error);
-					error = NULL;
-					goto android_dialog_cleanup2;
-				}
-				gdk_pixbuf_unref( icon_scaled_image );
-				g_free( image_filename );
 
-			#ifdef G_OS_WIN32
-				strcpy( aaptcommand, "compile\n-o\nresMerged\nresOrig\\drawable-xxhdpi\\icon.png\n\n" );
-			#else
-				strcpy( aaptcommand, "compile\n-o\nresMerged\nresOrig/drawable-xxhdpi/icon.png\n\n" );
-			#endif
-				write(aapt2_in.fd, aaptcommand, strlen(aaptcommand) );
-			}
+// the export started from the Android dialog, NULL when it isn't exporting
+static ExportTask *android_export_task = NULL;
 
-			const gchar* szDrawable_xhdpi = (app_type == 2) ? "drawable-xhdpi-v4" : "drawable-xhdpi";
-			const gchar* szDrawable_hdpi = (app_type == 2) ? "drawable-hdpi-v4" : "drawable-hdpi";
-			const gchar* szDrawable_mdpi = (app_type == 2) ? "drawable-mdpi-v4" : "drawable-mdpi";
-			const gchar* szDrawable_ldpi = (app_type == 2) ? "drawable-ldpi-v4" : "drawable-ldpi";
+static gboolean android_export_task_run( ExportTask *task, gpointer data )
+{
+	AndroidExportJob *job = data;
+	AndroidExportTools *tools = android_export_tools_new();
+	gboolean success;
 
-			const gchar* szMainIcon = (app_type == 2) ? "app_icon.png" : "icon.png";
-			
-			// 96x96
-			image_filename = g_build_path( "/", tmp_folder, "resOrig", szDrawable_xhdpi, szMainIcon, NULL );
-			icon_scaled_image = gdk_pixbuf_scale_simple( icon_image, 96, 96, GDK_INTERP_HYPER );
-			if ( !gdk_pixbuf_save( icon_scaled_image, image_filename, "png", &error, "compression", "9", NULL ) )
-			{
-				SHOW_ERR1( _("Failed to save xhdpi icon: %s"), error->message );
-				g_error_free(error);
-				error = NULL;
-				goto android_dialog_cleanup2;
-			}
-			gdk_pixbuf_unref( icon_scaled_image );
-			g_free( image_filename );
-
-		#ifdef G_OS_WIN32
-			strcpy( aaptcommand, "compile\n-o\nresMerged\nresOrig\\" ); strcat( aaptcommand, szDrawable_xhdpi ); strcat( aaptcommand, "\\" );
-			strcat( aaptcommand, szMainIcon ); strcat( aaptcommand, "\n\n" );
-		#else
-			strcpy( aaptcommand, "compile\n-o\nresMerged\nresOrig/" ); strcat( aaptcommand, szDrawable_xhdpi ); strcat( aaptcommand, "/" );
-			strcat( aaptcommand, szMainIcon ); strcat( aaptcommand, "\n\n" );
-		#endif
-			write(aapt2_in.fd, aaptcommand, strlen(aaptcommand) );
-
-			// 72x72
-			image_filename = g_build_path( "/", tmp_folder, "resOrig", szDrawable_hdpi, szMainIcon, NULL );
-			icon_scaled_image = gdk_pixbuf_scale_simple( icon_image, 72, 72, GDK_INTERP_HYPER );
-			if ( !gdk_pixbuf_save( icon_scaled_image, image_filename, "png", &error, "compression", "9", NULL ) )
-			{
-				SHOW_ERR1( _("Failed to save hdpi icon: %s"), error->message );
-				g_error_free(error);
-				error = NULL;
-				goto android_dialog_cleanup2;
-			}
-			gdk_pixbuf_unref( icon_scaled_image );
-			g_free( image_filename );
-
-		#ifdef G_OS_WIN32
-			strcpy( aaptcommand, "compile\n-o\nresMerged\nresOrig\\" ); strcat( aaptcommand, szDrawable_hdpi ); strcat( aaptcommand, "\\" );
-			strcat( aaptcommand, szMainIcon ); strcat( aaptcommand, "\n\n" );
-		#else
-			strcpy( aaptcommand, "compile\n-o\nresMerged\nresOrig/" ); strcat( aaptcommand, szDrawable_hdpi ); strcat( aaptcommand, "/" );
-			strcat( aaptcommand, szMainIcon ); strcat( aaptcommand, "\n\n" );
-		#endif
-			write(aapt2_in.fd, aaptcommand, strlen(aaptcommand) );
-
-			// 48x48
-			image_filename = g_build_path( "/", tmp_folder, "resOrig", szDrawable_mdpi, szMainIcon, NULL );
-			icon_scaled_image = gdk_pixbuf_scale_simple( icon_image, 48, 48, GDK_INTERP_HYPER );
-			if ( !gdk_pixbuf_save( icon_scaled_image, image_filename, "png", &error, "compression", "9", NULL ) )
-			{
-				SHOW_ERR1( _("Failed to save mdpi icon: %s"), error->message );
-				g_error_free(error);
-				error = NULL;
-				goto android_dialog_cleanup2;
-			}
-			gdk_pixbuf_unref( icon_scaled_image );
-			g_free( image_filename );
-
-		#ifdef G_OS_WIN32
-			strcpy( aaptcommand, "compile\n-o\nresMerged\nresOrig\\" ); strcat( aaptcommand, szDrawable_mdpi ); strcat( aaptcommand, "\\" );
-			strcat( aaptcommand, szMainIcon ); strcat( aaptcommand, "\n\n" );
-		#else
-			strcpy( aaptcommand, "compile\n-o\nresMerged\nresOrig/" ); strcat( aaptcommand, szDrawable_mdpi ); strcat( aaptcommand, "/" );
-			strcat( aaptcommand, szMainIcon ); strcat( aaptcommand, "\n\n" );
-		#endif
-			write(aapt2_in.fd, aaptcommand, strlen(aaptcommand) );
-
-			// 36x36
-			image_filename = g_build_path( "/", tmp_folder, "resOrig", szDrawable_ldpi, szMainIcon, NULL );
-			icon_scaled_image = gdk_pixbuf_scale_simple( icon_image, 36, 36, GDK_INTERP_HYPER );
-			if ( !gdk_pixbuf_save( icon_scaled_image, image_filename, "png", &error, "compression", "9", NULL ) )
-			{
-				SHOW_ERR1( _("Failed to save ldpi icon: %s"), error->message );
-				g_error_free(error);
-				error = NULL;
-				goto android_dialog_cleanup2;
-			}
-					
-			gdk_pixbuf_unref( icon_scaled_image );
-			icon_scaled_image = NULL;
-
-		#ifdef G_OS_WIN32
-			strcpy( aaptcommand, "compile\n-o\nresMerged\nresOrig\\" ); strcat( aaptcommand, szDrawable_ldpi ); strcat( aaptcommand, "\\" );
-			strcat( aaptcommand, szMainIcon ); strcat( aaptcommand, "\n\n" );
-		#else
-			strcpy( aaptcommand, "compile\n-o\nresMerged\nresOrig/" ); strcat( aaptcommand, szDrawable_ldpi ); strcat( aaptcommand, "/" );
-			strcat( aaptcommand, szMainIcon ); strcat( aaptcommand, "\n\n" );
-		#endif
-			write(aapt2_in.fd, aaptcommand, strlen(aaptcommand) );
-
-			g_free( image_filename );
-			image_filename = NULL;
-		}
+	job->task = task;
+	job->cancel = &task->cancel;
 
-		// load notification icon file
-		if ( notif_icon && *notif_icon && (app_type == 0 || app_type == 1) )
-		{
-			if ( icon_image ) gdk_pixbuf_unref(icon_image);
-			icon_image = gdk_pixbuf_new_from_file( notif_icon, &error );
-			if ( !icon_image || error )
-			{
-				SHOW_ERR1( _("Failed to load notification icon: %s"), error->message );
-				g_error_free(error);
-				error = NULL;
-				goto android_dialog_cleanup2;
-			}
+	success = android_export_job_run( job, tools );
+	if ( !success && job->error ) export_task_error( task, "%s", job->error );
 
-			// scale it and save it
-			// 96x96
-			image_filename = g_build_path( "/", tmp_folder, "resOrig", "drawable-xxxhdpi", "icon_white.png", NULL );
-			icon_scaled_image = gdk_pixbuf_scale_simple( icon_image, 96, 96, GDK_INTERP_HYPER );
-			if ( !gdk_pixbuf_save( icon_scaled_image, image_filename, "png", &error, "compression", "9", NULL ) )
-			{
-				SHOW_ERR1( _("Failed to save xxxhdpi icon: %s"), error->message );
-				g_error_free(error);
-				error = NULL;
-				goto android_dialog_cleanup2;
-			}
-			gdk_pixbuf_unref( icon_scaled_image );
-			g_free( image_filename );
-
-		#ifdef G_OS_WIN32
-			strcpy( aaptcommand, "compile\n-o\nresMerged\nresOrig\\drawable-xxxhdpi\\icon_white.png\n\n" );
-		#else
-			strcpy( aaptcommand, "compile\n-o\nresMerged\nresOrig/drawable-xxxhdpi/icon_white.png\n\n" );
-		#endif
-			write(aapt2_in.fd, aaptcommand, strlen(aaptcommand) );
-
-			// 72x72
-			image_filename = g_build_path( "/", tmp_folder, "resOrig", "drawable-xxhdpi", "icon_white.png", NULL );
-			icon_scaled_image = gdk_pixbuf_scale_simple( icon_image, 72, 72, GDK_INTERP_HYPER );
-			if ( !gdk_pixbuf_save( icon_scaled_image, image_filename, "png", &error, "compression", "9", NULL ) )
-			{
-				SHOW_ERR1( _("Failed to save xxhdpi icon: %s"), error->message );
-				g_error_free(error);
-				error = NULL;
-				goto android_dialog_cleanup2;
-			}
-			gdk_pixbuf_unref( icon_scaled_image );
-			g_free( image_filename );
-
-		#ifdef G_OS_WIN32
-			strcpy( aaptcommand, "compile\n-o\nresMerged\nresOrig\\drawable-xxhdpi\\icon_white.png\n\n" );
-		#else
-			strcpy( aaptcommand, "compile\n-o\nresMerged\nresOrig/drawable-xxhdpi/icon_white.png\n\n" );
-		#endif
-			write(aapt2_in.fd, aaptcommand, strlen(aaptcommand) );
-
-			const gchar* szDrawable_xhdpi = (app_type == 2) ? "drawable-xhdpi-v4" : "drawable-xhdpi";
-			const gchar* szDrawable_hdpi = (app_type == 2) ? "drawable-hdpi-v4" : "drawable-hdpi";
-			const gchar* szDrawable_mdpi = (app_type == 2) ? "drawable-mdpi-v4" : "drawable-mdpi";
-			const gchar* szDrawable_ldpi = (app_type == 2) ? "drawable-ldpi-v4" : "drawable-ldpi";
-
-			// 48x48
-			image_filename = g_build_path( "/", tmp_folder, "resOrig", szDrawable_xhdpi, "icon_white.png", NULL );
-			icon_scaled_image = gdk_pixbuf_scale_simple( icon_image, 48, 48, GDK_INTERP_HYPER );
-			if ( !gdk_pixbuf_save( icon_scaled_image, image_filename, "png", &error, "compression", "9", NULL ) )
-			{
-				SHOW_ERR1( _("Failed to save xhdpi icon: %s"), error->message );
-				g_error_free(error);
-				error = NULL;
-				goto android_dialog_cleanup2;
-			}
-			gdk_pixbuf_unref( icon_scaled_image );
-			g_free( image_filename );
-
-		#ifdef G_OS_WIN32
-			strcpy( aaptcommand, "compile\n-o\nresMerged\nresOrig\\" ); strcat( aaptcommand, szDrawable_xhdpi ); 
-			strcat( aaptcommand, "\\icon_white.png\n\n" );
-		#else
-			strcpy( aaptcommand, "compile\n-o\nresMerged\nresOrig/" ); strcat( aaptcommand, szDrawable_xhdpi );
-			strcat( aaptcommand, "/icon_white.png\n\n" );
-		#endif
-			write(aapt2_in.fd, aaptcommand, strlen(aaptcommand) );
-
-			// 36x36
-			image_filename = g_build_path( "/", tmp_folder, "resOrig", szDrawable_hdpi, "icon_white.png", NULL );
-			icon_scaled_image = gdk_pixbuf_scale_simple( icon_image, 36, 36, GDK_INTERP_HYPER );
-			if ( !gdk_pixbuf_save( icon_scaled_image, image_filename, "png", &error, "compression", "9", NULL ) )
-			{
-				SHOW_ERR1( _("Failed to save hdpi icon: %s"), error->message );
-				g_error_free(error);
-				error = NULL;
-				goto android_dialog_cleanup2;
-			}
-			gdk_pixbuf_unref( icon_scaled_image );
-			g_free( image_filename );
-
-		#ifdef G_OS_WIN32
-			strcpy( aaptcommand, "compile\n-o\nresMerged\nresOrig\\" ); strcat( aaptcommand, szDrawable_hdpi ); 
-			strcat( aaptcommand, "\\icon_white.png\n\n" );
-		#else
-			strcpy( aaptcommand, "compile\n-o\nresMerged\nresOrig/" ); strcat( aaptcommand, szDrawable_hdpi );
-			strcat( aaptcommand, "/icon_white.png\n\n" );
-		#endif
-			write(aapt2_in.fd, aaptcommand, strlen(aaptcommand) );
-
-			// 24x24
-			image_filename = g_build_path( "/", tmp_folder, "resOrig", szDrawable_mdpi, "icon_white.png", NULL );
-			icon_scaled_image = gdk_pixbuf_scale_simple( icon_image, 24, 24, GDK_INTERP_HYPER );
-			if ( !gdk_pixbuf_save( icon_scaled_image, image_filename, "png", &error, "compression", "9", NULL ) )
-			{
-				SHOW_ERR1( _("Failed to save mdpi icon: %s"), error->message );
-				g_error_free(error);
-				error = NULL;
-				goto android_dialog_cleanup2;
-			}
-			gdk_pixbuf_unref( icon_scaled_image );
-			g_free( image_filename );
-
-		#ifdef G_OS_WIN32
-			strcpy( aaptcommand, "compile\n-o\nresMerged\nresOrig\\" ); strcat( aaptcommand, szDrawable_mdpi ); 
-			strcat( aaptcommand, "\\icon_white.png\n\n" );
-		#else
-			strcpy( aaptcommand, "compile\n-o\nresMerged\nresOrig/" ); strcat( aaptcommand, szDrawable_mdpi );
-			strcat( aaptcommand, "/icon_white.png\n\n" );
-		#endif
-			write(aapt2_in.fd, aaptcommand, strlen(aaptcommand) );
-
-			// 24x24
-			image_filename = g_build_path( "/", tmp_folder, "resOrig", szDrawable_ldpi, "icon_white.png", NULL );
-			icon_scaled_image = gdk_pixbuf_scale_simple( icon_image, 24, 24, GDK_INTERP_HYPER );
-			if ( !gdk_pixbuf_save( icon_scaled_image, image_filename, "png", &error, "compression", "9", NULL ) )
-			{
-				SHOW_ERR1( _("Failed to save ldpi icon: %s"), error->message );
-				g_error_free(error);
-				error = NULL;
-				goto android_dialog_cleanup2;
-			}
-					
-			gdk_pixbuf_unref( icon_scaled_image );
-			icon_scaled_image = NULL;
-
-		#ifdef G_OS_WIN32
-			strcpy( aaptcommand, "compile\n-o\nresMerged\nresOrig\\" ); strcat( aaptcommand, szDrawable_ldpi ); 
-			strcat( aaptcommand, "\\icon_white.png\n\n" );
-		#else
-			strcpy( aaptcommand, "compile\n-o\nresMerged\nresOrig/" ); strcat( aaptcommand, szDrawable_ldpi );
-			strcat( aaptcommand, "/icon_white.png\n\n" );
-		#endif
-			write(aapt2_in.fd, aaptcommand, strlen(aaptcommand) );
-
-			g_free( image_filename );
-			image_filename = NULL;
-		}
+	android_export_tools_free( tools );
+	return success;
+}
 
-		// load ouya icon and check size
-		if ( app_type == 2 && ouya_icon && *ouya_icon )
-		{
-			if ( icon_image ) gdk_pixbuf_unref(icon_image);
-			icon_image = gdk_pixbuf_new_from_file( ouya_icon, &error );
-			if ( !icon_image || error )
-			{
-				SHOW_ERR1( _("Failed to load Ouya large icon: %s"), error->message );
-				g_error_free(error);
-				error = NULL;
-				goto android_dialog_cleanup2;
-			}
+static void android_export_task_done( ExportTask *task, gboolean success, gpointer data )
+{
+	AndroidExportJob *job = data;
 
-			if ( gdk_pixbuf_get_width( icon_image ) != 732 || gdk_pixbuf_get_height( icon_image ) != 412 )
-			{
-				SHOW_ERR( _("Ouya large icon must be 732x412 pixels") );
-				goto android_dialog_cleanup2;
-			}
+	android_export_task = NULL;
+	export_project_release( job->base_path );
+	gtk_widget_set_sensitive( ui_lookup_widget(ui_widgets.android_dialog, "android_export1"), TRUE );
 
-			// copy it to the res folder
-			image_filename = g_build_path( "/", tmp_folder, "resOrig", "drawable-xhdpi-v4", "ouya_icon.png", NULL );
-			utils_copy_file( ouya_icon, image_filename, TRUE, NULL );
-			g_free( image_filename );
-
-		#ifdef G_OS_WIN32
-			strcpy( aaptcommand, "compile\n-o\nresMerged\nresOrig\\drawable-xhdpi-v4\\ouya_icon.png\n\n" ); 
-		#else
-			strcpy( aaptcommand, "compile\n-o\nresMerged\nresOrig/drawable-xhdpi-v4/ouya_icon.png\n\n" );
-		#endif
-			write(aapt2_in.fd, aaptcommand, strlen(aaptcommand) );
-
-			// 320x180
-			image_filename = g_build_path( "/", tmp_folder, "resOrig", "drawable", "icon.png", NULL );
-			icon_scaled_image = gdk_pixbuf_scale_simple( icon_image, 320, 180, GDK_INTERP_HYPER );
-			if ( !gdk_pixbuf_save( icon_scaled_image, image_filename, "png", &error, "compression", "9", NULL ) )
-			{
-				SHOW_ERR1( _("Failed to save lean back icon: %s"), error->message );
-				g_error_free(error);
-				error = NULL;
-				goto android_dialog_cleanup2;
-			}
-					
-			gdk_pixbuf_unref( icon_scaled_image );
-			icon_scaled_image = NULL;
-
-		#ifdef G_OS_WIN32
-			strcpy( aaptcommand, "compile\n-o\nresMerged\nresOrig\\drawable\\icon.png\n\n" ); 
-		#else
-			strcpy( aaptcommand, "compile\n-o\nresMerged\nresOrig/drawable/icon.png\n\n" );
-		#endif
-			write(aapt2_in.fd, aaptcommand, strlen(aaptcommand) );
-
-			g_free( image_filename );
-			image_filename = NULL;
-		}
+	if ( success ) gtk_widget_hide( ui_widgets.android_dialog );
+	else if ( !export_task_cancelled( task ) ) SHOW_ERR1( "%s", task->error );
 
-		while (gtk_events_pending())
-			gtk_main_iteration();
-		
-		strcpy( aaptcommand, "l\n-I\n" );
-		strcat( aaptcommand, path_to_android_jar );
-		strcat( aaptcommand, "\n--manifest\n" );
-		strcat( aaptcommand, tmp_folder );
-		strcat( aaptcommand, "/AndroidManifest.xml\n-o\n" );
-		strcat( aaptcommand, output_file );
-		strcat( aaptcommand, "\n--auto-add-overlay\n--no-version-vectors\n" );
-
-		gchar* resMergedPath = g_build_filename( tmp_folder, "resMerged", NULL );
-		GDir *dir = g_dir_open(resMergedPath, 0, NULL);
-		
-		const gchar *filename;
-		foreach_dir(filename, dir)
-		{
-			gchar* fullsrcpath = g_build_filename( tmp_folder, "resMerged", filename, NULL );
+	if ( success && job->unchanged )
+		ui_set_statusbar( TRUE, _("Nothing has changed since the last Android export, %s is up to date."), job->output_file );
 
-			if ( g_file_test( fullsrcpath, G_FILE_TEST_IS_REGULAR ) )
-			{
-				strcat( aaptcommand, "-R\n" );
-				strcat( aaptcommand, fullsrcpath );
-				strcat( aaptcommand, "\n" );
-			}
+	android_export_job_free( job );
+}
 
-			g_free(fullsrcpath);
-		}
+static void on_android_dialog_response(GtkDialog *dialog, gint response, gpointer user_data)
+{
+	// while exporting the close button cancels the export
+	if ( android_export_task )
+	{
+		if ( response != 1 ) export_task_cancel( android_export_task );
+		return;
+	}
 
-		g_dir_close(dir);
-		g_free( resMergedPath );
+	if ( !android_export_files_ready() ) return;
 
-		/*
-		gchar* fullsrcpath = g_build_filename( tmp_folder, "resMerged\\values_values.arsc.flat", NULL );
-		strcat( aaptcommand, "-R\n" );
-		strcat( aaptcommand, fullsrcpath );
-		strcat( aaptcommand, "\n" );
-		g_free(fullsrcpath);
-		*/
+	// save default settings
+	if ( app->project && user_data == 0 )
+	{
+		GtkWidget *widget;
 
-		strcat( aaptcommand, "\nquit\n\n" );
+		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_app_name_entry");
+		AGK_CLEAR_STR(app->project->apk_settings.app_name) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+		
+		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_package_name_entry");
+		AGK_CLEAR_STR(app->project->apk_settings.package_name) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-	#ifdef G_OS_WIN32
-		gchar *ptr = aaptcommand;
-		while( *ptr )
-		{
-			if ( *ptr == '/' ) *ptr = '\\';
-			ptr++;
-		}
-	#endif
+		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_app_icon_entry");
+		AGK_CLEAR_STR(app->project->apk_settings.app_icon_path) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-		//gchar* logpath = g_build_filename( tmp_folder, "log.txt", NULL );
-		//FILE *pFile = fopen( logpath, "wb" );
-		//fputs( aaptcommand, pFile );
-		//fclose( pFile );
+		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_notif_icon_entry");
+		AGK_CLEAR_STR(app->project->apk_settings.notif_icon_path) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-		write(aapt2_in.fd, aaptcommand, strlen(aaptcommand) );
+		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_ouya_icon_entry");
+		AGK_CLEAR_STR(app->project->apk_settings.ouya_icon_path) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-	#ifdef G_OS_WIN32
-		WaitForProcess( aapt2_pid );
-	#else
-		waitpid( aapt2_pid, &status, 0 );
-	#endif
-		aapt2_pid = 0;
+		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_firebase_config_entry");
+		AGK_CLEAR_STR(app->project->apk_settings.firebase_config_path) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-		// if we have previously called g_spawn_async then g_spawn_sync will never return the correct exit status due to ECHILD being returned from waitpid()
+		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_orientation_combo");
+		app->project->apk_settings.orientation = gtk_combo_box_get_active(GTK_COMBO_BOX_TEXT(widget));
 		
-		// check the file was created instead
-		if ( !g_file_test( output_file, G_FILE_TEST_EXISTS ) )
-		{
-			SHOW_ERR( _("Failed to write output files, check that your project directory is not in a write protected location") );
-			goto android_dialog_cleanup2;
-		}
+		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_arcore_combo");
+		app->project->apk_settings.arcore = gtk_combo_box_get_active(GTK_COMBO_BOX_TEXT(widget));
 		
-		while (gtk_events_pending())
-			gtk_main_iteration();
+		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_sdk_combo");
+		gchar *app_sdk = gtk_combo_box_text_get_active_text(GTK_COMBO_BOX_TEXT(widget));
+		app->project->apk_settings.sdk_version = 1; // 4.1
+		if ( strncmp(app_sdk,"4.2",3) == 0 ) app->project->apk_settings.sdk_version = 2;
+		if ( strncmp(app_sdk,"4.3",3) == 0 ) app->project->apk_settings.sdk_version = 3;
+		if ( strncmp(app_sdk,"4.4",3) == 0 ) app->project->apk_settings.sdk_version = 4;
+		if ( strncmp(app_sdk,"5.0",3) == 0 ) app->project->apk_settings.sdk_version = 5;
+		if ( strncmp(app_sdk,"5.1",3) == 0 ) app->project->apk_settings.sdk_version = 6;
+		if ( strncmp(app_sdk,"6.0",3) == 0 ) app->project->apk_settings.sdk_version = 7;
+		if ( strncmp(app_sdk,"7.0",3) == 0 ) app->project->apk_settings.sdk_version = 8;
+		if ( strncmp(app_sdk,"7.1",3) == 0 ) app->project->apk_settings.sdk_version = 9;
+		if ( strncmp(app_sdk,"8.0",3) == 0 ) app->project->apk_settings.sdk_version = 10;
+		if ( strncmp(app_sdk,"8.1",3) == 0 ) app->project->apk_settings.sdk_version = 11;
+		if ( strncmp(app_sdk,"9.0",3) == 0 ) app->project->apk_settings.sdk_version = 12;
+		if ( strncmp(app_sdk,"10.0",3) == 0 ) app->project->apk_settings.sdk_version = 13;
+		g_free(app_sdk);
+				
+		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_url_scheme");
+		AGK_CLEAR_STR(app->project->apk_settings.url_scheme) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-		g_rename( output_file, output_file_zip );
+		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_deep_link");
+		AGK_CLEAR_STR(app->project->apk_settings.deep_link) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-		// open APK as a zip file
-		if ( !mz_zip_reader_init_file( &zip_archive, output_file_zip, 0 ) )
-		{
-			SHOW_ERR( _("Failed to initialise zip file for reading") );
-			goto android_dialog_cleanup2;
-		}
-		if ( !mz_zip_writer_init_from_reader( &zip_archive, output_file_zip ) )
-		{
-			SHOW_ERR( _("Failed to open zip file for writing") );
-			goto android_dialog_cleanup2;
-		}
+		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_google_play_app_id");
+		AGK_CLEAR_STR(app->project->apk_settings.play_app_id) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-		// copy in extra files
-		zip_add_file = g_build_path( "/", src_folder, "classes.dex", NULL );
-		mz_zip_writer_add_file( &zip_archive, "classes.dex", zip_add_file, NULL, 0, 9 );
-		
-		g_free( zip_add_file );
-		zip_add_file = g_build_path( "/", android_folder, "lib", "arm64-v8a", "libandroid_player.so", NULL );
-		mz_zip_writer_add_file( &zip_archive, "lib/arm64-v8a/libandroid_player.so", zip_add_file, NULL, 0, 9 );
-		
-		g_free( zip_add_file );
-		zip_add_file = g_build_path( "/", android_folder, "lib", "armeabi-v7a", "libandroid_player.so", NULL );
-		mz_zip_writer_add_file( &zip_archive, "lib/armeabi-v7a/libandroid_player.so", zip_add_file, NULL, 0, 9 );
-		
-		if ( arcore_mode > 0 )
-		{
-			// use real ARCore lib
-			g_free( zip_add_file );
-			zip_add_file = g_build_path( "/", android_folder, "lib", "arm64-v8a", "libarcore_sdk.so", NULL );
-			mz_zip_writer_add_file( &zip_archive, "lib/arm64-v8a/libarcore_sdk.so", zip_add_file, NULL, 0, 9 );
+		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_admob_app_id");
+		AGK_CLEAR_STR(app->project->apk_settings.admob_app_id) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-			g_free( zip_add_file );
-			zip_add_file = g_build_path( "/", android_folder, "lib", "armeabi-v7a", "libarcore_sdk.so", NULL );
-			mz_zip_writer_add_file( &zip_archive, "lib/armeabi-v7a/libarcore_sdk.so", zip_add_file, NULL, 0, 9 );
-		}
+		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_snapchat_client_id");
+		AGK_CLEAR_STR(app->project->apk_settings.snapchat_client_id) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-		if ( snapchat_client_id && *snapchat_client_id )
-		{
-			g_free( zip_add_file );
-			zip_add_file = g_build_path( "/", android_folder, "lib", "arm64-v8a", "libpruneau.so", NULL );
-			mz_zip_writer_add_file( &zip_archive, "lib/arm64-v8a/libpruneau.so", zip_add_file, NULL, 0, 9 );
+		// permissions
+		app->project->apk_settings.permission_flags = 0;
 
-			g_free( zip_add_file );
-			zip_add_file = g_build_path( "/", android_folder, "lib", "armeabi-v7a", "libpruneau.so", NULL );
-			mz_zip_writer_add_file( &zip_archive, "lib/armeabi-v7a/libpruneau.so", zip_add_file, NULL, 0, 9 );
-		}
-		
-		while (gtk_events_pending())
-			gtk_main_iteration();
+		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_external_storage");
+		if ( gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widget)) ) app->project->apk_settings.permission_flags |= AGK_ANDROID_PERMISSION_WRITE;
 
-		if ( app_type != 2 )
-		{
-			// copy assets for Google and Amazon
-			g_free( zip_add_file );
-			zip_add_file = g_build_path( "/", android_folder, "assets", NULL );
-			if ( !utils_add_folder_to_zip( &zip_archive, zip_add_file, "assets", TRUE, TRUE ) )
-			{
-				SHOW_ERR( _("Failed to add media files to APK") );
-				goto android_dialog_cleanup2;
-			}
-		}
+		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_location_fine");
+		if ( gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widget)) ) app->project->apk_settings.permission_flags |= AGK_ANDROID_PERMISSION_GPS;
 
-		// copy in media files
-		g_free( zip_add_file );
-		zip_add_file = g_build_path( "/", app->project->base_path, "media", NULL );
-		if ( !utils_add_folder_to_zip( &zip_archive, zip_add_file, "assets/media", TRUE, TRUE ) )
-		{
-			SHOW_ERR( _("Failed to add media files to APK") );
-			goto android_dialog_cleanup2;
-		}
+		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_location_coarse");
+		if ( gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widget)) ) app->project->apk_settings.permission_flags |= AGK_ANDROID_PERMISSION_LOCATION;
 
-		if ( !mz_zip_writer_finalize_archive( &zip_archive ) )
-		{
-			SHOW_ERR( _("Failed to add finalize zip file") );
-			goto android_dialog_cleanup2;
-		}
-		if ( !mz_zip_writer_end( &zip_archive ) )
-		{
-			SHOW_ERR( _("Failed to end zip file") );
-			goto android_dialog_cleanup2;
-		}
+		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_internet");
+		if ( gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widget)) ) app->project->apk_settings.permission_flags |= AGK_ANDROID_PERMISSION_INTERNET;
 
-		while (gtk_events_pending())
-			gtk_main_iteration();
+		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_wake");
+		if ( gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widget)) ) app->project->apk_settings.permission_flags |= AGK_ANDROID_PERMISSION_WAKE;
 
-		// sign apk
-		argv2 = g_new0( gchar*, 14 );
-		argv2[0] = g_strdup( path_to_jarsigner );
-		argv2[1] = g_strdup("-sigalg");
-		argv2[2] = g_strdup("MD5withRSA");
-		argv2[3] = g_strdup("-digestalg");
-		argv2[4] = g_strdup("SHA1");
-		argv2[5] = g_strdup("-storepass");
-#ifdef G_OS_WIN32
-		argv2[6] = g_strconcat( "\"", keystore_password, "\"", NULL );
-#else
-		argv2[6] = g_strdup( keystore_password );
-#endif
-		argv2[7] = g_strdup("-keystore");
-		argv2[8] = g_strdup(keystore_file);
-		argv2[9] = g_strdup(output_file_zip);
-		argv2[10] = g_strdup(alias_name);
-		argv2[11] = g_strdup("-keypass");
-#ifdef G_OS_WIN32
-		argv2[12] = g_strconcat( "\"", alias_password, "\"", NULL );
-#else
-		argv2[12] = g_strdup( alias_password );
-#endif
-		argv2[13] = NULL;
+		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_billing");
+		if ( gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widget)) ) app->project->apk_settings.permission_flags |= AGK_ANDROID_PERMISSION_IAP;
 
-		if ( !utils_spawn_sync( tmp_folder, argv2, NULL, 0, NULL, NULL, &str_out, NULL, &status, &error) )
-		{
-			SHOW_ERR1( _("Failed to run signing tool: %s"), error->message );
-			g_error_free(error);
-			error = NULL;
-			goto android_dialog_cleanup2;
-		}
-		
-		if ( status != 0 && str_out && *str_out && strstr(str_out,"jar signed.") == 0 )
-		{
-			SHOW_ERR1( _("Failed to sign APK, is your keystore password and alias correct? (error: %s)"), str_out );
-			goto android_dialog_cleanup2;
-		}
+		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_push_notifications");
+		if ( gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widget)) ) app->project->apk_settings.permission_flags |= AGK_ANDROID_PERMISSION_PUSH;
 
-		if ( str_out ) g_free(str_out);
-		str_out = 0;
+		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_camera");
+		if ( gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widget)) ) app->project->apk_settings.permission_flags |= AGK_ANDROID_PERMISSION_CAMERA;
 
-		while (gtk_events_pending())
-			gtk_main_iteration();
+		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_expansion");
+		if (gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widget)) ) app->project->apk_settings.permission_flags |= AGK_ANDROID_PERMISSION_EXPANSION;
 
-		// align apk
-		argv3 = g_new0( gchar*, 5 );
-		argv3[0] = g_strdup( path_to_zipalign );
-		argv3[1] = g_strdup("4");
-		argv3[2] = g_strdup(output_file_zip);
-		argv3[3] = g_strdup(output_file);
-		argv3[4] = NULL;
+		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_vibrate");
+		if (gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widget)) ) app->project->apk_settings.permission_flags |= AGK_ANDROID_PERMISSION_VIBRATE;
 
-		if ( !utils_spawn_sync( tmp_folder, argv3, NULL, 0, NULL, NULL, &str_out, NULL, &status, &error) )
-		{
-			SHOW_ERR1( _("Failed to run zipalign tool: %s"), error->message );
-			g_error_free(error);
-			error = NULL;
-			goto android_dialog_cleanup2;
-		}
+		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_record_audio");
+		if (gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widget)) ) app->project->apk_settings.permission_flags |= AGK_ANDROID_PERMISSION_RECORD_AUDIO;
+
+		// signing
+		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_keystore_file_entry");
+		AGK_CLEAR_STR(app->project->apk_settings.keystore_path) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 		
-		if ( status != 0 && str_out && *str_out )
-		{
-			SHOW_ERR1( _("Zip align tool returned error: %s"), str_out );
-			goto android_dialog_cleanup2;
-		}
+		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_version_number_entry");
+		AGK_CLEAR_STR(app->project->apk_settings.version_name) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+		
+		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_build_number_entry");
+		int build_number = atoi(gtk_entry_get_text(GTK_ENTRY(widget)));
+		app->project->apk_settings.version_number = build_number;
 
-		while (gtk_events_pending())
-			gtk_main_iteration();
+		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_alias_entry");
+		AGK_CLEAR_STR(app->project->apk_settings.alias) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-		if ( dialog ) gtk_widget_hide(GTK_WIDGET(dialog));
+		// output
+		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_output_file_entry");
+		AGK_CLEAR_STR(app->project->apk_settings.output_path) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-android_dialog_cleanup2:
-        
-        gtk_widget_set_sensitive( ui_lookup_widget(ui_widgets.android_dialog, "android_export1"), TRUE );
-		gtk_widget_set_sensitive( ui_lookup_widget(ui_widgets.android_dialog, "button7"), TRUE );
+		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_output_type_combo");
+		app->project->apk_settings.app_type = gtk_combo_box_get_active(GTK_COMBO_BOX_TEXT(widget));
+	}
+
+	if ( response != 1 )
+	{
+		if ( dialog ) gtk_widget_hide(GTK_WIDGET(dialog));
+	}
+	else
+	{
+		AndroidExportJob *job = android_export_job_from_dialog();
 
-		if ( aapt2_pid ) 
+		if ( !android_export_job_check( job ) )
 		{
-		#ifdef G_OS_WIN32
-			TerminateProcess(aapt2_pid, 0);
-		#else
-			kill(aapt2_pid, SIGTERM);
-		#endif
+			SHOW_ERR1( "%s", job->error );
+			android_export_job_free( job );
 		}
+		else if ( export_project_busy( job->base_path ) )
+		{
+			SHOW_ERR( _("Another export of this project is still running, wait for it to finish first") );
+			android_export_job_free( job );
+		}
+		else
+		{
+			export_project_claim( job->base_path );
+			// the close button stays enabled so the export can be cancelled
+			gtk_widget_set_sensitive( ui_lookup_widget(ui_widgets.android_dialog, "android_export1"), FALSE );
+			android_export_task = export_task_start( "Android export", android_export_task_run, android_export_task_done, job );
+		}
+	}
+}
 
-		g_unlink( output_file_zip );
-		utils_remove_folder_recursive( tmp_folder );
+static gchar *last_proj_path_android = 0;
 
-		if ( path_to_aapt2 ) g_free(path_to_aapt2);
-		if ( path_to_android_jar ) g_free(path_to_android_jar);
-		if ( path_to_jarsigner ) g_free(path_to_jarsigner);
-		if ( path_to_zipalign ) g_free(path_to_zipalign);
+#ifdef __APPLE__
+static gboolean android_unpack_progress( const gchar *archive_name, guint64 done, guint64 total, gpointer user_data )
+{
+	ExportTask *task = user_data;
 
-		if ( zip_add_file ) g_free(zip_add_file);
-		if ( manifest_file ) g_free(manifest_file);
-		if ( newcontents ) g_free(newcontents);
-		if ( newcontents2 ) g_free(newcontents2);
-		if ( contents ) g_free(contents);
-		if ( contentsOther ) g_free(contentsOther);
-		if ( resources_file ) g_free(resources_file);
-		if ( error ) g_error_free(error);
-		if ( icon_image ) gdk_pixbuf_unref(icon_image);
-		if ( image_filename ) g_free(image_filename);
-		if ( icon_scaled_image ) gdk_pixbuf_unref(icon_scaled_image);
-		if ( argv ) g_strfreev(argv);
-		if ( argv2 ) g_strfreev(argv2);
-		if ( argv3 ) g_strfreev(argv3);
-		if ( aaptcommand ) g_free(aaptcommand);
-		
-		if ( output_file_zip ) g_free(output_file_zip);
-		if ( tmp_folder ) g_free(tmp_folder);
-		if ( android_folder ) g_free(android_folder);
-		if ( src_folder ) g_free(src_folder);
-		if ( str_out ) g_free(str_out);
+	export_task_progress( task, NULL, done, total );
+	return !export_task_cancelled( task );
+}
 
-		if ( output_file ) g_free(output_file);
-		if ( app_name ) g_free(app_name);
-		if ( package_name ) g_free(package_name);
-		if ( app_icon ) g_free(app_icon);
-		if ( ouya_icon ) g_free(ouya_icon);
-		if ( firebase_config ) g_free(firebase_config);
-		if ( url_scheme ) g_free(url_scheme);
-		if ( deep_link ) g_free(deep_link);
-		if ( google_play_app_id ) g_free(google_play_app_id);
-		if ( admob_app_id ) g_free(admob_app_id);
-		if ( snapchat_client_id ) g_free(snapchat_client_id);
+static gboolean android_unpack_task_run( ExportTask *task, gpointer data )
+{
+	const gchar *zip_file = data;
+	// the archive is made on Windows so it has no permissions for the tools
+	static const gchar *executables[] = { "AndroidExport/aapt2", "AndroidExport/zipalign", NULL };
+	gchar *error = NULL;
 
-		if ( keystore_file ) g_free(keystore_file);
-		if ( keystore_password ) g_free(keystore_password);
-		if ( version_number ) g_free(version_number);
-		if ( alias_name ) g_free(alias_name);
-		if ( alias_password ) g_free(alias_password);
+	export_task_progress( task, "extract", 0, 0 );
+	if ( !utils_zip_extract( zip_file, app->configdir, executables, android_unpack_progress, task, &error ) )
+	{
+		export_task_error( task, "%s", error );
+		g_free( error );
+		return FALSE;
 	}
-
-	running = 0;
+	export_task_mark( task, "extract", NULL );
+	return TRUE;
 }
 
-static gchar *last_proj_path_android = 0;
+static void android_unpack_task_done( ExportTask *task, gboolean success, gpointer data )
+{
+	android_unpack_task = NULL;
+	g_free( data );
+
+	if ( success ) dialogs_show_msgbox( GTK_MESSAGE_INFO, "Android export download completed, you can now export Android APKs" );
+	else SHOW_ERR1( "Failed to extract the downloaded AndroidExport.zip: %s", task->error );
+}
 
-#ifdef __APPLE__
 @interface HTTPListener : NSObject
 {
 @public
@@ -3028,53 +3435,9 @@ static gchar *last_proj_path_android = 0;
         fclose( m_file );
         m_file = 0;
 
-        // extract zip file
-        mz_zip_archive zip_archive;
-        memset(&zip_archive, 0, sizeof(zip_archive));
-        if ( !mz_zip_reader_init_file( &zip_archive, m_filename, 0 ) )
-        {
-            mz_zip_reader_end( &zip_archive );
-            SHOW_ERR( "Failed to open downloaded AndroidExport.zip" );
-            return;
-        }
-        int numFiles = mz_zip_reader_get_num_files( &zip_archive );
-        char filename[ 1024 ];
-        for( int i = 0; i < numFiles; i++ )
-        {
-            if ( mz_zip_reader_is_file_a_directory( &zip_archive, i ) ) continue;
-            
-            mz_zip_reader_get_filename( &zip_archive, i, filename, 1024 );
-            
-            gchar* final_path = g_build_path( "/", app->configdir, filename, NULL );
-                        
-            char* withoutFile = (char*)malloc( strlen(final_path)+1 );
-            strcpy( withoutFile, final_path );
-            char *szSlash = strrchr( withoutFile, '/' );
-            if ( szSlash ) *szSlash = '\0';
-            
-            // create directory
-            NSString* pWriteDir = [ [ NSString alloc ] initWithUTF8String:withoutFile ];
-            [ g_pFileManager createDirectoryAtPath:pWriteDir withIntermediateDirectories:YES attributes:nil error:nil ];
-            [ pWriteDir release ];
-            
-            free(withoutFile);
-            
-            mz_zip_reader_extract_to_file( &zip_archive, i, final_path, 0 );
-            
-            g_free(final_path);
-        }
-        
-        mz_zip_reader_end( &zip_archive );
-        
-        gchar* file_path = g_build_path( "/", app->configdir, "AndroidExport", "aapt2", NULL );
-        chmod( file_path, 0755 );
-        g_free( file_path );
-        
-        file_path = g_build_path( "/", app->configdir, "AndroidExport", "zipalign", NULL );
-        chmod( file_path, 0755 );
-        g_free( file_path );
-        
-        dialogs_show_msgbox( GTK_MESSAGE_INFO, "Android export download completed, you can now export Android APKs" );
+        // extract zip file on a worker thread, the task reports when it's done
+        android_unpack_task = export_task_start( "Android export download", android_unpack_task_run,
+                                                 android_unpack_task_done, g_strdup( m_filename ) );
     }
 }
 
@@ -3152,7 +3515,7 @@ void project_export_apk()
     gchar* android_path = g_build_path( "/", app->configdir, "AndroidExport", "aapt2", NULL );
     if ( !g_file_test(android_path, G_FILE_TEST_EXISTS) )
     {
-        if ( !m_connection )
+        if ( !m_connection && !android_unpack_task )
         {
             if ( dialogs_show_question("The Android export files must be downloaded separately. Would you like to download them now?") )
             {
@@ -3160,8 +3523,7 @@ void project_export_apk()
                 NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:[NSURL URLWithString:sURL] cachePolicy:NSURLRequestReloadIgnoringLocalCacheData timeoutInterval:10.0 ];
                 if ( !m_listener ) m_listener = [[HTTPListener alloc] init];
                 else [ m_listener reset ];
-                strcpy( m_listener->m_filename, app->configdir );
-                strcat( m_listener->m_filename, "/AndroidExport.zip" );
+                g_snprintf( m_listener->m_filename, sizeof(m_listener->m_filename), "%s/AndroidExport.zip", app->configdir );
                 m_connection = [ [NSURLConnection alloc] initWithRequest:request delegate:m_listener ];
                 
                 dialogs_show_msgbox( GTK_MESSAGE_INFO, "The files will be downloaded in the background" );
@@ -3356,198 +3718,234 @@ void project_export_apk()
 	gtk_window_present(GTK_WINDOW(ui_widgets.android_dialog));
 }
 
-void on_android_all_dialog_response(GtkDialog *dialog, gint response, gpointer user_data)
+// finished jobs are handed back to the main thread, which reports them
+typedef struct AndroidExportQueue
 {
-	if ( response != 1 )
-	{
-		if ( dialog ) gtk_widget_hide(GTK_WIDGET(dialog));
-		return;
-	}
+	GMutex *mutex;
+	GCond *cond;
+	GQueue *finished;
+	const AndroidExportTools *tools;
+} AndroidExportQueue;
 
-	GeanyProject *orig_project = app->project;
+static void android_export_job_thread( gpointer data, gpointer user_data )
+{
+	AndroidExportJob *job = data;
+	AndroidExportQueue *queue = user_data;
 
-	// export all output folder
-	GtkWidget *widget = ui_lookup_widget(ui_widgets.android_all_dialog, "export_all_android_output_file_entry");
-	gchar *output_file = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+	if ( !android_export_job_cancelled( job ) ) android_export_job_run( job, queue->tools );
 
-	if ( !*output_file ) 
-	{
-		g_free(output_file);
-		SHOW_ERR(_("You must choose an output folder to save your APKs"));
-		return;
-	}
+	g_mutex_lock( queue->mutex );
+	g_queue_push_tail( queue->finished, job );
+	g_cond_signal( queue->cond );
+	g_mutex_unlock( queue->mutex );
+}
 
-	// get export all options
-	widget = ui_lookup_widget(ui_widgets.android_all_dialog, "export_all_android_keystore_password_entry");
-	gchar *keystore_password = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+// the jobs of an Export All, run by a thread pool from the export task
+typedef struct AndroidExportAll
+{
+	GPtrArray *jobs;
+	gint max_jobs;
+	GString *errors;
+	guint failed;
+} AndroidExportAll;
 
-	widget = ui_lookup_widget(ui_widgets.android_all_dialog, "export_all_android_version_number_entry");
-	gchar *version_number = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-	if ( !*version_number ) SETPTR( version_number, g_strdup("1.0.0") );
+static ExportTask *android_export_all_task = NULL;
 
-	widget = ui_lookup_widget(ui_widgets.android_all_dialog, "export_all_android_build_number_entry");
-	gchar* build_number = gtk_entry_get_text(GTK_ENTRY(widget));
-	if ( !*build_number ) SETPTR( build_number, g_strdup("1") );
-	
-	int i;
-	for ( i = 0; i < projects_array->len; i++ )
-	{
-		if ( !projects[i]->is_valid ) continue;
-		
-		GtkWidget *export_all_progress = ui_lookup_widget(ui_widgets.android_all_dialog, "export_all_android_progress");
-		gchar *text = g_strconcat( "Exporting: ", projects[i]->name, " - Google", NULL );
-		gtk_label_set_text( GTK_LABEL(export_all_progress), text );
-		g_free(text);
+static gboolean android_export_all_task_run( ExportTask *task, gpointer data )
+{
+	AndroidExportAll *all = data;
+	guint i;
 
-		while (gtk_events_pending()) gtk_main_iteration();
+	// the tool paths, icon cache and export templates are shared, each job has its own build folder
+	AndroidExportTools *tools = android_export_tools_new();
+	AndroidExportQueue queue;
+	queue.mutex = g_mutex_new();
+	queue.cond = g_cond_new();
+	queue.finished = g_queue_new();
+	queue.tools = tools;
 
-		// change current project
-		app->project = projects[i];
+	GThreadPool *pool = g_thread_pool_new( android_export_job_thread, &queue, all->max_jobs, FALSE, NULL );
 
-		// set up the android export dialog
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_app_name_entry");
-		gtk_entry_set_text( GTK_ENTRY(widget), FALLBACK(app->project->apk_settings.app_name, "") );
-		
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_package_name_entry");
-		gtk_entry_set_text( GTK_ENTRY(widget), FALLBACK(app->project->apk_settings.package_name, "") );
+	for ( i = 0; i < all->jobs->len; i++ )
+	{
+		AndroidExportJob *job = g_ptr_array_index( all->jobs, i );
+		job->cancel = &task->cancel;
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_app_icon_entry");
-		gtk_entry_set_text( GTK_ENTRY(widget), FALLBACK(app->project->apk_settings.app_icon_path, "") );
+		// settings errors are reported without starting the job
+		if ( android_export_job_check( job ) ) g_thread_pool_push( pool, job, NULL );
+		else
+		{
+			g_mutex_lock( queue.mutex );
+			g_queue_push_tail( queue.finished, job );
+			g_mutex_unlock( queue.mutex );
+		}
+	}
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_notif_icon_entry");
-		gtk_entry_set_text( GTK_ENTRY(widget), FALLBACK(app->project->apk_settings.notif_icon_path, "") );
+	// report each job as it finishes
+	guint done = 0;
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_ouya_icon_entry");
-		gtk_entry_set_text( GTK_ENTRY(widget), FALLBACK(app->project->apk_settings.ouya_icon_path, "") );
-
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_firebase_config_entry");
-		gtk_entry_set_text( GTK_ENTRY(widget), FALLBACK(app->project->apk_settings.firebase_config_path, "") );
-
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_orientation_combo");
-		gtk_combo_box_set_active( GTK_COMBO_BOX(widget), app->project->apk_settings.orientation );
-
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_arcore_combo");
-		gtk_combo_box_set_active( GTK_COMBO_BOX(widget), app->project->apk_settings.arcore );
-
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_sdk_combo");
-		int version = app->project->apk_settings.sdk_version - 1;
-		if ( version < 0 ) version = 0;
-		gtk_combo_box_set_active( GTK_COMBO_BOX(widget), version );
-								
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_url_scheme");
-		gtk_entry_set_text( GTK_ENTRY(widget), FALLBACK(app->project->apk_settings.url_scheme, "") );
+	g_mutex_lock( queue.mutex );
+	while ( done < all->jobs->len )
+	{
+		AndroidExportJob *job = g_queue_pop_head( queue.finished );
+		if ( !job )
+		{
+			g_cond_wait( queue.cond, queue.mutex );
+			continue;
+		}
+		g_mutex_unlock( queue.mutex );
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_deep_link");
-		gtk_entry_set_text( GTK_ENTRY(widget), FALLBACK(app->project->apk_settings.deep_link, "") );
+		gchar *phase = g_strconcat( job->name, " - ", android_store_names[job->app_type], NULL );
+		done++;
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_google_play_app_id");
-		gtk_entry_set_text( GTK_ENTRY(widget), FALLBACK(app->project->apk_settings.play_app_id, "") );
+		if ( job->error )
+		{
+			all->failed++;
+			g_string_append_printf( all->errors, "%s: %s\n", phase, job->error );
+			export_task_mark( task, phase, "%s", job->error );
+		}
+		else if ( job->unchanged ) export_task_mark( task, phase, "%s", _("unchanged") );
+		else export_task_mark( task, phase, NULL );
+		export_task_progress( task, phase, done, all->jobs->len );
+		g_free(phase);
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_admob_app_id");
-		gtk_entry_set_text( GTK_ENTRY(widget), FALLBACK(app->project->apk_settings.admob_app_id, "") );
+		g_mutex_lock( queue.mutex );
+	}
+	g_mutex_unlock( queue.mutex );
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_snapchat_client_id");
-		gtk_entry_set_text( GTK_ENTRY(widget), FALLBACK(app->project->apk_settings.snapchat_client_id, "") );
+	g_thread_pool_free( pool, FALSE, TRUE );
 
-		// permissions
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_external_storage");
-		int mode = (app->project->apk_settings.permission_flags & AGK_ANDROID_PERMISSION_WRITE) ? 1 : 0;
-		gtk_toggle_button_set_active( GTK_TOGGLE_BUTTON(widget), mode );
+	android_export_tools_free( tools );
+	g_queue_free( queue.finished );
+	g_cond_free( queue.cond );
+	g_mutex_free( queue.mutex );
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_location_fine");
-		mode = (app->project->apk_settings.permission_flags & AGK_ANDROID_PERMISSION_GPS) ? 1 : 0;
-		gtk_toggle_button_set_active( GTK_TOGGLE_BUTTON(widget), mode );
+	if ( all->failed ) export_task_error( task, _("%u of %u exports failed"), all->failed, all->jobs->len );
+	return all->failed == 0;
+}
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_location_coarse");
-		mode = (app->project->apk_settings.permission_flags & AGK_ANDROID_PERMISSION_LOCATION) ? 1 : 0;
-		gtk_toggle_button_set_active( GTK_TOGGLE_BUTTON(widget), mode );
+static void android_export_all_task_done( ExportTask *task, gboolean success, gpointer data )
+{
+	AndroidExportAll *all = data;
+	GtkWidget *export_all_progress = ui_lookup_widget(ui_widgets.android_all_dialog, "export_all_android_progress");
+	guint i;
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_internet");
-		mode = (app->project->apk_settings.permission_flags & AGK_ANDROID_PERMISSION_INTERNET) ? 1 : 0;
-		gtk_toggle_button_set_active( GTK_TOGGLE_BUTTON(widget), mode );
+	android_export_all_task = NULL;
+	gtk_widget_set_sensitive( ui_lookup_widget(ui_widgets.android_all_dialog, "html5_export2"), TRUE );
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_wake");
-		mode = (app->project->apk_settings.permission_flags & AGK_ANDROID_PERMISSION_WAKE) ? 1 : 0;
-		gtk_toggle_button_set_active( GTK_TOGGLE_BUTTON(widget), mode );
+	if ( !success )
+	{
+		gtk_label_set_text( GTK_LABEL(export_all_progress), task->error );
+		if ( all->errors->len ) SHOW_ERR1( _("Some APKs could not be exported:\n\n%s"), all->errors->str );
+	}
+	else
+	{
+		guint unchanged = 0;
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_billing");
-		mode = (app->project->apk_settings.permission_flags & AGK_ANDROID_PERMISSION_IAP) ? 1 : 0;
-		gtk_toggle_button_set_active( GTK_TOGGLE_BUTTON(widget), mode );
+		for ( i = 0; i < all->jobs->len; i++ )
+		{
+			AndroidExportJob *job = g_ptr_array_index( all->jobs, i );
+			if ( job->unchanged ) unchanged++;
+		}
+		if ( unchanged )
+			ui_set_statusbar( TRUE, _("%u of %u APKs were already up to date and were not exported again."), unchanged, all->jobs->len );
+		gtk_widget_hide( ui_widgets.android_all_dialog );
+	}
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_push_notifications");
-		mode = (app->project->apk_settings.permission_flags & AGK_ANDROID_PERMISSION_PUSH) ? 1 : 0;
-		gtk_toggle_button_set_active( GTK_TOGGLE_BUTTON(widget), mode );
+	g_string_free( all->errors, TRUE );
+	for ( i = 0; i < all->jobs->len; i++ )
+	{
+		AndroidExportJob *job = g_ptr_array_index( all->jobs, i );
+		export_project_release( job->base_path );
+		android_export_job_free( job );
+	}
+	g_ptr_array_free( all->jobs, TRUE );
+	g_free( all );
+}
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_camera");
-		mode = (app->project->apk_settings.permission_flags & AGK_ANDROID_PERMISSION_CAMERA) ? 1 : 0;
-		gtk_toggle_button_set_active( GTK_TOGGLE_BUTTON(widget), mode );
+void on_android_all_dialog_response(GtkDialog *dialog, gint response, gpointer user_data)
+{
+	// the dialog stays responsive during the export, closing it cancels the jobs that haven't finished
+	if ( android_export_all_task )
+	{
+		if ( response != 1 ) export_task_cancel( android_export_all_task );
+		return;
+	}
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_expansion");
-		mode = (app->project->apk_settings.permission_flags & AGK_ANDROID_PERMISSION_EXPANSION) ? 1 : 0;
-		gtk_toggle_button_set_active( GTK_TOGGLE_BUTTON(widget), mode );
-		
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_vibrate");
-		mode = (app->project->apk_settings.permission_flags & AGK_ANDROID_PERMISSION_VIBRATE) ? 1 : 0;
-		gtk_toggle_button_set_active( GTK_TOGGLE_BUTTON(widget), mode );
+	if ( response != 1 )
+	{
+		if ( dialog ) gtk_widget_hide(GTK_WIDGET(dialog));
+		return;
+	}
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_record_audio");
-		mode = (app->project->apk_settings.permission_flags & AGK_ANDROID_PERMISSION_RECORD_AUDIO) ? 1 : 0;
-		gtk_toggle_button_set_active( GTK_TOGGLE_BUTTON(widget), mode );
+	// export all output folder
+	GtkWidget *widget = ui_lookup_widget(ui_widgets.android_all_dialog, "export_all_android_output_file_entry");
+	gchar *output_file = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-		// signing
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_keystore_file_entry");
-		gtk_entry_set_text( GTK_ENTRY(widget), FALLBACK(app->project->apk_settings.keystore_path, "") );
+	if ( !*output_file ) 
+	{
+		g_free(output_file);
+		SHOW_ERR(_("You must choose an output folder to save your APKs"));
+		return;
+	}
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_keystore_password_entry");
-		gtk_entry_set_text( GTK_ENTRY(widget), keystore_password );
-		
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_version_number_entry");
-		gtk_entry_set_text( GTK_ENTRY(widget), version_number );
-		
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_build_number_entry");
-		gtk_entry_set_text( GTK_ENTRY(widget), build_number );
-				
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_alias_entry");
-		gtk_entry_set_text( GTK_ENTRY(widget), FALLBACK(app->project->apk_settings.alias, "") );
+	if ( !android_export_files_ready() )
+	{
+		g_free(output_file);
+		return;
+	}
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_alias_password_entry");
-		gtk_entry_set_text( GTK_ENTRY(widget), keystore_password );
+	guint i;
+	for ( i = 0; i < projects_array->len; i++ )
+	{
+		if ( projects[i]->is_valid && export_project_busy( projects[i]->base_path ) )
+		{
+			g_free(output_file);
+			SHOW_ERR1( _("Another export of the project %s is still running, wait for it to finish first"), projects[i]->name );
+			return;
+		}
+	}
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_output_type_combo");
-		gtk_combo_box_set_active( GTK_COMBO_BOX(widget), 0 ); // Google
-		
-		gchar *filename = g_strconcat( app->project->name, "-Google-", version_number, ".apk", NULL );
-		gchar* apk_path = g_build_filename( output_file, filename, NULL );
-		gtk_entry_set_text( GTK_ENTRY(ui_lookup_widget(ui_widgets.android_dialog, "android_output_file_entry")), apk_path );
-		g_free(apk_path);
-		g_free(filename);
+	AndroidExportAll *all = g_new0( AndroidExportAll, 1 );
+	all->errors = g_string_new( "" );
 
-		on_android_dialog_response( 0, 1, 1 ); // no dialog, export response, don't save settings
+	// get export all options
+	widget = ui_lookup_widget(ui_widgets.android_all_dialog, "export_all_android_keystore_password_entry");
+	gchar *keystore_password = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_output_type_combo");
-		gtk_combo_box_set_active( GTK_COMBO_BOX(widget), 1 ); // Amazon
+	widget = ui_lookup_widget(ui_widgets.android_all_dialog, "export_all_android_version_number_entry");
+	gchar *version_number = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+	if ( !*version_number ) SETPTR( version_number, g_strdup("1.0.0") );
 
-		filename = g_strconcat( app->project->name, "-Amazon-", version_number, ".apk", NULL );
-		apk_path = g_build_filename( output_file, filename, NULL );
-		gtk_entry_set_text( GTK_ENTRY(ui_lookup_widget(ui_widgets.android_dialog, "android_output_file_entry")), apk_path );
-		g_free(apk_path);
-		g_free(filename);
+	widget = ui_lookup_widget(ui_widgets.android_all_dialog, "export_all_android_build_number_entry");
+	int build_number = atoi(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-		text = g_strconcat( "Exporting: ", projects[i]->name, " - Amazon", NULL );
-		gtk_label_set_text( GTK_LABEL(export_all_progress), text );
-		g_free(text);
+	widget = ui_lookup_widget(ui_widgets.android_all_dialog, "export_all_android_jobs_spin");
+	all->max_jobs = gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(widget));
+	if ( all->max_jobs < 1 ) all->max_jobs = 1;
 
-		while (gtk_events_pending()) gtk_main_iteration();
+	// one job per project and store
+	all->jobs = g_ptr_array_new();
+	int app_type;
+	for ( i = 0; i < projects_array->len; i++ )
+	{
+		if ( !projects[i]->is_valid ) continue;
 
-		on_android_dialog_response( 0, 1, 1 ); // no dialog, export response, don't save settings
+		for ( app_type = 0; app_type < 2; app_type++ )
+		{
+			AndroidExportJob *job = android_export_job_from_project( projects[i], app_type, keystore_password, version_number, build_number, output_file );
+			export_project_claim( job->base_path );
+			g_ptr_array_add( all->jobs, job );
+		}
 	}
 
-	gtk_widget_hide(GTK_WIDGET(dialog));
+	g_free(output_file);
+	g_free(keystore_password);
+	g_free(version_number);
 
-	// reset current project and set future exports to reload normal settings
-	app->project = orig_project;
-	if ( last_proj_path_android ) g_free(last_proj_path_android);
-	last_proj_path_android = g_strdup( "" );
+	gtk_widget_set_sensitive( ui_lookup_widget(ui_widgets.android_all_dialog, "html5_export2"), FALSE );
+	android_export_all_task = export_task_start( "Android export all", android_export_all_task_run, android_export_all_task_done, all );
+	android_export_all_task->label = ui_lookup_widget(ui_widgets.android_all_dialog, "export_all_android_progress");
 }
 
 void project_export_apk_all()
@@ -3605,6 +4003,152 @@ void project_export_apk_all()
 	gtk_window_present(GTK_WINDOW(ui_widgets.android_all_dialog));
 }
 
+// what each file of an APK would cost, worked out without exporting
+typedef struct SizeReportJob
+{
+	gchar *base_path;
+	gchar *csv_file;
+	UtilsSizeReport *report;
+} SizeReportJob;
+
+static ExportTask *size_report_task = NULL;
+
+static gboolean size_report_progress( const gchar *archive_name, guint64 done, guint64 total, gpointer user_data )
+{
+	ExportTask *task = user_data;
+
+	export_task_progress( task, NULL, done, total );
+	return !export_task_cancelled( task );
+}
+
+static gboolean size_report_task_run( ExportTask *task, gpointer data )
+{
+	SizeReportJob *job = data;
+	AndroidExportTools *tools = android_export_tools_new();
+	GError *error = NULL;
+	gboolean success;
+	gchar *path;
+	int i;
+
+	// the same files and levels as the Google APK in android_export_job_run()
+	export_task_progress( task, "scan", 0, 0 );
+
+	path = g_build_path( "/", tools->android_folder, android_source_folders[0], "classes.dex", NULL );
+	utils_size_report_add_file( job->report, "classes.dex", path, 9 );
+	g_free( path );
+
+	for( i = 0; i < 2; i++ )
+	{
+		const gchar *abi = i ? "armeabi-v7a" : "arm64-v8a";
+		gchar *lib_name = g_strconcat( "lib/", abi, "/libandroid_player.so", NULL );
+
+		path = g_build_path( "/", tools->android_folder, "lib", abi, "libandroid_player.so", NULL );
+		if ( g_file_test( path, G_FILE_TEST_IS_REGULAR ) ) utils_size_report_add_file( job->report, lib_name, path, 9 );
+		g_free( path );
+		g_free( lib_name );
+	}
+
+	path = g_build_path( "/", tools->android_folder, "assets", NULL );
+	utils_size_report_add_folder( job->report, path, "assets", TRUE, TRUE );
+	g_free( path );
+
+	path = g_build_path( "/", job->base_path, "media", NULL );
+	utils_size_report_add_folder( job->report, path, "assets/media", TRUE, TRUE );
+	g_free( path );
+
+	android_export_tools_free( tools );
+	export_task_mark( task, "scan", "%u files", utils_size_report_get_count( job->report ) );
+
+	export_task_progress( task, "compress", 0, 0 );
+	success = utils_size_report_run( job->report, size_report_progress, task );
+	if ( !success ) return FALSE;
+	export_task_mark( task, "compress", NULL );
+
+	if ( !utils_size_report_write_csv( job->report, job->csv_file, &error ) )
+	{
+		export_task_error( task, _("Failed to write %s: %s"), job->csv_file, error->message );
+		g_error_free( error );
+		return FALSE;
+	}
+	export_task_mark( task, "csv", NULL );
+
+	return TRUE;
+}
+
+static void size_report_task_done( ExportTask *task, gboolean success, gpointer data )
+{
+	SizeReportJob *job = data;
+
+	size_report_task = NULL;
+
+	if ( success )
+	{
+		guint64 size = 0;
+		guint64 compressed = 0;
+		guint64 duplicated = 0;
+		guint count = utils_size_report_get_count( job->report );
+		guint i;
+
+		msgwin_sizes_start();
+		for( i = 0; i < count; i++ )
+		{
+			const UtilsSizeEntry *entry = utils_size_report_get_entry( job->report, i );
+
+			if ( entry->failed ) continue;
+
+			msgwin_sizes_add( entry->archive_name, entry->size, entry->compressed_size,
+				entry->duplicate_of ? entry->duplicate_of->archive_name : NULL );
+			size += entry->size;
+			compressed += entry->compressed_size;
+			if ( entry->duplicate_of ) duplicated += entry->compressed_size;
+		}
+		msgwin_sizes_finish();
+		msgwin_switch_tab( MSG_SIZES, TRUE );
+
+		{
+			gchar *size_str = utils_make_human_readable_str( size, 1, 0 );
+			gchar *compressed_str = utils_make_human_readable_str( compressed, 1, 0 );
+			gchar *duplicated_str = utils_make_human_readable_str( duplicated, 1, 0 );
+
+			msgwin_status_add( _("Export size: %s compressed to %s, %s of it in duplicate files, report saved to %s"),
+				size_str, compressed_str, duplicated_str, job->csv_file );
+			g_free( size_str );
+			g_free( compressed_str );
+			g_free( duplicated_str );
+		}
+	}
+	else if ( !export_task_cancelled( task ) ) SHOW_ERR1( "%s", task->error );
+
+	utils_size_report_free( job->report );
+	g_free( job->base_path );
+	g_free( job->csv_file );
+	g_free( job );
+}
+
+// compresses the project's media and the Android player the way an APK export would and lists
+// where the bytes go in the Export Size tab, also saved as a CSV file in the project folder
+void project_export_size_report( void )
+{
+	SizeReportJob *job;
+
+	if ( !app->project )
+	{
+		SHOW_ERR( _("You must have a project open to analyze its export size") );
+		return;
+	}
+
+	if ( size_report_task ) return;
+	if ( !android_export_files_ready() ) return;
+
+	job = g_new0( SizeReportJob, 1 );
+	job->base_path = g_strdup( app->project->base_path );
+	job->csv_file = g_build_filename( app->project->base_path, "export_size_report.csv", NULL );
+	job->report = utils_size_report_new();
+	utils_size_report_set_levels( job->report, app->project->apk_settings.compression );
+
+	size_report_task = export_task_start( "Export size report", size_report_task_run, size_report_task_done, job );
+}
+
 static void on_keystore_dialog_response(GtkDialog *dialog, gint response, gpointer user_data)
 {
 	static int running = 0;
@@ -3886,41 +4430,6 @@ void project_generate_keystore()
 	gtk_window_present(GTK_WINDOW(ui_widgets.keystore_dialog));
 }
 
-static int ios_convert_to_cgbi_png( const char* oldfilename, const char* newfilename )
-{
-	gint status = 0;
-	GError *error = NULL;
-
-	gchar** argv = g_new0( gchar*, 8 );
-	argv[0] = g_strdup( "/usr/bin/xcrun" );
-	argv[1] = g_strdup("-sdk");
-	argv[2] = g_strdup("iphoneos");
-	argv[3] = g_strdup("pngcrush");
-	argv[4] = g_strdup("-iphone");
-	argv[5] = g_strdup(oldfilename);
-	argv[6] = g_strdup(newfilename);
-	argv[7] = NULL;
-
-	if ( !utils_spawn_sync( "/", argv, NULL, 0, NULL, NULL, NULL, NULL, &status, &error) )
-	{
-		SHOW_ERR1( _("Failed to run \"pngcrush\" program: %s"), error->message );
-		g_error_free(error);
-		error = NULL;
-		g_strfreev(argv);
-		return 0;
-	}
-		
-	if ( !g_file_test (newfilename, G_FILE_TEST_EXISTS) )
-	{
-		SHOW_ERR1( _("Failed to convert png file \"%s\" to Apple's CgBI format"), newfilename );
-		g_strfreev(argv);
-		return 0;
-	}
-
-	g_strfreev(argv);
-	return 1;
-}
-
 static int hextoint( unsigned char letter )
 {
 	if ( letter >= 48 && letter <= 57 ) return letter - 48;
@@ -3929,1616 +4438,1653 @@ static int hextoint( unsigned char letter )
 	return 0;
 }
 
-static void on_ios_dialog_response(GtkDialog *dialog, gint response, gpointer user_data)
+// everything an IPA export needs, read up front so the export itself doesn't touch any widgets
+typedef struct IosExportJob
 {
-	static int running = 0;
-	if ( running ) return;
-
-	running = 1;
-
-	if ( app->project && !ios_exporting_player )
-	{
-		GtkWidget *widget; 
+	gchar *app_name;
+	gchar *profile;
+	gchar *app_icon;
+	gchar *firebase_config;
+	gchar *app_splash_logo;
+	gchar *app_splash_color;
+	gchar *url_scheme;
+	gchar *deep_link;
+	gchar *admob_app_id;
+	gchar *snapchat_client_id;
+	gchar *version_number;
+	gchar *build_number;
+	gchar *output_file;
+	gchar *base_path; // build_tmp is created here
+	gchar *media_folder; // NULL when exporting the player
+	int orientation;
+	int device_type;
+	int uses_ads;
+	gboolean unchanged; // set by the export if the IPA was already up to date
+} IosExportJob;
+
+// the export started from the iOS dialog, NULL when it isn't exporting
+static ExportTask *ios_export_task = NULL;
+
+static void ios_export_job_free( IosExportJob *job )
+{
+	g_free( job->app_name );
+	g_free( job->profile );
+	g_free( job->app_icon );
+	g_free( job->firebase_config );
+	g_free( job->app_splash_logo );
+	g_free( job->app_splash_color );
+	g_free( job->url_scheme );
+	g_free( job->deep_link );
+	g_free( job->admob_app_id );
+	g_free( job->snapchat_client_id );
+	g_free( job->version_number );
+	g_free( job->build_number );
+	g_free( job->output_file );
+	g_free( job->base_path );
+	g_free( job->media_folder );
+	g_free( job );
+}
 
-		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_app_name_entry");
-		AGK_CLEAR_STR(app->project->ipa_settings.app_name) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-		
-		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_provisioning_entry");
-		AGK_CLEAR_STR(app->project->ipa_settings.prov_profile_path) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+static gboolean ios_export_task_run( ExportTask *task, gpointer data )
+{
+	IosExportJob *job = data;
+	gboolean success = FALSE;
+	int i;
 
-		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_app_icon_entry");
-		AGK_CLEAR_STR(app->project->ipa_settings.app_icon_path) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+	// the export steps below use these names, deep_link is cut down in place
+	gchar *app_name = job->app_name;
+	gchar *profile = job->profile;
+	gchar *app_icon = job->app_icon;
+	gchar *firebase_config = job->firebase_config;
+	gchar *app_splash_logo = job->app_splash_logo;
+	gchar *app_splash_color = job->app_splash_color;
+	gchar *url_scheme = job->url_scheme;
+	gchar *deep_link = job->deep_link;
+	gchar *admob_app_id = job->admob_app_id;
+	gchar *snapchat_client_id = job->snapchat_client_id;
+	gchar *version_number = job->version_number;
+	gchar *build_number = job->build_number;
+	gchar *output_file = job->output_file;
+	int orientation = job->orientation;
+	int device_type = job->device_type;
+	int uses_ads = job->uses_ads;
+
+	const gchar* path_to_codesign = "/usr/bin/codesign";
+	const gchar* path_to_security = "/usr/bin/security";
+	const gchar* path_to_actool = "/Applications/XCode.app/Contents/Developer/usr/bin/actool";
+	const gchar* path_to_ibtool = "/Applications/XCode.app/Contents/Developer/usr/bin/ibtool";
+
+	// make temporary folder
+	gchar* ios_folder = g_build_filename( app->datadir, "ios", NULL );
+	gchar* tmp_folder = g_build_filename( job->base_path, "build_tmp", NULL );
 
-		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_firebase_config_entry");
-		AGK_CLEAR_STR(app->project->ipa_settings.firebase_config_path) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+        gchar* app_folder = g_build_filename( tmp_folder, app_name, NULL );
+	SETPTR(app_folder, g_strconcat( app_folder, ".app", NULL ));
 
-		// splash screens
-		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_app_splash_entry");
-		AGK_CLEAR_STR(app->project->ipa_settings.splash_logo) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+	gchar* app_folder_name = g_strdup( app_name );
+	SETPTR(app_folder_name, g_strconcat( app_folder_name, ".app", NULL ));
 
-		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_app_splash_entry2");
-		AGK_CLEAR_STR(app->project->ipa_settings.splash_color) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+	utils_str_replace_char( ios_folder, '\\', '/' );
+	utils_str_replace_char( tmp_folder, '\\', '/' );
+	
+	gchar* src_folder = g_build_path( "/", app->datadir, "ios", "source", "AppGameKit Player.app", NULL );
+	utils_str_replace_char( src_folder, '\\', '/' );
+
+	gchar* no_ads_binary = g_build_path( "/", app->datadir, "ios", "source", "AppGameKit Player No Ads", NULL );
+	utils_str_replace_char( no_ads_binary, '\\', '/' );
+
+	gchar* icons_src_folder = g_build_path( "/", app->datadir, "ios", "source", "Icons.xcassets", NULL );
+	utils_str_replace_char( icons_src_folder, '\\', '/' );
+
+	gchar* icons_dst_folder = g_build_path( "/", tmp_folder, "Icons.xcassets", NULL );
+	utils_str_replace_char( icons_dst_folder, '\\', '/' );
+
+	gchar* icons_sub_folder = g_build_path( "/", tmp_folder, "Icons.xcassets", "AppIcon.appiconset", NULL );
+	utils_str_replace_char( icons_sub_folder, '\\', '/' );
+
+	gchar *output_file_zip = g_strdup( output_file );
+	gchar *ext = strrchr( output_file_zip, '.' );
+	if ( ext ) *ext = 0;
+	SETPTR( output_file_zip, g_strconcat( output_file_zip, ".zip", NULL ) );
+
+	// decalrations
+	gchar newcontents[ 32000 ];
+	gchar *contents = NULL;
+	gsize length = 0;
+	gchar *certificate_data = NULL;
+	gchar *bundle_id = NULL;
+	gchar *app_group_data = 0;
+	gchar *team_id = NULL;
+	gchar *cert_hash = NULL;
+	gchar *cert_temp = NULL;
+	gchar **argv = NULL;
+	gchar *str_out = NULL;
+	gint status = 0;
+	GError *error = NULL;
+	gchar *entitlements_file = NULL;
+	gchar *expanded_entitlements_file = NULL;
+	gchar *temp_filename1 = NULL;
+	gchar *temp_filename2 = NULL;
+	gchar *version_string = NULL;
+	gchar *build_string = NULL;
+	gchar *bundle_id2 = NULL; // don't free, pointer to sub string
+	gchar *image_filename = NULL;
+	UtilsIconSet *icon_set = NULL;
+	GdkPixbuf *splash_image = NULL;
+	gchar *user_name = NULL;
+	gchar *group_name = NULL;
+	UtilsFingerprint *fingerprint = NULL;
+	gchar *changes = NULL;
+	mz_zip_archive zip_archive;
+	memset(&zip_archive, 0, sizeof(zip_archive));
+
+	// nothing to do if the IPA was made from exactly these inputs, the profile stands in for the certificate
+	export_task_progress( task, "fingerprint", 0, 0 );
+	fingerprint = export_fingerprint_new( output_file );
+	utils_fingerprint_add_string( fingerprint, "setting/app_name", app_name );
+	utils_fingerprint_add_string( fingerprint, "setting/app_splash_color", app_splash_color );
+	utils_fingerprint_add_string( fingerprint, "setting/url_scheme", url_scheme );
+	utils_fingerprint_add_string( fingerprint, "setting/deep_link", deep_link );
+	utils_fingerprint_add_string( fingerprint, "setting/admob_app_id", admob_app_id );
+	utils_fingerprint_add_string( fingerprint, "setting/snapchat_client_id", snapchat_client_id );
+	utils_fingerprint_add_string( fingerprint, "setting/version_number", version_number );
+	utils_fingerprint_add_string( fingerprint, "setting/build_number", build_number );
+	utils_fingerprint_add_int( fingerprint, "setting/orientation", orientation );
+	utils_fingerprint_add_int( fingerprint, "setting/device_type", device_type );
+	utils_fingerprint_add_int( fingerprint, "setting/uses_ads", uses_ads );
+	utils_fingerprint_add_file( fingerprint, "file/profile", profile );
+	utils_fingerprint_add_file( fingerprint, "file/app_icon", app_icon );
+	utils_fingerprint_add_file( fingerprint, "file/firebase_config", firebase_config );
+	utils_fingerprint_add_file( fingerprint, "file/app_splash_logo", app_splash_logo );
+	utils_fingerprint_add_folder( fingerprint, "template", ios_folder );
+	utils_fingerprint_add_folder( fingerprint, "media", job->media_folder );
+	utils_fingerprint_add_stamp( fingerprint, "tool/codesign", path_to_codesign );
+	utils_fingerprint_add_stamp( fingerprint, "tool/security", path_to_security );
+	utils_fingerprint_add_stamp( fingerprint, "tool/actool", path_to_actool );
+	utils_fingerprint_add_stamp( fingerprint, "tool/ibtool", path_to_ibtool );
+	if ( utils_fingerprint_matches( fingerprint ) )
+	{
+		export_task_mark( task, "fingerprint", "%s", _("unchanged") );
+		job->unchanged = TRUE;
+		success = TRUE;
+		goto ios_dialog_cleanup2;
+	}
+	changes = export_fingerprint_describe( fingerprint );
+	export_task_mark( task, "fingerprint", "%s", changes );
+	if ( export_task_cancelled( task ) ) goto ios_dialog_cleanup2;
 
-		//widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_facebook_id_entry");
-		//AGK_CLEAR_STR(app->project->ipa_settings.facebook_id) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+	export_task_progress( task, "copy", 0, 0 );
+	if ( !utils_copy_folder_full( src_folder, app_folder, TRUE, export_folder_progress, task, &str_out ) )
+	{
+		export_task_error( task, _("Failed to copy source folder: %s"), str_out );
+		goto ios_dialog_cleanup2;
+	}
+	export_task_mark( task, "copy", NULL );
+	if ( export_task_cancelled( task ) ) goto ios_dialog_cleanup2;
+	export_task_progress( task, "profile", 0, 0 );
 
-		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_url_scheme_entry");
-		AGK_CLEAR_STR(app->project->ipa_settings.url_scheme) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+	if ( !uses_ads )
+	{
+		gchar *binary_path = g_build_filename( app_folder, "AppGameKit Player", NULL );
+		utils_copy_file( no_ads_binary, binary_path, TRUE, NULL );
+		g_free( binary_path );
+	}
+	
+	// rename executable, the working directory is shared with the editor and the other exports so it isn't changed
+	{
+		gchar *binary_path = g_build_filename( app_folder, "AppGameKit Player", NULL );
+		gchar *renamed_path = g_build_filename( app_folder, app_name, NULL );
+		gint rename_error = g_rename( binary_path, renamed_path ) != 0 ? errno : 0;
 
-		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_deep_link_entry");
-		AGK_CLEAR_STR(app->project->ipa_settings.deep_link) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-
-		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_admob_app_id_entry");
-		AGK_CLEAR_STR(app->project->ipa_settings.admob_app_id) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-
-		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_snapchat_client_id_entry");
-		AGK_CLEAR_STR(app->project->ipa_settings.snapchat_client_id) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-
-		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_orientation_combo");
-		app->project->ipa_settings.orientation = gtk_combo_box_get_active(GTK_COMBO_BOX_TEXT(widget));
-				
-		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_version_number_entry");
-		AGK_CLEAR_STR(app->project->ipa_settings.version_number) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-		
-		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_build_number_entry");
-		AGK_CLEAR_STR(app->project->ipa_settings.build_number) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-
-		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_device_combo");
-		app->project->ipa_settings.device_type = gtk_combo_box_get_active(GTK_COMBO_BOX_TEXT(widget));
-		
-		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_app_uses_ads");
-		app->project->ipa_settings.uses_ads = gtk_toggle_button_get_active( GTK_TOGGLE_BUTTON(widget) );
-
-		// output
-		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_output_file_entry");
-		app->project->ipa_settings.output_path = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+		g_free( binary_path );
+		g_free( renamed_path );
+		if ( rename_error )
+		{
+			export_task_error( task, _("Failed to rename the player executable (%s)"), g_strerror( rename_error ) );
+			goto ios_dialog_cleanup2;
+		}
 	}
-
-	if ( response != 1 )
+	
+	// open provisioning profile and extract certificate
+	if ( !g_file_get_contents( profile, &contents, &length, NULL ) )
 	{
-		gtk_widget_hide(GTK_WIDGET(dialog));
+		export_task_error( task, _("Failed to read provisioning profile") );
+		goto ios_dialog_cleanup2;
 	}
-	else
-	{
-		int i;
-		GtkWidget *widget;
-
-		gtk_widget_set_sensitive( ui_lookup_widget(ui_widgets.ios_dialog, "ios_export1"), FALSE );
-		gtk_widget_set_sensitive( ui_lookup_widget(ui_widgets.ios_dialog, "button6"), FALSE );
-		
-		while (gtk_events_pending())
-			gtk_main_iteration();
-
-		// app details
-		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_app_name_entry");
-		gchar *app_name = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-		
-		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_provisioning_entry");
-		gchar *profile = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-
-		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_app_icon_entry");
-		gchar *app_icon = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-
-		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_firebase_config_entry");
-		gchar *firebase_config = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-		// splash screens
-		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_app_splash_entry");
-		gchar *app_splash_logo = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-
-		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_app_splash_entry2");
-		gchar *app_splash_color = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-
-		//widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_facebook_id_entry");
-		//gchar *facebook_id = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-
-		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_url_scheme_entry");
-		gchar *url_scheme = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-
-		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_deep_link_entry");
-		gchar *deep_link = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-
-		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_admob_app_id_entry");
-		gchar *admob_app_id = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+        // provisioning profile starts as binary, so skip 100 bytes to get to text
+	gchar* certificate = strstr( contents+100, "<key>DeveloperCertificates</key>" );
+	if ( !certificate )
+	{
+		export_task_error( task, _("Failed to read certificate from provisioning profile") );
+		goto ios_dialog_cleanup2;
+	}
 
-		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_snapchat_client_id_entry");
-		gchar *snapchat_client_id = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+	certificate = strstr( certificate, "<data>" );
+	if ( !certificate )
+	{
+		export_task_error( task, _("Failed to read certificate data from provisioning profile") );
+		goto ios_dialog_cleanup2;
+	}
 
-		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_orientation_combo");
-		int orientation = gtk_combo_box_get_active(GTK_COMBO_BOX_TEXT(widget));
-				
-		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_version_number_entry");
-		gchar *version_number = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-		if ( !*version_number ) SETPTR( version_number, g_strdup("1.0.0") );
+	certificate += strlen("<data>");
+	gchar* certificate_end = strstr( certificate, "</data>" );
+	if ( !certificate_end )
+	{
+		export_task_error( task, _("Failed to read certificate end data from provisioning profile") );
+		goto ios_dialog_cleanup2;
+	}
 
-		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_build_number_entry");
-		gchar *build_number = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-		if ( !*build_number ) SETPTR( build_number, g_strdup("1.0") );
+        // copy certificate into local storage
+	gint cert_length = (gint) (certificate_end - certificate);
+	certificate_data = g_new0( gchar, cert_length+1 );
+	strncpy( certificate_data, certificate, cert_length );
+	certificate_data[ cert_length ] = 0;
 
-		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_device_combo");
-		int device_type = gtk_combo_box_get_active(GTK_COMBO_BOX_TEXT(widget));;
+	utils_str_remove_chars( certificate_data, "\n\r" );
+        
+	// extract bundle ID, reuse variables
+	certificate = strstr( contents+100, "<key>application-identifier</key>" );
+	if ( !certificate )
+	{
+		export_task_error( task, _("Failed to read bundle ID from provisioning profile") );
+		goto ios_dialog_cleanup2;
+	}
 
-		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_app_uses_ads");
-		int uses_ads = gtk_toggle_button_get_active( GTK_TOGGLE_BUTTON(widget) );
+	certificate = strstr( certificate, "<string>" );
+	if ( !certificate )
+	{
+		export_task_error( task, _("Failed to read bundle ID data from provisioning profile") );
+		goto ios_dialog_cleanup2;
+	}
 
-		// output
-		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_output_file_entry");
-		gchar *output_file = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+	certificate += strlen("<string>");
+	certificate_end = strstr( certificate, "</string>" );
+	if ( !certificate_end )
+	{
+		export_task_error( task, _("Failed to read bundle ID end data from provisioning profile") );
+		goto ios_dialog_cleanup2;
+	}
+	
+        // copy bundle ID to local storage
+	cert_length = (gint) (certificate_end - certificate);
+	bundle_id = g_new0( gchar, cert_length+1 );
+	strncpy( bundle_id, certificate, cert_length );
+	bundle_id[ cert_length ] = 0;
+        
+        // look for beta entitlement
+        int betaReports = 0;
+        if ( strstr(contents+100, "<key>beta-reports-active</key>") != 0 )
+        {
+            betaReports = 1;
+        }
+        
+        // look for push notification entitlement
+        int pushNotifications = 0;
+        gchar* pushStr = strstr(contents+100, "<key>aps-environment</key>");
+        if ( pushStr != 0 )
+        {
+            gchar* pushType = strstr( pushStr, "<string>" );
+            if ( strncmp( pushType, "<string>development</string>", strlen("<string>development</string>") ) == 0 )
+                pushNotifications = 1;
+            else 
+                pushNotifications = 2;
+        }
 
-		gchar *percent = 0;
-		while ( (percent = strchr(output_file, '%')) != 0 )
+	// look for app groups
+	certificate = strstr( contents+100, "<key>com.apple.security.application-groups</key>" );
+	if ( certificate )
+	{
+		certificate = strstr( certificate, "<array>" );
+		if ( !certificate )
 		{
-			if ( strncmp( percent+1, "[version]", strlen("[version]") ) == 0 )
-			{
-				*percent = 0;
-				percent += strlen("[version]") + 1;
-				gchar *new_output = g_strconcat( output_file, build_number, percent, NULL );
-				g_free(output_file);
-				output_file = new_output;
-				continue;
-			}
+			export_task_error( task, _("Failed to read App Group data from provisioning profile") );
+			goto ios_dialog_cleanup2;
+		}
 
-			break;
+		app_group_data = strstr( certificate, "</array>" );
+		if ( !app_group_data )
+		{
+			export_task_error( task, _("Failed to read App Group end data from provisioning profile") );
+			goto ios_dialog_cleanup2;
 		}
 
+		// quick hack to prevent next search going beyond the array list
+		*app_group_data = 0;
 
-		// START CHECKS
+		// check there is at least one string
+		certificate_end = strstr( certificate, "<string>" );
 
-		if ( !output_file || !*output_file ) { SHOW_ERR(_("You must choose an output location to save your IPA")); goto ios_dialog_clean_up; }
-		if ( strchr(output_file, '.') == 0 ) { SHOW_ERR(_("The output location must be a file not a directory")); goto ios_dialog_clean_up; }
+		// repair the string
+		*app_group_data = '<'; 
+		app_group_data = 0;
 
-		// check app name
-		if ( !app_name || !*app_name ) { SHOW_ERR(_("You must enter an app name")); goto ios_dialog_clean_up; }
-		if ( strlen(app_name) > 30 ) { SHOW_ERR(_("App name must be less than 30 characters")); goto ios_dialog_clean_up; }
-		for( i = 0; i < strlen(app_name); i++ )
+		if ( certificate_end )
 		{
-			/*
-			if ( (app_name[i] < 97 || app_name[i] > 122)
-			  && (app_name[i] < 65 || app_name[i] > 90) 
-			  && (app_name[i] < 48 || app_name[i] > 57) 
-			  && app_name[i] != 32 
-			  && app_name[i] != 95 ) 
-			{ 
-				SHOW_ERR(_("App name contains invalid characters, must be A-Z 0-9 spaces and undersore only")); 
-				goto ios_dialog_clean_up; 
-			}
-			*/
-			//switch to black list
-			if ( app_name[i] == 34 || app_name[i] == 60 
-			  || app_name[i] == 62 || app_name[i] == 39
-			  || app_name[i] == 42 || app_name[i] == 46
-			  || app_name[i] == 47 || app_name[i] == 92
-			  || app_name[i] == 58 || app_name[i] == 59
-			  || app_name[i] == 124 || app_name[i] == 61
-			  || app_name[i] == 44 || app_name[i] == 38 )
+			// find the end of the list
+			certificate_end = strstr( certificate, "</array>" );
+			if ( !certificate_end )
 			{
-				SHOW_ERR(_("App name contains invalid characters, it must not contain quotes or any of the following < > * . / \\ : ; | = , &"));
-				goto ios_dialog_clean_up; 
+				export_task_error( task, _("Failed to read App Group end data from provisioning profile") );
+				goto ios_dialog_cleanup2;
 			}
-		}
-		
-		// check icon
-		//if ( !app_icon || !*app_icon ) { SHOW_ERR(_("You must select an app icon")); goto ios_dialog_clean_up; }
-		if ( app_icon && *app_icon )
-		{
-			if ( !strrchr( app_icon, '.' ) || utils_str_casecmp( strrchr( app_icon, '.' ), ".png" ) != 0 ) { SHOW_ERR(_("App icon must be a PNG file")); goto ios_dialog_clean_up; }
-			if ( !g_file_test( app_icon, G_FILE_TEST_EXISTS ) ) { SHOW_ERR(_("Could not find app icon location")); goto ios_dialog_clean_up; }
-		}
 
-		if ( firebase_config && *firebase_config )
-		{
-			if ( !strrchr( firebase_config, '.' ) || utils_str_casecmp( strrchr( firebase_config, '.' ), ".plist" ) != 0 ) { SHOW_ERR(_("Firebase config file must be a .plist file")); goto ios_dialog_clean_up; }
-			if ( !g_file_test( firebase_config, G_FILE_TEST_EXISTS ) ) { SHOW_ERR(_("Could not find Firebase config file")); goto ios_dialog_clean_up; }
+			certificate_end += strlen( "</array>" );
+			
+			// copy App Group strings to local storage
+			cert_length = (gint) (certificate_end - certificate);
+			app_group_data = g_new0( gchar, cert_length+1 );
+			strncpy( app_group_data, certificate, cert_length );
+			app_group_data[ cert_length ] = 0;
 		}
+	}
 
-		// check splash screen logo
-		if ( app_splash_logo && *app_splash_logo )
+	// look for cloud kit
+	int cloudKit = 0;
+        if ( strstr(contents+100, "<key>com.apple.developer.ubiquity-kvstore-identifier</key>") != 0 )
+        {
+            cloudKit = 1;
+        }
+	
+	// extract team ID, reuse variables
+	certificate = strstr( contents+100, "<key>com.apple.developer.team-identifier</key>" );
+	if ( !certificate )
+	{
+		certificate = strstr( contents+100, "<key>TeamIdentifier</key>" );
+		if ( !certificate )
 		{
-			if ( !strrchr( app_splash_logo, '.' ) || utils_str_casecmp( strrchr( app_splash_logo, '.' ), ".png" ) != 0 ) { SHOW_ERR(_("Splash Screen Logo must be a PNG file")); goto ios_dialog_clean_up; }
-			if ( !g_file_test( app_splash_logo, G_FILE_TEST_EXISTS ) ) { SHOW_ERR(_("Could not find Splash Screen Logo location")); goto ios_dialog_clean_up; }
+			export_task_error( task, _("Failed to read team ID from provisioning profile") );
+			goto ios_dialog_cleanup2;
 		}
+	}
 
-		// check splash screen color
-		if ( app_splash_color && *app_splash_color )
-		{
-			if ( strlen( app_splash_color ) != 6 ) { SHOW_ERR(_("Splash Screen Color must be a 6 digit hex value, e.g. E86C2B")); goto ios_dialog_clean_up; }
-			int i;
-			for( i = 0; i < strlen(app_splash_color); i++ )
-			{
-				if ( app_splash_color[i] >= 97 && app_splash_color[i] <= 102 ) app_splash_color[i] -= 32; // change to upper case
-				if ( (app_splash_color[i] < 48 || app_splash_color[i] > 57) && (app_splash_color[i] < 65 || app_splash_color[i] > 70) ) 
-				{ 
-					SHOW_ERR(_("Splash Screen Color must be a 6 digit hex value, e.g. E86C2B")); 
-					goto ios_dialog_clean_up; 
-				}
-			}
-		}
+	certificate = strstr( certificate, "<string>" );
+	if ( !certificate )
+	{
+		export_task_error( task, _("Failed to read team ID data from provisioning profile") );
+		goto ios_dialog_cleanup2;
+	}
 
-		// check profile
-		if ( !profile || !*profile ) { SHOW_ERR(_("You must select a provisioning profile")); goto ios_dialog_clean_up; }
-		if ( !strrchr( profile, '.' ) || utils_str_casecmp( strrchr( profile, '.' ), ".mobileprovision" ) != 0 ) { SHOW_ERR(_("Provisioning profile must have .mobileprovision extension")); goto ios_dialog_clean_up; }
-		if ( !g_file_test( profile, G_FILE_TEST_EXISTS ) ) { SHOW_ERR(_("Could not find provisioning profile location")); goto ios_dialog_clean_up; }
+	certificate += strlen("<string>");
+	certificate_end = strstr( certificate, "</string>" );
+	if ( !certificate_end )
+	{
+		export_task_error( task, _("Failed to read team ID end data from provisioning profile") );
+		goto ios_dialog_cleanup2;
+	}
+	
+        // copy team ID to local storage
+	cert_length = (gint) (certificate_end - certificate);
+	team_id = g_new0( gchar, cert_length+1 );
+	strncpy( team_id, certificate, cert_length );
+	team_id[ cert_length ] = 0;
+	
+	if ( strncmp( team_id, bundle_id, strlen(team_id) ) == 0 )
+	{
+		// remove team ID
+		bundle_id2 = strchr( bundle_id, '.' );
+		if ( bundle_id2 ) bundle_id2++;
+		else bundle_id2 = bundle_id;
+	}
+	else
+	{
+		bundle_id2 = bundle_id;
+	}
 
-		// check version
-		if ( !version_number || !*version_number ) { SHOW_ERR(_("You must enter a version number, e.g. 1.0.0")); goto ios_dialog_clean_up; }
-		for( i = 0; i < strlen(version_number); i++ )
-		{
-			if ( (version_number[i] < 48 || version_number[i] > 57) && version_number[i] != 46 ) 
-			{ 
-				SHOW_ERR(_("Version number contains invalid characters, must be 0-9 and . only")); 
-				goto ios_dialog_clean_up; 
-			}
-		}
+	// find all certificates, the identity is just the hash of the certificate
+	argv = g_new0( gchar*, 8 );
+	argv[0] = g_strdup( path_to_security );
+	argv[1] = g_strdup("find-certificate");
+	argv[2] = g_strdup("-a");
+	// certificate not guaranteed to have "iPhone" in the name
+	argv[3] = g_strdup("-p"); // use PEM format, same as provisioning profile
+	argv[4] = g_strdup("-Z"); // display hash
+	argv[5] = NULL;
+
+	if ( !utils_spawn_sync( tmp_folder, argv, NULL, 0, NULL, NULL, &str_out, NULL, &status, &error) )
+	{
+		export_task_error( task, _("Failed to run \"security\" program: %s"), error->message );
+		g_error_free(error);
+		error = NULL;
+		goto ios_dialog_cleanup2;
+	}
 
-		// check facebook id
-		/*
-		if ( facebook_id && *facebook_id )
-		{
-			for( i = 0; i < strlen(facebook_id); i++ )
-			{
-				if ( (facebook_id[i] < 48 || facebook_id[i] > 57) ) 
-				{ 
-					SHOW_ERR(_("Facebook App ID must be numbers only")); 
-					goto ios_dialog_clean_up; 
-				}
-			}
-		}
-		*/
+	g_strfreev(argv);
+	argv = 0;
+	
+	if ( status != 0 && strstr(str_out,"SHA-1") == 0 )
+	{
+		if ( str_out && *str_out ) export_task_error( task, _("Failed to get code signing identities (error %d: %s)"), status, str_out );
+		else export_task_error( task, _("Failed to get code signing identities (error: %d)"), status );
+		goto ios_dialog_cleanup2;
+	}
 
-		if ( url_scheme && *url_scheme )
+        // cycle through each certificate looking for one that matches provisioning profile
+	gchar *sha = strstr( str_out, "SHA-1 hash: " );
+	while ( sha )
+	{
+		sha += strlen( "SHA-1 hash: " );
+		gchar *sha_end = strchr( sha, '\n' );
+		if ( !sha_end )
 		{
-			if ( strchr(url_scheme, ':') || strchr(url_scheme, '/') )
-			{
-				SHOW_ERR(_("URL scheme must not contain : or /"));
-				goto ios_dialog_clean_up; 
-			}
+			export_task_error( task, _("Failed to read code signing identity from certificate list") );
+			goto ios_dialog_cleanup2;
 		}
 
-		if ( deep_link && *deep_link )
-		{
-			if ( strchr( deep_link, '.' ) == 0 )
-			{
-				SHOW_ERR(_("Universal link must be a domain, e.g. www.appgamekit.com"));
-				goto ios_dialog_clean_up; 
-			}
-		}
+		gint length = (gint) (sha_end - sha);
 
-		if ( admob_app_id && *admob_app_id )
+            // save hash for later, if this is the correct certificate then this will be the codesigning identity
+		if ( cert_hash ) g_free(cert_hash);
+		cert_hash = g_new0( gchar, length+1 );
+		strncpy( cert_hash, sha, length );
+		cert_hash[ length ] = 0;
+
+		sha = sha_end + 1;
+		sha = strstr( sha, "-----BEGIN CERTIFICATE-----" );
+		if ( !sha )
 		{
-			if ( strchr( admob_app_id, '~' ) == 0 )
-			{
-				SHOW_ERR(_("AdMob App ID must include a ~ character, for example \"ca-app-pub-3940256099942544~1458002511\""));
-				goto ios_dialog_clean_up; 
-			}
+			export_task_error( task, _("Failed to read certificate data from certificate list") );
+			goto ios_dialog_cleanup2;
 		}
 
-		if ( !g_file_test( "/Applications/XCode.app/Contents/Developer/usr/bin/actool", G_FILE_TEST_EXISTS ) )
+		sha += strlen( "-----BEGIN CERTIFICATE-----" ) + 1;
+		sha_end = strstr( sha, "-----END CERTIFICATE-----" );
+		if ( !sha_end )
 		{
-			SHOW_ERR(_("You must install XCode to export iOS apps from the AGK IDE. XCode can be downloaded from the Mac AppStore")); 
-			goto ios_dialog_clean_up;
+			export_task_error( task, _("Failed to read certificate end data from certificate list") );
+			goto ios_dialog_cleanup2;
 		}
-	
-		goto ios_dialog_continue;
 
-ios_dialog_clean_up:
-		if ( app_name ) g_free(app_name);
-		if ( profile ) g_free(profile);
-		if ( app_icon ) g_free(app_icon);
-		if ( firebase_config ) g_free(firebase_config);
-		if ( app_splash_logo ) g_free(app_splash_logo);
-		if ( app_splash_color ) g_free(app_splash_color);
-		//if ( facebook_id ) g_free(facebook_id);
-		if ( url_scheme ) g_free(url_scheme);
-		if ( deep_link ) g_free(deep_link);
-		if ( admob_app_id ) g_free(admob_app_id);
-		if ( snapchat_client_id ) g_free(snapchat_client_id);
-		if ( version_number ) g_free(version_number);
-		if ( output_file ) g_free(output_file);
-
-		gtk_widget_set_sensitive( ui_lookup_widget(ui_widgets.ios_dialog, "ios_export1"), TRUE );
-		gtk_widget_set_sensitive( ui_lookup_widget(ui_widgets.ios_dialog, "button6"), TRUE );
-		running = 0;
-		return;
+		length = (gint) (sha_end - sha);
 
-ios_dialog_continue:
+            // copy certificate to temp variable and check it
+		if ( cert_temp ) g_free(cert_temp);
+		cert_temp = g_new0( gchar, length+1 );
+		strncpy( cert_temp, sha, length );
+		cert_temp[ length ] = 0;
 
-		while (gtk_events_pending())
-			gtk_main_iteration();
+            // remove new line characters
+		utils_str_remove_chars( cert_temp, "\n\r" );
+            
+		if ( strcmp( cert_temp, certificate_data ) == 0 ) break; // we found the certificate
 
-		// CHECKS COMPLETE, START EXPORT
+		if ( cert_hash ) g_free(cert_hash);
+		cert_hash = 0;
 
-		const gchar* path_to_codesign = "/usr/bin/codesign";
-		const gchar* path_to_security = "/usr/bin/security";
-		const gchar* path_to_actool = "/Applications/XCode.app/Contents/Developer/usr/bin/actool";
-		const gchar* path_to_ibtool = "/Applications/XCode.app/Contents/Developer/usr/bin/ibtool";
-
-		// make temporary folder
-		gchar* ios_folder = g_build_filename( app->datadir, "ios", NULL );
-		gchar* tmp_folder;
-        if ( !ios_exporting_player && app->project )
-            tmp_folder = g_build_filename( app->project->base_path, "build_tmp", NULL );
-        else
-            tmp_folder = g_build_filename( global_project_prefs.project_file_path, "build_tmp", NULL );
-		
-        gchar* app_folder = g_build_filename( tmp_folder, app_name, NULL );
-		SETPTR(app_folder, g_strconcat( app_folder, ".app", NULL ));
+            // look for next certificate
+		sha = sha_end+1;
+		sha = strstr( sha, "SHA-1 hash: " );
+	}
 
-		gchar* app_folder_name = g_strdup( app_name );
-		SETPTR(app_folder_name, g_strconcat( app_folder_name, ".app", NULL ));
+	if ( !cert_hash )
+	{
+		export_task_error( task, _("Could not find the certificate used to create the provisioning profile, have you added the certificate to your keychain?") );
+		goto ios_dialog_cleanup2;
+	}
 
-		utils_str_replace_char( ios_folder, '\\', '/' );
-		utils_str_replace_char( tmp_folder, '\\', '/' );
-		
-		gchar* src_folder = g_build_path( "/", app->datadir, "ios", "source", "AppGameKit Player.app", NULL );
-		utils_str_replace_char( src_folder, '\\', '/' );
+	g_free(str_out);
+	str_out = 0;
 
-		gchar* no_ads_binary = g_build_path( "/", app->datadir, "ios", "source", "AppGameKit Player No Ads", NULL );
-		utils_str_replace_char( no_ads_binary, '\\', '/' );
+	// find all valid identities
+	argv = g_new0( gchar*, 6 );
+	argv[0] = g_strdup( path_to_security );
+	argv[1] = g_strdup("find-identity");
+	argv[2] = g_strdup("-p");
+	argv[3] = g_strdup("codesigning");
+	argv[4] = g_strdup("-v");
+	argv[5] = NULL;
 
-		gchar* icons_src_folder = g_build_path( "/", app->datadir, "ios", "source", "Icons.xcassets", NULL );
-		utils_str_replace_char( icons_src_folder, '\\', '/' );
+	if ( !utils_spawn_sync( tmp_folder, argv, NULL, 0, NULL, NULL, &str_out, NULL, &status, &error) )
+	{
+		export_task_error( task, _("Failed to run \"security\" program: %s"), error->message );
+		g_error_free(error);
+		error = NULL;
+		goto ios_dialog_cleanup2;
+	}
 
-		gchar* icons_dst_folder = g_build_path( "/", tmp_folder, "Icons.xcassets", NULL );
-		utils_str_replace_char( icons_dst_folder, '\\', '/' );
+	g_strfreev(argv);
+	argv = 0;
+	
+	if ( status != 0 && strncmp(str_out,"  1) ",strlen("  1) ") != 0) )
+	{
+		if ( str_out && *str_out ) export_task_error( task, _("Failed to get code signing identities (error %d: %s)"), status, str_out );
+		else export_task_error( task, _("Failed to get code signing identities (error: %d)"), status );
+		goto ios_dialog_cleanup2;
+	}
 
-		gchar* icons_sub_folder = g_build_path( "/", tmp_folder, "Icons.xcassets", "AppIcon.appiconset", NULL );
-		utils_str_replace_char( icons_sub_folder, '\\', '/' );
+	// parse identities, look for the identity we found earlier
+	if ( strstr( str_out, cert_hash ) == 0 )
+	{
+		export_task_error( task, _("Signing certificate is not valid, either the private key is missing from your keychain, or the certificate has expired") );
+		goto ios_dialog_cleanup2;
+	}
+	
+	if ( str_out ) g_free(str_out);
+	str_out = 0;
 
-		gchar *output_file_zip = g_strdup( output_file );
-		gchar *ext = strrchr( output_file_zip, '.' );
-		if ( ext ) *ext = 0;
-		SETPTR( output_file_zip, g_strconcat( output_file_zip, ".zip", NULL ) );
+	export_task_mark( task, "profile", NULL );
+	if ( export_task_cancelled( task ) ) goto ios_dialog_cleanup2;
+	export_task_progress( task, "manifest", 0, 0 );
 
-		// decalrations
-		gchar newcontents[ 32000 ];
-		gchar *contents = NULL;
-		gsize length = 0;
-		gchar *certificate_data = NULL;
-		gchar *bundle_id = NULL;
-		gchar *app_group_data = 0;
-		gchar *team_id = NULL;
-		gchar *cert_hash = NULL;
-		gchar *cert_temp = NULL;
-		gchar **argv = NULL;
-		gchar *str_out = NULL;
-		gint status = 0;
-		GError *error = NULL;
-		gchar *entitlements_file = NULL;
-		gchar *expanded_entitlements_file = NULL;
-		gchar *temp_filename1 = NULL;
-		gchar *temp_filename2 = NULL;
-		gchar *version_string = NULL;
-		gchar *build_string = NULL;
-		gchar *bundle_id2 = NULL; // don't free, pointer to sub string
-		gchar *image_filename = NULL;
-		gchar *temp_image_filename = NULL;
-		GdkPixbuf *icon_scaled_image = NULL;
-		GdkPixbuf *icon_image = NULL;
-		GdkPixbuf *splash_image = NULL;
-		gchar *user_name = NULL;
-		gchar *group_name = NULL;
-		mz_zip_archive zip_archive;
-		memset(&zip_archive, 0, sizeof(zip_archive));
+	// write entitlements file
+	strcpy( newcontents, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n\
+<!DOCTYPE plist PUBLIC \"-//Apple//DTD PLIST 1.0//EN\" \"http://www.apple.com/DTDs/PropertyList-1.0.dtd\">\n\
+<plist version=\"1.0\">\n<dict>\n	<key>application-identifier</key>\n	<string>" );
+	strcat( newcontents, bundle_id );
+	strcat( newcontents, "</string>\n	<key>com.apple.developer.team-identifier</key>\n	<string>" );
+	strcat( newcontents, team_id );
+	strcat( newcontents, "</string>\n" );
+	
+	if ( betaReports )
+		strcat( newcontents, "	<key>beta-reports-active</key>\n	<true/>\n" );
 		
-		if ( !utils_copy_folder( src_folder, app_folder, TRUE, NULL ) )
-		{
-			SHOW_ERR( _("Failed to copy source folder") );
-			goto ios_dialog_cleanup2;
-		}
 
-		if ( !uses_ads )
-		{
-			gchar *binary_path = g_build_filename( app_folder, "AppGameKit Player", NULL );
-			utils_copy_file( no_ads_binary, binary_path, TRUE, NULL );
-			g_free( binary_path );
-		}
-		
-		// rename executable
-		g_chdir( app_folder );
-		g_rename( "AppGameKit Player", app_name );
-		
-		while (gtk_events_pending())
-			gtk_main_iteration();
+	if ( pushNotifications == 1 )
+		strcat( newcontents, "	<key>aps-environment</key>\n	<string>development</string>\n" );
+	else if ( pushNotifications == 2 )
+		strcat( newcontents, "	<key>aps-environment</key>\n	<string>production</string>\n" );
 
-		// open provisioning profile and extract certificate
-		if ( !g_file_get_contents( profile, &contents, &length, NULL ) )
-		{
-			SHOW_ERR( _("Failed to read provisioning profile") );
-			goto ios_dialog_cleanup2;
-		}
+	strcat( newcontents, "	<key>get-task-allow</key>\n	<false/>\n" );
 
-        // provisioning profile starts as binary, so skip 100 bytes to get to text
-		gchar* certificate = strstr( contents+100, "<key>DeveloperCertificates</key>" );
-		if ( !certificate )
-		{
-			SHOW_ERR( _("Failed to read certificate from provisioning profile") );
-			goto ios_dialog_cleanup2;
-		}
+	if ( app_group_data ) 
+	{
+		strcat( newcontents, "	<key>com.apple.security.application-groups</key>\n" );
+		strcat( newcontents, app_group_data );
+		strcat( newcontents, "\n" );
+	}
 
-		certificate = strstr( certificate, "<data>" );
-		if ( !certificate )
-		{
-			SHOW_ERR( _("Failed to read certificate data from provisioning profile") );
-			goto ios_dialog_cleanup2;
-		}
+	if ( cloudKit )
+	{
+		strcat( newcontents, "  <key>com.apple.developer.icloud-container-identifiers</key>\n	<array/>" );
+		strcat( newcontents, "  <key>com.apple.developer.ubiquity-kvstore-identifier</key>\n	<string>" );
+		strcat( newcontents, bundle_id );
+		strcat( newcontents, "</string>\n" );
+	}
 
-		certificate += strlen("<data>");
-		gchar* certificate_end = strstr( certificate, "</data>" );
-		if ( !certificate_end )
-		{
-			SHOW_ERR( _("Failed to read certificate end data from provisioning profile") );
-			goto ios_dialog_cleanup2;
-		}
+	if ( deep_link && *deep_link )
+	{
+		gchar *szDomain = strstr( deep_link, "://" );
+		if ( szDomain ) szDomain += 3;
+		else szDomain = deep_link;
+
+		gchar *szSlash = strchr( szDomain, '/' );
+		if ( szSlash ) *szSlash = 0;
+		strcat( newcontents, "  <key>com.apple.developer.associated-domains</key>\n <array>\n  <string>applinks:" );
+		strcat( newcontents, szDomain );
+		strcat( newcontents, "</string>\n</array>\n" );
+	}
 
-        // copy certificate into local storage
-		gint cert_length = (gint) (certificate_end - certificate);
-		certificate_data = g_new0( gchar, cert_length+1 );
-		strncpy( certificate_data, certificate, cert_length );
-		certificate_data[ cert_length ] = 0;
+	strcat( newcontents, "</dict>\n</plist>" );
 
-		utils_str_remove_chars( certificate_data, "\n\r" );
-        
-		// extract bundle ID, reuse variables
-		certificate = strstr( contents+100, "<key>application-identifier</key>" );
-		if ( !certificate )
-		{
-			SHOW_ERR( _("Failed to read bundle ID from provisioning profile") );
-			goto ios_dialog_cleanup2;
-		}
+	entitlements_file = g_build_filename( tmp_folder, "entitlements.xcent", NULL );
 
-		certificate = strstr( certificate, "<string>" );
-		if ( !certificate )
-		{
-			SHOW_ERR( _("Failed to read bundle ID data from provisioning profile") );
-			goto ios_dialog_cleanup2;
-		}
+	if ( !g_file_set_contents( entitlements_file, newcontents, strlen(newcontents), &error ) )
+	{
+		export_task_error( task, _("Failed to write entitlements file: %s"), error->message );
+		g_error_free(error);
+		error = NULL;
+		goto ios_dialog_cleanup2;
+	}
 
-		certificate += strlen("<string>");
-		certificate_end = strstr( certificate, "</string>" );
-		if ( !certificate_end )
-		{
-			SHOW_ERR( _("Failed to read bundle ID end data from provisioning profile") );
-			goto ios_dialog_cleanup2;
-		}
-		
-        // copy bundle ID to local storage
-		cert_length = (gint) (certificate_end - certificate);
-		bundle_id = g_new0( gchar, cert_length+1 );
-		strncpy( bundle_id, certificate, cert_length );
-		bundle_id[ cert_length ] = 0;
-        
-        // look for beta entitlement
-        int betaReports = 0;
-        if ( strstr(contents+100, "<key>beta-reports-active</key>") != 0 )
-        {
-            betaReports = 1;
-        }
-        
-        // look for push notification entitlement
-        int pushNotifications = 0;
-        gchar* pushStr = strstr(contents+100, "<key>aps-environment</key>");
-        if ( pushStr != 0 )
-        {
-            gchar* pushType = strstr( pushStr, "<string>" );
-            if ( strncmp( pushType, "<string>development</string>", strlen("<string>development</string>") ) == 0 )
-                pushNotifications = 1;
-            else 
-                pushNotifications = 2;
-        }
+	// write archived expanded entitlements file
+	strcpy( newcontents, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n\
+<!DOCTYPE plist PUBLIC \"-//Apple//DTD PLIST 1.0//EN\" \"http://www.apple.com/DTDs/PropertyList-1.0.dtd\">\n\
+<plist version=\"1.0\">\n<dict>\n	<key>application-identifier</key>\n	<string>" );
+	strcat( newcontents, bundle_id );
+	strcat( newcontents, "</string>\n" );
 
-		// look for app groups
-		certificate = strstr( contents+100, "<key>com.apple.security.application-groups</key>" );
-		if ( certificate )
-		{
-			certificate = strstr( certificate, "<array>" );
-			if ( !certificate )
-			{
-				SHOW_ERR( _("Failed to read App Group data from provisioning profile") );
-				goto ios_dialog_cleanup2;
-			}
+	if ( app_group_data )
+	{
+		strcat( newcontents, "	<key>com.apple.security.application-groups</key>\n" );
+		strcat( newcontents, app_group_data );
+		strcat( newcontents, "\n" );
+	}
 
-			app_group_data = strstr( certificate, "</array>" );
-			if ( !app_group_data )
-			{
-				SHOW_ERR( _("Failed to read App Group end data from provisioning profile") );
-				goto ios_dialog_cleanup2;
-			}
+	strcat( newcontents, "</dict>\n</plist>" );
 
-			// quick hack to prevent next search going beyond the array list
-			*app_group_data = 0;
+	expanded_entitlements_file = g_build_filename( app_folder, "archived-expanded-entitlements.xcent", NULL );
 
-			// check there is at least one string
-			certificate_end = strstr( certificate, "<string>" );
+	if ( !g_file_set_contents( expanded_entitlements_file, newcontents, strlen(newcontents), &error ) )
+	{
+		export_task_error( task, _("Failed to write expanded entitlements file: %s"), error->message );
+		g_error_free(error);
+		error = NULL;
+		goto ios_dialog_cleanup2;
+	}
 
-			// repair the string
-			*app_group_data = '<'; 
-			app_group_data = 0;
+	// copy Firebase config file
+	if ( firebase_config && *firebase_config )
+	{
+		temp_filename1 = g_build_filename( app_folder, "GoogleService-Info.plist", NULL );
+		utils_copy_file( firebase_config, temp_filename1, TRUE, NULL );
+		g_free(temp_filename1);
+	}
 
-			if ( certificate_end )
-			{
-				// find the end of the list
-				certificate_end = strstr( certificate, "</array>" );
-				if ( !certificate_end )
-				{
-					SHOW_ERR( _("Failed to read App Group end data from provisioning profile") );
-					goto ios_dialog_cleanup2;
-				}
+	// copy provisioning profile
+	temp_filename1 = g_build_filename( app_folder, "embedded.mobileprovision", NULL );
+	utils_copy_file( profile, temp_filename1, TRUE, NULL );
+	// edit Info.plist
+	g_free(temp_filename1);
+	temp_filename1 = g_build_filename( app_folder, "Info.plist", NULL );
 
-				certificate_end += strlen( "</array>" );
-				
-				// copy App Group strings to local storage
-				cert_length = (gint) (certificate_end - certificate);
-				app_group_data = g_new0( gchar, cert_length+1 );
-				strncpy( app_group_data, certificate, cert_length );
-				app_group_data[ cert_length ] = 0;
-			}
-		}
+	if ( contents ) g_free(contents);
+	contents = 0;
+	if ( !g_file_get_contents( temp_filename1, &contents, &length, NULL ) )
+	{
+		export_task_error( task, _("Failed to read Info.plist file") );
+		goto ios_dialog_cleanup2;
+	}
 
-		// look for cloud kit
-		int cloudKit = 0;
-        if ( strstr(contents+100, "<key>com.apple.developer.ubiquity-kvstore-identifier</key>") != 0 )
-        {
-            cloudKit = 1;
-        }
-		
-		// extract team ID, reuse variables
-		certificate = strstr( contents+100, "<key>com.apple.developer.team-identifier</key>" );
-		if ( !certificate )
+	{
+		const gchar *plist_keys[] = { "${PRODUCT_NAME}", "${EXECUTABLE_NAME}", "${ADMOB_APP_ID}", "${SNAPCHAT_ID}", "com.thegamecreators.agk2player",
+									  "<string>${URLSCHEMES}</string>\n", "<string>${URLSCHEMES}</string>\r\n",
+									  "<string>UIInterfaceOrientationPortrait</string>", "<string>UIInterfaceOrientationPortraitUpsideDown</string>",
+									  "<string>UIInterfaceOrientationLandscapeLeft</string>", "<string>UIInterfaceOrientationLandscapeRight</string>",
+									  "${InitialInterfaceOrientation}", "${VERSION}", "${BUILD}", "\t\t<integer>1</integer>\n", "\t\t<integer>2</integer>\n" };
+		UtilsTemplate *plist = utils_template_new();
+		GString *new_plist = g_string_sized_new( length + 1024 );
+		gchar *url_schemes = NULL;
+		gboolean written;
+
+		for( i = 0; i < (int) G_N_ELEMENTS(plist_keys); i++ ) utils_template_add_key( plist, plist_keys[i] );
+		utils_template_compile( plist, contents, length );
+
+		utils_template_set( plist, "${PRODUCT_NAME}", app_name );
+		utils_template_set( plist, "${EXECUTABLE_NAME}", app_name );
+		if ( admob_app_id && *admob_app_id ) utils_template_set( plist, "${ADMOB_APP_ID}", admob_app_id );
+		else utils_template_set( plist, "${ADMOB_APP_ID}", "ca-app-pub-3940256099942544~1458002511" ); // needs something, use TGC Admob value
+		if ( snapchat_client_id && *snapchat_client_id ) utils_template_set( plist, "${SNAPCHAT_ID}", snapchat_client_id );
+		utils_template_set( plist, "com.thegamecreators.agk2player", bundle_id2 );
+		//if ( facebook_id && *facebook_id ) utils_str_replace_all( &contents, "358083327620324", facebook_id );
+		if ( url_scheme && *url_scheme ) url_schemes = g_strconcat( "<string>", url_scheme, "</string>\n", NULL );
+		utils_template_set( plist, "<string>${URLSCHEMES}</string>\n", url_schemes ? url_schemes : "" );
+		utils_template_set( plist, "<string>${URLSCHEMES}</string>\r\n", url_schemes ? url_schemes : "" );
+		g_free( url_schemes );
+
+		switch( orientation )
 		{
-			certificate = strstr( contents+100, "<key>TeamIdentifier</key>" );
-			if ( !certificate )
+			case 0:
 			{
-				SHOW_ERR( _("Failed to read team ID from provisioning profile") );
-				goto ios_dialog_cleanup2;
+				utils_template_set( plist, "<string>UIInterfaceOrientationPortrait</string>", "" );
+				utils_template_set( plist, "<string>UIInterfaceOrientationPortraitUpsideDown</string>", "" );
+				utils_template_set( plist, "${InitialInterfaceOrientation}", "UIInterfaceOrientationLandscapeLeft" );
+				break;
+			}
+			case 1:
+			{
+				utils_template_set( plist, "<string>UIInterfaceOrientationLandscapeLeft</string>", "" );
+				utils_template_set( plist, "<string>UIInterfaceOrientationLandscapeRight</string>", "" );
+				utils_template_set( plist, "${InitialInterfaceOrientation}", "UIInterfaceOrientationPortrait" );
+				break;
+			}
+			case 2:
+			{
+				utils_template_set( plist, "${InitialInterfaceOrientation}", "UIInterfaceOrientationPortrait" );
+				break;
 			}
 		}
 
-		certificate = strstr( certificate, "<string>" );
-		if ( !certificate )
-		{
-			SHOW_ERR( _("Failed to read team ID data from provisioning profile") );
-			goto ios_dialog_cleanup2;
-		}
+		utils_template_set( plist, "${VERSION}", version_number );
+		utils_template_set( plist, "${BUILD}", build_number );
 
-		certificate += strlen("<string>");
-		certificate_end = strstr( certificate, "</string>" );
-		if ( !certificate_end )
-		{
-			SHOW_ERR( _("Failed to read team ID end data from provisioning profile") );
-			goto ios_dialog_cleanup2;
-		}
-		
-        // copy team ID to local storage
-		cert_length = (gint) (certificate_end - certificate);
-		team_id = g_new0( gchar, cert_length+1 );
-		strncpy( team_id, certificate, cert_length );
-		team_id[ cert_length ] = 0;
-		
-		if ( strncmp( team_id, bundle_id, strlen(team_id) ) == 0 )
-		{
-			// remove team ID
-			bundle_id2 = strchr( bundle_id, '.' );
-			if ( bundle_id2 ) bundle_id2++;
-			else bundle_id2 = bundle_id;
-		}
-		else
-		{
-			bundle_id2 = bundle_id;
-		}
+		if ( device_type == 1 ) utils_template_set( plist, "\t\t<integer>2</integer>\n", "" );
+		else if ( device_type == 2 ) utils_template_set( plist, "\t\t<integer>1</integer>\n", "" );
 
-		// find all certificates, the identity is just the hash of the certificate
-		argv = g_new0( gchar*, 8 );
-		argv[0] = g_strdup( path_to_security );
-		argv[1] = g_strdup("find-certificate");
-		argv[2] = g_strdup("-a");
-		// certificate not guaranteed to have "iPhone" in the name
-		argv[3] = g_strdup("-p"); // use PEM format, same as provisioning profile
-		argv[4] = g_strdup("-Z"); // display hash
-		argv[5] = NULL;
+		utils_template_render( plist, new_plist );
+		written = g_file_set_contents( temp_filename1, new_plist->str, new_plist->len, NULL );
+		g_string_free( new_plist, TRUE );
+		utils_template_free( plist );
 
-		if ( !utils_spawn_sync( tmp_folder, argv, NULL, 0, NULL, NULL, &str_out, NULL, &status, &error) )
+		if ( !written )
 		{
-			SHOW_ERR1( _("Failed to run \"security\" program: %s"), error->message );
-			g_error_free(error);
-			error = NULL;
+			export_task_error( task, _("Failed to write Info.plist file") );
 			goto ios_dialog_cleanup2;
 		}
+	}
 
-		g_strfreev(argv);
-		argv = 0;
-		
-		if ( status != 0 && strstr(str_out,"SHA-1") == 0 )
+	g_free(str_out);
+	str_out = 0;
+
+	// convert plist to binary
+	argv = g_new0( gchar*, 6 );
+	argv[0] = g_strdup( "/usr/bin/plutil" );
+	argv[1] = g_strdup("-convert");
+	argv[2] = g_strdup("binary1");
+	argv[3] = g_strdup(temp_filename1);
+	argv[4] = NULL;
+
+	if ( !utils_spawn_sync( tmp_folder, argv, NULL, 0, NULL, NULL, &str_out, NULL, &status, &error) )
+	{
+		export_task_error( task, _("Failed to run userid program: %s"), error->message );
+		g_error_free(error);
+		error = NULL;
+		goto ios_dialog_cleanup2;
+	}
+
+	g_strfreev(argv);
+	argv = 0;
+	
+        /*
+	if ( status != 0 )
+	{
+		export_task_error( task, _("Failed to get user name (error: %d)"), status );
+		goto ios_dialog_cleanup2;
+	}
+         */
+
+	export_task_mark( task, "manifest", NULL );
+	if ( export_task_cancelled( task ) ) goto ios_dialog_cleanup2;
+	export_task_progress( task, "icons", 0, 0 );
+
+	// load icon file
+	if ( app_icon && *app_icon )
+	{
+		// write Icons.xcassets file
+		if ( !utils_copy_folder( icons_src_folder, icons_dst_folder, TRUE, NULL ) )
 		{
-			if ( str_out && *str_out ) dialogs_show_msgbox(GTK_MESSAGE_ERROR, _("Failed to get code signing identities (error %d: %s)"), status, str_out );
-			else SHOW_ERR1( _("Failed to get code signing identities (error: %d)"), status );
+			export_task_error( task, _("Failed to create icon asset catalog") );
 			goto ios_dialog_cleanup2;
 		}
 
-        // cycle through each certificate looking for one that matches provisioning profile
-		gchar *sha = strstr( str_out, "SHA-1 hash: " );
-		while ( sha )
+		// scale it and save it in Apple's CgBI format
 		{
-			sha += strlen( "SHA-1 hash: " );
-			gchar *sha_end = strchr( sha, '\n' );
-			if ( !sha_end )
-			{
-				SHOW_ERR( _("Failed to read code signing identity from certificate list") );
-				goto ios_dialog_cleanup2;
-			}
-
-			gint length = (gint) (sha_end - sha);
+			const gint icon_sizes[] = { 152, 180, 167, 120, 76, 1024 }; // 60x60 no longer needed
 
-            // save hash for later, if this is the correct certificate then this will be the codesigning identity
-			if ( cert_hash ) g_free(cert_hash);
-			cert_hash = g_new0( gchar, length+1 );
-			strncpy( cert_hash, sha, length );
-			cert_hash[ length ] = 0;
-
-			sha = sha_end + 1;
-			sha = strstr( sha, "-----BEGIN CERTIFICATE-----" );
-			if ( !sha )
+			icon_set = utils_icon_set_new( app_icon );
+			utils_icon_set_set_cgbi( icon_set, TRUE );
+			for( i = 0; i < (int) G_N_ELEMENTS(icon_sizes); i++ )
 			{
-				SHOW_ERR( _("Failed to read certificate data from certificate list") );
-				goto ios_dialog_cleanup2;
+				gchar *name = g_strdup_printf( "icon-%d.png", icon_sizes[i] );
+				image_filename = g_build_path( "/", icons_sub_folder, name, NULL );
+				utils_icon_set_add( icon_set, icon_sizes[i], icon_sizes[i], image_filename );
+				g_free( image_filename );
+				g_free( name );
 			}
+			image_filename = NULL;
 
-			sha += strlen( "-----BEGIN CERTIFICATE-----" ) + 1;
-			sha_end = strstr( sha, "-----END CERTIFICATE-----" );
-			if ( !sha_end )
+			if ( !utils_icon_set_write( icon_set, &error ) )
 			{
-				SHOW_ERR( _("Failed to read certificate end data from certificate list") );
+				export_task_error( task, _("Failed to save app icons: %s"), error->message );
+				g_error_free(error);
+				error = NULL;
 				goto ios_dialog_cleanup2;
 			}
-
-			length = (gint) (sha_end - sha);
-
-            // copy certificate to temp variable and check it
-			if ( cert_temp ) g_free(cert_temp);
-			cert_temp = g_new0( gchar, length+1 );
-			strncpy( cert_temp, sha, length );
-			cert_temp[ length ] = 0;
-
-            // remove new line characters
-			utils_str_remove_chars( cert_temp, "\n\r" );
-            
-			if ( strcmp( cert_temp, certificate_data ) == 0 ) break; // we found the certificate
-
-			if ( cert_hash ) g_free(cert_hash);
-			cert_hash = 0;
-
-            // look for next certificate
-			sha = sha_end+1;
-			sha = strstr( sha, "SHA-1 hash: " );
-		}
-
-		if ( !cert_hash )
-		{
-			SHOW_ERR( _("Could not find the certificate used to create the provisioning profile, have you added the certificate to your keychain?") );
-			goto ios_dialog_cleanup2;
-		}
-
-		g_free(str_out);
-		str_out = 0;
-
-		// find all valid identities
-		argv = g_new0( gchar*, 6 );
-		argv[0] = g_strdup( path_to_security );
-		argv[1] = g_strdup("find-identity");
-		argv[2] = g_strdup("-p");
-		argv[3] = g_strdup("codesigning");
-		argv[4] = g_strdup("-v");
-		argv[5] = NULL;
+			utils_icon_set_free( icon_set );
+			icon_set = NULL;
+		}
+
+		// run actool to compile asset catalog, it will copy the app icons to the app_folder and create the Assets.car file
+		argv = g_new0( gchar*, 20 );
+		argv[0] = g_strdup( path_to_actool );
+		argv[1] = g_strdup("--output-partial-info-plist");
+		argv[2] = g_strdup("temp.plist");
+		argv[3] = g_strdup("--app-icon");
+		argv[4] = g_strdup("AppIcon");
+		argv[5] = g_strdup("--target-device");
+		argv[6] = g_strdup("iphone");
+		argv[7] = g_strdup("--target-device");
+		argv[8] = g_strdup("ipad");
+		argv[9] = g_strdup("--minimum-deployment-target");
+		argv[10] = g_strdup("9.0");
+		argv[11] = g_strdup("--platform");
+		argv[12] = g_strdup("iphoneos");
+		argv[13] = g_strdup("--product-type");
+		argv[14] = g_strdup("com.apple.product-type.application");
+		argv[15] = g_strdup("--compress-pngs");
+		argv[16] = g_strdup("--compile");
+		argv[17] = g_strdup(app_folder_name);
+		argv[18] = g_strdup("Icons.xcassets");
+		argv[19] = NULL;
 
 		if ( !utils_spawn_sync( tmp_folder, argv, NULL, 0, NULL, NULL, &str_out, NULL, &status, &error) )
 		{
-			SHOW_ERR1( _("Failed to run \"security\" program: %s"), error->message );
+			export_task_error( task, _("Failed to run \"actool\" program: %s"), error->message );
 			g_error_free(error);
 			error = NULL;
 			goto ios_dialog_cleanup2;
 		}
-
-		g_strfreev(argv);
-		argv = 0;
-		
-		if ( status != 0 && strncmp(str_out,"  1) ",strlen("  1) ") != 0) )
+	
+		if ( !str_out || strstr(str_out,"actool.errors") != 0 || strstr(str_out,"actool.warnings") != 0 || strstr(str_out,"actool.notices") != 0 )
 		{
-			if ( str_out && *str_out ) dialogs_show_msgbox(GTK_MESSAGE_ERROR, _("Failed to get code signing identities (error %d: %s)"), status, str_out );
-			else SHOW_ERR1( _("Failed to get code signing identities (error: %d)"), status );
+			if ( str_out && *str_out ) export_task_error( task, _("Failed to compile asset catalog (error %d: %s)"), status, str_out );
+			else export_task_error( task, _("Failed to get compile asset catalog (error: %d)"), status );
 			goto ios_dialog_cleanup2;
 		}
 
-		// parse identities, look for the identity we found earlier
-		if ( strstr( str_out, cert_hash ) == 0 )
-		{
-			SHOW_ERR( _("Signing certificate is not valid, either the private key is missing from your keychain, or the certificate has expired") );
-			goto ios_dialog_cleanup2;
-		}
-		
-		if ( str_out ) g_free(str_out);
+		g_free(str_out);
 		str_out = 0;
+		g_strfreev(argv);
+		argv = 0;
+	}
 
-		while (gtk_events_pending())
-			gtk_main_iteration();
-
-		// write entitlements file
-		strcpy( newcontents, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n\
-<!DOCTYPE plist PUBLIC \"-//Apple//DTD PLIST 1.0//EN\" \"http://www.apple.com/DTDs/PropertyList-1.0.dtd\">\n\
-<plist version=\"1.0\">\n<dict>\n	<key>application-identifier</key>\n	<string>" );
-		strcat( newcontents, bundle_id );
-		strcat( newcontents, "</string>\n	<key>com.apple.developer.team-identifier</key>\n	<string>" );
-		strcat( newcontents, team_id );
-		strcat( newcontents, "</string>\n" );
-		
-		if ( betaReports )
-			strcat( newcontents, "	<key>beta-reports-active</key>\n	<true/>\n" );
-			
+	export_task_mark( task, "icons", NULL );
+	if ( export_task_cancelled( task ) ) goto ios_dialog_cleanup2;
+	export_task_progress( task, "media", 0, 0 );
 
-		if ( pushNotifications == 1 )
-			strcat( newcontents, "	<key>aps-environment</key>\n	<string>development</string>\n" );
-		else if ( pushNotifications == 2 )
-			strcat( newcontents, "	<key>aps-environment</key>\n	<string>production</string>\n" );
+	// copy splash logo
+	if ( app_splash_logo && *app_splash_logo )
+	{
+		if ( temp_filename1 ) g_free(temp_filename1);
+		temp_filename1 = g_build_filename( app_folder, "SplashLogo.png", NULL );
+		utils_copy_file( app_splash_logo, temp_filename1, TRUE, NULL );
+	}
+	
+	if ( app_splash_color && *app_splash_color )
+	{
+		int iRed = hextoint( app_splash_color[0] ) * 16 + hextoint( app_splash_color[1] );
+		int iGreen = hextoint( app_splash_color[2] ) * 16 + hextoint( app_splash_color[3] );
+		int iBlue = hextoint( app_splash_color[4] ) * 16 + hextoint( app_splash_color[5] );
 
-		strcat( newcontents, "	<key>get-task-allow</key>\n	<false/>\n" );
+		float red = iRed / 255.0f;
+		float green = iGreen / 255.0f;
+		float blue = iBlue / 255.0f;
 
-		if ( app_group_data ) 
-		{
-			strcat( newcontents, "	<key>com.apple.security.application-groups</key>\n" );
-			strcat( newcontents, app_group_data );
-			strcat( newcontents, "\n" );
-		}
+		// edit UntitledViewController
+		if ( temp_filename1 ) g_free(temp_filename1);
+		temp_filename1 = g_build_filename( app_folder, "UntitledViewController.xib", NULL );
 
-		if ( cloudKit )
+		if ( contents ) g_free(contents);
+		contents = 0;
+		if ( !g_file_get_contents( temp_filename1, &contents, &length, NULL ) )
 		{
-			strcat( newcontents, "  <key>com.apple.developer.icloud-container-identifiers</key>\n	<array/>" );
-			strcat( newcontents, "  <key>com.apple.developer.ubiquity-kvstore-identifier</key>\n	<string>" );
-			strcat( newcontents, bundle_id );
-			strcat( newcontents, "</string>\n" );
+			export_task_error( task, _("Failed to read UntitledViewController.xib file") );
+			goto ios_dialog_cleanup2;
 		}
 
-		if ( deep_link && *deep_link )
+		*newcontents = 0;
+		char* start = strstr( contents, "backgroundColor\"" );
+		if ( !start )
 		{
-			gchar *szDomain = strstr( deep_link, "://" );
-			if ( szDomain ) szDomain += 3;
-			else szDomain = deep_link;
-
-			gchar *szSlash = strchr( szDomain, '/' );
-			if ( szSlash ) *szSlash = 0;
-			strcat( newcontents, "  <key>com.apple.developer.associated-domains</key>\n <array>\n  <string>applinks:" );
-			strcat( newcontents, szDomain );
-			strcat( newcontents, "</string>\n</array>\n" );
+			export_task_error( task, _("Failed to modify UntitledViewController.xib, backgroundColor not found") );
+			goto ios_dialog_cleanup2;
 		}
 
-		strcat( newcontents, "</dict>\n</plist>" );
+		start += strlen("backgroundColor\"");
+		*start = 0;
+		strcpy( newcontents, contents );
+		*start = ' ';
 
-		entitlements_file = g_build_filename( tmp_folder, "entitlements.xcent", NULL );
+		char newcolor[ 256 ];
+		*newcolor = 0;
+		sprintf( newcolor, " red=\"%f\" green=\"%f\" blue=\"%f\" ", red, green, blue );
+		strcat( newcontents, newcolor );
 
-		if ( !g_file_set_contents( entitlements_file, newcontents, strlen(newcontents), &error ) )
+		start = strstr( start, "alpha=" );
+		if ( !start )
 		{
-			SHOW_ERR1( _("Failed to write entitlements file: %s"), error->message );
-			g_error_free(error);
-			error = NULL;
+			export_task_error( task, _("Failed to modify UntitledViewController.xib, alpha not found") );
 			goto ios_dialog_cleanup2;
 		}
 
-		// write archived expanded entitlements file
-		strcpy( newcontents, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n\
-<!DOCTYPE plist PUBLIC \"-//Apple//DTD PLIST 1.0//EN\" \"http://www.apple.com/DTDs/PropertyList-1.0.dtd\">\n\
-<plist version=\"1.0\">\n<dict>\n	<key>application-identifier</key>\n	<string>" );
-		strcat( newcontents, bundle_id );
-		strcat( newcontents, "</string>\n" );
-
-		if ( app_group_data )
-		{
-			strcat( newcontents, "	<key>com.apple.security.application-groups</key>\n" );
-			strcat( newcontents, app_group_data );
-			strcat( newcontents, "\n" );
-		}
-
-		strcat( newcontents, "</dict>\n</plist>" );
-
-		expanded_entitlements_file = g_build_filename( app_folder, "archived-expanded-entitlements.xcent", NULL );
+		strcat( newcontents, start );
 
-		if ( !g_file_set_contents( expanded_entitlements_file, newcontents, strlen(newcontents), &error ) )
+		if ( !g_file_set_contents( temp_filename1, newcontents, strlen(newcontents), &error ) )
 		{
-			SHOW_ERR1( _("Failed to write expanded entitlements file: %s"), error->message );
+			export_task_error( task, _("Failed to write UntitledViewController.xib file: %s"), error->message );
 			g_error_free(error);
 			error = NULL;
 			goto ios_dialog_cleanup2;
 		}
-
-		// copy Firebase config file
-		if ( firebase_config && *firebase_config )
-		{
-			temp_filename1 = g_build_filename( app_folder, "GoogleService-Info.plist", NULL );
-			utils_copy_file( firebase_config, temp_filename1, TRUE, NULL );
-			g_free(temp_filename1);
-		}
-
-		// copy provisioning profile
-		temp_filename1 = g_build_filename( app_folder, "embedded.mobileprovision", NULL );
-		utils_copy_file( profile, temp_filename1, TRUE, NULL );
-		// edit Info.plist
-		g_free(temp_filename1);
-		temp_filename1 = g_build_filename( app_folder, "Info.plist", NULL );
+		
+		// edit storyboard
+		if ( temp_filename1 ) g_free(temp_filename1);
+		temp_filename1 = g_build_filename( app_folder, "LaunchScreen.storyboard", NULL );
 
 		if ( contents ) g_free(contents);
 		contents = 0;
 		if ( !g_file_get_contents( temp_filename1, &contents, &length, NULL ) )
 		{
-			SHOW_ERR( _("Failed to read Info.plist file") );
+			export_task_error( task, _("Failed to read LaunchScreen.storyboard file") );
 			goto ios_dialog_cleanup2;
-		}
+		}	
 
-		utils_str_replace_all( &contents, "${PRODUCT_NAME}", app_name );
-		utils_str_replace_all( &contents, "${EXECUTABLE_NAME}", app_name );
-		if ( admob_app_id && *admob_app_id ) utils_str_replace_all( &contents, "${ADMOB_APP_ID}", admob_app_id );
-		else utils_str_replace_all( &contents, "${ADMOB_APP_ID}", "ca-app-pub-3940256099942544~1458002511" ); // needs something, use TGC Admob value
-		if ( snapchat_client_id && *snapchat_client_id ) utils_str_replace_all( &contents, "${SNAPCHAT_ID}", snapchat_client_id );
-		utils_str_replace_all( &contents, "com.thegamecreators.agk2player", bundle_id2 );
-		//if ( facebook_id && *facebook_id ) utils_str_replace_all( &contents, "358083327620324", facebook_id );
-		const char* urlschemereplacement = "<string>${URLSCHEMES}</string>\n";
-		if ( strstr( contents, urlschemereplacement ) == 0 ) urlschemereplacement = "<string>${URLSCHEMES}</string>\r\n";
-		if ( url_scheme && *url_scheme ) 
-		{
-			gchar* newUrlSchemes = g_new0( gchar*, strlen(url_scheme) + 30 );
-			strcpy( newUrlSchemes, "<string>" );
-			strcat( newUrlSchemes, url_scheme );
-			strcat( newUrlSchemes, "</string>\n" );
-			utils_str_replace_all( &contents, urlschemereplacement, newUrlSchemes );
-			g_free( newUrlSchemes );
-		}
-		else
+		*newcontents = 0;
+		start = strstr( contents, "backgroundColor\"" );
+		if ( !start )
 		{
-			utils_str_replace_all( &contents, urlschemereplacement, "" );
+			export_task_error( task, _("Failed to modify LaunchScreen.storyboard, backgroundColor not found") );
+			goto ios_dialog_cleanup2;
 		}
 
-		switch( orientation )
+		start += strlen("backgroundColor\"");
+		*start = 0;
+		strcpy( newcontents, contents );
+		*start = ' ';
+
+		*newcolor = 0;
+		sprintf( newcolor, " red=\"%f\" green=\"%f\" blue=\"%f\" ", red, green, blue );
+		strcat( newcontents, newcolor );
+
+		start = strstr( start, "alpha=" );
+		if ( !start )
 		{
-			case 0:
-            {
-                utils_str_replace_all( &contents, "<string>UIInterfaceOrientationPortrait</string>", "" );
-                utils_str_replace_all( &contents, "<string>UIInterfaceOrientationPortraitUpsideDown</string>", "" );
-                utils_str_replace_all( &contents, "${InitialInterfaceOrientation}", "UIInterfaceOrientationLandscapeLeft" );
-                break;
-            }
-			case 1:
-            {
-                utils_str_replace_all( &contents, "<string>UIInterfaceOrientationLandscapeLeft</string>", "" );
-                utils_str_replace_all( &contents, "<string>UIInterfaceOrientationLandscapeRight</string>", "" );
-                utils_str_replace_all( &contents, "${InitialInterfaceOrientation}", "UIInterfaceOrientationPortrait" );
-                break;
-            }
-			case 2:
-            {
-				utils_str_replace_all( &contents, "${InitialInterfaceOrientation}", "UIInterfaceOrientationPortrait" );
-                break;
-            }
+			export_task_error( task, _("Failed to modify LaunchScreen.storyboard, alpha not found") );
+			goto ios_dialog_cleanup2;
 		}
-		
-		utils_str_replace_all( &contents, "${VERSION}", version_number );
-		utils_str_replace_all( &contents, "${BUILD}", build_number );
 
-		if ( device_type == 1 ) utils_str_replace_all( &contents, "\t\t<integer>2</integer>\n", "" );
-		else if ( device_type == 2 ) utils_str_replace_all( &contents, "\t\t<integer>1</integer>\n", "" );
+		strcat( newcontents, start );
 
-		if ( !g_file_set_contents( temp_filename1, contents, strlen(contents), NULL ) )
+		if ( !g_file_set_contents( temp_filename1, newcontents, strlen(newcontents), &error ) )
 		{
-			SHOW_ERR( _("Failed to write Info.plist file") );
+			export_task_error( task, _("Failed to write LaunchScreen.storyboard file: %s"), error->message );
+			g_error_free(error);
+			error = NULL;
 			goto ios_dialog_cleanup2;
 		}
+	}
+
+	// compile UntitledViewController
+	argv = g_new0( gchar*, 19 );
+	argv[0] = g_strdup( path_to_ibtool );
+	argv[1] = g_strdup("--errors");
+	argv[2] = g_strdup("--warnings");
+	argv[3] = g_strdup("--notices");
+	argv[4] = g_strdup("--module");
+	argv[5] = g_strdup("AppGameKit_Player");
+	argv[6] = g_strdup("--auto-activate-custom-fonts");
+	argv[7] = g_strdup("--target-device");
+	argv[8] = g_strdup("iphone");
+	argv[9] = g_strdup("--target-device");
+	argv[10] = g_strdup("ipad");
+	argv[11] = g_strdup("--minimum-deployment-target");
+	argv[12] = g_strdup("9.0");
+	argv[13] = g_strdup("--output-format");
+	argv[14] = g_strdup("human-readable-text");
+	argv[15] = g_strdup("--compile");
+	argv[16] = g_strdup("UntitledViewController.nib");
+	argv[17] = g_strdup("UntitledViewController.xib");
+	argv[18] = NULL;
+		
+	if ( !utils_spawn_sync( app_folder, argv, NULL, 0, NULL, NULL, &str_out, NULL, &status, &error) )
+	{
+		export_task_error( task, _("Failed to run \"ibtool\" program: %s"), error->message );
+		g_error_free(error);
+		error = NULL;
+		goto ios_dialog_cleanup2;
+	}
+	
+	if ( !str_out || strstr(str_out,"ibtool.errors") != 0 || strstr(str_out,"ibtool.warnings") != 0 || strstr(str_out,"ibtool.notices") != 0 )
+	{
+		if ( str_out && *str_out ) export_task_error( task, _("Failed to compile UntitledViewController.nib (error %d: %s)"), status, str_out );
+		else export_task_error( task, _("Failed to get compile UntitledViewController.nib (error: %d)"), status );
+		goto ios_dialog_cleanup2;
+	}
+
+	g_free(str_out);
+	str_out = 0;
+	g_strfreev(argv);
+	argv = 0;
+
+	// delete old UntitledViewController.xib
+	if ( temp_filename1 ) g_free(temp_filename1);
+	temp_filename1 = g_build_filename( app_folder, "UntitledViewController.xib", NULL );
+	g_unlink( temp_filename1 );
+
+
+	// compile storyboard
+	argv = g_new0( gchar*, 19 );
+	argv[0] = g_strdup( path_to_ibtool );
+	argv[1] = g_strdup("--errors");
+	argv[2] = g_strdup("--warnings");
+	argv[3] = g_strdup("--notices");
+	argv[4] = g_strdup("--module");
+	argv[5] = g_strdup("AppGameKit_Player");
+	argv[6] = g_strdup("--auto-activate-custom-fonts");
+	argv[7] = g_strdup("--target-device");
+	argv[8] = g_strdup("iphone");
+	argv[9] = g_strdup("--target-device");
+	argv[10] = g_strdup("ipad");
+	argv[11] = g_strdup("--minimum-deployment-target");
+	argv[12] = g_strdup("9.0");
+	argv[13] = g_strdup("--output-format");
+	argv[14] = g_strdup("human-readable-text");
+	argv[15] = g_strdup("--compilation-directory");
+	argv[16] = g_strdup("./");
+	argv[17] = g_strdup("LaunchScreen.storyboard");
+	argv[18] = NULL;
+		
+	if ( !utils_spawn_sync( app_folder, argv, NULL, 0, NULL, NULL, &str_out, NULL, &status, &error) )
+	{
+		export_task_error( task, _("Failed to run \"ibtool\" program: %s"), error->message );
+		g_error_free(error);
+		error = NULL;
+		goto ios_dialog_cleanup2;
+	}
+	
+	if ( !str_out || strstr(str_out,"ibtool.errors") != 0 || strstr(str_out,"ibtool.warnings") != 0 || strstr(str_out,"ibtool.notices") != 0 )
+	{
+		if ( str_out && *str_out ) export_task_error( task, _("Failed to compile LaunchScreen.storyboard (error %d: %s)"), status, str_out );
+		else export_task_error( task, _("Failed to get compile LaunchScreen.storyboard (error: %d)"), status );
+		goto ios_dialog_cleanup2;
+	}
+
+	g_free(str_out);
+	str_out = 0;
+	g_strfreev(argv);
+	argv = 0;
+
+	// delete old storyboard
+	if ( temp_filename1 ) g_free(temp_filename1);
+	temp_filename1 = g_build_filename( app_folder, "LaunchScreen.storyboard", NULL );
+	g_unlink( temp_filename1 );
+	
+	// copy media folder
+        if ( job->media_folder )
+        {
+            if ( temp_filename1 ) g_free(temp_filename1);
+            temp_filename1 = g_strdup( job->media_folder );
+            temp_filename2 = g_build_filename( app_folder, "media", NULL );
+            utils_copy_folder( temp_filename1, temp_filename2, TRUE, NULL );
+        }
+	export_task_mark( task, "media", NULL );
+	if ( export_task_cancelled( task ) ) goto ios_dialog_cleanup2;
+	export_task_progress( task, "sign", 0, 0 );
+
+	g_free(str_out);
+	str_out = 0;
+
+	// find user name
+	argv = g_new0( gchar*, 6 );
+	argv[0] = g_strdup( "/usr/bin/id" );
+	argv[1] = g_strdup("-u");
+	argv[2] = g_strdup("-n");
+	argv[3] = NULL;
+
+	if ( !utils_spawn_sync( tmp_folder, argv, NULL, 0, NULL, NULL, &str_out, NULL, &status, &error) )
+	{
+		export_task_error( task, _("Failed to run userid program: %s"), error->message );
+		g_error_free(error);
+		error = NULL;
+		goto ios_dialog_cleanup2;
+	}
+	
+	if ( !str_out || !*str_out )
+	{
+		export_task_error( task, _("Failed to get user name (error: %d)"), status );
+		goto ios_dialog_cleanup2;
+	}
+
+	user_name = g_strdup( str_out );
+        user_name[ strlen(user_name)-1 ] = 0;
+
+	g_free(str_out);
+	str_out = 0;
+	g_strfreev(argv);
+	argv = 0;
+
+	// find group name
+	argv = g_new0( gchar*, 6 );
+	argv[0] = g_strdup( "/usr/bin/id" );
+	argv[1] = g_strdup("-g");
+	argv[2] = g_strdup("-n");
+	argv[3] = NULL;
+
+	if ( !utils_spawn_sync( tmp_folder, argv, NULL, 0, NULL, NULL, &str_out, NULL, &status, &error) )
+	{
+		export_task_error( task, _("Failed to run groupid program: %s"), error->message );
+		g_error_free(error);
+		error = NULL;
+		goto ios_dialog_cleanup2;
+	}
+	
+	if ( !str_out || !*str_out )
+	{
+		export_task_error( task, _("Failed to get group name (error: %d)"), status );
+		goto ios_dialog_cleanup2;
+	}
+
+	group_name = g_strdup( str_out );
+        group_name[ strlen(group_name)-1 ] = 0;
+
+	g_free(str_out);
+	str_out = 0;
+	g_strfreev(argv);
+	argv = 0;
+
+	// prepare bundle
+	argv = g_new0( gchar*, 6 );
+	argv[0] = g_strdup( "/usr/sbin/chown" );
+	argv[1] = g_strdup("-RH");
+	argv[2] = g_strconcat( user_name, ":", group_name, NULL );
+	argv[3] = g_strdup(app_folder);
+	argv[4] = NULL;
+        
+	if ( !utils_spawn_sync( tmp_folder, argv, NULL, 0, NULL, NULL, &str_out, NULL, &status, &error) )
+	{
+		export_task_error( task, _("Failed to run chown program: %s"), error->message );
+		g_error_free(error);
+		error = NULL;
+		goto ios_dialog_cleanup2;
+	}
+	
+        /*
+	if ( status != 0 && status < 256 )
+	{
+		if ( str_out && *str_out ) export_task_error( task, _("Failed to set file ownership (error: %s)"), str_out );
+		else export_task_error( task, _("Failed to set file ownership (error: %d)"), status );
+		goto ios_dialog_cleanup2;
+	}
+         */
+
+	g_free(str_out);
+	str_out = 0;
+	g_strfreev(argv);
+	argv = 0;
+
+	// prepare bundle 2
+	argv = g_new0( gchar*, 6 );
+	argv[0] = g_strdup( "/bin/chmod" );
+	argv[1] = g_strdup("-RH");
+	argv[2] = g_strdup("u+w,go-w,a+rX");
+	argv[3] = g_strdup(app_folder);
+	argv[4] = NULL;
+
+	if ( !utils_spawn_sync( tmp_folder, argv, NULL, 0, NULL, NULL, &str_out, NULL, &status, &error) )
+	{
+		export_task_error( task, _("Failed to run chmod program: %s"), error->message );
+		g_error_free(error);
+		error = NULL;
+		goto ios_dialog_cleanup2;
+	}
+	
+        /*
+	if ( status != 0 && status < 256 )
+	{
+		if ( str_out && *str_out ) export_task_error( task, _("Failed to set file permissions (error: %s)"), str_out );
+		else export_task_error( task, _("Failed to set file permissions (error: %d)"), status );
+		goto ios_dialog_cleanup2;
+	}
+         */
+
+	g_free(str_out);
+	str_out = 0;
+	g_strfreev(argv);
+	argv = 0;
+
+	// sign SnapChat
+	if ( temp_filename2 ) g_free(temp_filename2);
+	temp_filename2 = g_build_filename( app_folder, "Frameworks/SCSDKCoreKit.framework", NULL );
+	argv = g_new0( gchar*, 10 );
+	argv[0] = g_strdup( path_to_codesign );
+	argv[1] = g_strdup("--force");
+	argv[2] = g_strdup("--sign");
+	argv[3] = g_strdup(cert_hash);
+	//argv[4] = g_strdup("--entitlements");
+	//argv[5] = g_strdup(entitlements_file);
+	argv[4] = g_strdup(temp_filename2);
+	argv[5] = NULL;
+        
+	if ( !utils_spawn_sync( tmp_folder, argv, NULL, 0, NULL, NULL, &str_out, NULL, &status, &error) )
+	{
+		export_task_error( task, _("Failed to run codesign program: %s"), error->message );
+		g_error_free(error);
+		error = NULL;
+		goto ios_dialog_cleanup2;
+	}
+
+	g_strfreev(argv);
+	argv = 0;
+
+	// sign SnapChat2
+	if ( temp_filename2 ) g_free(temp_filename2);
+	temp_filename2 = g_build_filename( app_folder, "Frameworks/SCSDKCreativeKit.framework", NULL );
+	argv = g_new0( gchar*, 10 );
+	argv[0] = g_strdup( path_to_codesign );
+	argv[1] = g_strdup("--force");
+	argv[2] = g_strdup("--sign");
+	argv[3] = g_strdup(cert_hash);
+	//argv[4] = g_strdup("--entitlements");
+	//argv[5] = g_strdup(entitlements_file);
+	argv[4] = g_strdup(temp_filename2);
+	argv[5] = NULL;
+
+	if ( !utils_spawn_sync( tmp_folder, argv, NULL, 0, NULL, NULL, &str_out, NULL, &status, &error) )
+	{
+		export_task_error( task, _("Failed to run codesign program: %s"), error->message );
+		g_error_free(error);
+		error = NULL;
+		goto ios_dialog_cleanup2;
+	}
 
-		g_free(str_out);
-		str_out = 0;
+	g_strfreev(argv);
+	argv = 0;
+
+	// sign bundle
+	argv = g_new0( gchar*, 10 );
+	argv[0] = g_strdup( path_to_codesign );
+	argv[1] = g_strdup("--force");
+	argv[2] = g_strdup("--sign");
+	argv[3] = g_strdup(cert_hash);
+	//argv[4] = g_strdup("--resource-rules"); // Apple stopped using resource rules?
+	//argv[5] = g_strconcat( app_folder, "/ResourceRules.plist", NULL );
+	argv[4] = g_strdup("--entitlements");
+	argv[5] = g_strdup(entitlements_file);
+	argv[6] = g_strdup(app_folder);
+	argv[7] = NULL;
+        
+	if ( !utils_spawn_sync( tmp_folder, argv, NULL, 0, NULL, NULL, &str_out, NULL, &status, &error) )
+	{
+		export_task_error( task, _("Failed to run codesign program: %s"), error->message );
+		g_error_free(error);
+		error = NULL;
+		goto ios_dialog_cleanup2;
+	}
 
-		// convert plist to binary
-		argv = g_new0( gchar*, 6 );
-		argv[0] = g_strdup( "/usr/bin/plutil" );
-		argv[1] = g_strdup("-convert");
-		argv[2] = g_strdup("binary1");
-		argv[3] = g_strdup(temp_filename1);
-		argv[4] = NULL;
+	g_strfreev(argv);
+	argv = 0;
+	
+        /*
+	if ( status != 0 && status < 256 )
+	{
+		if ( str_out && *str_out ) export_task_error( task, _("Failed to sign app (error: %s)"), str_out );
+		else export_task_error( task, _("Failed to sign app (error: %d)"), status );
+		goto ios_dialog_cleanup2;
+	}
+         */
+			
 
-		if ( !utils_spawn_sync( tmp_folder, argv, NULL, 0, NULL, NULL, &str_out, NULL, &status, &error) )
-		{
-			SHOW_ERR1( _("Failed to run userid program: %s"), error->message );
-			g_error_free(error);
-			error = NULL;
-			goto ios_dialog_cleanup2;
-		}
+	export_task_mark( task, "sign", NULL );
+	if ( export_task_cancelled( task ) ) goto ios_dialog_cleanup2;
+	export_task_progress( task, "zip", 0, 0 );
 
-		g_strfreev(argv);
-		argv = 0;
-		
-        /*
-		if ( status != 0 )
-		{
-			SHOW_ERR1( _("Failed to get user name (error: %d)"), status );
+	// create IPA zip file
+	if ( !mz_zip_writer_init_file( &zip_archive, output_file_zip, 0 ) )
+	{
+		export_task_error( task, _("Failed to initialise zip file for writing") );
+		goto ios_dialog_cleanup2;
+	}
+	
+	if ( temp_filename1 ) g_free(temp_filename1);
+	temp_filename1 = g_strconcat( "Payload/", app_name, ".app", NULL );
+	{
+		// maximum deflate as before, the Android audio and video rule doesn't apply to an IPA,
+		// media the APK also deflated at that level is taken from the blob store
+		UtilsZipQueue *zip_queue = utils_zip_queue_new( &zip_archive );
+		gboolean zip_result;
+
+		utils_zip_queue_set_blob_store( zip_queue, export_blob_store() );
+		zip_result = utils_zip_queue_add_folder( zip_queue, app_folder, temp_filename1, TRUE, FALSE );
+		if ( !utils_zip_queue_finish( zip_queue ) ) zip_result = FALSE;
+		utils_zip_queue_free( zip_queue );
+		if ( !zip_result )
+		{
+			export_task_error( task, _("Failed to add files to IPA") );
 			goto ios_dialog_cleanup2;
 		}
-         */
-
-		// load icon file
-		if ( app_icon && *app_icon )
-		{
-			// write Icons.xcassets file
-			if ( !utils_copy_folder( icons_src_folder, icons_dst_folder, TRUE, NULL ) )
-			{
-				SHOW_ERR( _("Failed to create icon asset catalog") );
-				goto ios_dialog_cleanup2;
-			}
+	}
 
-			icon_image = gdk_pixbuf_new_from_file( app_icon, &error );
-			if ( !icon_image || error )
-			{
-				SHOW_ERR1( _("Failed to load image icon: %s"), error->message );
-				g_error_free(error);
-				error = NULL;
-				goto ios_dialog_cleanup2;
-			}
+	if ( !mz_zip_writer_finalize_archive( &zip_archive ) )
+	{
+		export_task_error( task, _("Failed to finalize IPA file") );
+		goto ios_dialog_cleanup2;
+	}
+	if ( !mz_zip_writer_end( &zip_archive ) )
+	{
+		export_task_error( task, _("Failed to end IPA file") );
+		goto ios_dialog_cleanup2;
+	}
 
-			temp_image_filename = g_build_path( "/", icons_sub_folder, "temp.png", NULL );
+	g_rename( output_file_zip, output_file );
+	export_task_mark( task, "zip", NULL );
 
-			// scale it and save it
-			// 152x152
-			image_filename = g_build_path( "/", icons_sub_folder, "icon-152.png", NULL );
-			icon_scaled_image = gdk_pixbuf_scale_simple( icon_image, 152, 152, GDK_INTERP_HYPER );
-			if ( !gdk_pixbuf_save( icon_scaled_image, temp_image_filename, "png", &error, "compression", "9", NULL ) )
-			{
-				SHOW_ERR1( _("Failed to save 152x152 icon: %s"), error->message );
-				g_error_free(error);
-				error = NULL;
-				goto ios_dialog_cleanup2;
-			}
-			gdk_pixbuf_unref( icon_scaled_image );
-			if ( !ios_convert_to_cgbi_png( temp_image_filename, image_filename ) ) goto ios_dialog_cleanup2;
-			g_unlink( temp_image_filename );
-			g_free( image_filename );
-
-			// 180x180
-			image_filename = g_build_path( "/", icons_sub_folder, "icon-180.png", NULL );
-			icon_scaled_image = gdk_pixbuf_scale_simple( icon_image, 180, 180, GDK_INTERP_HYPER );
-			if ( !gdk_pixbuf_save( icon_scaled_image, temp_image_filename, "png", &error, "compression", "9", NULL ) )
-			{
-				SHOW_ERR1( _("Failed to save 180x180 icon: %s"), error->message );
-				g_error_free(error);
-				error = NULL;
-				goto ios_dialog_cleanup2;
-			}
-			gdk_pixbuf_unref( icon_scaled_image );
-			if ( !ios_convert_to_cgbi_png( temp_image_filename, image_filename ) ) goto ios_dialog_cleanup2;
-			g_unlink( temp_image_filename );
-			g_free( image_filename );
-
-			// 167x167
-			image_filename = g_build_path( "/", icons_sub_folder, "icon-167.png", NULL );
-			icon_scaled_image = gdk_pixbuf_scale_simple( icon_image, 167, 167, GDK_INTERP_HYPER );
-			if ( !gdk_pixbuf_save( icon_scaled_image, temp_image_filename, "png", &error, "compression", "9", NULL ) )
-			{
-				SHOW_ERR1( _("Failed to save 167x167 icon: %s"), error->message );
-				g_error_free(error);
-				error = NULL;
-				goto ios_dialog_cleanup2;
-			}
-			gdk_pixbuf_unref( icon_scaled_image );
-			if ( !ios_convert_to_cgbi_png( temp_image_filename, image_filename ) ) goto ios_dialog_cleanup2;
-			g_unlink( temp_image_filename );
-			g_free( image_filename );
-
-			// 120x120
-			image_filename = g_build_path( "/", icons_sub_folder, "icon-120.png", NULL );
-			icon_scaled_image = gdk_pixbuf_scale_simple( icon_image, 120, 120, GDK_INTERP_HYPER );
-			if ( !gdk_pixbuf_save( icon_scaled_image, temp_image_filename, "png", &error, "compression", "9", NULL ) )
-			{
-				SHOW_ERR1( _("Failed to save 120x120 icon: %s"), error->message );
-				g_error_free(error);
-				error = NULL;
-				goto ios_dialog_cleanup2;
-			}
-			gdk_pixbuf_unref( icon_scaled_image );
-			if ( !ios_convert_to_cgbi_png( temp_image_filename, image_filename ) ) goto ios_dialog_cleanup2;
-			g_unlink( temp_image_filename );
-			g_free( image_filename );
-
-			// 76x76
-			image_filename = g_build_path( "/", icons_sub_folder, "icon-76.png", NULL );
-			icon_scaled_image = gdk_pixbuf_scale_simple( icon_image, 76, 76, GDK_INTERP_HYPER );
-			if ( !gdk_pixbuf_save( icon_scaled_image, temp_image_filename, "png", &error, "compression", "9", NULL ) )
-			{
-				SHOW_ERR1( _("Failed to save 76x76 icon: %s"), error->message );
-				g_error_free(error);
-				error = NULL;
-				goto ios_dialog_cleanup2;
-			}
-			gdk_pixbuf_unref( icon_scaled_image );
-			if ( !ios_convert_to_cgbi_png( temp_image_filename, image_filename ) ) goto ios_dialog_cleanup2;
-			g_unlink( temp_image_filename );
-			g_free( image_filename );
+	// for the next export, failing to record it only means that one can't be skipped
+	utils_fingerprint_add_output( fingerprint, output_file );
+	utils_fingerprint_save( fingerprint );
+	success = TRUE;
 
-			/*
-			// 60x60
-			image_filename = g_build_path( "/", icons_sub_folder, "icon-60.png", NULL );
-			icon_scaled_image = gdk_pixbuf_scale_simple( icon_image, 60, 60, GDK_INTERP_HYPER );
-			if ( !gdk_pixbuf_save( icon_scaled_image, temp_image_filename, "png", &error, "compression", "9", NULL ) )
-			{
-				SHOW_ERR1( _("Failed to save 60x60 icon: %s"), error->message );
-				g_error_free(error);
-				error = NULL;
-				goto ios_dialog_cleanup2;
-			}
-			gdk_pixbuf_unref( icon_scaled_image );
-			if ( !ios_convert_to_cgbi_png( temp_image_filename, image_filename ) ) goto ios_dialog_cleanup2;
-			g_unlink( temp_image_filename );
-			g_free( image_filename );
-			*/
+ios_dialog_cleanup2:
+	utils_remove_folder_full( tmp_folder, export_folder_progress, NULL );
+
+	if ( output_file_zip ) g_free(output_file_zip);
+	if ( ios_folder ) g_free(ios_folder);
+	if ( tmp_folder ) g_free(tmp_folder);
+	if ( src_folder ) g_free(src_folder);
+	if ( app_folder ) g_free(app_folder);
+	if ( app_folder_name ) g_free(app_folder_name);
+	if ( no_ads_binary ) g_free(no_ads_binary);
+	if ( icons_src_folder ) g_free(icons_src_folder);
+	if ( icons_dst_folder ) g_free(icons_dst_folder);
+	if ( icons_sub_folder ) g_free(icons_sub_folder);
+
+	if ( error ) g_error_free(error);
+	if ( str_out ) g_free(str_out);
+	if ( argv ) g_strfreev(argv);
+	if ( contents ) g_free(contents);
+	if ( certificate_data ) g_free(certificate_data);
+	if ( team_id ) g_free(team_id);
+	if ( bundle_id ) g_free(bundle_id);
+	if ( cert_hash ) g_free(cert_hash);
+	if ( cert_temp ) g_free(cert_temp);
+	if ( app_group_data ) g_free(app_group_data);
+
+	if ( entitlements_file ) g_free(entitlements_file);
+	if ( expanded_entitlements_file ) g_free(expanded_entitlements_file);
+	if ( temp_filename1 ) g_free(temp_filename1);
+	if ( temp_filename2 ) g_free(temp_filename2);
+	if ( version_string ) g_free(version_string);
+	if ( build_string ) g_free(build_string);
+	if ( image_filename ) g_free(image_filename);
+	if ( user_name ) g_free(user_name);
+	if ( group_name ) g_free(group_name);
+	utils_icon_set_free( icon_set );
+	if ( splash_image ) gdk_pixbuf_unref(splash_image);
+	utils_fingerprint_free( fingerprint );
+	g_free( changes );
+	return success;
+}
 
-			// 1024x1024
-			image_filename = g_build_path( "/", icons_sub_folder, "icon-1024.png", NULL );
-			icon_scaled_image = gdk_pixbuf_scale_simple( icon_image, 1024, 1024, GDK_INTERP_HYPER );
-			if ( !gdk_pixbuf_save( icon_scaled_image, temp_image_filename, "png", &error, "compression", "9", NULL ) )
-			{
-				SHOW_ERR1( _("Failed to save 1024x1024 icon: %s"), error->message );
-				g_error_free(error);
-				error = NULL;
-				goto ios_dialog_cleanup2;
-			}
-			gdk_pixbuf_unref( icon_scaled_image );
-			if ( !ios_convert_to_cgbi_png( temp_image_filename, image_filename ) ) goto ios_dialog_cleanup2;
-			g_unlink( temp_image_filename );
-			g_free( image_filename );
-			g_free( temp_image_filename );
+static void ios_export_task_done( ExportTask *task, gboolean success, gpointer data )
+{
+	IosExportJob *job = data;
 
-			icon_scaled_image = NULL;
-			image_filename = NULL;
-			temp_image_filename = NULL;
-
-			// run actool to compile asset catalog, it will copy the app icons to the app_folder and create the Assets.car file
-			argv = g_new0( gchar*, 20 );
-			argv[0] = g_strdup( path_to_actool );
-			argv[1] = g_strdup("--output-partial-info-plist");
-			argv[2] = g_strdup("temp.plist");
-			argv[3] = g_strdup("--app-icon");
-			argv[4] = g_strdup("AppIcon");
-			argv[5] = g_strdup("--target-device");
-			argv[6] = g_strdup("iphone");
-			argv[7] = g_strdup("--target-device");
-			argv[8] = g_strdup("ipad");
-			argv[9] = g_strdup("--minimum-deployment-target");
-			argv[10] = g_strdup("9.0");
-			argv[11] = g_strdup("--platform");
-			argv[12] = g_strdup("iphoneos");
-			argv[13] = g_strdup("--product-type");
-			argv[14] = g_strdup("com.apple.product-type.application");
-			argv[15] = g_strdup("--compress-pngs");
-			argv[16] = g_strdup("--compile");
-			argv[17] = g_strdup(app_folder_name);
-			argv[18] = g_strdup("Icons.xcassets");
-			argv[19] = NULL;
-
-			if ( !utils_spawn_sync( tmp_folder, argv, NULL, 0, NULL, NULL, &str_out, NULL, &status, &error) )
-			{
-				SHOW_ERR1( _("Failed to run \"actool\" program: %s"), error->message );
-				g_error_free(error);
-				error = NULL;
-				goto ios_dialog_cleanup2;
-			}
-		
-			if ( !str_out || strstr(str_out,"actool.errors") != 0 || strstr(str_out,"actool.warnings") != 0 || strstr(str_out,"actool.notices") != 0 )
-			{
-				if ( str_out && *str_out ) dialogs_show_msgbox(GTK_MESSAGE_ERROR, _("Failed to compile asset catalog (error %d: %s)"), status, str_out );
-				else SHOW_ERR1( _("Failed to get compile asset catalog (error: %d)"), status );
-				goto ios_dialog_cleanup2;
-			}
+	ios_export_task = NULL;
+	export_project_release( job->base_path );
+	gtk_widget_set_sensitive( ui_lookup_widget(ui_widgets.ios_dialog, "ios_export1"), TRUE );
 
-			g_free(str_out);
-			str_out = 0;
-			g_strfreev(argv);
-			argv = 0;
-		}
+	if ( success ) gtk_widget_hide( ui_widgets.ios_dialog );
+	else if ( !export_task_cancelled( task ) ) SHOW_ERR1( "%s", task->error );
 
-		while (gtk_events_pending())
-			gtk_main_iteration();
+	if ( success && job->unchanged )
+		ui_set_statusbar( TRUE, _("Nothing has changed since the last iOS export, %s is up to date."), job->output_file );
 
-		// copy splash logo
-		if ( app_splash_logo && *app_splash_logo )
-		{
-			if ( temp_filename1 ) g_free(temp_filename1);
-			temp_filename1 = g_build_filename( app_folder, "SplashLogo.png", NULL );
-			utils_copy_file( app_splash_logo, temp_filename1, TRUE, NULL );
-		}
-		
-		if ( app_splash_color && *app_splash_color )
-		{
-			int iRed = hextoint( app_splash_color[0] ) * 16 + hextoint( app_splash_color[1] );
-			int iGreen = hextoint( app_splash_color[2] ) * 16 + hextoint( app_splash_color[3] );
-			int iBlue = hextoint( app_splash_color[4] ) * 16 + hextoint( app_splash_color[5] );
+	ios_export_job_free( data );
+}
 
-			float red = iRed / 255.0f;
-			float green = iGreen / 255.0f;
-			float blue = iBlue / 255.0f;
+static void on_ios_dialog_response(GtkDialog *dialog, gint response, gpointer user_data)
+{
+	// while exporting the close button cancels the export
+	if ( ios_export_task )
+	{
+		if ( response != 1 ) export_task_cancel( ios_export_task );
+		return;
+	}
 
-			// edit UntitledViewController
-			if ( temp_filename1 ) g_free(temp_filename1);
-			temp_filename1 = g_build_filename( app_folder, "UntitledViewController.xib", NULL );
+	if ( app->project && !ios_exporting_player )
+	{
+		GtkWidget *widget; 
 
-			if ( contents ) g_free(contents);
-			contents = 0;
-			if ( !g_file_get_contents( temp_filename1, &contents, &length, NULL ) )
-			{
-				SHOW_ERR( _("Failed to read UntitledViewController.xib file") );
-				goto ios_dialog_cleanup2;
-			}
+		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_app_name_entry");
+		AGK_CLEAR_STR(app->project->ipa_settings.app_name) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+		
+		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_provisioning_entry");
+		AGK_CLEAR_STR(app->project->ipa_settings.prov_profile_path) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-			*newcontents = 0;
-			char* start = strstr( contents, "backgroundColor\"" );
-			if ( !start )
-			{
-				SHOW_ERR( _("Failed to modify UntitledViewController.xib, backgroundColor not found") );
-				goto ios_dialog_cleanup2;
-			}
+		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_app_icon_entry");
+		AGK_CLEAR_STR(app->project->ipa_settings.app_icon_path) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-			start += strlen("backgroundColor\"");
-			*start = 0;
-			strcpy( newcontents, contents );
-			*start = ' ';
+		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_firebase_config_entry");
+		AGK_CLEAR_STR(app->project->ipa_settings.firebase_config_path) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-			char newcolor[ 256 ];
-			*newcolor = 0;
-			sprintf( newcolor, " red=\"%f\" green=\"%f\" blue=\"%f\" ", red, green, blue );
-			strcat( newcontents, newcolor );
+		// splash screens
+		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_app_splash_entry");
+		AGK_CLEAR_STR(app->project->ipa_settings.splash_logo) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-			start = strstr( start, "alpha=" );
-			if ( !start )
-			{
-				SHOW_ERR( _("Failed to modify UntitledViewController.xib, alpha not found") );
-				goto ios_dialog_cleanup2;
-			}
+		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_app_splash_entry2");
+		AGK_CLEAR_STR(app->project->ipa_settings.splash_color) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-			strcat( newcontents, start );
+		//widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_facebook_id_entry");
+		//AGK_CLEAR_STR(app->project->ipa_settings.facebook_id) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-			if ( !g_file_set_contents( temp_filename1, newcontents, strlen(newcontents), &error ) )
-			{
-				SHOW_ERR1( _("Failed to write UntitledViewController.xib file: %s"), error->message );
-				g_error_free(error);
-				error = NULL;
-				goto ios_dialog_cleanup2;
-			}
-			
-			// edit storyboard
-			if ( temp_filename1 ) g_free(temp_filename1);
-			temp_filename1 = g_build_filename( app_folder, "LaunchScreen.storyboard", NULL );
+		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_url_scheme_entry");
+		AGK_CLEAR_STR(app->project->ipa_settings.url_scheme) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-			if ( contents ) g_free(contents);
-			contents = 0;
-			if ( !g_file_get_contents( temp_filename1, &contents, &length, NULL ) )
-			{
-				SHOW_ERR( _("Failed to read LaunchScreen.storyboard file") );
-				goto ios_dialog_cleanup2;
-			}	
+		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_deep_link_entry");
+		AGK_CLEAR_STR(app->project->ipa_settings.deep_link) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-			*newcontents = 0;
-			start = strstr( contents, "backgroundColor\"" );
-			if ( !start )
-			{
-				SHOW_ERR( _("Failed to modify LaunchScreen.storyboard, backgroundColor not found") );
-				goto ios_dialog_cleanup2;
-			}
+		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_admob_app_id_entry");
+		AGK_CLEAR_STR(app->project->ipa_settings.admob_app_id) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-			start += strlen("backgroundColor\"");
-			*start = 0;
-			strcpy( newcontents, contents );
-			*start = ' ';
+		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_snapchat_client_id_entry");
+		AGK_CLEAR_STR(app->project->ipa_settings.snapchat_client_id) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-			*newcolor = 0;
-			sprintf( newcolor, " red=\"%f\" green=\"%f\" blue=\"%f\" ", red, green, blue );
-			strcat( newcontents, newcolor );
+		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_orientation_combo");
+		app->project->ipa_settings.orientation = gtk_combo_box_get_active(GTK_COMBO_BOX_TEXT(widget));
+				
+		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_version_number_entry");
+		AGK_CLEAR_STR(app->project->ipa_settings.version_number) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+		
+		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_build_number_entry");
+		AGK_CLEAR_STR(app->project->ipa_settings.build_number) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-			start = strstr( start, "alpha=" );
-			if ( !start )
-			{
-				SHOW_ERR( _("Failed to modify LaunchScreen.storyboard, alpha not found") );
-				goto ios_dialog_cleanup2;
-			}
+		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_device_combo");
+		app->project->ipa_settings.device_type = gtk_combo_box_get_active(GTK_COMBO_BOX_TEXT(widget));
+		
+		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_app_uses_ads");
+		app->project->ipa_settings.uses_ads = gtk_toggle_button_get_active( GTK_TOGGLE_BUTTON(widget) );
 
-			strcat( newcontents, start );
+		// output
+		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_output_file_entry");
+		app->project->ipa_settings.output_path = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+	}
 
-			if ( !g_file_set_contents( temp_filename1, newcontents, strlen(newcontents), &error ) )
-			{
-				SHOW_ERR1( _("Failed to write LaunchScreen.storyboard file: %s"), error->message );
-				g_error_free(error);
-				error = NULL;
-				goto ios_dialog_cleanup2;
-			}
-		}
+	if ( response != 1 )
+	{
+		gtk_widget_hide(GTK_WIDGET(dialog));
+	}
+	else
+	{
+		int i;
+		GtkWidget *widget;
+		IosExportJob *job;
 
-		// compile UntitledViewController
-		argv = g_new0( gchar*, 19 );
-		argv[0] = g_strdup( path_to_ibtool );
-		argv[1] = g_strdup("--errors");
-		argv[2] = g_strdup("--warnings");
-		argv[3] = g_strdup("--notices");
-		argv[4] = g_strdup("--module");
-		argv[5] = g_strdup("AppGameKit_Player");
-		argv[6] = g_strdup("--auto-activate-custom-fonts");
-		argv[7] = g_strdup("--target-device");
-		argv[8] = g_strdup("iphone");
-		argv[9] = g_strdup("--target-device");
-		argv[10] = g_strdup("ipad");
-		argv[11] = g_strdup("--minimum-deployment-target");
-		argv[12] = g_strdup("9.0");
-		argv[13] = g_strdup("--output-format");
-		argv[14] = g_strdup("human-readable-text");
-		argv[15] = g_strdup("--compile");
-		argv[16] = g_strdup("UntitledViewController.nib");
-		argv[17] = g_strdup("UntitledViewController.xib");
-		argv[18] = NULL;
-			
-		if ( !utils_spawn_sync( app_folder, argv, NULL, 0, NULL, NULL, &str_out, NULL, &status, &error) )
-		{
-			SHOW_ERR1( _("Failed to run \"ibtool\" program: %s"), error->message );
-			g_error_free(error);
-			error = NULL;
-			goto ios_dialog_cleanup2;
-		}
+		// app details
+		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_app_name_entry");
+		gchar *app_name = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 		
-		if ( !str_out || strstr(str_out,"ibtool.errors") != 0 || strstr(str_out,"ibtool.warnings") != 0 || strstr(str_out,"ibtool.notices") != 0 )
-		{
-			if ( str_out && *str_out ) dialogs_show_msgbox(GTK_MESSAGE_ERROR, _("Failed to compile UntitledViewController.nib (error %d: %s)"), status, str_out );
-			else SHOW_ERR1( _("Failed to get compile UntitledViewController.nib (error: %d)"), status );
-			goto ios_dialog_cleanup2;
-		}
+		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_provisioning_entry");
+		gchar *profile = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-		g_free(str_out);
-		str_out = 0;
-		g_strfreev(argv);
-		argv = 0;
+		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_app_icon_entry");
+		gchar *app_icon = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-		// delete old UntitledViewController.xib
-		if ( temp_filename1 ) g_free(temp_filename1);
-		temp_filename1 = g_build_filename( app_folder, "UntitledViewController.xib", NULL );
-		g_unlink( temp_filename1 );
+		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_firebase_config_entry");
+		gchar *firebase_config = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
+		// splash screens
+		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_app_splash_entry");
+		gchar *app_splash_logo = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-		// compile storyboard
-		argv = g_new0( gchar*, 19 );
-		argv[0] = g_strdup( path_to_ibtool );
-		argv[1] = g_strdup("--errors");
-		argv[2] = g_strdup("--warnings");
-		argv[3] = g_strdup("--notices");
-		argv[4] = g_strdup("--module");
-		argv[5] = g_strdup("AppGameKit_Player");
-		argv[6] = g_strdup("--auto-activate-custom-fonts");
-		argv[7] = g_strdup("--target-device");
-		argv[8] = g_strdup("iphone");
-		argv[9] = g_strdup("--target-device");
-		argv[10] = g_strdup("ipad");
-		argv[11] = g_strdup("--minimum-deployment-target");
-		argv[12] = g_strdup("9.0");
-		argv[13] = g_strdup("--output-format");
-		argv[14] = g_strdup("human-readable-text");
-		argv[15] = g_strdup("--compilation-directory");
-		argv[16] = g_strdup("./");
-		argv[17] = g_strdup("LaunchScreen.storyboard");
-		argv[18] = NULL;
-			
-		if ( !utils_spawn_sync( app_folder, argv, NULL, 0, NULL, NULL, &str_out, NULL, &status, &error) )
-		{
-			SHOW_ERR1( _("Failed to run \"ibtool\" program: %s"), error->message );
-			g_error_free(error);
-			error = NULL;
-			goto ios_dialog_cleanup2;
-		}
-		
-		if ( !str_out || strstr(str_out,"ibtool.errors") != 0 || strstr(str_out,"ibtool.warnings") != 0 || strstr(str_out,"ibtool.notices") != 0 )
-		{
-			if ( str_out && *str_out ) dialogs_show_msgbox(GTK_MESSAGE_ERROR, _("Failed to compile LaunchScreen.storyboard (error %d: %s)"), status, str_out );
-			else SHOW_ERR1( _("Failed to get compile LaunchScreen.storyboard (error: %d)"), status );
-			goto ios_dialog_cleanup2;
-		}
+		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_app_splash_entry2");
+		gchar *app_splash_color = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-		g_free(str_out);
-		str_out = 0;
-		g_strfreev(argv);
-		argv = 0;
+		//widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_facebook_id_entry");
+		//gchar *facebook_id = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-		// delete old storyboard
-		if ( temp_filename1 ) g_free(temp_filename1);
-		temp_filename1 = g_build_filename( app_folder, "LaunchScreen.storyboard", NULL );
-		g_unlink( temp_filename1 );
-		
-		while (gtk_events_pending())
-			gtk_main_iteration();
+		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_url_scheme_entry");
+		gchar *url_scheme = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-		// copy media folder
-        if ( !ios_exporting_player && app->project )
-        {
-            if ( temp_filename1 ) g_free(temp_filename1);
-            temp_filename1 = g_build_filename( app->project->base_path, "media", NULL );
-            temp_filename2 = g_build_filename( app_folder, "media", NULL );
-            utils_copy_folder( temp_filename1, temp_filename2, TRUE, NULL );
-        }
+		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_deep_link_entry");
+		gchar *deep_link = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+
+		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_admob_app_id_entry");
+		gchar *admob_app_id = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-		g_free(str_out);
-		str_out = 0;
+		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_snapchat_client_id_entry");
+		gchar *snapchat_client_id = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-		// find user name
-		argv = g_new0( gchar*, 6 );
-		argv[0] = g_strdup( "/usr/bin/id" );
-		argv[1] = g_strdup("-u");
-		argv[2] = g_strdup("-n");
-		argv[3] = NULL;
+		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_orientation_combo");
+		int orientation = gtk_combo_box_get_active(GTK_COMBO_BOX_TEXT(widget));
+				
+		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_version_number_entry");
+		gchar *version_number = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+		if ( !*version_number ) SETPTR( version_number, g_strdup("1.0.0") );
 
-		if ( !utils_spawn_sync( tmp_folder, argv, NULL, 0, NULL, NULL, &str_out, NULL, &status, &error) )
-		{
-			SHOW_ERR1( _("Failed to run userid program: %s"), error->message );
-			g_error_free(error);
-			error = NULL;
-			goto ios_dialog_cleanup2;
-		}
-		
-		if ( !str_out || !*str_out )
-		{
-			SHOW_ERR1( _("Failed to get user name (error: %d)"), status );
-			goto ios_dialog_cleanup2;
-		}
+		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_build_number_entry");
+		gchar *build_number = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+		if ( !*build_number ) SETPTR( build_number, g_strdup("1.0") );
 
-		user_name = g_strdup( str_out );
-        user_name[ strlen(user_name)-1 ] = 0;
+		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_device_combo");
+		int device_type = gtk_combo_box_get_active(GTK_COMBO_BOX_TEXT(widget));;
 
-		g_free(str_out);
-		str_out = 0;
-		g_strfreev(argv);
-		argv = 0;
+		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_app_uses_ads");
+		int uses_ads = gtk_toggle_button_get_active( GTK_TOGGLE_BUTTON(widget) );
 
-		// find group name
-		argv = g_new0( gchar*, 6 );
-		argv[0] = g_strdup( "/usr/bin/id" );
-		argv[1] = g_strdup("-g");
-		argv[2] = g_strdup("-n");
-		argv[3] = NULL;
+		// output
+		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_output_file_entry");
+		gchar *output_file = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-		if ( !utils_spawn_sync( tmp_folder, argv, NULL, 0, NULL, NULL, &str_out, NULL, &status, &error) )
-		{
-			SHOW_ERR1( _("Failed to run groupid program: %s"), error->message );
-			g_error_free(error);
-			error = NULL;
-			goto ios_dialog_cleanup2;
-		}
-		
-		if ( !str_out || !*str_out )
+		gchar *percent = 0;
+		while ( (percent = strchr(output_file, '%')) != 0 )
 		{
-			SHOW_ERR1( _("Failed to get group name (error: %d)"), status );
-			goto ios_dialog_cleanup2;
+			if ( strncmp( percent+1, "[version]", strlen("[version]") ) == 0 )
+			{
+				*percent = 0;
+				percent += strlen("[version]") + 1;
+				gchar *new_output = g_strconcat( output_file, build_number, percent, NULL );
+				g_free(output_file);
+				output_file = new_output;
+				continue;
+			}
+
+			break;
 		}
 
-		group_name = g_strdup( str_out );
-        group_name[ strlen(group_name)-1 ] = 0;
 
-		g_free(str_out);
-		str_out = 0;
-		g_strfreev(argv);
-		argv = 0;
+		// START CHECKS
 
-		// prepare bundle
-		argv = g_new0( gchar*, 6 );
-		argv[0] = g_strdup( "/usr/sbin/chown" );
-		argv[1] = g_strdup("-RH");
-		argv[2] = g_strconcat( user_name, ":", group_name, NULL );
-		argv[3] = g_strdup(app_folder);
-		argv[4] = NULL;
-        
-		if ( !utils_spawn_sync( tmp_folder, argv, NULL, 0, NULL, NULL, &str_out, NULL, &status, &error) )
+		if ( !output_file || !*output_file ) { SHOW_ERR(_("You must choose an output location to save your IPA")); goto ios_dialog_clean_up; }
+		if ( strchr(output_file, '.') == 0 ) { SHOW_ERR(_("The output location must be a file not a directory")); goto ios_dialog_clean_up; }
+
+		// check app name
+		if ( !app_name || !*app_name ) { SHOW_ERR(_("You must enter an app name")); goto ios_dialog_clean_up; }
+		if ( strlen(app_name) > 30 ) { SHOW_ERR(_("App name must be less than 30 characters")); goto ios_dialog_clean_up; }
+		for( i = 0; i < strlen(app_name); i++ )
 		{
-			SHOW_ERR1( _("Failed to run chown program: %s"), error->message );
-			g_error_free(error);
-			error = NULL;
-			goto ios_dialog_cleanup2;
+			/*
+			if ( (app_name[i] < 97 || app_name[i] > 122)
+			  && (app_name[i] < 65 || app_name[i] > 90) 
+			  && (app_name[i] < 48 || app_name[i] > 57) 
+			  && app_name[i] != 32 
+			  && app_name[i] != 95 ) 
+			{ 
+				SHOW_ERR(_("App name contains invalid characters, must be A-Z 0-9 spaces and undersore only")); 
+				goto ios_dialog_clean_up; 
+			}
+			*/
+			//switch to black list
+			if ( app_name[i] == 34 || app_name[i] == 60 
+			  || app_name[i] == 62 || app_name[i] == 39
+			  || app_name[i] == 42 || app_name[i] == 46
+			  || app_name[i] == 47 || app_name[i] == 92
+			  || app_name[i] == 58 || app_name[i] == 59
+			  || app_name[i] == 124 || app_name[i] == 61
+			  || app_name[i] == 44 || app_name[i] == 38 )
+			{
+				SHOW_ERR(_("App name contains invalid characters, it must not contain quotes or any of the following < > * . / \\ : ; | = , &"));
+				goto ios_dialog_clean_up; 
+			}
 		}
 		
-        /*
-		if ( status != 0 && status < 256 )
+		// check icon
+		//if ( !app_icon || !*app_icon ) { SHOW_ERR(_("You must select an app icon")); goto ios_dialog_clean_up; }
+		if ( app_icon && *app_icon )
 		{
-			if ( str_out && *str_out ) SHOW_ERR1( _("Failed to set file ownership (error: %s)"), str_out );
-			else SHOW_ERR1( _("Failed to set file ownership (error: %d)"), status );
-			goto ios_dialog_cleanup2;
+			if ( !strrchr( app_icon, '.' ) || utils_str_casecmp( strrchr( app_icon, '.' ), ".png" ) != 0 ) { SHOW_ERR(_("App icon must be a PNG file")); goto ios_dialog_clean_up; }
+			if ( !g_file_test( app_icon, G_FILE_TEST_EXISTS ) ) { SHOW_ERR(_("Could not find app icon location")); goto ios_dialog_clean_up; }
 		}
-         */
-
-		g_free(str_out);
-		str_out = 0;
-		g_strfreev(argv);
-		argv = 0;
 
-		// prepare bundle 2
-		argv = g_new0( gchar*, 6 );
-		argv[0] = g_strdup( "/bin/chmod" );
-		argv[1] = g_strdup("-RH");
-		argv[2] = g_strdup("u+w,go-w,a+rX");
-		argv[3] = g_strdup(app_folder);
-		argv[4] = NULL;
-
-		if ( !utils_spawn_sync( tmp_folder, argv, NULL, 0, NULL, NULL, &str_out, NULL, &status, &error) )
-		{
-			SHOW_ERR1( _("Failed to run chmod program: %s"), error->message );
-			g_error_free(error);
-			error = NULL;
-			goto ios_dialog_cleanup2;
-		}
-		
-        /*
-		if ( status != 0 && status < 256 )
+		if ( firebase_config && *firebase_config )
 		{
-			if ( str_out && *str_out ) SHOW_ERR1( _("Failed to set file permissions (error: %s)"), str_out );
-			else SHOW_ERR1( _("Failed to set file permissions (error: %d)"), status );
-			goto ios_dialog_cleanup2;
+			if ( !strrchr( firebase_config, '.' ) || utils_str_casecmp( strrchr( firebase_config, '.' ), ".plist" ) != 0 ) { SHOW_ERR(_("Firebase config file must be a .plist file")); goto ios_dialog_clean_up; }
+			if ( !g_file_test( firebase_config, G_FILE_TEST_EXISTS ) ) { SHOW_ERR(_("Could not find Firebase config file")); goto ios_dialog_clean_up; }
 		}
-         */
-
-		g_free(str_out);
-		str_out = 0;
-		g_strfreev(argv);
-		argv = 0;
 
-		// sign SnapChat
-		if ( temp_filename2 ) g_free(temp_filename2);
-		temp_filename2 = g_build_filename( app_folder, "Frameworks/SCSDKCoreKit.framework", NULL );
-		argv = g_new0( gchar*, 10 );
-		argv[0] = g_strdup( path_to_codesign );
-		argv[1] = g_strdup("--force");
-		argv[2] = g_strdup("--sign");
-		argv[3] = g_strdup(cert_hash);
-		//argv[4] = g_strdup("--entitlements");
-		//argv[5] = g_strdup(entitlements_file);
-		argv[4] = g_strdup(temp_filename2);
-		argv[5] = NULL;
-        
-		if ( !utils_spawn_sync( tmp_folder, argv, NULL, 0, NULL, NULL, &str_out, NULL, &status, &error) )
+		// check splash screen logo
+		if ( app_splash_logo && *app_splash_logo )
 		{
-			SHOW_ERR1( _("Failed to run codesign program: %s"), error->message );
-			g_error_free(error);
-			error = NULL;
-			goto ios_dialog_cleanup2;
+			if ( !strrchr( app_splash_logo, '.' ) || utils_str_casecmp( strrchr( app_splash_logo, '.' ), ".png" ) != 0 ) { SHOW_ERR(_("Splash Screen Logo must be a PNG file")); goto ios_dialog_clean_up; }
+			if ( !g_file_test( app_splash_logo, G_FILE_TEST_EXISTS ) ) { SHOW_ERR(_("Could not find Splash Screen Logo location")); goto ios_dialog_clean_up; }
 		}
 
-		g_strfreev(argv);
-		argv = 0;
-
-		// sign SnapChat2
-		if ( temp_filename2 ) g_free(temp_filename2);
-		temp_filename2 = g_build_filename( app_folder, "Frameworks/SCSDKCreativeKit.framework", NULL );
-		argv = g_new0( gchar*, 10 );
-		argv[0] = g_strdup( path_to_codesign );
-		argv[1] = g_strdup("--force");
-		argv[2] = g_strdup("--sign");
-		argv[3] = g_strdup(cert_hash);
-		//argv[4] = g_strdup("--entitlements");
-		//argv[5] = g_strdup(entitlements_file);
-		argv[4] = g_strdup(temp_filename2);
-		argv[5] = NULL;
-
-		if ( !utils_spawn_sync( tmp_folder, argv, NULL, 0, NULL, NULL, &str_out, NULL, &status, &error) )
+		// check splash screen color
+		if ( app_splash_color && *app_splash_color )
 		{
-			SHOW_ERR1( _("Failed to run codesign program: %s"), error->message );
-			g_error_free(error);
-			error = NULL;
-			goto ios_dialog_cleanup2;
+			if ( strlen( app_splash_color ) != 6 ) { SHOW_ERR(_("Splash Screen Color must be a 6 digit hex value, e.g. E86C2B")); goto ios_dialog_clean_up; }
+			int i;
+			for( i = 0; i < strlen(app_splash_color); i++ )
+			{
+				if ( app_splash_color[i] >= 97 && app_splash_color[i] <= 102 ) app_splash_color[i] -= 32; // change to upper case
+				if ( (app_splash_color[i] < 48 || app_splash_color[i] > 57) && (app_splash_color[i] < 65 || app_splash_color[i] > 70) ) 
+				{ 
+					SHOW_ERR(_("Splash Screen Color must be a 6 digit hex value, e.g. E86C2B")); 
+					goto ios_dialog_clean_up; 
+				}
+			}
 		}
 
-		g_strfreev(argv);
-		argv = 0;
+		// check profile
+		if ( !profile || !*profile ) { SHOW_ERR(_("You must select a provisioning profile")); goto ios_dialog_clean_up; }
+		if ( !strrchr( profile, '.' ) || utils_str_casecmp( strrchr( profile, '.' ), ".mobileprovision" ) != 0 ) { SHOW_ERR(_("Provisioning profile must have .mobileprovision extension")); goto ios_dialog_clean_up; }
+		if ( !g_file_test( profile, G_FILE_TEST_EXISTS ) ) { SHOW_ERR(_("Could not find provisioning profile location")); goto ios_dialog_clean_up; }
 
-		// sign bundle
-		argv = g_new0( gchar*, 10 );
-		argv[0] = g_strdup( path_to_codesign );
-		argv[1] = g_strdup("--force");
-		argv[2] = g_strdup("--sign");
-		argv[3] = g_strdup(cert_hash);
-		//argv[4] = g_strdup("--resource-rules"); // Apple stopped using resource rules?
-		//argv[5] = g_strconcat( app_folder, "/ResourceRules.plist", NULL );
-		argv[4] = g_strdup("--entitlements");
-		argv[5] = g_strdup(entitlements_file);
-		argv[6] = g_strdup(app_folder);
-		argv[7] = NULL;
-        
-		if ( !utils_spawn_sync( tmp_folder, argv, NULL, 0, NULL, NULL, &str_out, NULL, &status, &error) )
+		// check version
+		if ( !version_number || !*version_number ) { SHOW_ERR(_("You must enter a version number, e.g. 1.0.0")); goto ios_dialog_clean_up; }
+		for( i = 0; i < strlen(version_number); i++ )
 		{
-			SHOW_ERR1( _("Failed to run codesign program: %s"), error->message );
-			g_error_free(error);
-			error = NULL;
-			goto ios_dialog_cleanup2;
+			if ( (version_number[i] < 48 || version_number[i] > 57) && version_number[i] != 46 ) 
+			{ 
+				SHOW_ERR(_("Version number contains invalid characters, must be 0-9 and . only")); 
+				goto ios_dialog_clean_up; 
+			}
 		}
 
-		g_strfreev(argv);
-		argv = 0;
-		
-        /*
-		if ( status != 0 && status < 256 )
+		// check facebook id
+		/*
+		if ( facebook_id && *facebook_id )
 		{
-			if ( str_out && *str_out ) SHOW_ERR1( _("Failed to sign app (error: %s)"), str_out );
-			else SHOW_ERR1( _("Failed to sign app (error: %d)"), status );
-			goto ios_dialog_cleanup2;
+			for( i = 0; i < strlen(facebook_id); i++ )
+			{
+				if ( (facebook_id[i] < 48 || facebook_id[i] > 57) ) 
+				{ 
+					SHOW_ERR(_("Facebook App ID must be numbers only")); 
+					goto ios_dialog_clean_up; 
+				}
+			}
 		}
-         */
-				
+		*/
 
-		// create IPA zip file
-		if ( !mz_zip_writer_init_file( &zip_archive, output_file_zip, 0 ) )
+		if ( url_scheme && *url_scheme )
 		{
-			SHOW_ERR( _("Failed to initialise zip file for writing") );
-			goto ios_dialog_cleanup2;
+			if ( strchr(url_scheme, ':') || strchr(url_scheme, '/') )
+			{
+				SHOW_ERR(_("URL scheme must not contain : or /"));
+				goto ios_dialog_clean_up; 
+			}
 		}
-		
-		if ( temp_filename1 ) g_free(temp_filename1);
-		temp_filename1 = g_strconcat( "Payload/", app_name, ".app", NULL );
-		if ( !utils_add_folder_to_zip( &zip_archive, app_folder, temp_filename1, TRUE, FALSE ) )
+
+		if ( deep_link && *deep_link )
 		{
-			SHOW_ERR( _("Failed to add files to IPA") );
-			goto ios_dialog_cleanup2;
+			if ( strchr( deep_link, '.' ) == 0 )
+			{
+				SHOW_ERR(_("Universal link must be a domain, e.g. www.appgamekit.com"));
+				goto ios_dialog_clean_up; 
+			}
 		}
 
-		if ( !mz_zip_writer_finalize_archive( &zip_archive ) )
+		if ( admob_app_id && *admob_app_id )
 		{
-			SHOW_ERR( _("Failed to finalize IPA file") );
-			goto ios_dialog_cleanup2;
+			if ( strchr( admob_app_id, '~' ) == 0 )
+			{
+				SHOW_ERR(_("AdMob App ID must include a ~ character, for example \"ca-app-pub-3940256099942544~1458002511\""));
+				goto ios_dialog_clean_up; 
+			}
 		}
-		if ( !mz_zip_writer_end( &zip_archive ) )
+
+		if ( !g_file_test( "/Applications/XCode.app/Contents/Developer/usr/bin/actool", G_FILE_TEST_EXISTS ) )
 		{
-			SHOW_ERR( _("Failed to end IPA file") );
-			goto ios_dialog_cleanup2;
+			SHOW_ERR(_("You must install XCode to export iOS apps from the AGK IDE. XCode can be downloaded from the Mac AppStore")); 
+			goto ios_dialog_clean_up;
 		}
+	
+		goto ios_dialog_continue;
 
-		g_rename( output_file_zip, output_file );
-
-		while (gtk_events_pending())
-			gtk_main_iteration();
-
-		gtk_widget_hide(GTK_WIDGET(dialog));
-
-ios_dialog_cleanup2:
-        
-        gtk_widget_set_sensitive( ui_lookup_widget(ui_widgets.ios_dialog, "ios_export1"), TRUE );
-		gtk_widget_set_sensitive( ui_lookup_widget(ui_widgets.ios_dialog, "button6"), TRUE );
-
-		utils_remove_folder_recursive( tmp_folder );
-
-		if ( output_file_zip ) g_free(output_file_zip);
-		if ( ios_folder ) g_free(ios_folder);
-		if ( tmp_folder ) g_free(tmp_folder);
-		if ( src_folder ) g_free(src_folder);
-		if ( app_folder ) g_free(app_folder);
-		if ( app_folder_name ) g_free(app_folder_name);
-		if ( no_ads_binary ) g_free(no_ads_binary);
-		if ( icons_src_folder ) g_free(icons_src_folder);
-		if ( icons_dst_folder ) g_free(icons_dst_folder);
-		if ( icons_sub_folder ) g_free(icons_sub_folder);
-
-		if ( error ) g_error_free(error);
-		if ( str_out ) g_free(str_out);
-		if ( argv ) g_strfreev(argv);
-		if ( contents ) g_free(contents);
-		if ( certificate_data ) g_free(certificate_data);
-		if ( team_id ) g_free(team_id);
-		if ( bundle_id ) g_free(bundle_id);
-		if ( cert_hash ) g_free(cert_hash);
-		if ( cert_temp ) g_free(cert_temp);
-		if ( app_group_data ) g_free(app_group_data);
-
-		if ( entitlements_file ) g_free(entitlements_file);
-		if ( expanded_entitlements_file ) g_free(expanded_entitlements_file);
-		if ( temp_filename1 ) g_free(temp_filename1);
-		if ( temp_filename2 ) g_free(temp_filename2);
-		if ( version_string ) g_free(version_string);
-		if ( build_string ) g_free(build_string);
-		if ( image_filename ) g_free(image_filename);
-		if ( user_name ) g_free(user_name);
-		if ( group_name ) g_free(group_name);
-		if ( icon_scaled_image ) gdk_pixbuf_unref(icon_scaled_image);
-		if ( icon_image ) gdk_pixbuf_unref(icon_image);
-		if ( splash_image ) gdk_pixbuf_unref(splash_image);
-		
+ios_dialog_clean_up:
 		if ( app_name ) g_free(app_name);
 		if ( profile ) g_free(profile);
 		if ( app_icon ) g_free(app_icon);
 		if ( firebase_config ) g_free(firebase_config);
+		if ( app_splash_logo ) g_free(app_splash_logo);
+		if ( app_splash_color ) g_free(app_splash_color);
 		//if ( facebook_id ) g_free(facebook_id);
 		if ( url_scheme ) g_free(url_scheme);
 		if ( deep_link ) g_free(deep_link);
@@ -5547,9 +6093,46 @@ ios_dialog_cleanup2:
 		if ( version_number ) g_free(version_number);
 		if ( build_number ) g_free(build_number);
 		if ( output_file ) g_free(output_file);
-	}
+		return;
 
-	running = 0;
+ios_dialog_continue:
+		// CHECKS COMPLETE, START EXPORT
+		job = g_new0( IosExportJob, 1 );
+		job->app_name = app_name;
+		job->profile = profile;
+		job->app_icon = app_icon;
+		job->firebase_config = firebase_config;
+		job->app_splash_logo = app_splash_logo;
+		job->app_splash_color = app_splash_color;
+		job->url_scheme = url_scheme;
+		job->deep_link = deep_link;
+		job->admob_app_id = admob_app_id;
+		job->snapchat_client_id = snapchat_client_id;
+		job->version_number = version_number;
+		job->build_number = build_number;
+		job->output_file = output_file;
+		job->orientation = orientation;
+		job->device_type = device_type;
+		job->uses_ads = uses_ads;
+		if ( !ios_exporting_player && app->project )
+		{
+			job->base_path = g_strdup( app->project->base_path );
+			job->media_folder = g_build_filename( app->project->base_path, "media", NULL );
+		}
+		else job->base_path = g_strdup( global_project_prefs.project_file_path );
+
+		if ( export_project_busy( job->base_path ) )
+		{
+			SHOW_ERR( _("Another export of this project is still running, wait for it to finish first") );
+			ios_export_job_free( job );
+			return;
+		}
+		export_project_claim( job->base_path );
+
+		// the close button stays enabled so the export can be cancelled
+		gtk_widget_set_sensitive( ui_lookup_widget(ui_widgets.ios_dialog, "ios_export1"), FALSE );
+		ios_export_task = export_task_start( "iOS export", ios_export_task_run, ios_export_task_done, job );
+	}
 }
 
 void project_export_ipa()
@@ -5809,6 +6392,7 @@ void init_android_settings( GeanyProject* project )
 	project->apk_settings.version_number = 0;
 	project->apk_settings.firebase_config_path = 0;
 	project->apk_settings.arcore = 0;
+	project->apk_settings.compression = 0;
 }
 
 void init_ios_settings( GeanyProject* project )
@@ -5836,6 +6420,7 @@ void init_html5_settings( GeanyProject* project )
 {
 	project->html5_settings.commands_used = 0; // 2D only
 	project->html5_settings.dynamic_memory = 0;
+	project->html5_settings.gzip_output = 0;
 	project->html5_settings.output_path = 0;
 }
 
@@ -5856,6 +6441,7 @@ void free_android_settings( GeanyProject* project )
 	if ( project->apk_settings.snapchat_client_id ) g_free(project->apk_settings.snapchat_client_id);
 	if ( project->apk_settings.version_name ) g_free(project->apk_settings.version_name);
 	if ( project->apk_settings.firebase_config_path ) g_free(project->apk_settings.firebase_config_path);
+	if ( project->apk_settings.compression ) g_free(project->apk_settings.compression);
 }
 
 void free_ios_settings( GeanyProject* project )
@@ -5903,6 +6489,7 @@ void save_android_settings( GKeyFile *config, GeanyProject* project )
 	g_key_file_set_string( config, "apk_settings", "version_name", FALLBACK(project->apk_settings.version_name,"") );
 	g_key_file_set_integer( config, "apk_settings", "version_number", project->apk_settings.version_number );
 	g_key_file_set_string( config, "apk_settings", "firebase_config_path", FALLBACK(project->apk_settings.firebase_config_path,"") );
+	g_key_file_set_string( config, "apk_settings", "compression", FALLBACK(project->apk_settings.compression,"") );
 }
 
 void save_ios_settings( GKeyFile *config, GeanyProject* project )
@@ -5930,6 +6517,7 @@ void save_html5_settings( GKeyFile *config, GeanyProject* project )
 {
 	g_key_file_set_integer( config, "html5_settings", "commands_used", project->html5_settings.commands_used );
 	g_key_file_set_integer( config, "html5_settings", "dynamic_memory", project->html5_settings.dynamic_memory );
+	g_key_file_set_integer( config, "html5_settings", "gzip_output", project->html5_settings.gzip_output );
 	g_key_file_set_string( config, "html5_settings", "output_path", FALLBACK(project->html5_settings.output_path,"") );
 }
 
@@ -5956,6 +6544,7 @@ void load_android_settings( GKeyFile *config, GeanyProject* project )
 	project->apk_settings.version_name = g_key_file_get_string( config, "apk_settings", "version_name", 0 );
 	project->apk_settings.version_number = utils_get_setting_integer( config, "apk_settings", "version_number", 0 );
 	project->apk_settings.firebase_config_path = g_key_file_get_string( config, "apk_settings", "firebase_config_path", 0 );
+	project->apk_settings.compression = g_key_file_get_string( config, "apk_settings", "compression", 0 );
 }
 
 void load_ios_settings( GKeyFile *config, GeanyProject* project )
@@ -5983,6 +6572,7 @@ void load_html5_settings( GKeyFile *config, GeanyProject* project )
 {
 	project->html5_settings.commands_used = utils_get_setting_integer( config, "html5_settings", "commands_used", 0 );
 	project->html5_settings.dynamic_memory = utils_get_setting_integer( config, "html5_settings", "dynamic_memory", 0 );
+	project->html5_settings.gzip_output = utils_get_setting_integer( config, "html5_settings", "gzip_output", 0 );
 	project->html5_settings.output_path = g_key_file_get_string( config, "html5_settings", "output_path", 0 );
 }
 
@@ -84,6 +84,7 @@ typedef struct GeanyProjectAPKSettings
 	gchar* alias;
 	gchar* firebase_config_path;
 	int arcore;
+	gchar* compression; // per extension levels for the APK, e.g. "ktx=store;json=max", others are sampled
 }
 GeanyProjectAPKSettings;
 
@@ -114,6 +115,7 @@ typedef struct GeanyProjectHTML5Settings
 	gchar* output_path;
 	int commands_used;
 	int dynamic_memory;
+	int gzip_output; // also write .gz copies of the large files
 }
 GeanyProjectHTML5Settings;
 
@@ -196,6 +198,10 @@ void project_import(void);
 
 void project_export();
 
+void project_export_size_report( void );
+
+gboolean project_export_running( void );
+
 GeanyProject* find_project_for_document( gchar* filename );
 
 gboolean project_close(GeanyProject *project, gboolean open_default);
@@ -32,6 +32,7 @@
 #include <string.h>
 #include <errno.h>
 #include <stdarg.h>
+#include <fcntl.h>
 
 #ifdef HAVE_SYS_STAT_H
 # include <sys/stat.h>
@@ -44,6 +45,29 @@
 
 #include <gio/gio.h>
 
+#ifdef G_OS_WIN32
+# include <windows.h>
+# include <sys/utime.h>
+#else
+# include <utime.h>
+# include <dirent.h>
+#endif
+
+#ifdef __linux__
+# include <sys/ioctl.h>
+# include <sys/sendfile.h>
+# ifndef FICLONE
+#  define FICLONE _IOW(0x94, 9, int)
+# endif
+# if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 27))
+#  define UTILS_HAVE_COPY_FILE_RANGE
+# endif
+#endif
+
+#ifndef O_BINARY
+# define O_BINARY 0
+#endif
+
 #include "prefs.h"
 #include "support.h"
 #include "document.h"
@@ -55,6 +79,7 @@
 #include "templates.h"
 
 #include "utils.h"
+#include "pngutils.h"
 
 /**
  *  Tries to open the given URI in a browser.
@@ -1135,6 +1160,14 @@ gchar *utils_get_current_time_string(void)
 
 GIOChannel *utils_set_up_io_channel(
 				gint fd, GIOCondition cond, gboolean nblock, GIOFunc func, gpointer data)
+{
+	return utils_set_up_io_channel_full(fd, cond, nblock, func, data, NULL);
+}
+
+
+/* Same as utils_set_up_io_channel(), notify is called with data once the watch is removed. */
+GIOChannel *utils_set_up_io_channel_full(
+				gint fd, GIOCondition cond, gboolean nblock, GIOFunc func, gpointer data, GDestroyNotify notify)
 {
 	GIOChannel *ioc;
 	/*const gchar *encoding;*/
@@ -1165,7 +1198,7 @@ GIOChannel *utils_set_up_io_channel(
 	/* "auto-close" ;-) */
 	g_io_channel_set_close_on_unref(ioc, TRUE);
 
-	g_io_add_watch(ioc, cond, func, data);
+	g_io_add_watch_full(ioc, G_PRIORITY_DEFAULT, cond, func, data, notify);
 	g_io_channel_unref(ioc);
 
 	return ioc;
@@ -2269,6 +2302,118 @@ gchar *utils_parse_and_format_build_date(const gchar *input)
 	return g_strdup(input);
 }
 
+#define UTILS_COPY_BUFFER_SIZE (256*1024)
+#define UTILS_COPY_CHUNK_SIZE (64*1024*1024)
+
+/* Copies everything from in_fd to out_fd using the cheapest method available, each method
+ * carries on from where the previous one stopped since they all advance the file offsets. */
+static gboolean utils_copy_fd( int in_fd, int out_fd, gint64 size )
+{
+	gint64 remaining = size;
+	gchar *buffer;
+	gboolean result = TRUE;
+
+#ifdef __linux__
+	// shares the data blocks instead of copying them, on filesystems that support it
+	if ( size > 0 && ioctl( out_fd, FICLONE, in_fd ) == 0 )
+		return TRUE;
+#endif
+
+#ifdef UTILS_HAVE_COPY_FILE_RANGE
+	while( remaining > 0 )
+	{
+		ssize_t written = copy_file_range( in_fd, NULL, out_fd, NULL, (size_t) MIN( remaining, UTILS_COPY_CHUNK_SIZE ), 0 );
+		if ( written <= 0 ) break;
+		remaining -= written;
+	}
+#endif
+
+#ifdef __linux__
+	while( remaining > 0 )
+	{
+		ssize_t written = sendfile( out_fd, in_fd, NULL, (size_t) MIN( remaining, UTILS_COPY_CHUNK_SIZE ) );
+		if ( written <= 0 ) break;
+		remaining -= written;
+	}
+	if ( remaining <= 0 ) return TRUE;
+#endif
+
+	// plain buffered copy, also picks up anything appended since size was taken
+	buffer = g_malloc( UTILS_COPY_BUFFER_SIZE );
+	while( 1 )
+	{
+		ssize_t count = read( in_fd, buffer, UTILS_COPY_BUFFER_SIZE );
+		ssize_t offset = 0;
+
+		if ( count < 0 && errno == EINTR ) continue;
+		if ( count <= 0 )
+		{
+			result = (count == 0);
+			break;
+		}
+
+		while( offset < count )
+		{
+			ssize_t written = write( out_fd, buffer + offset, count - offset );
+			if ( written < 0 )
+			{
+				if ( errno == EINTR ) continue;
+				result = FALSE;
+				break;
+			}
+			offset += written;
+		}
+		if ( !result ) break;
+	}
+	g_free( buffer );
+
+	return result;
+}
+
+/* Copies the contents, permissions and modification time of src to dst, without any of the
+ * checks in utils_copy_file(). */
+static gboolean utils_copy_file_data( const gchar *src, const gchar *dst, gchar **error )
+{
+	struct stat st;
+	struct utimbuf times;
+	int in_fd, out_fd;
+	gboolean result;
+
+	in_fd = g_open( src, O_RDONLY | O_BINARY, 0 );
+	if ( in_fd < 0 || fstat( in_fd, &st ) != 0 )
+	{
+		*error = g_strdup_printf( "Unable to open '%s' for reading. %s.", src, g_strerror (errno) );
+		if ( in_fd >= 0 ) close( in_fd );
+		return FALSE;
+	}
+
+	out_fd = g_open( dst, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, st.st_mode & 0777 );
+	if ( out_fd < 0 )
+	{
+		*error = g_strdup_printf( "Unable to open '%s' for writing. %s.", dst, g_strerror (errno) );
+		close( in_fd );
+		return FALSE;
+	}
+
+	result = utils_copy_fd( in_fd, out_fd, st.st_size );
+	if ( close( out_fd ) != 0 ) result = FALSE;
+	close( in_fd );
+
+	if ( !result )
+	{
+		*error = g_strdup_printf( "Unable to write '%s'. %s.", dst, g_strerror (errno) );
+		g_unlink( dst );
+		return FALSE;
+	}
+
+	// keep the modification time so later exports can tell the file hasn't changed
+	times.actime = st.st_atime;
+	times.modtime = st.st_mtime;
+	g_utime( dst, &times );
+
+	return TRUE;
+}
+
 gboolean utils_copy_file (const gchar *src, const gchar *dst, gboolean overwrite, volatile gchar* progress)
 {
     g_return_val_if_fail (src != NULL, FALSE);
@@ -2316,258 +2461,3762 @@ gboolean utils_copy_file (const gchar *src, const gchar *dst, gboolean overwrite
         }
     }
 
-	gchar *contents = 0;
-	gsize length = 0;
-
-	if ( !g_file_get_contents( src, &contents, &length, NULL ) )
-	{
-        if ( progress ) sprintf( (gchar*)progress, "Unable to open '%s' for reading. %s.", src, g_strerror (errno) );
-        else g_critical (G_STRLOC ": Unable to open '%s' for reading. %s.", src, g_strerror (errno));
-        return FALSE;
-	}
+	gchar *error = NULL;
 
-	if ( !g_file_set_contents( dst, contents, length, NULL ) )
+	if ( !utils_copy_file_data( src, dst, &error ) )
 	{
-		g_free(contents);
-        if ( progress ) sprintf( (gchar*)progress, "Unable to open '%s' for writing. %s.", dst, g_strerror (errno) );
-        else g_critical (G_STRLOC ": Unable to open '%s' for writing. %s.", dst, g_strerror (errno));
+        if ( progress ) sprintf( (gchar*)progress, "%s", error );
+        else g_critical (G_STRLOC ": %s", error);
+		g_free( error );
         return FALSE;
 	}
     
-	g_free(contents);
-    
     return TRUE;
 }
 
-gboolean utils_copy_folder ( const gchar* src, const gchar* dst, gboolean recursive, volatile gchar* progress )
+
+/* Marks a file taken from a cache folder as just used, see utils_cache_prune(). */
+void utils_cache_touch( const gchar *path )
 {
-	g_return_val_if_fail (src != NULL, FALSE);
-    g_return_val_if_fail (dst != NULL, FALSE);
+	g_return_if_fail (path != NULL);
 
-	if (!g_file_test (src, G_FILE_TEST_EXISTS)) {
-        if ( progress ) sprintf( (gchar*)progress, "Location '%s' not found.", src );
-        else g_critical (G_STRLOC ": Location '%s' not found.", src);
-        return FALSE;
-    }
+	g_utime( path, NULL );
+}
 
-	if (!g_file_test (src, G_FILE_TEST_IS_DIR)) {
-        if ( progress ) sprintf( (gchar*)progress, "Location '%s' is not a directory.", src );
-        else g_critical (G_STRLOC ": Location '%s' is not a directory.", src);
-        return FALSE;
-    }
-    
-#ifndef G_OS_WIN32
-    if (g_file_test (src, G_FILE_TEST_IS_SYMLINK)) {
-        gchar* link = g_file_read_link( src, NULL );
-        if ( link )
-        {
-            symlink( link, dst );
-            g_free( link );
-        }
-        return TRUE;
-    }
-#endif
 
+typedef struct UtilsCacheFile
+{
+	gchar *path;
+	gint64 size;
+	gint64 used;	/* modification time, bumped by utils_cache_touch() */
+} UtilsCacheFile;
 
-	if (!g_file_test (dst, G_FILE_TEST_EXISTS)) {
-        if ( g_mkdir_with_parents( dst, 0755 ) < 0 )
-		{
-            if ( progress ) sprintf( (gchar*)progress, "Failed to make destination directory '%s'", dst );
-            else g_critical (G_STRLOC ": Failed to make destination directory '%s'", dst);
-			return FALSE;
-		}
-    }
+static gint utils_cache_compare_used(gconstpointer a, gconstpointer b)
+{
+	const UtilsCacheFile *fa = *(const UtilsCacheFile**) a;
+	const UtilsCacheFile *fb = *(const UtilsCacheFile**) b;
 
-	// scan the directory
+	return (fa->used < fb->used) ? -1 : (fa->used > fb->used);
+}
+
+/* Keeps a cache folder under max_size, the same way the blob store of a zip queue is kept: once
+ * its files add up to more, the ones used longest ago are deleted until it is down to three
+ * quarters of it. Files read from the cache should be marked with utils_cache_touch(). */
+void utils_cache_prune( const gchar *folder, gint64 max_size )
+{
+	GDir *dir;
 	const gchar *filename;
-	GDir *dir = g_dir_open(src, 0, NULL);
-	if (dir == NULL)
-	{
-        if ( progress ) sprintf( (gchar*)progress, "Failed to open directory '%s'", src );
-        else g_critical (G_STRLOC ": Failed to open directory '%s'", src);
-		return FALSE;
-	}
+	GPtrArray *files;
+	gint64 total = 0;
+	guint i;
+
+	g_return_if_fail (folder != NULL);
 
+	dir = g_dir_open( folder, 0, NULL );
+	if ( !dir ) return;
+
+	files = g_ptr_array_new();
 	foreach_dir(filename, dir)
 	{
-		gchar* fullsrcpath = g_build_filename( src, filename, NULL );
-		gchar* fulldstpath = g_build_filename( dst, filename, NULL );
+		gchar *path = g_build_filename( folder, filename, NULL );
+		struct stat st;
 
-		if ( g_file_test( fullsrcpath, G_FILE_TEST_IS_DIR ) )
+		if ( g_stat( path, &st ) == 0 && S_ISREG( st.st_mode ) )
 		{
-			if ( recursive )
-			{
-				if ( !utils_copy_folder( fullsrcpath, fulldstpath, recursive, progress ) ) 
-				{
-					g_dir_close(dir);
-					g_free(fullsrcpath);
-					g_free(fulldstpath);
-					return FALSE;
-				}
-			}
+			UtilsCacheFile *file = g_new0( UtilsCacheFile, 1 );
+
+			file->path = path;
+			file->size = st.st_size;
+			file->used = st.st_mtime;
+			total += file->size;
+			g_ptr_array_add( files, file );
 		}
-		else if ( g_file_test( fullsrcpath, G_FILE_TEST_IS_REGULAR ) )
+		else g_free( path );
+	}
+	g_dir_close( dir );
+
+	if ( total > max_size )
+	{
+		g_ptr_array_sort( files, utils_cache_compare_used );
+		for( i = 0; i < files->len && total > max_size / 4 * 3; i++ )
 		{
-			if ( progress ) strcpy( progress, fulldstpath );
-			if ( !utils_copy_file( fullsrcpath, fulldstpath, TRUE, progress ) )
-			{
-				g_dir_close(dir);
-				g_free(fullsrcpath);
-				g_free(fulldstpath);
-				return FALSE;
-			}
+			UtilsCacheFile *file = g_ptr_array_index( files, i );
+
+			// another export may still have it open, it goes next time then
+			if ( g_unlink( file->path ) == 0 ) total -= file->size;
 		}
+	}
 
-		g_free(fullsrcpath);
-		g_free(fulldstpath);
+	for( i = 0; i < files->len; i++ )
+	{
+		UtilsCacheFile *file = g_ptr_array_index( files, i );
+		g_free( file->path );
+		g_free( file );
 	}
+	g_ptr_array_free( files, TRUE );
+}
 
-	g_dir_close(dir);
-	
-	return TRUE;
+
+/* Directory copy and delete. The calling thread walks the tree and hands the files to a pool
+ * of threads, calling func now and then with the last path done and the counts so far. func
+ * runs on the calling thread, so it may update the UI, and returning FALSE from it cancels
+ * everything that hasn't started yet. */
+
+#define UTILS_TREE_MAX_THREADS 8
+
+typedef struct UtilsTreeJob
+{
+	gchar *src;
+	gchar *dst;
+} UtilsTreeJob;
+
+typedef struct UtilsTreeTask
+{
+	GThreadPool *pool;
+	GMutex *mutex;
+	GCond *cond;
+	guint pending;			/* jobs pushed and not finished */
+	guint done;
+	guint total;
+	gint cancelled;			/* atomic */
+	gchar *last_path;
+	gchar *error;			/* first failure */
+	GPtrArray *deferred;	/* directories to remove once the jobs inside them are done */
+	UtilsTreeProgressFunc func;
+	gpointer user_data;
+} UtilsTreeTask;
+
+
+static void utils_tree_task_init( UtilsTreeTask *task, GFunc worker, UtilsTreeProgressFunc func, gpointer user_data )
+{
+	guint num_threads = CLAMP( utils_get_cpu_count(), 2, UTILS_TREE_MAX_THREADS );
+
+	memset( task, 0, sizeof(UtilsTreeTask) );
+	task->mutex = g_mutex_new();
+	task->cond = g_cond_new();
+	task->deferred = g_ptr_array_new();
+	task->func = func;
+	task->user_data = user_data;
+	task->pool = g_thread_pool_new( worker, task, num_threads, FALSE, NULL );
 }
 
-gboolean utils_remove_folder_recursive ( const gchar* src )
+
+// keeps the first error and stops the rest, takes ownership of message
+static void utils_tree_fail( UtilsTreeTask *task, gchar *message )
 {
-	g_return_val_if_fail (src != NULL, FALSE);
-	if ( strcmp(src,"/") == 0 ) { g_critical (G_STRLOC ": Delete attempt on '%s' ignored.", src); return FALSE; } // don't delete root
-	if ( strcmp(src,"C:") == 0 ) { g_critical (G_STRLOC ": Delete attempt on '%s' ignored.", src); return FALSE; } // don't delete root
-	if ( strcmp(src,"C:\\") == 0 ) { g_critical (G_STRLOC ": Delete attempt on '%s' ignored.", src); return FALSE; } // don't delete root
+	g_mutex_lock( task->mutex );
+	if ( !task->error ) task->error = message;
+	else g_free( message );
+	g_mutex_unlock( task->mutex );
 
-	if (!g_file_test (src, G_FILE_TEST_EXISTS)) {
-        return TRUE;
-    }
+	g_atomic_int_set( &task->cancelled, 1 );
+}
 
-	if (!g_file_test (src, G_FILE_TEST_IS_DIR)) {
-        g_critical (G_STRLOC ": Location '%s' is not a directory.", src);
-        return FALSE;
-    }
 
-	// scan the directory
-	const gchar *filename;
-	GDir *dir = g_dir_open(src, 0, NULL);
-	if (dir == NULL)
-	{
-		g_critical (G_STRLOC ": Failed to open directory '%s'", src);
-		return FALSE;
-	}
+static void utils_tree_push( UtilsTreeTask *task, gchar *src, gchar *dst, gboolean count )
+{
+	UtilsTreeJob *job = g_new0( UtilsTreeJob, 1 );
 
-	foreach_dir(filename, dir)
-	{
-		gchar* fullsrcpath = g_build_filename( src, filename, NULL );
+	job->src = src;
+	job->dst = dst;
 
-		if ( g_file_test( fullsrcpath, G_FILE_TEST_IS_DIR ) )
-		{
-			if ( !utils_remove_folder_recursive( fullsrcpath ) ) 
-			{
-				g_dir_close(dir);
-				g_free(fullsrcpath);
-				return FALSE;
-			}
-		}
-		else if ( g_file_test( fullsrcpath, G_FILE_TEST_IS_REGULAR ) )
-		{
-			if ( g_unlink( fullsrcpath ) != 0 ) 
-			{
-				g_dir_close(dir);
-				g_free(fullsrcpath);
-				return FALSE;
-			}
-		}
+	g_mutex_lock( task->mutex );
+	task->pending++;
+	if ( count ) task->total++;
+	g_mutex_unlock( task->mutex );
 
-		g_free(fullsrcpath);
-	}
+	g_thread_pool_push( task->pool, job, NULL );
+}
 
-	g_dir_close(dir);
 
-	g_rmdir( src );
-	
-	return TRUE;
+static void utils_tree_job_done( UtilsTreeTask *task, UtilsTreeJob *job, guint done, const gchar *path )
+{
+	g_mutex_lock( task->mutex );
+	task->pending--;
+	task->done += done;
+	if ( done && path ) SETPTR( task->last_path, g_strdup( path ) );
+	g_cond_signal( task->cond );
+	g_mutex_unlock( task->mutex );
+
+	g_free( job->src );
+	g_free( job->dst );
+	g_free( job );
 }
 
-gboolean utils_add_folder_to_zip ( mz_zip_archive *pZip, const gchar* src, const gchar* dst, gboolean recursive, gboolean selective_compress )
+
+// reports progress on the calling thread
+static void utils_tree_poll( UtilsTreeTask *task )
 {
-	g_return_val_if_fail (pZip != NULL, FALSE);
-	g_return_val_if_fail (src != NULL, FALSE);
-    g_return_val_if_fail (dst != NULL, FALSE);
+	gchar *path;
+	guint done, total;
 
-	if (!g_file_test (src, G_FILE_TEST_EXISTS)) {
-        g_critical (G_STRLOC ": Location '%s' not found.", src);
-        return FALSE;
-    }
+	if ( !task->func || g_atomic_int_get( &task->cancelled ) ) return;
 
-	if (!g_file_test (src, G_FILE_TEST_IS_DIR)) {
-        g_critical (G_STRLOC ": Location '%s' is not a directory.", src);
-        return FALSE;
-    }
+	g_mutex_lock( task->mutex );
+	path = g_strdup( task->last_path );
+	done = task->done;
+	total = task->total;
+	g_mutex_unlock( task->mutex );
 
-	// scan the directory
-	const gchar *filename;
-	GDir *dir = g_dir_open(src, 0, NULL);
-	if (dir == NULL)
-	{
-		g_critical (G_STRLOC ": Failed to open directory '%s'", src);
-		return FALSE;
-	}
+	if ( !task->func( path, done, total, task->user_data ) )
+		g_atomic_int_set( &task->cancelled, 1 );
+	g_free( path );
+}
 
-	foreach_dir(filename, dir)
+
+static gint utils_tree_compare_depth( gconstpointer a, gconstpointer b )
+{
+	// deepest first, a child path is always longer than its parent
+	return (gint) strlen( *(const gchar**) b ) - (gint) strlen( *(const gchar**) a );
+}
+
+
+static gboolean utils_tree_task_finish( UtilsTreeTask *task, gchar **error )
+{
+	gboolean result;
+	guint i;
+
+	g_mutex_lock( task->mutex );
+	while( task->pending > 0 )
 	{
-		gchar* fullsrcpath = g_build_path( "/", src, filename, NULL );
-		gchar* fulldstpath = g_build_path( "/", dst, filename, NULL );
+		GTimeVal until;
 
-		if ( g_file_test( fullsrcpath, G_FILE_TEST_IS_DIR ) )
-		{
-			if ( recursive )
-			{
-				if ( !utils_add_folder_to_zip( pZip, fullsrcpath, fulldstpath, recursive, selective_compress ) ) 
-				{
-					g_dir_close(dir);
-					g_free(fullsrcpath);
-					g_free(fulldstpath);
-					return FALSE;
-				}
-			}
-		}
-		else if ( g_file_test( fullsrcpath, G_FILE_TEST_IS_REGULAR ) )
-		{
-			int level = 9;
-			gchar *ext = strrchr( filename, '.' );
-			if ( ext && selective_compress )
-			{
-				if ( utils_str_casecmp( ext, ".mp3" ) == 0 ) level = 0;
-				if ( utils_str_casecmp( ext, ".m4a" ) == 0 ) level = 0;
-				if ( utils_str_casecmp( ext, ".jpg" ) == 0 ) level = 0;
-				if ( utils_str_casecmp( ext, ".png" ) == 0 ) level = 0;
-				if ( utils_str_casecmp( ext, ".gif" ) == 0 ) level = 0;
-				if ( utils_str_casecmp( ext, ".wav" ) == 0 ) level = 0;
-				if ( utils_str_casecmp( ext, ".ogg" ) == 0 ) level = 0;
-				if ( utils_str_casecmp( ext, ".mpg" ) == 0 ) level = 0;
-				if ( utils_str_casecmp( ext, ".mpeg" ) == 0 ) level = 0;
-				if ( utils_str_casecmp( ext, ".mp4" ) == 0 ) level = 0;
-				if ( utils_str_casecmp( ext, ".m4v" ) == 0 ) level = 0;
-				if ( utils_str_casecmp( ext, ".dat" ) == 0 ) level = 0;
-				if ( utils_str_casecmp( ext, ".zip" ) == 0 ) level = 0;
-			}
+		g_get_current_time( &until );
+		g_time_val_add( &until, 50000 );
+		g_cond_timed_wait( task->cond, task->mutex, &until );
 
-			if ( !mz_zip_writer_add_file( pZip, fulldstpath, fullsrcpath, NULL, 0, level ) )
-			{
-				g_dir_close(dir);
-				g_free(fullsrcpath);
-				g_free(fulldstpath);
-				return FALSE;
-			}
-		}
+		g_mutex_unlock( task->mutex );
+		utils_tree_poll( task );
+		g_mutex_lock( task->mutex );
+	}
+	g_mutex_unlock( task->mutex );
 
-		g_free(fullsrcpath);
-		g_free(fulldstpath);
+	g_thread_pool_free( task->pool, FALSE, TRUE );
+	utils_tree_poll( task );
+
+	g_ptr_array_sort( task->deferred, utils_tree_compare_depth );
+	for( i = 0; i < task->deferred->len; i++ )
+	{
+		gchar *path = g_ptr_array_index( task->deferred, i );
+		g_rmdir( path );
+		g_free( path );
 	}
+	g_ptr_array_free( task->deferred, TRUE );
 
-	g_dir_close(dir);
-	
-	return TRUE;
-}
+	result = !g_atomic_int_get( &task->cancelled );
+	if ( error )
+	{
+		if ( task->error ) *error = task->error;
+		else *error = result ? NULL : g_strdup( "Cancelled" );
+	}
+	else g_free( task->error );
 
-gboolean utils_add_folder_to_html5_data_file( FILE *pHTML5Data, const gchar* srcfull, const gchar* src, gchar* load_package_string, gchar* additional_folders_string, int* currpos )
+	g_free( task->last_path );
+	g_mutex_free( task->mutex );
+	g_cond_free( task->cond );
+	return result;
+}
+
+
+static void utils_tree_copy_job( gpointer data, gpointer user_data )
+{
+	UtilsTreeJob *job = data;
+	UtilsTreeTask *task = user_data;
+	gchar *message = NULL;
+	guint done = 0;
+
+	if ( !g_atomic_int_get( &task->cancelled ) )
+	{
+		if ( utils_copy_file_data( job->src, job->dst, &message ) ) done = 1;
+		else utils_tree_fail( task, message );
+	}
+
+	utils_tree_job_done( task, job, done, job->dst );
+}
+
+
+#ifndef G_OS_WIN32
+// recreates a link to a file or folder, the same as utils_copy_file() and utils_copy_folder() do
+static void utils_tree_copy_link( const gchar *src, const gchar *dst, gboolean recursive )
+{
+	struct stat st;
+	gchar *link;
+
+	if ( stat( src, &st ) != 0 ) return;
+	if ( !S_ISREG( st.st_mode ) && !(S_ISDIR( st.st_mode ) && recursive) ) return;
+
+	link = g_file_read_link( src, NULL );
+	if ( link )
+	{
+		symlink( link, dst );
+		g_free( link );
+	}
+}
+#endif
+
+
+// creates the folders as it goes, files are left to the pool
+static void utils_tree_copy_walk( UtilsTreeTask *task, const gchar *src, const gchar *dst, gboolean recursive )
+{
+	guint count = 0;
+
+	if ( g_atomic_int_get( &task->cancelled ) ) return;
+
+	if ( g_mkdir_with_parents( dst, 0755 ) < 0 )
+	{
+		utils_tree_fail( task, g_strdup_printf( "Failed to make destination directory '%s'", dst ) );
+		return;
+	}
+
+#ifdef G_OS_WIN32
+	const gchar *filename;
+	GDir *dir = g_dir_open( src, 0, NULL );
+	if ( dir == NULL )
+	{
+		utils_tree_fail( task, g_strdup_printf( "Failed to open directory '%s'", src ) );
+		return;
+	}
+
+	foreach_dir( filename, dir )
+	{
+		gchar* fullsrcpath = g_build_filename( src, filename, NULL );
+		gchar* fulldstpath = g_build_filename( dst, filename, NULL );
+
+		if ( g_atomic_int_get( &task->cancelled ) )
+		{
+			g_free( fullsrcpath );
+			g_free( fulldstpath );
+			break;
+		}
+
+		if ( g_file_test( fullsrcpath, G_FILE_TEST_IS_DIR ) )
+		{
+			if ( recursive ) utils_tree_copy_walk( task, fullsrcpath, fulldstpath, recursive );
+		}
+		else if ( g_file_test( fullsrcpath, G_FILE_TEST_IS_REGULAR ) )
+		{
+			utils_tree_push( task, fullsrcpath, fulldstpath, TRUE );
+			fullsrcpath = fulldstpath = NULL;
+		}
+
+		g_free( fullsrcpath );
+		g_free( fulldstpath );
+
+		if ( ++count % 256 == 0 ) utils_tree_poll( task );
+	}
+
+	g_dir_close( dir );
+#else
+	struct dirent *entry;
+	DIR *dir = opendir( src );
+	if ( dir == NULL )
+	{
+		utils_tree_fail( task, g_strdup_printf( "Failed to open directory '%s'", src ) );
+		return;
+	}
+
+	while( (entry = readdir( dir )) != NULL && !g_atomic_int_get( &task->cancelled ) )
+	{
+		gchar *fullsrcpath, *fulldstpath;
+		int type = entry->d_type;
+
+		if ( strcmp( entry->d_name, "." ) == 0 || strcmp( entry->d_name, ".." ) == 0 ) continue;
+
+		fullsrcpath = g_build_filename( src, entry->d_name, NULL );
+		fulldstpath = g_build_filename( dst, entry->d_name, NULL );
+
+		// only some filesystems fill in the type
+		if ( type == DT_UNKNOWN )
+		{
+			struct stat st;
+			if ( lstat( fullsrcpath, &st ) == 0 )
+			{
+				if ( S_ISDIR( st.st_mode ) ) type = DT_DIR;
+				else if ( S_ISREG( st.st_mode ) ) type = DT_REG;
+				else if ( S_ISLNK( st.st_mode ) ) type = DT_LNK;
+			}
+		}
+
+		if ( type == DT_DIR )
+		{
+			if ( recursive ) utils_tree_copy_walk( task, fullsrcpath, fulldstpath, recursive );
+		}
+		else if ( type == DT_REG )
+		{
+			utils_tree_push( task, fullsrcpath, fulldstpath, TRUE );
+			fullsrcpath = fulldstpath = NULL;
+		}
+		else if ( type == DT_LNK )
+		{
+			utils_tree_copy_link( fullsrcpath, fulldstpath, recursive );
+		}
+
+		g_free( fullsrcpath );
+		g_free( fulldstpath );
+
+		if ( ++count % 256 == 0 ) utils_tree_poll( task );
+	}
+
+	closedir( dir );
+#endif
+}
+
+
+#ifdef G_OS_WIN32
+static void utils_tree_remove_contents( UtilsTreeTask *task, const gchar *path )
+{
+	const gchar *filename;
+	guint removed = 0;
+	GDir *dir = g_dir_open( path, 0, NULL );
+	if ( dir == NULL )
+	{
+		utils_tree_fail( task, g_strdup_printf( "Failed to open directory '%s'", path ) );
+		return;
+	}
+
+	foreach_dir( filename, dir )
+	{
+		gchar* fullpath = g_build_filename( path, filename, NULL );
+
+		if ( g_atomic_int_get( &task->cancelled ) )
+		{
+			g_free( fullpath );
+			break;
+		}
+
+		if ( g_file_test( fullpath, G_FILE_TEST_IS_DIR ) )
+		{
+			// hand subfolders to idle threads, otherwise do them here
+			if ( g_thread_pool_unprocessed( task->pool ) == 0 )
+			{
+				utils_tree_push( task, fullpath, NULL, FALSE );
+				fullpath = NULL;
+			}
+			else
+			{
+				utils_tree_remove_contents( task, fullpath );
+				if ( g_rmdir( fullpath ) != 0 )
+				{
+					g_mutex_lock( task->mutex );
+					g_ptr_array_add( task->deferred, g_strdup( fullpath ) );
+					g_mutex_unlock( task->mutex );
+				}
+			}
+		}
+		else if ( g_file_test( fullpath, G_FILE_TEST_IS_REGULAR ) )
+		{
+			if ( g_unlink( fullpath ) != 0 )
+				utils_tree_fail( task, g_strdup_printf( "Failed to delete '%s'. %s.", fullpath, g_strerror (errno) ) );
+			else removed++;
+		}
+
+		g_free( fullpath );
+	}
+
+	g_dir_close( dir );
+
+	g_mutex_lock( task->mutex );
+	task->done += removed;
+	g_mutex_unlock( task->mutex );
+}
+#else
+// removes everything in the directory open as fd (and closes it), relative to the directory so nothing is looked up twice
+static void utils_tree_remove_contents( UtilsTreeTask *task, int fd, const gchar *path )
+{
+	struct dirent *entry;
+	guint removed = 0;
+	DIR *dir = fdopendir( fd );
+	if ( dir == NULL )
+	{
+		close( fd );
+		utils_tree_fail( task, g_strdup_printf( "Failed to open directory '%s'", path ) );
+		return;
+	}
+
+	while( (entry = readdir( dir )) != NULL && !g_atomic_int_get( &task->cancelled ) )
+	{
+		gboolean is_dir = (entry->d_type == DT_DIR);
+
+		if ( strcmp( entry->d_name, "." ) == 0 || strcmp( entry->d_name, ".." ) == 0 ) continue;
+
+		if ( entry->d_type == DT_UNKNOWN )
+		{
+			struct stat st;
+			is_dir = fstatat( dirfd( dir ), entry->d_name, &st, AT_SYMLINK_NOFOLLOW ) == 0 && S_ISDIR( st.st_mode );
+		}
+
+		if ( !is_dir )
+		{
+			if ( unlinkat( dirfd( dir ), entry->d_name, 0 ) != 0 )
+				utils_tree_fail( task, g_strdup_printf( "Failed to delete '%s/%s'. %s.", path, entry->d_name, g_strerror (errno) ) );
+			else removed++;
+		}
+		else
+		{
+			gchar *subpath = g_build_filename( path, entry->d_name, NULL );
+
+			// hand subfolders to idle threads, otherwise do them here
+			if ( g_thread_pool_unprocessed( task->pool ) == 0 )
+			{
+				utils_tree_push( task, subpath, NULL, FALSE );
+				subpath = NULL;
+			}
+			else
+			{
+				int subfd = openat( dirfd( dir ), entry->d_name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW );
+				if ( subfd < 0 )
+					utils_tree_fail( task, g_strdup_printf( "Failed to open directory '%s'", subpath ) );
+				else
+				{
+					utils_tree_remove_contents( task, subfd, subpath );
+					if ( unlinkat( dirfd( dir ), entry->d_name, AT_REMOVEDIR ) != 0 )
+					{
+						g_mutex_lock( task->mutex );
+						g_ptr_array_add( task->deferred, g_strdup( subpath ) );
+						g_mutex_unlock( task->mutex );
+					}
+				}
+			}
+
+			g_free( subpath );
+		}
+	}
+
+	closedir( dir );
+
+	g_mutex_lock( task->mutex );
+	task->done += removed;
+	SETPTR( task->last_path, g_strdup( path ) );
+	g_mutex_unlock( task->mutex );
+}
+#endif
+
+
+static void utils_tree_remove_job( gpointer data, gpointer user_data )
+{
+	UtilsTreeJob *job = data;
+	UtilsTreeTask *task = user_data;
+
+	if ( !g_atomic_int_get( &task->cancelled ) )
+	{
+#ifdef G_OS_WIN32
+		utils_tree_remove_contents( task, job->src );
+#else
+		int fd = open( job->src, O_RDONLY | O_DIRECTORY | O_NOFOLLOW );
+		if ( fd < 0 )
+			utils_tree_fail( task, g_strdup_printf( "Failed to open directory '%s'", job->src ) );
+		else
+			utils_tree_remove_contents( task, fd, job->src );
+#endif
+
+		// subfolders still being removed by other threads leave it for later
+		if ( g_rmdir( job->src ) != 0 )
+		{
+			g_mutex_lock( task->mutex );
+			g_ptr_array_add( task->deferred, g_strdup( job->src ) );
+			g_mutex_unlock( task->mutex );
+		}
+	}
+
+	utils_tree_job_done( task, job, 0, NULL );
+}
+
+
+/* Copies the contents of src into dst, see above for func. On failure error is set to a
+ * message to be freed, if not NULL. */
+gboolean utils_copy_folder_full( const gchar* src, const gchar* dst, gboolean recursive, UtilsTreeProgressFunc func, gpointer user_data, gchar **error )
+{
+	UtilsTreeTask task;
+
+	g_return_val_if_fail (src != NULL, FALSE);
+	g_return_val_if_fail (dst != NULL, FALSE);
+
+	utils_tree_task_init( &task, utils_tree_copy_job, func, user_data );
+	utils_tree_copy_walk( &task, src, dst, recursive );
+	return utils_tree_task_finish( &task, error );
+}
+
+
+/* Deletes src and everything in it, see above for func. */
+gboolean utils_remove_folder_full( const gchar* src, UtilsTreeProgressFunc func, gpointer user_data )
+{
+	UtilsTreeTask task;
+	gchar *error = NULL;
+
+	g_return_val_if_fail (src != NULL, FALSE);
+	if ( strcmp(src,"/") == 0 ) { g_critical (G_STRLOC ": Delete attempt on '%s' ignored.", src); return FALSE; } // don't delete root
+	if ( strcmp(src,"C:") == 0 ) { g_critical (G_STRLOC ": Delete attempt on '%s' ignored.", src); return FALSE; } // don't delete root
+	if ( strcmp(src,"C:\\") == 0 ) { g_critical (G_STRLOC ": Delete attempt on '%s' ignored.", src); return FALSE; } // don't delete root
+
+	if (!g_file_test (src, G_FILE_TEST_EXISTS)) {
+        return TRUE;
+    }
+
+	if (!g_file_test (src, G_FILE_TEST_IS_DIR)) {
+        g_critical (G_STRLOC ": Location '%s' is not a directory.", src);
+        return FALSE;
+    }
+
+	utils_tree_task_init( &task, utils_tree_remove_job, func, user_data );
+	utils_tree_push( &task, g_strdup( src ), NULL, FALSE );
+	if ( !utils_tree_task_finish( &task, &error ) )
+	{
+		g_critical (G_STRLOC ": %s", error);
+		g_free( error );
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+
+// keeps the old progress string up to date with the file being copied
+static gboolean utils_copy_folder_progress( const gchar *path, guint done, guint total, gpointer user_data )
+{
+	if ( path ) strcpy( (gchar*) user_data, path );
+	return TRUE;
+}
+
+gboolean utils_copy_folder ( const gchar* src, const gchar* dst, gboolean recursive, volatile gchar* progress )
+{
+	g_return_val_if_fail (src != NULL, FALSE);
+    g_return_val_if_fail (dst != NULL, FALSE);
+
+	if (!g_file_test (src, G_FILE_TEST_EXISTS)) {
+        if ( progress ) sprintf( (gchar*)progress, "Location '%s' not found.", src );
+        else g_critical (G_STRLOC ": Location '%s' not found.", src);
+        return FALSE;
+    }
+
+	if (!g_file_test (src, G_FILE_TEST_IS_DIR)) {
+        if ( progress ) sprintf( (gchar*)progress, "Location '%s' is not a directory.", src );
+        else g_critical (G_STRLOC ": Location '%s' is not a directory.", src);
+        return FALSE;
+    }
+    
+#ifndef G_OS_WIN32
+    if (g_file_test (src, G_FILE_TEST_IS_SYMLINK)) {
+        gchar* link = g_file_read_link( src, NULL );
+        if ( link )
+        {
+            symlink( link, dst );
+            g_free( link );
+        }
+        return TRUE;
+    }
+#endif
+
+
+	gchar *error = NULL;
+
+	if ( !utils_copy_folder_full( src, dst, recursive, progress ? utils_copy_folder_progress : NULL, (gpointer) progress, &error ) )
+	{
+        if ( progress ) sprintf( (gchar*)progress, "%s", error );
+        else g_critical (G_STRLOC ": %s", error);
+		g_free( error );
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+gboolean utils_remove_folder_recursive ( const gchar* src )
+{
+	return utils_remove_folder_full( src, NULL, NULL );
+}
+
+gboolean utils_add_folder_to_zip ( mz_zip_archive *pZip, const gchar* src, const gchar* dst, gboolean recursive, gboolean selective_compress )
+{
+	g_return_val_if_fail (pZip != NULL, FALSE);
+
+	UtilsZipQueue *queue = utils_zip_queue_new( pZip );
+	gboolean result = utils_zip_queue_add_folder( queue, src, dst, recursive, selective_compress );
+
+	// anything queued before a failure is still written, as it was when entries were added one by one
+	if ( !utils_zip_queue_finish( queue ) ) result = FALSE;
+
+	return result;
+}
+
+
+/* Returns the number of processors available, at least 1. */
+guint utils_get_cpu_count(void)
+{
+#if GLIB_CHECK_VERSION(2, 36, 0)
+	return g_get_num_processors();
+#elif defined(G_OS_WIN32)
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return MAX(info.dwNumberOfProcessors, 1);
+#else
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	return (count > 0) ? (guint) count : 1;
+#endif
+}
+
+
+/* Parallel zip writing.
+ * Entries are queued with utils_zip_queue_add_file() and utils_zip_queue_add_folder() and
+ * written by utils_zip_queue_finish(). A pool of threads reads and deflates the queued files
+ * into memory while the calling thread appends them to the archive one at a time in the order
+ * they were queued, so the archive comes out the same whatever the number of threads.
+ * Entries stored without compression are streamed from disk by the writer itself.
+ *
+ * With utils_zip_queue_set_blob_store() the compressed entries are taken from and added to
+ * a store of deflated blobs, named by the SHA1 of their contents and their level, which any
+ * number of queues can share. Each file is then read and deflated once, whatever the number
+ * of archives it goes into, and later sessions find it there too. A file with the same size
+ * and modification time as when the store last read it is taken as unchanged without reading
+ * it, and the level sampled for some contents is remembered for the next archive. The blob
+ * store keeps the blobs used most recently, up to UTILS_BLOB_STORE_MAX_SIZE bytes.
+ *
+ * With utils_zip_queue_set_alignment() the data of every stored entry is aligned as it is
+ * written, the way zipalign would, so the archive doesn't need a separate alignment pass.
+ *
+ * Entries queued with UTILS_ZIP_LEVEL_AUTO, which is what utils_zip_queue_add_folder() uses
+ * for selective compression, get their level from a sample of their contents. The first
+ * UTILS_ZIP_SAMPLE_SIZE bytes are deflated at the fastest level on the worker thread and the
+ * ratio achieved decides between storing, fast deflate and maximum deflate. Extensions can be
+ * given a fixed level instead with utils_zip_queue_set_levels(), and utils_zip_queue_set_log()
+ * writes out what was decided for each entry. Audio and video are always stored, whatever their
+ * sample or the overrides say, as Android can only play assets from the APK uncompressed. */
+
+#define UTILS_ZIP_SAMPLE_SIZE 65536
+#define UTILS_ZIP_STORE_RATIO 0.95	/* sample barely shrinks, already compressed */
+#define UTILS_ZIP_FAST_RATIO 0.80	/* some gain, not worth the time of maximum deflate */
+
+#define UTILS_BLOB_STORE_HEADER "AGK blob store 1"
+#define UTILS_BLOB_STORE_MAX_SIZE G_GINT64_CONSTANT(1024*1024*1024)
+#define UTILS_BLOB_HEADER_SIZE 12	/* "AGKB", CRC-32 and size of the uncompressed data */
+
+typedef struct UtilsBlobStamp
+{
+	gint64 size;
+	gint64 mtime;
+	gint64 checked;		/* when the file was read, a time this late isn't trusted */
+	gchar *sha1;
+} UtilsBlobStamp;
+
+typedef struct UtilsBlobRecord
+{
+	gint64 size;		/* of the blob file */
+	gint64 used;		/* last time it was read or written */
+} UtilsBlobRecord;
+
+struct UtilsBlobStore
+{
+	gchar *folder;
+	GMutex *mutex;
+	GCond *cond;			/* signalled when a file stops being busy */
+	GHashTable *stamps;		/* source path -> UtilsBlobStamp */
+	GHashTable *levels;		/* sha1 -> level + 1, sampled for UTILS_ZIP_LEVEL_AUTO, and
+							 * sha1-level -> 1 when deflate at that level didn't shrink it */
+	GHashTable *blobs;		/* sha1-level -> UtilsBlobRecord */
+	GHashTable *busy;		/* source paths a queue is reading */
+};
+
+typedef struct UtilsZipEntry
+{
+	gchar *archive_name;
+	gchar *src_path;
+	gint level;				/* UTILS_ZIP_LEVEL_AUTO until the worker thread has decided */
+	gboolean pooled;		/* read by a worker thread, otherwise streamed from disk by the writer */
+	gboolean auto_level;	/* queued as UTILS_ZIP_LEVEL_AUTO */
+	const gchar *reason;	/* why the level was fixed when queued, NULL if it was left to the queue */
+
+	/* filled in by a worker thread */
+	gdouble sample_ratio;	/* achieved by the sample, negative if the level wasn't sampled */
+	gboolean done;
+	gboolean failed;
+	gboolean reuse;			/* level, and maybe data, came from the blob store */
+	gboolean from_blob;		/* data was read from the blob store */
+	gboolean store_known;	/* deflate at this level didn't shrink the same contents before */
+	gboolean deflated;		/* data is raw deflate, otherwise the file contents */
+	void *data;
+	size_t data_size;
+	mz_uint64 uncomp_size;
+	mz_uint32 crc32;
+	time_t mtime;
+	gchar *sha1;			/* only when there is a blob store */
+} UtilsZipEntry;
+
+struct UtilsZipQueue
+{
+	mz_zip_archive *zip;
+	GPtrArray *entries;
+	GMutex *mutex;
+	GCond *cond;
+
+	UtilsBlobStore *store;	/* shared, not owned by the queue */
+
+	guint alignment;		/* for stored entries, 0 leaves the archive's own setting alone */
+	guint lib_alignment;	/* for stored .so files */
+
+	UtilsZipProgressFunc progress_func;
+	gpointer progress_data;
+
+	GHashTable *levels;		/* lower case extension without the dot -> level, or NULL */
+	gchar *log_file;
+};
+
+
+/* Parses overrides like "ktx=store; json=max; bin=fast; dat=6" into a table for
+ * utils_zip_get_level(). Levels are store, fast, max, auto or a number from 0 to 9,
+ * anything else is ignored. Returns NULL if there is nothing to override. */
+static GHashTable *utils_zip_parse_levels(const gchar *overrides)
+{
+	GHashTable *levels = NULL;
+	gchar **items;
+	gint i;
+
+	if ( !overrides || !*overrides ) return NULL;
+
+	items = g_strsplit_set( overrides, ";,\n", -1 );
+	for( i = 0; items[i]; i++ )
+	{
+		gchar *ext = items[i];
+		gchar *value = strchr( ext, '=' );
+		gint level;
+
+		if ( !value ) continue;
+		*value++ = 0;
+		g_strstrip( ext );
+		g_strstrip( value );
+		if ( *ext == '.' ) ext++;
+		if ( !*ext ) continue;
+
+		if ( g_ascii_strcasecmp( value, "store" ) == 0 ) level = 0;
+		else if ( g_ascii_strcasecmp( value, "fast" ) == 0 ) level = MZ_BEST_SPEED;
+		else if ( g_ascii_strcasecmp( value, "max" ) == 0 ) level = MZ_BEST_COMPRESSION;
+		else if ( g_ascii_strcasecmp( value, "auto" ) == 0 ) level = UTILS_ZIP_LEVEL_AUTO;
+		else if ( g_ascii_isdigit( value[0] ) && !value[1] ) level = value[0] - '0';
+		else continue; // unknown, this may run on an export thread so it isn't logged
+
+		if ( !levels ) levels = g_hash_table_new_full( g_str_hash, g_str_equal, g_free, NULL );
+		g_hash_table_insert( levels, g_ascii_strdown( ext, -1 ), GINT_TO_POINTER( level ) );
+	}
+	g_strfreev( items );
+
+	return levels;
+}
+
+
+static gint utils_zip_get_level(const gchar *filename, gboolean selective_compress, GHashTable *levels, const gchar **reason)
+{
+	// AssetManager.openFd() only works on stored entries, the same list aapt never compresses
+	static const gchar *streamed[] = { ".mp3", ".m4a", ".wav", ".ogg", ".mpg", ".mpeg", ".mp4", ".m4v" };
+	const gchar *ext = strrchr( filename, '.' );
+	guint i;
+
+	if ( reason ) *reason = NULL;
+	if ( !selective_compress ) return MZ_BEST_COMPRESSION;
+
+	for( i = 0; ext && i < G_N_ELEMENTS(streamed); i++ )
+	{
+		if ( g_ascii_strcasecmp( ext, streamed[i] ) == 0 )
+		{
+			if ( reason ) *reason = "audio or video, always stored";
+			return 0;
+		}
+	}
+
+	if ( ext && levels )
+	{
+		gchar *key = g_ascii_strdown( ext + 1, -1 );
+		gpointer value;
+		gboolean found = g_hash_table_lookup_extended( levels, key, NULL, &value );
+
+		g_free( key );
+		if ( found )
+		{
+			if ( reason ) *reason = "extension override";
+			return GPOINTER_TO_INT( value );
+		}
+	}
+
+	return UTILS_ZIP_LEVEL_AUTO;
+}
+
+
+/* Deflates a sample from the start of data at the fastest level and picks a level for the
+ * whole file from the ratio achieved. Sets ratio to compressed over original sample size. */
+static gint utils_zip_classify(const void *data, size_t length, gdouble *ratio)
+{
+	size_t sample = MIN( length, UTILS_ZIP_SAMPLE_SIZE );
+	size_t comp_size = 0;
+	void *comp;
+
+	*ratio = 1.0;
+
+	// deflate can't gain anything worth having on a few bytes
+	if ( sample < 64 ) return 0;
+
+	comp = tdefl_compress_mem_to_heap( data, sample, &comp_size,
+		tdefl_create_comp_flags_from_zip_params( MZ_BEST_SPEED, -15, MZ_DEFAULT_STRATEGY ) );
+	if ( comp ) *ratio = (gdouble) comp_size / sample;
+	mz_free( comp );
+
+	if ( *ratio > UTILS_ZIP_STORE_RATIO ) return 0;
+	if ( *ratio > UTILS_ZIP_FAST_RATIO ) return MZ_BEST_SPEED;
+	return MZ_BEST_COMPRESSION;
+}
+
+
+static void utils_zip_entry_free(UtilsZipEntry *entry)
+{
+	if ( entry->deflated ) mz_free( entry->data );
+	else g_free( entry->data );
+	g_free( entry->archive_name );
+	g_free( entry->src_path );
+	g_free( entry->sha1 );
+	g_free( entry );
+}
+
+
+static void utils_blob_stamp_free(gpointer data)
+{
+	UtilsBlobStamp *stamp = data;
+
+	g_free( stamp->sha1 );
+	g_free( stamp );
+}
+
+
+static gint64 utils_blob_store_now(void)
+{
+	GTimeVal now;
+
+	g_get_current_time( &now );
+	return now.tv_sec;
+}
+
+
+// blobs are spread over 256 folders by the first two characters of their hash
+static gchar *utils_blob_store_path(UtilsBlobStore *store, const gchar *key)
+{
+	gchar prefix[3] = { key[0], key[1], 0 };
+
+	return g_build_filename( store->folder, prefix, key, NULL );
+}
+
+
+/* Opens the store kept in folder, which is created when the first blob is added. A store
+ * can be shared by any number of queues, on any threads. */
+UtilsBlobStore *utils_blob_store_new( const gchar *folder )
+{
+	UtilsBlobStore *store = g_new0( UtilsBlobStore, 1 );
+	gchar *index_file = g_build_filename( folder, "index", NULL );
+	gchar *contents = NULL;
+
+	store->folder = g_strdup( folder );
+	store->mutex = g_mutex_new();
+	store->cond = g_cond_new();
+	store->stamps = g_hash_table_new_full( g_str_hash, g_str_equal, g_free, utils_blob_stamp_free );
+	store->levels = g_hash_table_new_full( g_str_hash, g_str_equal, g_free, NULL );
+	store->blobs = g_hash_table_new_full( g_str_hash, g_str_equal, g_free, g_free );
+	store->busy = g_hash_table_new_full( g_str_hash, g_str_equal, g_free, NULL );
+
+	if ( g_file_get_contents( index_file, &contents, NULL, NULL ) && g_str_has_prefix( contents, UTILS_BLOB_STORE_HEADER "\n" ) )
+	{
+		gchar **lines = g_strsplit( contents, "\n", -1 );
+		gint i;
+
+		// file: f, size, time, time it was read, sha1, escaped path
+		// sampled level: a, sha1, level
+		// blob: b, sha1-level, size, time last used
+		for( i = 1; lines[i]; i++ )
+		{
+			gchar **fields = g_strsplit( lines[i], "\t", 6 );
+			guint count = g_strv_length( fields );
+
+			if ( count == 6 && strcmp( fields[0], "f" ) == 0 )
+			{
+				UtilsBlobStamp *stamp = g_new0( UtilsBlobStamp, 1 );
+
+				stamp->size = g_ascii_strtoll( fields[1], NULL, 10 );
+				stamp->mtime = g_ascii_strtoll( fields[2], NULL, 10 );
+				stamp->checked = g_ascii_strtoll( fields[3], NULL, 10 );
+				stamp->sha1 = g_strdup( fields[4] );
+				g_hash_table_insert( store->stamps, g_strcompress( fields[5] ), stamp );
+			}
+			else if ( count == 3 && strcmp( fields[0], "a" ) == 0 )
+				g_hash_table_insert( store->levels, g_strdup( fields[1] ), GINT_TO_POINTER( atoi( fields[2] ) + 1 ) );
+			else if ( count == 4 && strcmp( fields[0], "b" ) == 0 )
+			{
+				UtilsBlobRecord *record = g_new0( UtilsBlobRecord, 1 );
+
+				record->size = g_ascii_strtoll( fields[2], NULL, 10 );
+				record->used = g_ascii_strtoll( fields[3], NULL, 10 );
+				g_hash_table_insert( store->blobs, g_strdup( fields[1] ), record );
+			}
+			g_strfreev( fields );
+		}
+		g_strfreev( lines );
+	}
+
+	g_free( contents );
+	g_free( index_file );
+	return store;
+}
+
+
+/* Writes the index of the store and frees it. */
+void utils_blob_store_free( UtilsBlobStore *store )
+{
+	if ( !store ) return;
+
+	utils_blob_store_flush( store );
+	g_hash_table_destroy( store->stamps );
+	g_hash_table_destroy( store->levels );
+	g_hash_table_destroy( store->blobs );
+	g_hash_table_destroy( store->busy );
+	g_cond_free( store->cond );
+	g_mutex_free( store->mutex );
+	g_free( store->folder );
+	g_free( store );
+}
+
+
+static gint utils_blob_store_compare_used(gconstpointer a, gconstpointer b, gpointer user_data)
+{
+	const UtilsBlobRecord *ra = g_hash_table_lookup( user_data, *(const gchar**) a );
+	const UtilsBlobRecord *rb = g_hash_table_lookup( user_data, *(const gchar**) b );
+
+	return (ra->used < rb->used) ? -1 : (ra->used > rb->used);
+}
+
+
+// deletes the blobs used longest ago until the store is well under its limit, called with the lock held
+static void utils_blob_store_prune(UtilsBlobStore *store)
+{
+	GHashTableIter iter;
+	gpointer key, value;
+	GPtrArray *keys;
+	gint64 total = 0;
+	guint i;
+
+	g_hash_table_iter_init( &iter, store->blobs );
+	while( g_hash_table_iter_next( &iter, &key, &value ) ) total += ((UtilsBlobRecord*) value)->size;
+	if ( total <= UTILS_BLOB_STORE_MAX_SIZE ) return;
+
+	keys = g_ptr_array_sized_new( g_hash_table_size( store->blobs ) );
+	g_hash_table_iter_init( &iter, store->blobs );
+	while( g_hash_table_iter_next( &iter, &key, NULL ) ) g_ptr_array_add( keys, key );
+	g_ptr_array_sort_with_data( keys, utils_blob_store_compare_used, store->blobs );
+
+	for( i = 0; i < keys->len && total > UTILS_BLOB_STORE_MAX_SIZE / 4 * 3; i++ )
+	{
+		const gchar *blob_key = g_ptr_array_index( keys, i );
+		gchar *path = utils_blob_store_path( store, blob_key );
+
+		total -= ((UtilsBlobRecord*) g_hash_table_lookup( store->blobs, blob_key ))->size;
+		g_unlink( path );
+		g_free( path );
+		g_hash_table_remove( store->blobs, blob_key );
+	}
+	g_ptr_array_free( keys, TRUE );
+}
+
+
+/* Writes the index of the store so the next session can use it, after deleting the blobs used
+ * longest ago if the store is over UTILS_BLOB_STORE_MAX_SIZE. Files that no longer exist are
+ * dropped from the index. utils_zip_queue_finish() calls this for the queue's store. */
+gboolean utils_blob_store_flush( UtilsBlobStore *store )
+{
+	GString *index = g_string_sized_new( 65536 );
+	gchar *index_file;
+	GHashTableIter iter;
+	gpointer key, value;
+	gboolean result;
+
+	g_mutex_lock( store->mutex );
+
+	utils_blob_store_prune( store );
+	g_string_append( index, UTILS_BLOB_STORE_HEADER "\n" );
+
+	g_hash_table_iter_init( &iter, store->stamps );
+	while( g_hash_table_iter_next( &iter, &key, &value ) )
+	{
+		UtilsBlobStamp *stamp = value;
+		gchar *escaped;
+
+		// such as the staging copies of an export
+		if ( !g_file_test( key, G_FILE_TEST_IS_REGULAR ) )
+		{
+			g_hash_table_iter_remove( &iter );
+			continue;
+		}
+
+		escaped = g_strescape( key, NULL );
+		g_string_append_printf( index, "f\t%" G_GINT64_FORMAT "\t%" G_GINT64_FORMAT "\t%" G_GINT64_FORMAT "\t%s\t%s\n",
+			stamp->size, stamp->mtime, stamp->checked, stamp->sha1, escaped );
+		g_free( escaped );
+	}
+
+	g_hash_table_iter_init( &iter, store->levels );
+	while( g_hash_table_iter_next( &iter, &key, &value ) )
+		g_string_append_printf( index, "a\t%s\t%d\n", (const gchar*) key, GPOINTER_TO_INT( value ) - 1 );
+
+	g_hash_table_iter_init( &iter, store->blobs );
+	while( g_hash_table_iter_next( &iter, &key, &value ) )
+	{
+		UtilsBlobRecord *record = value;
+		g_string_append_printf( index, "b\t%s\t%" G_GINT64_FORMAT "\t%" G_GINT64_FORMAT "\n", (const gchar*) key, record->size, record->used );
+	}
+
+	g_mutex_unlock( store->mutex );
+
+	utils_mkdir( store->folder, TRUE );
+	index_file = g_build_filename( store->folder, "index", NULL );
+	result = g_file_set_contents( index_file, index->str, index->len, NULL );
+
+	g_free( index_file );
+	g_string_free( index, TRUE );
+	return result;
+}
+
+
+// reads a blob into entry, the header is the CRC-32 and size of the uncompressed data
+static gboolean utils_blob_store_read(UtilsBlobStore *store, const gchar *key, UtilsZipEntry *entry)
+{
+	gchar *path = utils_blob_store_path( store, key );
+	FILE *pFile = g_fopen( path, "rb" );
+	guchar header[ UTILS_BLOB_HEADER_SIZE ];
+	gboolean result = FALSE;
+	struct stat st;
+
+	g_free( path );
+	if ( !pFile ) return FALSE;
+
+	if ( fstat( fileno( pFile ), &st ) == 0 && st.st_size > UTILS_BLOB_HEADER_SIZE
+		&& fread( header, 1, sizeof(header), pFile ) == sizeof(header) && memcmp( header, "AGKB", 4 ) == 0 )
+	{
+		size_t size = (size_t) (st.st_size - UTILS_BLOB_HEADER_SIZE);
+		// freed with mz_free() like the output of tdefl
+		void *data = malloc( size );
+
+		if ( data && fread( data, 1, size, pFile ) == size )
+		{
+			entry->crc32 = header[4] | (header[5] << 8) | (header[6] << 16) | ((mz_uint32) header[7] << 24);
+			entry->uncomp_size = header[8] | (header[9] << 8) | (header[10] << 16) | ((mz_uint64) header[11] << 24);
+			entry->data = data;
+			entry->data_size = size;
+			entry->deflated = TRUE;
+			entry->from_blob = TRUE;
+			result = TRUE;
+		}
+		else free( data );
+	}
+
+	fclose( pFile );
+	return result;
+}
+
+
+// writes a temporary file and renames it, so a blob is never seen half written
+static gboolean utils_blob_store_write(UtilsBlobStore *store, const gchar *key, UtilsZipEntry *entry)
+{
+	gchar *path = utils_blob_store_path( store, key );
+	gchar *folder = g_path_get_dirname( path );
+	gchar *tmp_path = g_strdup_printf( "%s.%p.tmp", path, (void*) g_thread_self() );
+	guchar header[ UTILS_BLOB_HEADER_SIZE ] = { 'A', 'G', 'K', 'B' };
+	gboolean result = FALSE;
+	FILE *pFile;
+	gint i;
+
+	for( i = 0; i < 4; i++ )
+	{
+		header[4 + i] = (guchar) (entry->crc32 >> (i * 8));
+		header[8 + i] = (guchar) (entry->uncomp_size >> (i * 8));
+	}
+
+	utils_mkdir( folder, TRUE );
+	pFile = g_fopen( tmp_path, "wb" );
+	if ( pFile )
+	{
+		result = fwrite( header, 1, sizeof(header), pFile ) == sizeof(header)
+			&& fwrite( entry->data, 1, entry->data_size, pFile ) == entry->data_size;
+		if ( fclose( pFile ) != 0 ) result = FALSE;
+
+		// another export may have just added the same blob
+		if ( result && g_rename( tmp_path, path ) != 0 ) result = g_file_test( path, G_FILE_TEST_IS_REGULAR );
+		g_unlink( tmp_path );
+	}
+
+	g_free( tmp_path );
+	g_free( folder );
+	g_free( path );
+	return result;
+}
+
+
+/* Fills in entry from a blob of the contents with hash entry->sha1 at the entry's level. An
+ * automatic level is replaced by the one picked when the same contents were last sampled, even
+ * if the entry can't be filled in because that level stores it or its blob is gone. Contents
+ * that deflate didn't shrink at that level before are marked to be stored without trying again. */
+static gboolean utils_blob_store_get_by_hash(UtilsBlobStore *store, UtilsZipEntry *entry)
+{
+	UtilsBlobRecord *record = NULL;
+	gchar *key = NULL;
+	gint level = entry->level;
+
+	g_mutex_lock( store->mutex );
+	if ( level == UTILS_ZIP_LEVEL_AUTO )
+	{
+		level = GPOINTER_TO_INT( g_hash_table_lookup( store->levels, entry->sha1 ) ) - 1;
+		if ( level != UTILS_ZIP_LEVEL_AUTO )
+		{
+			entry->level = level;
+			entry->reuse = TRUE;
+		}
+	}
+	if ( level > 0 )
+	{
+		key = g_strdup_printf( "%s-%d", entry->sha1, level );
+		record = g_hash_table_lookup( store->blobs, key );
+		if ( record ) record->used = utils_blob_store_now();
+		else if ( GPOINTER_TO_INT( g_hash_table_lookup( store->levels, key ) ) == 1 )
+		{
+			entry->level = level;
+			entry->reuse = TRUE;
+			entry->store_known = TRUE;
+		}
+	}
+	g_mutex_unlock( store->mutex );
+
+	if ( record && !utils_blob_store_read( store, key, entry ) )
+	{
+		// deleted from outside, it will be added again
+		g_mutex_lock( store->mutex );
+		g_hash_table_remove( store->blobs, key );
+		g_mutex_unlock( store->mutex );
+		record = NULL;
+	}
+	if ( record )
+	{
+		entry->level = level;
+		entry->reuse = TRUE;
+	}
+
+	g_free( key );
+	return record != NULL;
+}
+
+
+/* Fills in entry from the store if its file was compressed at its level before, by this
+ * session or an earlier one, and hasn't changed since. Otherwise the file is marked as being
+ * read, so another queue with the same file waits for this one rather than repeating the work,
+ * and utils_blob_store_release() must be called when the entry is done. */
+static gboolean utils_blob_store_get(UtilsBlobStore *store, UtilsZipEntry *entry, const struct stat *st)
+{
+	UtilsBlobStamp *stamp;
+
+	g_mutex_lock( store->mutex );
+	while( g_hash_table_lookup( store->busy, entry->src_path ) )
+		g_cond_wait( store->cond, store->mutex );
+
+	// a file changed in the second it was read might have changed again without its time changing
+	stamp = g_hash_table_lookup( store->stamps, entry->src_path );
+	if ( stamp && stamp->size == (gint64) st->st_size && stamp->mtime == (gint64) st->st_mtime && stamp->mtime < stamp->checked )
+		entry->sha1 = g_strdup( stamp->sha1 );
+	g_hash_table_insert( store->busy, g_strdup( entry->src_path ), GINT_TO_POINTER( 1 ) );
+	g_mutex_unlock( store->mutex );
+
+	if ( entry->sha1 && utils_blob_store_get_by_hash( store, entry ) )
+	{
+		g_mutex_lock( store->mutex );
+		g_hash_table_remove( store->busy, entry->src_path );
+		g_cond_broadcast( store->cond );
+		g_mutex_unlock( store->mutex );
+		return TRUE;
+	}
+	return FALSE;
+}
+
+
+/* Adds what was worked out for an entry that wasn't in the store: the hash of its file as of
+ * checked, the level picked for its contents, and its compressed data. */
+static void utils_blob_store_release(UtilsBlobStore *store, UtilsZipEntry *entry, const struct stat *st, gint64 checked)
+{
+	gchar *key = NULL;
+	gboolean added = FALSE;
+
+	if ( !entry->failed && entry->deflated && !entry->from_blob )
+	{
+		key = g_strdup_printf( "%s-%d", entry->sha1, entry->level );
+		added = utils_blob_store_write( store, key, entry );
+	}
+
+	g_mutex_lock( store->mutex );
+	if ( !entry->failed && entry->sha1 )
+	{
+		UtilsBlobStamp *stamp = g_new0( UtilsBlobStamp, 1 );
+
+		stamp->size = st->st_size;
+		stamp->mtime = st->st_mtime;
+		stamp->checked = checked;
+		stamp->sha1 = g_strdup( entry->sha1 );
+		g_hash_table_insert( store->stamps, g_strdup( entry->src_path ), stamp );
+
+		if ( entry->auto_level && entry->sample_ratio >= 0 )
+			g_hash_table_insert( store->levels, g_strdup( entry->sha1 ), GINT_TO_POINTER( entry->level + 1 ) );
+
+		// stored, there is no blob, so remember not to deflate it again
+		if ( entry->level > 0 && !entry->deflated && !entry->store_known )
+			g_hash_table_insert( store->levels, g_strdup_printf( "%s-%d", entry->sha1, entry->level ), GINT_TO_POINTER( 1 ) );
+	}
+	if ( added )
+	{
+		UtilsBlobRecord *record = g_new0( UtilsBlobRecord, 1 );
+
+		record->size = (gint64) entry->data_size + UTILS_BLOB_HEADER_SIZE;
+		record->used = utils_blob_store_now();
+		g_hash_table_insert( store->blobs, key, record );
+		key = NULL;
+	}
+	g_hash_table_remove( store->busy, entry->src_path );
+	g_cond_broadcast( store->cond );
+	g_mutex_unlock( store->mutex );
+
+	g_free( key );
+}
+
+
+static void utils_zip_deflate_entry(gpointer data, gpointer user_data)
+{
+	UtilsZipEntry *entry = data;
+	UtilsZipQueue *queue = user_data;
+	gint64 checked = utils_blob_store_now();
+	gchar *contents = NULL;
+	gsize length = 0;
+	void *comp = NULL;
+	size_t comp_size = 0;
+	struct stat st;
+
+	if ( g_stat( entry->src_path, &st ) != 0 )
+	{
+		entry->failed = TRUE;
+		goto deflate_done;
+	}
+	entry->mtime = st.st_mtime;
+
+	// compressed before, by this archive, another one or an earlier session
+	if ( queue->store && utils_blob_store_get( queue->store, entry, &st ) ) goto deflate_done;
+
+	if ( !g_file_get_contents( entry->src_path, &contents, &length, NULL ) || length > 0xFFFFFFFF ) // no zip64 support
+	{
+		g_free( contents );
+		entry->failed = TRUE;
+		goto deflate_release;
+	}
+	entry->uncomp_size = length;
+
+	if ( queue->store && !entry->sha1 )
+	{
+		entry->sha1 = g_compute_checksum_for_data( G_CHECKSUM_SHA1, (const guchar*) contents, length );
+
+		// the same contents under another name
+		if ( utils_blob_store_get_by_hash( queue->store, entry ) )
+		{
+			g_free( contents );
+			goto deflate_release;
+		}
+	}
+
+	if ( entry->level == UTILS_ZIP_LEVEL_AUTO )
+		entry->level = utils_zip_classify( contents, length, &entry->sample_ratio );
+
+	// same as miniz, tiny files are always stored
+	if ( entry->level > 0 && length > 3 && !entry->store_known )
+	{
+		entry->crc32 = (mz_uint32) mz_crc32( MZ_CRC32_INIT, (const mz_uint8*) contents, length );
+		comp = tdefl_compress_mem_to_heap( contents, length, &comp_size,
+			tdefl_create_comp_flags_from_zip_params( entry->level, -15, MZ_DEFAULT_STRATEGY ) );
+	}
+
+	if ( comp && comp_size < length )
+	{
+		g_free( contents );
+		entry->data = comp;
+		entry->data_size = comp_size;
+		entry->deflated = TRUE;
+	}
+	else
+	{
+		mz_free( comp );
+		entry->data = contents;
+		entry->data_size = length;
+	}
+
+deflate_release:
+	if ( queue->store ) utils_blob_store_release( queue->store, entry, &st, checked );
+
+deflate_done:
+	g_mutex_lock( queue->mutex );
+	entry->done = TRUE;
+	g_cond_broadcast( queue->cond );
+	g_mutex_unlock( queue->mutex );
+}
+
+
+static guint utils_zip_get_alignment(guint alignment, guint lib_alignment, const gchar *archive_name)
+{
+	if ( lib_alignment && g_str_has_suffix( archive_name, ".so" ) ) return lib_alignment;
+	return alignment;
+}
+
+
+static gboolean utils_zip_write_entry(UtilsZipQueue *queue, UtilsZipEntry *entry)
+{
+	if ( queue->alignment )
+		queue->zip->m_stored_data_alignment = utils_zip_get_alignment( queue->alignment, queue->lib_alignment, entry->archive_name );
+
+	if ( !entry->pooled )
+		return mz_zip_writer_add_file( queue->zip, entry->archive_name, entry->src_path, NULL, 0, 0 );
+
+	if ( entry->failed )
+		return FALSE;
+
+	if ( entry->deflated )
+		return mz_zip_writer_add_mem_ex_v2( queue->zip, entry->archive_name, entry->data, entry->data_size, NULL, 0,
+			entry->level | MZ_ZIP_FLAG_COMPRESSED_DATA, entry->uncomp_size, entry->crc32, &entry->mtime );
+
+	// deflate didn't make it smaller, store it
+	return mz_zip_writer_add_mem_ex_v2( queue->zip, entry->archive_name, entry->data, entry->data_size, NULL, 0,
+		0, 0, 0, &entry->mtime );
+}
+
+
+UtilsZipQueue *utils_zip_queue_new( mz_zip_archive *pZip )
+{
+	UtilsZipQueue *queue = g_new0( UtilsZipQueue, 1 );
+
+	queue->zip = pZip;
+	queue->entries = g_ptr_array_new();
+	queue->mutex = g_mutex_new();
+	queue->cond = g_cond_new();
+
+	return queue;
+}
+
+
+/* Queues src_path to be added as archive_name, level 0 stores it uncompressed and
+ * UTILS_ZIP_LEVEL_AUTO picks the level from a sample of the file. */
+void utils_zip_queue_add_file( UtilsZipQueue *queue, const gchar *archive_name, const gchar *src_path, gint level )
+{
+	UtilsZipEntry *entry = g_new0( UtilsZipEntry, 1 );
+
+	entry->archive_name = g_strdup( archive_name );
+	entry->src_path = g_strdup( src_path );
+	entry->level = (level == UTILS_ZIP_LEVEL_AUTO) ? level : CLAMP( level, 0, MZ_UBER_COMPRESSION );
+	entry->auto_level = (level == UTILS_ZIP_LEVEL_AUTO);
+	entry->pooled = (entry->level != 0);
+	entry->sample_ratio = -1.0;
+	g_ptr_array_add( queue->entries, entry );
+}
+
+
+/* Queues every file in src under dst, with the same rules as utils_add_folder_to_zip().
+ * With selective_compress the level of each file is sampled unless its extension has a level
+ * from utils_zip_queue_set_levels(), otherwise everything gets maximum deflate. */
+gboolean utils_zip_queue_add_folder( UtilsZipQueue *queue, const gchar* src, const gchar* dst, gboolean recursive, gboolean selective_compress )
+{
+	g_return_val_if_fail (queue != NULL, FALSE);
+	g_return_val_if_fail (src != NULL, FALSE);
+	g_return_val_if_fail (dst != NULL, FALSE);
+
+	if (!g_file_test (src, G_FILE_TEST_EXISTS)) {
+		g_critical (G_STRLOC ": Location '%s' not found.", src);
+		return FALSE;
+	}
+
+	if (!g_file_test (src, G_FILE_TEST_IS_DIR)) {
+		g_critical (G_STRLOC ": Location '%s' is not a directory.", src);
+		return FALSE;
+	}
+
+	// scan the directory
+	const gchar *filename;
+	GDir *dir = g_dir_open(src, 0, NULL);
+	if (dir == NULL)
+	{
+		g_critical (G_STRLOC ": Failed to open directory '%s'", src);
+		return FALSE;
+	}
+
+	foreach_dir(filename, dir)
+	{
+		gchar* fullsrcpath = g_build_path( "/", src, filename, NULL );
+		gchar* fulldstpath = g_build_path( "/", dst, filename, NULL );
+
+		if ( g_file_test( fullsrcpath, G_FILE_TEST_IS_DIR ) )
+		{
+			if ( recursive && !utils_zip_queue_add_folder( queue, fullsrcpath, fulldstpath, recursive, selective_compress ) )
+			{
+				g_dir_close(dir);
+				g_free(fullsrcpath);
+				g_free(fulldstpath);
+				return FALSE;
+			}
+		}
+		else if ( g_file_test( fullsrcpath, G_FILE_TEST_IS_REGULAR ) )
+		{
+			const gchar *reason;
+			gint level = utils_zip_get_level( filename, selective_compress, queue->levels, &reason );
+			UtilsZipEntry *entry;
+
+			utils_zip_queue_add_file( queue, fulldstpath, fullsrcpath, level );
+			entry = g_ptr_array_index( queue->entries, queue->entries->len - 1 );
+			entry->reason = reason;
+		}
+
+		g_free(fullsrcpath);
+		g_free(fulldstpath);
+	}
+
+	g_dir_close(dir);
+
+	return TRUE;
+}
+
+
+// one line per entry: archive name, level, and why it got that level
+static void utils_zip_log_entry(GString *log, UtilsZipEntry *entry)
+{
+	gchar buf[ G_ASCII_DTOSTR_BUF_SIZE ];
+	const gchar *name;
+
+	if ( entry->level == 0 ) name = "store";
+	else if ( entry->level == MZ_BEST_SPEED ) name = "fast";
+	else if ( entry->level == MZ_BEST_COMPRESSION ) name = "max";
+	else name = "level";
+
+	g_string_append_printf( log, "%s\t%s %d\t", entry->archive_name, name, entry->level );
+
+	if ( entry->reason ) g_string_append( log, entry->reason );
+	else if ( !entry->auto_level ) g_string_append( log, "fixed" );
+	else if ( entry->sample_ratio >= 0 ) g_string_append_printf( log, "sample ratio %s",
+		g_ascii_formatd( buf, sizeof(buf), "%.3f", entry->sample_ratio ) );
+	else if ( entry->reuse ) g_string_append( log, "same contents as before, level from the blob store" );
+	else g_string_append( log, "not sampled" );
+
+	if ( entry->level > 0 && !entry->deflated ) g_string_append( log, ", stored as deflate didn't shrink it" );
+	g_string_append_c( log, '\n' );
+}
+
+
+/* Compresses and writes all queued entries to the archive and frees the queue.
+ * Returns FALSE if any entry could not be read or written, the entries before it are in the archive. */
+gboolean utils_zip_queue_finish( UtilsZipQueue *queue )
+{
+	guint num_threads = utils_get_cpu_count();
+	guint window = num_threads * 2; // entries read ahead of the writer, limits memory use
+	guint submitted = 0;
+	guint i;
+	gboolean result = TRUE;
+	// only keep the UI going if this is the main loop's thread
+	gboolean pump_events = g_main_context_is_owner( g_main_context_default() );
+	GThreadPool *pool;
+	guint64 bytes_done = 0;
+	guint64 bytes_total = 0;
+	GString *log = queue->log_file ? g_string_sized_new( 64 + queue->entries->len * 64 ) : NULL;
+
+	if ( queue->progress_func )
+	{
+		for( i = 0; i < queue->entries->len; i++ )
+		{
+			UtilsZipEntry *entry = g_ptr_array_index( queue->entries, i );
+			struct stat st;
+
+			if ( g_stat( entry->src_path, &st ) != 0 ) continue;
+			bytes_total += st.st_size;
+			// stored entries are written straight from the file, nothing else sets their size
+			if ( !entry->pooled ) entry->uncomp_size = st.st_size;
+		}
+	}
+
+	pool = g_thread_pool_new( utils_zip_deflate_entry, queue, num_threads, FALSE, NULL );
+
+	for( i = 0; i < queue->entries->len; i++ )
+	{
+		UtilsZipEntry *entry = g_ptr_array_index( queue->entries, i );
+
+		for( ; submitted < queue->entries->len && submitted < i + window; submitted++ )
+		{
+			UtilsZipEntry *next = g_ptr_array_index( queue->entries, submitted );
+			if ( !next->pooled ) continue;
+			g_thread_pool_push( pool, next, NULL );
+		}
+
+		if ( entry->pooled )
+		{
+			g_mutex_lock( queue->mutex );
+			while( !entry->done )
+			{
+				if ( pump_events )
+				{
+					GTimeVal until;
+
+					g_get_current_time( &until );
+					g_time_val_add( &until, 20000 );
+					g_cond_timed_wait( queue->cond, queue->mutex, &until );
+
+					g_mutex_unlock( queue->mutex );
+					while (gtk_events_pending())
+						gtk_main_iteration();
+					g_mutex_lock( queue->mutex );
+				}
+				else
+					g_cond_wait( queue->cond, queue->mutex );
+			}
+			g_mutex_unlock( queue->mutex );
+		}
+
+		if ( !utils_zip_write_entry( queue, entry ) )
+		{
+			g_critical (G_STRLOC ": Failed to add '%s' to zip file", entry->src_path);
+			result = FALSE;
+			break;
+		}
+		if ( log ) utils_zip_log_entry( log, entry );
+
+		bytes_done += entry->uncomp_size;
+		if ( queue->progress_func && !queue->progress_func( entry->archive_name, bytes_done, bytes_total, queue->progress_data ) )
+		{
+			result = FALSE;
+			break;
+		}
+
+		// release the memory as soon as the entry is written
+		if ( entry->deflated ) mz_free( entry->data );
+		else g_free( entry->data );
+		entry->data = NULL;
+		entry->deflated = FALSE;
+	}
+
+	// waits for any entries still being compressed
+	g_thread_pool_free( pool, FALSE, TRUE );
+
+	if ( queue->store ) utils_blob_store_flush( queue->store );
+
+	if ( log )
+	{
+		// whatever got written, a failed export is when the log is most useful
+		g_file_set_contents( queue->log_file, log->str, log->len, NULL );
+		g_string_free( log, TRUE );
+	}
+
+	utils_zip_queue_free( queue );
+	return result;
+}
+
+
+/* Frees the queue without writing anything. */
+void utils_zip_queue_free( UtilsZipQueue *queue )
+{
+	guint i;
+
+	for( i = 0; i < queue->entries->len; i++ )
+		utils_zip_entry_free( g_ptr_array_index( queue->entries, i ) );
+	g_ptr_array_free( queue->entries, TRUE );
+	g_mutex_free( queue->mutex );
+	g_cond_free( queue->cond );
+	g_free( queue->log_file );
+	if ( queue->levels ) g_hash_table_destroy( queue->levels );
+	g_free( queue );
+}
+
+
+/* Takes compressed entries from store, and adds the ones it doesn't have yet, so the files are
+ * only deflated once for all the queues sharing it. Must be called before anything is written. */
+void utils_zip_queue_set_blob_store( UtilsZipQueue *queue, UtilsBlobStore *store )
+{
+	queue->store = store;
+}
+
+
+/* Aligns the data of entries stored without compression to alignment bytes, or lib_alignment
+ * for shared libraries, by padding their local headers. Use 4 and 4096 to match "zipalign -p 4". */
+void utils_zip_queue_set_alignment( UtilsZipQueue *queue, guint alignment, guint lib_alignment )
+{
+	g_return_if_fail( alignment < 0x10000 && lib_alignment < 0x10000 );
+
+	queue->alignment = alignment;
+	queue->lib_alignment = lib_alignment;
+}
+
+
+/* Calls func on the thread running utils_zip_queue_finish() after each entry is written, with the
+ * uncompressed bytes written so far and in total. Returning FALSE from func stops the archive. */
+void utils_zip_queue_set_progress( UtilsZipQueue *queue, UtilsZipProgressFunc func, gpointer user_data )
+{
+	queue->progress_func = func;
+	queue->progress_data = user_data;
+}
+
+
+/* Fixes the level of files with the given extensions instead of sampling them, overrides is
+ * a list like "ktx=store; json=max; bin=fast; dat=6". Only affects utils_zip_queue_add_folder()
+ * with selective compression, so must be called before that. */
+void utils_zip_queue_set_levels( UtilsZipQueue *queue, const gchar *overrides )
+{
+	if ( queue->levels ) g_hash_table_destroy( queue->levels );
+	queue->levels = utils_zip_parse_levels( overrides );
+}
+
+
+/* Writes the level of each entry and the reason for it to log_file when the archive is finished. */
+void utils_zip_queue_set_log( UtilsZipQueue *queue, const gchar *log_file )
+{
+	SETPTR( queue->log_file, g_strdup( log_file ) );
+}
+
+
+/* Checks the archive the same way "zipalign -c" does, every stored entry's data has to start on
+ * a multiple of alignment, or of lib_alignment for .so files if that isn't 0 (zipalign's -p).
+ * If bad_entry is not NULL it is set to the name of the first misaligned entry, free it with g_free(). */
+gboolean utils_zip_check_alignment( const gchar *zip_path, guint alignment, guint lib_alignment, gchar **bad_entry )
+{
+	mz_zip_archive zip;
+	mz_uint i;
+	gboolean result = TRUE;
+
+	g_return_val_if_fail( alignment > 0, FALSE );
+
+	if ( bad_entry ) *bad_entry = NULL;
+
+	memset( &zip, 0, sizeof(zip) );
+	if ( !mz_zip_reader_init_file( &zip, zip_path, 0 ) ) return FALSE;
+
+	for( i = 0; i < mz_zip_reader_get_num_files( &zip ) && result; i++ )
+	{
+		mz_zip_archive_file_stat stat;
+		guchar header[30];
+		guint64 data_offset;
+		guint required;
+
+		if ( !mz_zip_reader_file_stat( &zip, i, &stat ) ) { result = FALSE; break; }
+		if ( stat.m_method != 0 ) continue;
+
+		// the central directory doesn't know how long the local extra field is
+		if ( zip.m_pRead( zip.m_pIO_opaque, stat.m_local_header_ofs, header, sizeof(header) ) != sizeof(header)
+		  || header[0] != 'P' || header[1] != 'K' || header[2] != 3 || header[3] != 4 )
+		{
+			result = FALSE;
+			break;
+		}
+
+		data_offset = stat.m_local_header_ofs + sizeof(header) + (header[26] | (header[27] << 8)) + (header[28] | (header[29] << 8));
+		required = utils_zip_get_alignment( alignment, lib_alignment, stat.m_filename );
+		if ( data_offset % required != 0 )
+		{
+			result = FALSE;
+			if ( bad_entry ) *bad_entry = g_strdup( stat.m_filename );
+		}
+	}
+
+	mz_zip_reader_end( &zip );
+	return result;
+}
+
+
+/* Parallel zip extraction.
+ * utils_zip_extract() unpacks a whole archive, such as a downloaded tool set or a player
+ * template. Each thread has its own reader and takes the next entry in order of compressed
+ * size, largest first, so a big file started late doesn't hold up the end. All the folders
+ * are created before anything is written, files are preallocated to their final size, and
+ * the CRC of each file is checked as it is written. */
+
+typedef struct UtilsZipExtractEntry
+{
+	mz_uint index;
+	gchar *path;			/* where it is written */
+	mz_uint64 size;
+	mz_uint64 comp_size;
+	guint mode;
+	time_t mtime;
+} UtilsZipExtractEntry;
+
+typedef struct UtilsZipExtract
+{
+	const gchar *zip_path;
+	GPtrArray *entries;		/* UtilsZipExtractEntry, largest compressed size first */
+
+	/* guarded by mutex */
+	GMutex *mutex;
+	GCond *cond;
+	guint next;				/* entries handed out so far */
+	guint running;			/* threads that haven't finished */
+	guint64 bytes_done;
+	gboolean stop;
+	gchar *error;			/* first failure */
+} UtilsZipExtract;
+
+typedef struct UtilsZipExtractWrite
+{
+	UtilsZipExtract *extract;
+	int fd;
+} UtilsZipExtractWrite;
+
+
+// only the first error is kept and everything stops, error is taken over
+static void utils_zip_extract_fail( UtilsZipExtract *extract, gchar *error )
+{
+	g_mutex_lock( extract->mutex );
+	if ( !extract->error && !extract->stop ) extract->error = error;
+	else g_free( error );
+	extract->stop = TRUE;
+	g_mutex_unlock( extract->mutex );
+}
+
+
+// reserves the space for a file about to be written, it doesn't matter if this fails
+static void utils_preallocate( int fd, guint64 size )
+{
+	if ( size == 0 ) return;
+#if defined(__linux__)
+	posix_fallocate( fd, 0, (off_t) size );
+#elif defined(__APPLE__)
+	{
+		fstore_t store = { F_ALLOCATECONTIG, F_PEOFPOSMODE, 0, (off_t) size, 0 };
+		if ( fcntl( fd, F_PREALLOCATE, &store ) == -1 )
+		{
+			store.fst_flags = F_ALLOCATEALL;
+			fcntl( fd, F_PREALLOCATE, &store );
+		}
+	}
+#endif
+}
+
+
+static size_t utils_zip_extract_write( void *opaque, mz_uint64 file_ofs, const void *buf, size_t n )
+{
+	UtilsZipExtractWrite *write_data = opaque;
+	UtilsZipExtract *extract = write_data->extract;
+	const gchar *data = buf;
+	size_t offset = 0;
+	gboolean stop;
+
+	while( offset < n )
+	{
+		ssize_t written = write( write_data->fd, data + offset, n - offset );
+		if ( written < 0 )
+		{
+			if ( errno == EINTR ) continue;
+			return 0;
+		}
+		offset += written;
+	}
+
+	g_mutex_lock( extract->mutex );
+	extract->bytes_done += n;
+	stop = extract->stop;
+	g_mutex_unlock( extract->mutex );
+
+	// a short count makes miniz give up on the entry
+	return stop ? 0 : n;
+}
+
+
+static void utils_zip_extract_entry( UtilsZipExtract *extract, mz_zip_archive *zip, UtilsZipExtractEntry *entry )
+{
+	UtilsZipExtractWrite write_data;
+	struct utimbuf times;
+	gboolean result;
+
+	write_data.extract = extract;
+	write_data.fd = g_open( entry->path, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, entry->mode );
+	if ( write_data.fd < 0 )
+	{
+		utils_zip_extract_fail( extract, g_strdup_printf( "Unable to open '%s' for writing. %s.", entry->path, g_strerror (errno) ) );
+		return;
+	}
+
+	utils_preallocate( write_data.fd, entry->size );
+	// checks the CRC and the size once the last byte has been written
+	result = mz_zip_reader_extract_to_callback( zip, entry->index, utils_zip_extract_write, &write_data, 0 );
+	if ( close( write_data.fd ) != 0 ) result = FALSE;
+
+	if ( !result )
+	{
+		utils_zip_extract_fail( extract, g_strdup_printf( "Failed to extract '%s', the archive may be damaged or the disk full.", entry->path ) );
+		g_unlink( entry->path );
+		return;
+	}
+
+#ifndef G_OS_WIN32
+	// the mode given to open() is reduced by the umask
+	chmod( entry->path, entry->mode );
+#endif
+	times.actime = entry->mtime;
+	times.modtime = entry->mtime;
+	g_utime( entry->path, &times );
+}
+
+
+static gpointer utils_zip_extract_thread( gpointer data )
+{
+	UtilsZipExtract *extract = data;
+	mz_zip_archive zip;
+
+	memset( &zip, 0, sizeof(zip) );
+	if ( mz_zip_reader_init_file( &zip, extract->zip_path, 0 ) )
+	{
+		for( ;; )
+		{
+			UtilsZipExtractEntry *entry = NULL;
+
+			g_mutex_lock( extract->mutex );
+			if ( !extract->stop && extract->next < extract->entries->len )
+				entry = g_ptr_array_index( extract->entries, extract->next++ );
+			g_mutex_unlock( extract->mutex );
+
+			if ( !entry ) break;
+			utils_zip_extract_entry( extract, &zip, entry );
+		}
+		mz_zip_reader_end( &zip );
+	}
+	else utils_zip_extract_fail( extract, g_strdup_printf( "Failed to open '%s'.", extract->zip_path ) );
+
+	g_mutex_lock( extract->mutex );
+	extract->running--;
+	g_cond_broadcast( extract->cond );
+	g_mutex_unlock( extract->mutex );
+	return NULL;
+}
+
+
+// stops archives from writing outside the destination with absolute paths or ".."
+static gboolean utils_zip_extract_name_is_safe( const gchar *name )
+{
+	gchar **parts;
+	gboolean safe = TRUE;
+	gint i;
+
+	if ( !*name || name[0] == '/' || name[0] == '\\' || strchr( name, ':' ) ) return FALSE;
+
+	parts = g_strsplit_set( name, "/\\", -1 );
+	for( i = 0; parts[i] && safe; i++ )
+	{
+		if ( strcmp( parts[i], ".." ) == 0 ) safe = FALSE;
+	}
+	g_strfreev( parts );
+
+	return safe;
+}
+
+
+static gint utils_zip_extract_compare( gconstpointer a, gconstpointer b )
+{
+	const UtilsZipExtractEntry *entry_a = *(const UtilsZipExtractEntry**) a;
+	const UtilsZipExtractEntry *entry_b = *(const UtilsZipExtractEntry**) b;
+
+	if ( entry_a->comp_size == entry_b->comp_size ) return (gint) entry_a->index - (gint) entry_b->index;
+	return (entry_a->comp_size > entry_b->comp_size) ? -1 : 1;
+}
+
+
+/* Unpacks every entry of zip_path into dest on a few threads, replacing existing files.
+ * Files keep the Unix permissions stored in the archive. Archive names listed in executables,
+ * a NULL terminated array which may be NULL, are made executable even if the archive has no
+ * permissions, as archives made on Windows don't. func is called on the calling thread now and
+ * then with the uncompressed bytes written so far and in total, archive_name is NULL, and
+ * returning FALSE from it stops the extraction. On failure, error is set if it isn't NULL and
+ * files already written are left where they are. */
+gboolean utils_zip_extract( const gchar *zip_path, const gchar *dest, const gchar **executables,
+                            UtilsZipProgressFunc func, gpointer user_data, gchar **error )
+{
+	UtilsZipExtract extract;
+	mz_zip_archive zip;
+	GHashTable *folders;
+	GHashTableIter iter;
+	gpointer folder;
+	guint64 bytes_total = 0;
+	guint num_threads;
+	gboolean result = TRUE;
+	mz_uint i;
+
+	g_return_val_if_fail( zip_path != NULL, FALSE );
+	g_return_val_if_fail( dest != NULL, FALSE );
+
+	if ( error ) *error = NULL;
+
+	memset( &zip, 0, sizeof(zip) );
+	if ( !mz_zip_reader_init_file( &zip, zip_path, 0 ) )
+	{
+		if ( error ) *error = g_strdup_printf( "Failed to open '%s'.", zip_path );
+		return FALSE;
+	}
+
+	memset( &extract, 0, sizeof(extract) );
+	extract.zip_path = zip_path;
+	extract.entries = g_ptr_array_new();
+	folders = g_hash_table_new_full( g_str_hash, g_str_equal, g_free, NULL );
+	g_hash_table_insert( folders, g_strdup( dest ), NULL );
+
+	// names are read at their full length, they aren't limited to the size of a buffer
+	for( i = 0; i < mz_zip_reader_get_num_files( &zip ) && result; i++ )
+	{
+		mz_zip_archive_file_stat stat;
+		mz_uint name_size = mz_zip_reader_get_filename( &zip, i, NULL, 0 );
+		gchar *name = g_malloc( MAX( name_size, 1 ) );
+		gchar *path;
+
+		mz_zip_reader_get_filename( &zip, i, name, name_size );
+		if ( !mz_zip_reader_file_stat( &zip, i, &stat ) || !utils_zip_extract_name_is_safe( name ) )
+		{
+			if ( error ) *error = g_strdup_printf( "Invalid entry '%s' in '%s'.", name, zip_path );
+			result = FALSE;
+		}
+		else if ( mz_zip_reader_is_file_a_directory( &zip, i ) )
+		{
+			g_hash_table_insert( folders, g_build_filename( dest, name, NULL ), NULL );
+		}
+		else
+		{
+			UtilsZipExtractEntry *entry = g_new0( UtilsZipExtractEntry, 1 );
+			guint mode = stat.m_external_attr >> 16;
+			guint j;
+
+			path = g_build_filename( dest, name, NULL );
+			g_hash_table_insert( folders, g_path_get_dirname( path ), NULL );
+
+			entry->index = i;
+			entry->path = path;
+			entry->size = stat.m_uncomp_size;
+			entry->comp_size = stat.m_comp_size;
+			entry->mtime = stat.m_time;
+			// version made by 3 is Unix, which keeps the file mode in the top of the external attributes
+			entry->mode = ((stat.m_version_made_by >> 8) == 3 && (mode & 0777)) ? (mode & 0777) : 0644;
+			for( j = 0; executables && executables[j]; j++ )
+			{
+				if ( strcmp( executables[j], name ) == 0 ) entry->mode |= 0755;
+			}
+
+			bytes_total += entry->size;
+			g_ptr_array_add( extract.entries, entry );
+		}
+		g_free( name );
+	}
+	mz_zip_reader_end( &zip );
+
+	// folders first so that the threads only ever write files
+	g_hash_table_iter_init( &iter, folders );
+	while ( result && g_hash_table_iter_next( &iter, &folder, NULL ) )
+	{
+		if ( g_mkdir_with_parents( folder, 0755 ) != 0 )
+		{
+			if ( error ) *error = g_strdup_printf( "Unable to create folder '%s'. %s.", (gchar*) folder, g_strerror (errno) );
+			result = FALSE;
+		}
+	}
+	g_hash_table_destroy( folders );
+
+	if ( result && extract.entries->len > 0 )
+	{
+		GThread **threads;
+
+		g_ptr_array_sort( extract.entries, utils_zip_extract_compare );
+		extract.mutex = g_mutex_new();
+		extract.cond = g_cond_new();
+
+		num_threads = MIN( utils_get_cpu_count(), extract.entries->len );
+		threads = g_new0( GThread*, num_threads );
+		for( i = 0; i < num_threads; i++ )
+		{
+			g_mutex_lock( extract.mutex );
+			extract.running++;
+			g_mutex_unlock( extract.mutex );
+
+			threads[i] = g_thread_create( utils_zip_extract_thread, &extract, TRUE, NULL );
+			if ( !threads[i] )
+			{
+				g_mutex_lock( extract.mutex );
+				extract.running--;
+				g_mutex_unlock( extract.mutex );
+				break;
+			}
+		}
+
+		// no threads at all, do it here instead
+		if ( i == 0 )
+		{
+			extract.running = 1;
+			utils_zip_extract_thread( &extract );
+		}
+
+		g_mutex_lock( extract.mutex );
+		while( extract.running > 0 )
+		{
+			GTimeVal until;
+			guint64 bytes_done;
+
+			g_get_current_time( &until );
+			g_time_val_add( &until, 100000 );
+			g_cond_timed_wait( extract.cond, extract.mutex, &until );
+
+			bytes_done = extract.bytes_done;
+			g_mutex_unlock( extract.mutex );
+			if ( func && !func( NULL, bytes_done, bytes_total, user_data ) )
+				utils_zip_extract_fail( &extract, g_strdup( "Extraction cancelled." ) );
+			g_mutex_lock( extract.mutex );
+		}
+		g_mutex_unlock( extract.mutex );
+
+		for( i = 0; i < num_threads && threads[i]; i++ )
+			g_thread_join( threads[i] );
+		g_free( threads );
+
+		if ( extract.error )
+		{
+			result = FALSE;
+			if ( error ) *error = extract.error;
+			else g_free( extract.error );
+		}
+		else if ( func ) func( NULL, bytes_total, bytes_total, user_data );
+
+		g_mutex_free( extract.mutex );
+		g_cond_free( extract.cond );
+	}
+
+	for( i = 0; i < extract.entries->len; i++ )
+	{
+		UtilsZipExtractEntry *entry = g_ptr_array_index( extract.entries, i );
+		g_free( entry->path );
+		g_free( entry );
+	}
+	g_ptr_array_free( extract.entries, TRUE );
+
+	return result;
+}
+
+
+/* Export size analysis.
+ * Works out what each file would cost in an export archive without writing one. Files are
+ * queued like utils_zip_queue_add_file() and utils_zip_queue_add_folder(), with the same
+ * compression levels, and utils_size_report_run() deflates them on a pool of threads and
+ * finds the ones with identical contents. */
+
+struct UtilsSizeReport
+{
+	GPtrArray *entries;		/* UtilsSizeEntry */
+	GHashTable *levels;		/* from utils_size_report_set_levels(), or NULL */
+	GMutex *mutex;
+	GCond *cond;
+};
+
+
+UtilsSizeReport *utils_size_report_new( void )
+{
+	UtilsSizeReport *report = g_new0( UtilsSizeReport, 1 );
+
+	report->entries = g_ptr_array_new();
+	report->mutex = g_mutex_new();
+	report->cond = g_cond_new();
+	return report;
+}
+
+
+void utils_size_report_free( UtilsSizeReport *report )
+{
+	guint i;
+
+	if ( !report ) return;
+
+	for( i = 0; i < report->entries->len; i++ )
+	{
+		UtilsSizeEntry *entry = g_ptr_array_index( report->entries, i );
+		g_free( entry->archive_name );
+		g_free( entry->src_path );
+		g_free( entry->sha1 );
+		g_free( entry );
+	}
+	g_ptr_array_free( report->entries, TRUE );
+	if ( report->levels ) g_hash_table_destroy( report->levels );
+	g_mutex_free( report->mutex );
+	g_cond_free( report->cond );
+	g_free( report );
+}
+
+
+void utils_size_report_add_file( UtilsSizeReport *report, const gchar *archive_name, const gchar *src_path, gint level )
+{
+	UtilsSizeEntry *entry = g_new0( UtilsSizeEntry, 1 );
+
+	entry->archive_name = g_strdup( archive_name );
+	entry->src_path = g_strdup( src_path );
+	entry->level = level;
+	g_ptr_array_add( report->entries, entry );
+}
+
+
+/* Same as utils_zip_queue_set_levels(), must be called before utils_size_report_add_folder(). */
+void utils_size_report_set_levels( UtilsSizeReport *report, const gchar *overrides )
+{
+	if ( report->levels ) g_hash_table_destroy( report->levels );
+	report->levels = utils_zip_parse_levels( overrides );
+}
+
+
+/* Adds every file in src under dst, with the levels utils_add_folder_to_zip() would use. */
+gboolean utils_size_report_add_folder( UtilsSizeReport *report, const gchar* src, const gchar* dst, gboolean recursive, gboolean selective_compress )
+{
+	const gchar *filename;
+	GDir *dir = g_dir_open( src, 0, NULL );
+
+	if ( !dir ) return FALSE;
+
+	foreach_dir(filename, dir)
+	{
+		gchar* fullsrcpath = g_build_path( "/", src, filename, NULL );
+		gchar* fulldstpath = g_build_path( "/", dst, filename, NULL );
+
+		if ( g_file_test( fullsrcpath, G_FILE_TEST_IS_DIR ) )
+		{
+			if ( recursive ) utils_size_report_add_folder( report, fullsrcpath, fulldstpath, recursive, selective_compress );
+		}
+		else if ( g_file_test( fullsrcpath, G_FILE_TEST_IS_REGULAR ) )
+		{
+			utils_size_report_add_file( report, fulldstpath, fullsrcpath, utils_zip_get_level( filename, selective_compress, report->levels, NULL ) );
+		}
+
+		g_free(fullsrcpath);
+		g_free(fulldstpath);
+	}
+
+	g_dir_close(dir);
+	return TRUE;
+}
+
+
+static void utils_size_report_measure_entry(gpointer data, gpointer user_data)
+{
+	UtilsSizeEntry *entry = data;
+	UtilsSizeReport *report = user_data;
+	gchar *contents = NULL;
+	gsize length = 0;
+
+	if ( !g_file_get_contents( entry->src_path, &contents, &length, NULL ) )
+	{
+		entry->failed = TRUE;
+	}
+	else
+	{
+		entry->size = length;
+		entry->compressed_size = length;
+		entry->sha1 = g_compute_checksum_for_data( G_CHECKSUM_SHA1, (const guchar*) contents, length );
+
+		// same rules as utils_zip_deflate_entry(), deflate is only kept if it is smaller
+		if ( entry->level == UTILS_ZIP_LEVEL_AUTO )
+		{
+			gdouble ratio;
+			entry->level = utils_zip_classify( contents, length, &ratio );
+		}
+		if ( entry->level > 0 && length > 3 )
+		{
+			size_t comp_size = 0;
+			void *comp = tdefl_compress_mem_to_heap( contents, length, &comp_size,
+				tdefl_create_comp_flags_from_zip_params( entry->level, -15, MZ_DEFAULT_STRATEGY ) );
+
+			if ( comp && comp_size < length ) entry->compressed_size = comp_size;
+			mz_free( comp );
+		}
+		g_free( contents );
+	}
+
+	g_mutex_lock( report->mutex );
+	entry->done = TRUE;
+	g_cond_broadcast( report->cond );
+	g_mutex_unlock( report->mutex );
+}
+
+
+/* Reads and compresses every file on a pool of threads, then marks each file whose contents
+ * were already seen as a duplicate of the first one. func is called on the calling thread as
+ * files complete, in the order they were added, with the bytes read so far; returning FALSE
+ * stops the report and makes this return FALSE. Files that can't be read are marked failed. */
+gboolean utils_size_report_run( UtilsSizeReport *report, UtilsZipProgressFunc func, gpointer user_data )
+{
+	guint num_threads = utils_get_cpu_count();
+	guint window = num_threads * 2; // files held in memory at once
+	guint submitted = 0;
+	guint i;
+	guint64 bytes_done = 0;
+	guint64 bytes_total = 0;
+	gboolean result = TRUE;
+	GThreadPool *pool;
+	GHashTable *seen;
+
+	if ( func )
+	{
+		for( i = 0; i < report->entries->len; i++ )
+		{
+			UtilsSizeEntry *entry = g_ptr_array_index( report->entries, i );
+			struct stat st;
+
+			if ( g_stat( entry->src_path, &st ) == 0 ) bytes_total += st.st_size;
+		}
+	}
+
+	pool = g_thread_pool_new( utils_size_report_measure_entry, report, num_threads, FALSE, NULL );
+
+	for( i = 0; i < report->entries->len; i++ )
+	{
+		UtilsSizeEntry *entry = g_ptr_array_index( report->entries, i );
+
+		for( ; submitted < report->entries->len && submitted < i + window; submitted++ )
+			g_thread_pool_push( pool, g_ptr_array_index( report->entries, submitted ), NULL );
+
+		g_mutex_lock( report->mutex );
+		while( !entry->done )
+			g_cond_wait( report->cond, report->mutex );
+		g_mutex_unlock( report->mutex );
+
+		bytes_done += entry->size;
+		if ( func && !func( entry->archive_name, bytes_done, bytes_total, user_data ) )
+		{
+			result = FALSE;
+			break;
+		}
+	}
+
+	// waits for any files still being read
+	g_thread_pool_free( pool, FALSE, TRUE );
+	if ( !result ) return FALSE;
+
+	seen = g_hash_table_new( g_str_hash, g_str_equal );
+	for( i = 0; i < report->entries->len; i++ )
+	{
+		UtilsSizeEntry *entry = g_ptr_array_index( report->entries, i );
+		UtilsSizeEntry *first;
+
+		if ( entry->failed || entry->size == 0 ) continue;
+
+		first = g_hash_table_lookup( seen, entry->sha1 );
+		if ( first ) entry->duplicate_of = first;
+		else g_hash_table_insert( seen, entry->sha1, entry );
+	}
+	g_hash_table_destroy( seen );
+
+	return TRUE;
+}
+
+
+guint utils_size_report_get_count( UtilsSizeReport *report )
+{
+	return report->entries->len;
+}
+
+
+const UtilsSizeEntry *utils_size_report_get_entry( UtilsSizeReport *report, guint index )
+{
+	g_return_val_if_fail( index < report->entries->len, NULL );
+
+	return g_ptr_array_index( report->entries, index );
+}
+
+
+static void utils_size_report_append_csv_field( GString *str, const gchar *text )
+{
+	const gchar *p;
+
+	if ( !strpbrk( text, ",\"\r\n" ) )
+	{
+		g_string_append( str, text );
+		return;
+	}
+
+	g_string_append_c( str, '"' );
+	for( p = text; *p; p++ )
+	{
+		if ( *p == '"' ) g_string_append_c( str, '"' );
+		g_string_append_c( str, *p );
+	}
+	g_string_append_c( str, '"' );
+}
+
+
+/* Writes one line per file, after a header line, for loading into a spreadsheet.
+ * The ratio is compressed size over size, so smaller is better. */
+gboolean utils_size_report_write_csv( UtilsSizeReport *report, const gchar *filename, GError **error )
+{
+	GString *str = g_string_sized_new( 128 + report->entries->len * 96 );
+	gchar buf[ G_ASCII_DTOSTR_BUF_SIZE ];
+	gboolean result;
+	guint i;
+
+	g_string_append( str, "file,extension,size,compressed,ratio,level,duplicate_of\n" );
+	for( i = 0; i < report->entries->len; i++ )
+	{
+		UtilsSizeEntry *entry = g_ptr_array_index( report->entries, i );
+		const gchar *name = strrchr( entry->archive_name, '/' );
+		const gchar *ext = strrchr( name ? name : entry->archive_name, '.' );
+		gdouble ratio = entry->size ? (gdouble) entry->compressed_size / entry->size : 1.0;
+
+		if ( entry->failed ) continue;
+
+		utils_size_report_append_csv_field( str, entry->archive_name );
+		g_string_append_c( str, ',' );
+		utils_size_report_append_csv_field( str, ext ? ext : "" );
+		g_string_append_printf( str, ",%" G_GUINT64_FORMAT ",%" G_GUINT64_FORMAT ",%s,%d,",
+			entry->size, entry->compressed_size, g_ascii_formatd( buf, sizeof(buf), "%.3f", ratio ), entry->level );
+		if ( entry->duplicate_of ) utils_size_report_append_csv_field( str, entry->duplicate_of->archive_name );
+		g_string_append_c( str, '\n' );
+	}
+
+	result = g_file_set_contents( filename, str->str, str->len, error );
+	g_string_free( str, TRUE );
+	return result;
+}
+
+
+
+/* Export staging without copying the template. Paths relative to the template folder read
+ * from the template itself unless the export replaced them with generated contents, and
+ * only the files an external tool has to find on disk are written out. */
+
+typedef struct UtilsOverlayFile
+{
+	gchar *contents;
+	gsize length;
+} UtilsOverlayFile;
+
+struct UtilsOverlay
+{
+	gchar *base_folder;
+	GHashTable *files;		/* relative path -> UtilsOverlayFile */
+};
+
+
+static void utils_overlay_file_free(gpointer data)
+{
+	UtilsOverlayFile *file = data;
+
+	g_free( file->contents );
+	g_free( file );
+}
+
+
+UtilsOverlay *utils_overlay_new( const gchar *base_folder )
+{
+	UtilsOverlay *overlay = g_new0( UtilsOverlay, 1 );
+
+	overlay->base_folder = g_strdup( base_folder );
+	overlay->files = g_hash_table_new_full( g_str_hash, g_str_equal, g_free, utils_overlay_file_free );
+	return overlay;
+}
+
+
+void utils_overlay_free( UtilsOverlay *overlay )
+{
+	if ( !overlay ) return;
+
+	g_hash_table_destroy( overlay->files );
+	g_free( overlay->base_folder );
+	g_free( overlay );
+}
+
+
+/* Replaces the template file at path, contents are copied. */
+void utils_overlay_set_contents( UtilsOverlay *overlay, const gchar *path, const gchar *contents, gssize length )
+{
+	UtilsOverlayFile *file = g_new0( UtilsOverlayFile, 1 );
+
+	file->length = (length < 0) ? strlen( contents ) : (gsize) length;
+	file->contents = g_malloc( file->length + 1 );
+	memcpy( file->contents, contents, file->length );
+	file->contents[ file->length ] = 0;
+
+	g_hash_table_insert( overlay->files, g_strdup( path ), file );
+}
+
+
+/* Same as g_file_get_contents() but sees replaced files. */
+gboolean utils_overlay_get_contents( UtilsOverlay *overlay, const gchar *path, gchar **contents, gsize *length, GError **error )
+{
+	UtilsOverlayFile *file = g_hash_table_lookup( overlay->files, path );
+	gchar *src_path;
+	gboolean result;
+
+	if ( file )
+	{
+		*contents = g_memdup( file->contents, file->length + 1 );
+		if ( length ) *length = file->length;
+		return TRUE;
+	}
+
+	src_path = g_build_path( "/", overlay->base_folder, path, NULL );
+	result = g_file_get_contents( src_path, contents, length, error );
+	g_free( src_path );
+	return result;
+}
+
+
+/* Writes the file at path to dst_path, copying it straight from the template if it wasn't replaced. */
+gboolean utils_overlay_write( UtilsOverlay *overlay, const gchar *path, const gchar *dst_path, GError **error )
+{
+	UtilsOverlayFile *file = g_hash_table_lookup( overlay->files, path );
+	gchar *src_path;
+	gboolean result;
+
+	if ( file )
+		return g_file_set_contents( dst_path, file->contents, file->length, error );
+
+	src_path = g_build_path( "/", overlay->base_folder, path, NULL );
+	result = utils_copy_file( src_path, dst_path, TRUE, NULL );
+	if ( !result )
+		g_set_error( error, G_FILE_ERROR, G_FILE_ERROR_FAILED, "Failed to copy %s", src_path );
+	g_free( src_path );
+	return result;
+}
+
+
+/* Writes the file at path to the same relative location in dst_folder, for tools that must read it from disk. */
+gboolean utils_overlay_materialize( UtilsOverlay *overlay, const gchar *path, const gchar *dst_folder, GError **error )
+{
+	gchar *dst_path = g_build_path( "/", dst_folder, path, NULL );
+	gchar *dst_dir = g_path_get_dirname( dst_path );
+	gboolean result;
+
+	utils_mkdir( dst_dir, TRUE );
+	result = utils_overlay_write( overlay, path, dst_path, error );
+
+	g_free( dst_dir );
+	g_free( dst_path );
+	return result;
+}
+
+
+/* Placeholder substitution for the export templates. Keys are found in a single scan when the
+ * template is compiled, which splits it into literal text and placeholders, and every value is
+ * then written in one pass. A plain key is replaced as a whole, an element key keeps its open
+ * and close text and replaces what is between them, e.g. the contents of <string name="app_name">.
+ * Placeholders without a value keep their original text. */
+
+typedef struct UtilsTemplateKey
+{
+	gchar *open;
+	gsize open_len;
+	gchar *close;		/* NULL for plain keys */
+	gchar *value;		/* NULL keeps the original text */
+	guint count;		/* matches in the compiled text */
+} UtilsTemplateKey;
+
+typedef struct UtilsTemplateSegment
+{
+	gsize start;
+	gsize length;
+	UtilsTemplateKey *key;		/* NULL for literal text */
+} UtilsTemplateSegment;
+
+struct UtilsTemplate
+{
+	GPtrArray *keys;
+	GHashTable *lookup;		/* open text -> UtilsTemplateKey */
+	gboolean first_bytes[256];	/* bytes a key can start with */
+	gchar *text;
+	GArray *segments;
+};
+
+
+UtilsTemplate *utils_template_new( void )
+{
+	UtilsTemplate *tmpl = g_new0( UtilsTemplate, 1 );
+
+	tmpl->keys = g_ptr_array_new();
+	tmpl->lookup = g_hash_table_new( g_str_hash, g_str_equal );
+	tmpl->segments = g_array_new( FALSE, FALSE, sizeof(UtilsTemplateSegment) );
+	return tmpl;
+}
+
+
+void utils_template_free( UtilsTemplate *tmpl )
+{
+	guint i;
+
+	if ( !tmpl ) return;
+
+	for ( i = 0; i < tmpl->keys->len; i++ )
+	{
+		UtilsTemplateKey *key = g_ptr_array_index( tmpl->keys, i );
+		g_free( key->open );
+		g_free( key->close );
+		g_free( key->value );
+		g_free( key );
+	}
+	g_ptr_array_free( tmpl->keys, TRUE );
+	g_hash_table_destroy( tmpl->lookup );
+	g_array_free( tmpl->segments, TRUE );
+	g_free( tmpl->text );
+	g_free( tmpl );
+}
+
+
+static void utils_template_add( UtilsTemplate *tmpl, const gchar *open, const gchar *close )
+{
+	UtilsTemplateKey *key;
+
+	g_return_if_fail( open != NULL && *open );
+
+	if ( g_hash_table_lookup( tmpl->lookup, open ) ) return;
+
+	key = g_new0( UtilsTemplateKey, 1 );
+	key->open = g_strdup( open );
+	key->open_len = strlen( open );
+	key->close = g_strdup( close );
+	g_ptr_array_add( tmpl->keys, key );
+	g_hash_table_insert( tmpl->lookup, key->open, key );
+	tmpl->first_bytes[ (guchar) *open ] = TRUE;
+}
+
+
+/* Adds a key that is replaced as a whole, must be called before utils_template_compile(). */
+void utils_template_add_key( UtilsTemplate *tmpl, const gchar *key )
+{
+	utils_template_add( tmpl, key, NULL );
+}
+
+
+/* Adds a key whose value replaces the text between open and the next close, must be called
+ * before utils_template_compile(). The value is set using open as the key. */
+void utils_template_add_element( UtilsTemplate *tmpl, const gchar *open, const gchar *close )
+{
+	g_return_if_fail( close != NULL && *close );
+
+	utils_template_add( tmpl, open, close );
+}
+
+
+static void utils_template_add_segment( UtilsTemplate *tmpl, gsize start, gsize end, UtilsTemplateKey *key )
+{
+	UtilsTemplateSegment segment;
+
+	if ( end <= start && !key ) return;
+
+	segment.start = start;
+	segment.length = end - start;
+	segment.key = key;
+	g_array_append_val( tmpl->segments, segment );
+}
+
+
+/* Splits text into literal text and placeholders for the keys added so far, text is copied.
+ * Where keys overlap the longest one wins. */
+void utils_template_compile( UtilsTemplate *tmpl, const gchar *text, gssize length )
+{
+	gsize len = (length < 0) ? strlen( text ) : (gsize) length;
+	gsize literal = 0;
+	gsize pos = 0;
+	guint i;
+
+	g_free( tmpl->text );
+	tmpl->text = g_strndup( text, len );
+	g_array_set_size( tmpl->segments, 0 );
+	for ( i = 0; i < tmpl->keys->len; i++ )
+		((UtilsTemplateKey*) g_ptr_array_index( tmpl->keys, i ))->count = 0;
+
+	while ( pos < len )
+	{
+		UtilsTemplateKey *match = NULL;
+		const gchar *close = NULL;
+
+		if ( !tmpl->first_bytes[ (guchar) tmpl->text[pos] ] )
+		{
+			pos++;
+			continue;
+		}
+
+		for ( i = 0; i < tmpl->keys->len; i++ )
+		{
+			UtilsTemplateKey *key = g_ptr_array_index( tmpl->keys, i );
+			const gchar *key_close = NULL;
+
+			if ( key->open_len > len - pos || (match && key->open_len <= match->open_len) ) continue;
+			if ( memcmp( tmpl->text + pos, key->open, key->open_len ) != 0 ) continue;
+			if ( key->close )
+			{
+				gsize from = pos + key->open_len;
+				key_close = g_strstr_len( tmpl->text + from, len - from, key->close );
+				if ( !key_close ) continue;
+			}
+
+			match = key;
+			close = key_close;
+		}
+
+		if ( !match )
+		{
+			pos++;
+			continue;
+		}
+
+		match->count++;
+		if ( close )
+		{
+			gsize end = close - tmpl->text;
+			utils_template_add_segment( tmpl, literal, pos + match->open_len, NULL );
+			utils_template_add_segment( tmpl, pos + match->open_len, end, match );
+			literal = end;
+			pos = end + strlen( match->close );
+		}
+		else
+		{
+			utils_template_add_segment( tmpl, literal, pos, NULL );
+			utils_template_add_segment( tmpl, pos, pos + match->open_len, match );
+			pos += match->open_len;
+			literal = pos;
+		}
+	}
+
+	utils_template_add_segment( tmpl, literal, len, NULL );
+}
+
+
+/* Whether the compiled text contains key, for element keys this needs the close text as well. */
+gboolean utils_template_contains( UtilsTemplate *tmpl, const gchar *key )
+{
+	UtilsTemplateKey *k = g_hash_table_lookup( tmpl->lookup, key );
+
+	return k && k->count > 0;
+}
+
+
+/* Sets the value written for key, or NULL to keep the original text. The value is copied. */
+void utils_template_set( UtilsTemplate *tmpl, const gchar *key, const gchar *value )
+{
+	UtilsTemplateKey *k = g_hash_table_lookup( tmpl->lookup, key );
+
+	g_return_if_fail( k != NULL );
+
+	SETPTR( k->value, g_strdup( value ) );
+}
+
+
+/* Appends the compiled text with all the values filled in to output. */
+void utils_template_render( UtilsTemplate *tmpl, GString *output )
+{
+	guint i;
+
+	for ( i = 0; i < tmpl->segments->len; i++ )
+	{
+		const UtilsTemplateSegment *segment = &g_array_index( tmpl->segments, UtilsTemplateSegment, i );
+
+		if ( segment->key && segment->key->value )
+			g_string_append( output, segment->key->value );
+		else
+			g_string_append_len( output, tmpl->text + segment->start, segment->length );
+	}
+}
+
+
+/* gzip files for static web hosting. The file is split into chunks that are deflated on
+ * separate threads at the highest level, every chunk but the last ending in a sync flush, so
+ * that joined together they make one deflate stream. Chunks don't share a dictionary, which
+ * costs a little size for a lot of speed on large files. */
+
+#define UTILS_GZIP_CHUNK_SIZE (1024*1024)
+#define UTILS_HTML5_CHUNK_SIZE (256*1024)
+
+typedef struct UtilsGzipChunk
+{
+	const guint8 *data;
+	size_t size;
+	gboolean last;
+
+	/* filled in by a worker thread */
+	gboolean done;
+	gboolean failed;
+	GByteArray *output;
+} UtilsGzipChunk;
+
+typedef struct UtilsGzipState
+{
+	GMutex *mutex;
+	GCond *cond;
+} UtilsGzipState;
+
+
+static mz_bool utils_gzip_put_buf( const void *pBuf, int len, void *pUser )
+{
+	g_byte_array_append( (GByteArray*) pUser, (const guint8*) pBuf, len );
+	return MZ_TRUE;
+}
+
+
+static void utils_gzip_deflate_chunk( gpointer data, gpointer user_data )
+{
+	UtilsGzipChunk *chunk = data;
+	UtilsGzipState *state = user_data;
+	tdefl_compressor *comp = g_try_malloc( sizeof(tdefl_compressor) );
+	tdefl_status expected = chunk->last ? TDEFL_STATUS_DONE : TDEFL_STATUS_OKAY;
+
+	chunk->output = g_byte_array_sized_new( chunk->size / 2 + 64 );
+	if ( !comp
+		|| tdefl_init( comp, utils_gzip_put_buf, chunk->output, tdefl_create_comp_flags_from_zip_params( MZ_UBER_COMPRESSION, -15, MZ_DEFAULT_STRATEGY ) ) != TDEFL_STATUS_OKAY
+		|| tdefl_compress_buffer( comp, chunk->data, chunk->size, chunk->last ? TDEFL_FINISH : TDEFL_SYNC_FLUSH ) != expected )
+	{
+		chunk->failed = TRUE;
+	}
+	g_free( comp );
+
+	g_mutex_lock( state->mutex );
+	chunk->done = TRUE;
+	g_cond_signal( state->cond );
+	g_mutex_unlock( state->mutex );
+}
+
+
+static void utils_gzip_put_uint32( guint8 *dst, guint32 value )
+{
+	dst[0] = value & 0xFF;
+	dst[1] = (value >> 8) & 0xFF;
+	dst[2] = (value >> 16) & 0xFF;
+	dst[3] = (value >> 24) & 0xFF;
+}
+
+
+/* Writes a gzip compressed copy of src_path to dst_path. */
+gboolean utils_write_gzip_file( const gchar *src_path, const gchar *dst_path )
+{
+	GMappedFile *map;
+	const guint8 *contents;
+	gsize length;
+	guint num_chunks, num_threads, window, submitted = 0, i;
+	UtilsGzipChunk *chunks;
+	UtilsGzipState state;
+	GThreadPool *pool;
+	guint8 header[10] = { 0x1F, 0x8B, 8, 0, 0, 0, 0, 0, 2, 3 }; // deflate, no name, best compression, unix
+	guint8 trailer[8];
+	mz_ulong crc = MZ_CRC32_INIT;
+	struct stat st;
+	FILE *pFile;
+	gboolean result = TRUE;
+	// only keep the UI going if this is the main loop's thread
+	gboolean pump_events = g_main_context_is_owner( g_main_context_default() );
+
+	g_return_val_if_fail (src_path != NULL, FALSE);
+	g_return_val_if_fail (dst_path != NULL, FALSE);
+
+	map = g_mapped_file_new( src_path, FALSE, NULL );
+	if ( !map )
+	{
+		g_critical (G_STRLOC ": Failed to open file '%s'", src_path);
+		return FALSE;
+	}
+	contents = (const guint8*) g_mapped_file_get_contents( map );
+	length = g_mapped_file_get_length( map );
+
+	pFile = g_fopen( dst_path, "wb" );
+	if ( !pFile )
+	{
+		g_critical (G_STRLOC ": Failed to open file '%s' for writing", dst_path);
+#if GLIB_CHECK_VERSION(2, 22, 0)
+		g_mapped_file_unref( map );
+#else
+		g_mapped_file_free( map );
+#endif
+		return FALSE;
+	}
+
+	if ( g_stat( src_path, &st ) == 0 ) utils_gzip_put_uint32( header + 4, (guint32) st.st_mtime );
+	if ( fwrite( header, 1, sizeof(header), pFile ) != sizeof(header) ) result = FALSE;
+
+	num_chunks = MAX( 1, (length + UTILS_GZIP_CHUNK_SIZE - 1) / UTILS_GZIP_CHUNK_SIZE );
+	chunks = g_new0( UtilsGzipChunk, num_chunks );
+	for( i = 0; i < num_chunks; i++ )
+	{
+		chunks[i].data = contents + (gsize) i * UTILS_GZIP_CHUNK_SIZE;
+		chunks[i].size = MIN( UTILS_GZIP_CHUNK_SIZE, length - (gsize) i * UTILS_GZIP_CHUNK_SIZE );
+		chunks[i].last = (i == num_chunks - 1);
+	}
+
+	num_threads = utils_get_cpu_count();
+	window = num_threads * 2; // compressed chunks waiting to be written, limits memory use
+	state.mutex = g_mutex_new();
+	state.cond = g_cond_new();
+	pool = g_thread_pool_new( utils_gzip_deflate_chunk, &state, num_threads, FALSE, NULL );
+
+	for( i = 0; i < num_chunks && result; i++ )
+	{
+		for( ; submitted < num_chunks && submitted < i + window; submitted++ )
+			g_thread_pool_push( pool, &chunks[submitted], NULL );
+
+		g_mutex_lock( state.mutex );
+		while( !chunks[i].done )
+		{
+			if ( pump_events )
+			{
+				GTimeVal until;
+
+				g_get_current_time( &until );
+				g_time_val_add( &until, 20000 );
+				g_cond_timed_wait( state.cond, state.mutex, &until );
+
+				g_mutex_unlock( state.mutex );
+				while (gtk_events_pending())
+					gtk_main_iteration();
+				g_mutex_lock( state.mutex );
+			}
+			else
+				g_cond_wait( state.cond, state.mutex );
+		}
+		g_mutex_unlock( state.mutex );
+
+		crc = mz_crc32( crc, chunks[i].data, chunks[i].size );
+		if ( chunks[i].failed || fwrite( chunks[i].output->data, 1, chunks[i].output->len, pFile ) != chunks[i].output->len )
+			result = FALSE;
+
+		g_byte_array_free( chunks[i].output, TRUE );
+		chunks[i].output = NULL;
+	}
+
+	// waits for any chunks still being compressed
+	g_thread_pool_free( pool, FALSE, TRUE );
+	for( i = 0; i < num_chunks; i++ )
+		if ( chunks[i].output ) g_byte_array_free( chunks[i].output, TRUE );
+
+	utils_gzip_put_uint32( trailer, (guint32) crc );
+	utils_gzip_put_uint32( trailer + 4, (guint32) length );
+	if ( result && fwrite( trailer, 1, sizeof(trailer), pFile ) != sizeof(trailer) ) result = FALSE;
+	if ( fclose( pFile ) != 0 ) result = FALSE;
+
+	if ( !result )
+	{
+		g_critical (G_STRLOC ": Failed to write file '%s'", dst_path);
+		g_unlink( dst_path );
+	}
+
+	g_free( chunks );
+	g_mutex_free( state.mutex );
+	g_cond_free( state.cond );
+#if GLIB_CHECK_VERSION(2, 22, 0)
+	g_mapped_file_unref( map );
+#else
+	g_mapped_file_free( map );
+#endif
+	return result;
+}
+
+
+/* Export fingerprints. Every input of an export is recorded with a hash of its contents, and the
+ * record is saved with the hashes of the files the export wrote. The next export of the same
+ * output compares its inputs against the record, so it can skip the work when nothing changed
+ * and otherwise say exactly which inputs did. Files whose size and time match the record reuse
+ * the hash from it, unless they were modified in the second the record was taken. */
+
+#define UTILS_FINGERPRINT_HEADER "AGK fingerprint 1"
+#define UTILS_FINGERPRINT_BUFFER_SIZE (64*1024)
+
+typedef struct UtilsFingerprintInput
+{
+	gint64 size;		/* -1 unless the hash is of a file's contents */
+	gint64 mtime;
+	gchar *hash;
+} UtilsFingerprintInput;
+
+struct UtilsFingerprint
+{
+	gchar *record_file;
+	gint64 time;			/* when the inputs were read */
+	GHashTable *inputs;		/* key -> UtilsFingerprintInput */
+	GHashTable *outputs;	/* path -> NULL, filled in by utils_fingerprint_save() */
+
+	/* from the record of the last export, if there is one */
+	gboolean have_previous;
+	gint64 previous_time;
+	gchar *previous_digest;
+	GHashTable *previous_inputs;
+	GHashTable *previous_outputs;	/* path -> UtilsFingerprintInput */
+};
+
+
+static void utils_fingerprint_input_free(gpointer data)
+{
+	UtilsFingerprintInput *input = data;
+
+	g_free( input->hash );
+	g_free( input );
+}
+
+
+static UtilsFingerprintInput *utils_fingerprint_input_new(gint64 size, gint64 mtime, gchar *hash)
+{
+	UtilsFingerprintInput *input = g_new0( UtilsFingerprintInput, 1 );
+
+	input->size = size;
+	input->mtime = mtime;
+	input->hash = hash;
+	return input;
+}
+
+
+// SHA1 of the contents of path, read in pieces so large media doesn't have to fit in memory
+static gchar *utils_fingerprint_hash_file(const gchar *path)
+{
+	GChecksum *checksum;
+	guchar *buffer;
+	gchar *hash = NULL;
+	size_t count;
+	FILE *pFile = g_fopen( path, "rb" );
+
+	if ( !pFile ) return NULL;
+
+	checksum = g_checksum_new( G_CHECKSUM_SHA1 );
+	buffer = g_malloc( UTILS_FINGERPRINT_BUFFER_SIZE );
+	while( (count = fread( buffer, 1, UTILS_FINGERPRINT_BUFFER_SIZE, pFile )) > 0 )
+		g_checksum_update( checksum, buffer, count );
+	if ( !ferror( pFile ) ) hash = g_strdup( g_checksum_get_string( checksum ) );
+
+	fclose( pFile );
+	g_free( buffer );
+	g_checksum_free( checksum );
+	return hash;
+}
+
+
+// reads the record of the last export, a missing or unreadable record just means there isn't one
+static void utils_fingerprint_load(UtilsFingerprint *fp)
+{
+	gchar *contents = NULL;
+	gchar **lines;
+	gint i;
+
+	if ( !g_file_get_contents( fp->record_file, &contents, NULL, NULL ) ) return;
+
+	lines = g_strsplit( contents, "\n", -1 );
+	if ( lines[0] && strcmp( lines[0], UTILS_FINGERPRINT_HEADER ) == 0 )
+	{
+		fp->have_previous = TRUE;
+
+		// time and digest lines, then one line per input or output: type, size, time, hash, escaped key
+		for( i = 1; lines[i]; i++ )
+		{
+			gchar **fields = g_strsplit( lines[i], "\t", 5 );
+			guint count = g_strv_length( fields );
+
+			if ( count == 2 && strcmp( fields[0], "time" ) == 0 )
+				fp->previous_time = g_ascii_strtoll( fields[1], NULL, 10 );
+			else if ( count == 2 && strcmp( fields[0], "digest" ) == 0 )
+				SETPTR( fp->previous_digest, g_strdup( fields[1] ) );
+			else if ( count == 5 && (strcmp( fields[0], "in" ) == 0 || strcmp( fields[0], "out" ) == 0) )
+			{
+				GHashTable *table = (fields[0][0] == 'i') ? fp->previous_inputs : fp->previous_outputs;
+
+				g_hash_table_insert( table, g_strcompress( fields[4] ),
+					utils_fingerprint_input_new( g_ascii_strtoll( fields[1], NULL, 10 ), g_ascii_strtoll( fields[2], NULL, 10 ),
+						g_strdup( fields[3] ) ) );
+			}
+			g_strfreev( fields );
+		}
+	}
+
+	g_strfreev( lines );
+	g_free( contents );
+}
+
+
+/* Starts the fingerprint of an export whose record is kept in record_file, reading the record
+ * of the last export from it. */
+UtilsFingerprint *utils_fingerprint_new( const gchar *record_file )
+{
+	UtilsFingerprint *fp = g_new0( UtilsFingerprint, 1 );
+	GTimeVal now;
+
+	g_get_current_time( &now );
+	fp->record_file = g_strdup( record_file );
+	fp->time = now.tv_sec;
+	fp->inputs = g_hash_table_new_full( g_str_hash, g_str_equal, g_free, utils_fingerprint_input_free );
+	fp->outputs = g_hash_table_new_full( g_str_hash, g_str_equal, g_free, NULL );
+	fp->previous_inputs = g_hash_table_new_full( g_str_hash, g_str_equal, g_free, utils_fingerprint_input_free );
+	fp->previous_outputs = g_hash_table_new_full( g_str_hash, g_str_equal, g_free, utils_fingerprint_input_free );
+
+	utils_fingerprint_load( fp );
+	return fp;
+}
+
+
+void utils_fingerprint_free( UtilsFingerprint *fp )
+{
+	if ( !fp ) return;
+
+	g_hash_table_destroy( fp->inputs );
+	g_hash_table_destroy( fp->outputs );
+	g_hash_table_destroy( fp->previous_inputs );
+	g_hash_table_destroy( fp->previous_outputs );
+	g_free( fp->previous_digest );
+	g_free( fp->record_file );
+	g_free( fp );
+}
+
+
+/* Adds a setting, NULL is the same as an empty string. Only a hash of the value is recorded. */
+void utils_fingerprint_add_string( UtilsFingerprint *fp, const gchar *key, const gchar *value )
+{
+	gchar *hash = g_compute_checksum_for_string( G_CHECKSUM_SHA1, value ? value : "", -1 );
+
+	g_hash_table_insert( fp->inputs, g_strdup( key ), utils_fingerprint_input_new( -1, -1, hash ) );
+}
+
+
+void utils_fingerprint_add_int( UtilsFingerprint *fp, const gchar *key, gint value )
+{
+	gchar *str = g_strdup_printf( "%d", value );
+
+	utils_fingerprint_add_string( fp, key, str );
+	g_free( str );
+}
+
+
+/* Adds the contents of the file at path. An empty path and a missing file are recorded as such,
+ * so a file that appears later counts as a change. */
+void utils_fingerprint_add_file( UtilsFingerprint *fp, const gchar *key, const gchar *path )
+{
+	UtilsFingerprintInput *previous;
+	struct stat st;
+	gchar *hash = NULL;
+
+	if ( !path || !*path )
+	{
+		g_hash_table_insert( fp->inputs, g_strdup( key ), utils_fingerprint_input_new( -1, -1, g_strdup( "none" ) ) );
+		return;
+	}
+	if ( g_stat( path, &st ) != 0 )
+	{
+		g_hash_table_insert( fp->inputs, g_strdup( key ), utils_fingerprint_input_new( -1, -1, g_strdup( "missing" ) ) );
+		return;
+	}
+
+	// a file written in the same second as the record could have changed again without its time changing
+	previous = g_hash_table_lookup( fp->previous_inputs, key );
+	if ( previous && previous->size == (gint64) st.st_size && previous->mtime == (gint64) st.st_mtime
+		&& previous->mtime < fp->previous_time )
+		hash = g_strdup( previous->hash );
+	else hash = utils_fingerprint_hash_file( path );
+
+	if ( !hash ) hash = g_strdup( "unreadable" );
+	g_hash_table_insert( fp->inputs, g_strdup( key ), utils_fingerprint_input_new( st.st_size, st.st_mtime, hash ) );
+}
+
+
+/* Adds every file below path, each with its relative path under key. */
+void utils_fingerprint_add_folder( UtilsFingerprint *fp, const gchar *key, const gchar *path )
+{
+	GDir *dir = path ? g_dir_open( path, 0, NULL ) : NULL;
+	const gchar *name;
+
+	if ( !dir ) return;
+
+	foreach_dir( name, dir )
+	{
+		gchar *sub_path = g_build_path( "/", path, name, NULL );
+		gchar *sub_key = g_strconcat( key, "/", name, NULL );
+
+		if ( g_file_test( sub_path, G_FILE_TEST_IS_DIR ) ) utils_fingerprint_add_folder( fp, sub_key, sub_path );
+		else utils_fingerprint_add_file( fp, sub_key, sub_path );
+
+		g_free( sub_key );
+		g_free( sub_path );
+	}
+	g_dir_close( dir );
+}
+
+
+/* Adds the size and time of path without reading it, for tools too large to hash on every export. */
+void utils_fingerprint_add_stamp( UtilsFingerprint *fp, const gchar *key, const gchar *path )
+{
+	struct stat st;
+	gchar *hash;
+
+	if ( path && g_stat( path, &st ) == 0 )
+		hash = g_strdup_printf( "%" G_GINT64_FORMAT ":%" G_GINT64_FORMAT, (gint64) st.st_size, (gint64) st.st_mtime );
+	else hash = g_strdup( "missing" );
+
+	g_hash_table_insert( fp->inputs, g_strdup( key ), utils_fingerprint_input_new( -1, -1, hash ) );
+}
+
+
+static gint utils_fingerprint_compare_keys(gconstpointer a, gconstpointer b)
+{
+	return strcmp( *(const gchar**) a, *(const gchar**) b );
+}
+
+
+// the keys of table in a fixed order
+static GPtrArray *utils_fingerprint_sorted_keys(GHashTable *table)
+{
+	GPtrArray *keys = g_ptr_array_sized_new( g_hash_table_size( table ) );
+	GHashTableIter iter;
+	gpointer key;
+
+	g_hash_table_iter_init( &iter, table );
+	while( g_hash_table_iter_next( &iter, &key, NULL ) ) g_ptr_array_add( keys, key );
+	g_ptr_array_sort( keys, utils_fingerprint_compare_keys );
+	return keys;
+}
+
+
+// one hash over all the inputs, their keys included so a renamed file is a change
+static gchar *utils_fingerprint_digest(UtilsFingerprint *fp)
+{
+	GChecksum *checksum = g_checksum_new( G_CHECKSUM_SHA1 );
+	GPtrArray *keys = utils_fingerprint_sorted_keys( fp->inputs );
+	gchar *digest;
+	guint i;
+
+	for( i = 0; i < keys->len; i++ )
+	{
+		const gchar *key = g_ptr_array_index( keys, i );
+		UtilsFingerprintInput *input = g_hash_table_lookup( fp->inputs, key );
+
+		g_checksum_update( checksum, (const guchar*) key, strlen(key) + 1 );
+		g_checksum_update( checksum, (const guchar*) input->hash, strlen(input->hash) + 1 );
+	}
+
+	digest = g_strdup( g_checksum_get_string( checksum ) );
+	g_ptr_array_free( keys, TRUE );
+	g_checksum_free( checksum );
+	return digest;
+}
+
+
+/* Whether the inputs added are the same as those of the last export, and every file it wrote
+ * is still there with the same contents. Outputs are always read in full. */
+gboolean utils_fingerprint_matches( UtilsFingerprint *fp )
+{
+	GHashTableIter iter;
+	gpointer key, value;
+	gchar *digest;
+	gboolean matches;
+
+	if ( !fp->have_previous || !fp->previous_digest || g_hash_table_size( fp->previous_outputs ) == 0 ) return FALSE;
+
+	digest = utils_fingerprint_digest( fp );
+	matches = strcmp( digest, fp->previous_digest ) == 0;
+	g_free( digest );
+
+	g_hash_table_iter_init( &iter, fp->previous_outputs );
+	while( matches && g_hash_table_iter_next( &iter, &key, &value ) )
+	{
+		UtilsFingerprintInput *output = value;
+		struct stat st;
+		gchar *hash;
+
+		if ( g_stat( key, &st ) != 0 || (gint64) st.st_size != output->size ) matches = FALSE;
+		else
+		{
+			hash = utils_fingerprint_hash_file( key );
+			matches = hash && strcmp( hash, output->hash ) == 0;
+			g_free( hash );
+		}
+	}
+
+	return matches;
+}
+
+
+/* The keys of the inputs that were added, removed or changed since the last export, sorted,
+ * or NULL if there is no record of one. Free with g_strfreev(). */
+gchar **utils_fingerprint_get_changes( UtilsFingerprint *fp )
+{
+	GPtrArray *changes;
+	GPtrArray *keys;
+	GHashTableIter iter;
+	gpointer key, value;
+	guint i;
+
+	if ( !fp->have_previous ) return NULL;
+
+	changes = g_ptr_array_new();
+	keys = utils_fingerprint_sorted_keys( fp->inputs );
+	for( i = 0; i < keys->len; i++ )
+	{
+		const gchar *input_key = g_ptr_array_index( keys, i );
+		UtilsFingerprintInput *input = g_hash_table_lookup( fp->inputs, input_key );
+		UtilsFingerprintInput *previous = g_hash_table_lookup( fp->previous_inputs, input_key );
+
+		if ( !previous || strcmp( previous->hash, input->hash ) != 0 ) g_ptr_array_add( changes, g_strdup( input_key ) );
+	}
+	g_ptr_array_free( keys, TRUE );
+
+	// removed inputs, in order with the rest
+	g_hash_table_iter_init( &iter, fp->previous_inputs );
+	while( g_hash_table_iter_next( &iter, &key, &value ) )
+	{
+		if ( !g_hash_table_lookup( fp->inputs, key ) ) g_ptr_array_add( changes, g_strdup( key ) );
+	}
+	g_ptr_array_sort( changes, utils_fingerprint_compare_keys );
+
+	g_ptr_array_add( changes, NULL );
+	return (gchar**) g_ptr_array_free( changes, FALSE );
+}
+
+
+/* Adds a file written by the export, it is hashed by utils_fingerprint_save(). Files that don't
+ * exist by then are left out. */
+void utils_fingerprint_add_output( UtilsFingerprint *fp, const gchar *path )
+{
+	g_hash_table_insert( fp->outputs, g_strdup( path ), NULL );
+}
+
+
+/* Writes the inputs and the hashes of the outputs to the record file, for the next export. */
+gboolean utils_fingerprint_save( UtilsFingerprint *fp )
+{
+	GString *record = g_string_sized_new( 65536 );
+	GPtrArray *keys;
+	gchar *digest = utils_fingerprint_digest( fp );
+	gboolean result;
+	guint i;
+
+	g_string_append_printf( record, "%s\ntime\t%" G_GINT64_FORMAT "\ndigest\t%s\n", UTILS_FINGERPRINT_HEADER, fp->time, digest );
+	g_free( digest );
+
+	for( i = 0; i < 2; i++ )
+	{
+		GHashTable *table = i ? fp->outputs : fp->inputs;
+		guint k;
+
+		keys = utils_fingerprint_sorted_keys( table );
+		for( k = 0; k < keys->len; k++ )
+		{
+			const gchar *key = g_ptr_array_index( keys, k );
+			gchar *escaped = g_strescape( key, NULL );
+
+			if ( i == 0 )
+			{
+				UtilsFingerprintInput *input = g_hash_table_lookup( fp->inputs, key );
+				g_string_append_printf( record, "in\t%" G_GINT64_FORMAT "\t%" G_GINT64_FORMAT "\t%s\t%s\n",
+					input->size, input->mtime, input->hash, escaped );
+			}
+			else
+			{
+				struct stat st;
+				gchar *hash = NULL;
+
+				if ( g_stat( key, &st ) == 0 && (hash = utils_fingerprint_hash_file( key )) )
+					g_string_append_printf( record, "out\t%" G_GINT64_FORMAT "\t%" G_GINT64_FORMAT "\t%s\t%s\n",
+						(gint64) st.st_size, (gint64) st.st_mtime, hash, escaped );
+				g_free( hash );
+			}
+			g_free( escaped );
+		}
+		g_ptr_array_free( keys, TRUE );
+	}
+
+	result = g_file_set_contents( fp->record_file, record->str, record->len, NULL );
+	g_string_free( record, TRUE );
+	return result;
+}
+
+
+/* App icons in several sizes from one source image. The source is decoded once and halved
+ * until it is less than twice the size of a target, then each target is scaled from the nearest
+ * level and encoded on a worker thread. Encoded icons are kept in the config folder under the
+ * hash of the source file and their size, so exporting again with the same icon only copies
+ * files. The cache is pruned to the icons used most recently once it passes
+ * UTILS_ICON_CACHE_MAX_SIZE. */
+
+#define UTILS_ICON_CACHE_MAX_SIZE G_GINT64_CONSTANT(64*1024*1024)
+
+typedef struct UtilsIconTarget
+{
+	gint width;
+	gint height;
+	gchar *dst_path;
+	gchar *cache_path;
+	gboolean cgbi;
+	struct UtilsIconTarget *same_as; // earlier target with the same size, copied from it
+
+	/* used by a worker thread */
+	GdkPixbuf *level;
+	gchar *error;
+} UtilsIconTarget;
+
+struct UtilsIconSet
+{
+	gchar *src_path;
+	GPtrArray *targets;
+	gboolean cgbi;
+};
+
+typedef struct UtilsIconState
+{
+	GMutex *mutex;
+	GCond *cond;
+	guint remaining;
+} UtilsIconState;
+
+
+UtilsIconSet *utils_icon_set_new( const gchar *src_path )
+{
+	UtilsIconSet *set;
+
+	g_return_val_if_fail (src_path != NULL, NULL);
+
+	set = g_new0( UtilsIconSet, 1 );
+	set->src_path = g_strdup( src_path );
+	set->targets = g_ptr_array_new();
+	return set;
+}
+
+
+void utils_icon_set_free( UtilsIconSet *set )
+{
+	guint i;
+
+	if ( !set ) return;
+
+	for( i = 0; i < set->targets->len; i++ )
+	{
+		UtilsIconTarget *target = g_ptr_array_index( set->targets, i );
+		g_free( target->dst_path );
+		g_free( target->cache_path );
+		g_free( target->error );
+		g_free( target );
+	}
+	g_ptr_array_free( set->targets, TRUE );
+	g_free( set->src_path );
+	g_free( set );
+}
+
+
+/* Writes the icons in Apple's CgBI format for iOS instead of standard PNG. */
+void utils_icon_set_set_cgbi( UtilsIconSet *set, gboolean cgbi )
+{
+	g_return_if_fail (set != NULL);
+
+	set->cgbi = cgbi;
+}
+
+
+/* Adds a width x height copy of the source image to be written to dst_path as a PNG file. */
+void utils_icon_set_add( UtilsIconSet *set, gint width, gint height, const gchar *dst_path )
+{
+	UtilsIconTarget *target;
+
+	g_return_if_fail (set != NULL);
+	g_return_if_fail (width > 0 && height > 0);
+	g_return_if_fail (dst_path != NULL);
+
+	target = g_new0( UtilsIconTarget, 1 );
+	target->width = width;
+	target->height = height;
+	target->dst_path = g_strdup( dst_path );
+	g_ptr_array_add( set->targets, target );
+}
+
+
+static void utils_icon_set_encode( gpointer data, gpointer user_data )
+{
+	UtilsIconTarget *target = data;
+	UtilsIconState *state = user_data;
+	GdkPixbuf *scaled;
+	GError *error = NULL;
+
+	if ( gdk_pixbuf_get_width( target->level ) == target->width && gdk_pixbuf_get_height( target->level ) == target->height )
+		scaled = g_object_ref( target->level );
+	else
+		scaled = gdk_pixbuf_scale_simple( target->level, target->width, target->height, GDK_INTERP_HYPER );
+
+	if ( !scaled )
+		target->error = g_strdup( "not enough memory to scale image" );
+	else
+	{
+		gint channels = gdk_pixbuf_get_n_channels( scaled );
+		gint rowstride = gdk_pixbuf_get_rowstride( scaled );
+		gint row_size = target->width * channels;
+		const guint8 *pixels = gdk_pixbuf_get_pixels( scaled );
+		guint8 *packed = NULL;
+		size_t png_size = 0;
+		void *png;
+		gint y;
+
+		// miniz wants the rows with no padding between them
+		if ( !target->cgbi && rowstride != row_size )
+		{
+			packed = g_malloc( (gsize) row_size * target->height );
+			for( y = 0; y < target->height; y++ )
+				memcpy( packed + (gsize) y * row_size, pixels + (gsize) y * rowstride, row_size );
+			pixels = packed;
+		}
+
+		if ( target->cgbi )
+			png = pngutils_write_cgbi_in_memory( pixels, target->width, target->height, channels, rowstride, &png_size );
+		else
+			png = tdefl_write_image_to_png_file_in_memory_ex( pixels, target->width, target->height, channels, &png_size, MZ_BEST_COMPRESSION, MZ_FALSE );
+		if ( !png )
+			target->error = g_strdup( "failed to encode PNG image" );
+		else
+		{
+			if ( !g_file_set_contents( target->dst_path, png, png_size, &error ) )
+			{
+				target->error = g_strdup( error->message );
+				g_error_free( error );
+			}
+			else if ( target->cache_path )
+			{
+				// a missing cache entry only costs time on the next export
+				g_file_set_contents( target->cache_path, png, png_size, NULL );
+			}
+			if ( target->cgbi ) g_free( png );
+			else mz_free( png );
+		}
+
+		g_free( packed );
+		g_object_unref( scaled );
+	}
+
+	g_mutex_lock( state->mutex );
+	state->remaining--;
+	g_cond_signal( state->cond );
+	g_mutex_unlock( state->mutex );
+}
+
+
+/* Writes every size added to the set, reusing cached icons where possible. */
+gboolean utils_icon_set_write( UtilsIconSet *set, GError **error )
+{
+	gchar *contents = NULL;
+	gsize length = 0;
+	gchar *digest;
+	gchar *cache_folder;
+	GPtrArray *pending;
+	GPtrArray *levels = NULL;
+	gboolean result = TRUE;
+	guint i, j;
+
+	g_return_val_if_fail (set != NULL, FALSE);
+
+	if ( !g_file_get_contents( set->src_path, &contents, &length, error ) ) return FALSE;
+
+	digest = g_compute_checksum_for_data( G_CHECKSUM_SHA1, (const guchar*) contents, length );
+	cache_folder = g_build_path( "/", app->configdir, "iconcache", NULL );
+	if ( utils_mkdir( cache_folder, TRUE ) != 0 && !g_file_test( cache_folder, G_FILE_TEST_IS_DIR ) )
+		SETPTR( cache_folder, NULL );
+
+	pending = g_ptr_array_new();
+	for( i = 0; i < set->targets->len; i++ )
+	{
+		UtilsIconTarget *target = g_ptr_array_index( set->targets, i );
+
+		target->cgbi = set->cgbi;
+		target->same_as = NULL;
+		for( j = 0; j < i; j++ )
+		{
+			UtilsIconTarget *other = g_ptr_array_index( set->targets, j );
+			if ( other->width == target->width && other->height == target->height )
+			{
+				target->same_as = other;
+				break;
+			}
+		}
+		if ( target->same_as ) continue;
+
+		if ( cache_folder )
+		{
+			gchar *name = g_strdup_printf( "%s-%dx%d%s.png", digest, target->width, target->height, target->cgbi ? "-cgbi" : "" );
+			SETPTR( target->cache_path, g_build_path( "/", cache_folder, name, NULL ) );
+			g_free( name );
+
+			if ( g_file_test( target->cache_path, G_FILE_TEST_IS_REGULAR )
+				&& utils_copy_file( target->cache_path, target->dst_path, TRUE, NULL ) )
+			{
+				utils_cache_touch( target->cache_path );
+				continue;
+			}
+		}
+
+		g_ptr_array_add( pending, target );
+	}
+
+	if ( pending->len > 0 )
+	{
+		GdkPixbufLoader *loader = gdk_pixbuf_loader_new();
+		GdkPixbuf *image = NULL;
+		GdkPixbuf *level;
+		gint min_width = G_MAXINT, min_height = G_MAXINT;
+		UtilsIconState state;
+		GThreadPool *pool;
+		// only keep the UI going if this is the main loop's thread
+		gboolean pump_events = g_main_context_is_owner( g_main_context_default() );
+
+		// a failed write closes the loader itself
+		if ( gdk_pixbuf_loader_write( loader, (const guchar*) contents, length, error )
+			&& gdk_pixbuf_loader_close( loader, error ) )
+		{
+			image = gdk_pixbuf_loader_get_pixbuf( loader );
+			if ( image ) g_object_ref( image );
+			else g_set_error( error, GDK_PIXBUF_ERROR, GDK_PIXBUF_ERROR_CORRUPT_IMAGE, "Failed to load image \"%s\"", set->src_path );
+		}
+		g_object_unref( loader );
+
+		if ( !image )
+		{
+			result = FALSE;
+			goto icon_set_done;
+		}
+
+		// halve the image while every level is still at least as big as some target
+		for( i = 0; i < pending->len; i++ )
+		{
+			UtilsIconTarget *target = g_ptr_array_index( pending, i );
+			min_width = MIN( min_width, target->width );
+			min_height = MIN( min_height, target->height );
+		}
+
+		levels = g_ptr_array_new();
+		g_ptr_array_add( levels, image );
+		level = image;
+		while( gdk_pixbuf_get_width( level ) / 2 >= min_width && gdk_pixbuf_get_height( level ) / 2 >= min_height )
+		{
+			level = gdk_pixbuf_scale_simple( level, gdk_pixbuf_get_width( level ) / 2, gdk_pixbuf_get_height( level ) / 2, GDK_INTERP_BILINEAR );
+			if ( !level ) break;
+			g_ptr_array_add( levels, level );
+		}
+
+		// smallest level that doesn't need enlarging, or the source if the target is bigger
+		for( i = 0; i < pending->len; i++ )
+		{
+			UtilsIconTarget *target = g_ptr_array_index( pending, i );
+
+			target->level = image;
+			for( j = levels->len; j > 0; j-- )
+			{
+				level = g_ptr_array_index( levels, j - 1 );
+				if ( gdk_pixbuf_get_width( level ) >= target->width && gdk_pixbuf_get_height( level ) >= target->height )
+				{
+					target->level = level;
+					break;
+				}
+			}
+		}
+
+		state.mutex = g_mutex_new();
+		state.cond = g_cond_new();
+		state.remaining = pending->len;
+		pool = g_thread_pool_new( utils_icon_set_encode, &state, MIN( utils_get_cpu_count(), pending->len ), FALSE, NULL );
+		for( i = 0; i < pending->len; i++ )
+			g_thread_pool_push( pool, g_ptr_array_index( pending, i ), NULL );
+
+		g_mutex_lock( state.mutex );
+		while( state.remaining > 0 )
+		{
+			if ( pump_events )
+			{
+				GTimeVal until;
+
+				g_get_current_time( &until );
+				g_time_val_add( &until, 20000 );
+				g_cond_timed_wait( state.cond, state.mutex, &until );
+
+				g_mutex_unlock( state.mutex );
+				while (gtk_events_pending())
+					gtk_main_iteration();
+				g_mutex_lock( state.mutex );
+			}
+			else
+				g_cond_wait( state.cond, state.mutex );
+		}
+		g_mutex_unlock( state.mutex );
+
+		g_thread_pool_free( pool, FALSE, TRUE );
+		g_mutex_free( state.mutex );
+		g_cond_free( state.cond );
+
+		for( i = 0; i < pending->len; i++ )
+		{
+			UtilsIconTarget *target = g_ptr_array_index( pending, i );
+
+			target->level = NULL;
+			if ( target->error && result )
+			{
+				g_set_error( error, G_FILE_ERROR, G_FILE_ERROR_FAILED, "Failed to save %dx%d icon: %s", target->width, target->height, target->error );
+				result = FALSE;
+			}
+			SETPTR( target->error, NULL );
+		}
+
+		if ( cache_folder ) utils_cache_prune( cache_folder, UTILS_ICON_CACHE_MAX_SIZE );
+	}
+
+	for( i = 0; i < set->targets->len && result; i++ )
+	{
+		UtilsIconTarget *target = g_ptr_array_index( set->targets, i );
+
+		if ( target->same_as && !utils_copy_file( target->same_as->dst_path, target->dst_path, TRUE, NULL ) )
+		{
+			g_set_error( error, G_FILE_ERROR, G_FILE_ERROR_FAILED, "Failed to save %dx%d icon: could not copy %s", target->width, target->height, target->same_as->dst_path );
+			result = FALSE;
+		}
+	}
+
+icon_set_done:
+	if ( levels )
+	{
+		for( i = 0; i < levels->len; i++ )
+			g_object_unref( g_ptr_array_index( levels, i ) );
+		g_ptr_array_free( levels, TRUE );
+	}
+	g_ptr_array_free( pending, TRUE );
+	g_free( cache_folder );
+	g_free( digest );
+	g_free( contents );
+	return result;
+}
+
+
+// appends str to a JavaScript or JSON string literal
+static void utils_html5_append_escaped( GString *out, const gchar *str )
+{
+	for( ; *str; str++ )
+	{
+		if ( *str == '"' || *str == '\\' ) g_string_append_c( out, '\\' );
+		g_string_append_c( out, *str );
+	}
+}
+
+// appends a file to the data file a chunk at a time
+static gboolean utils_html5_append_file( FILE *pHTML5Data, const gchar *filepath, gint64 *length )
+{
+	gchar *buffer;
+	gboolean result = TRUE;
+	size_t count;
+	FILE *pFile = g_fopen( filepath, "rb" );
+
+	*length = 0;
+	if ( !pFile )
+	{
+		g_critical (G_STRLOC ": Failed to open file '%s'", filepath);
+		return FALSE;
+	}
+
+	buffer = g_malloc( UTILS_HTML5_CHUNK_SIZE );
+	while( (count = fread( buffer, 1, UTILS_HTML5_CHUNK_SIZE, pFile )) > 0 )
+	{
+		if ( fwrite( buffer, 1, count, pHTML5Data ) != count )
+		{
+			g_critical (G_STRLOC ": Failed to convert file '%s' to HTML5 data", filepath);
+			result = FALSE;
+			break;
+		}
+		*length += count;
+	}
+
+	if ( result && ferror( pFile ) )
+	{
+		g_critical (G_STRLOC ": Failed to read file '%s'", filepath);
+		result = FALSE;
+	}
+
+	g_free( buffer );
+	fclose( pFile );
+	return result;
+}
+
+/* Appends every file in srcfull to the HTML5 data file and adds its entry to load_package_string,
+ * with the folders it needs created added to additional_folders_string. currpos is the size of the
+ * data file so far. */
+gboolean utils_add_folder_to_html5_data_file( FILE *pHTML5Data, const gchar* srcfull, const gchar* src, GString* load_package_string, GString* additional_folders_string, gint64* currpos )
 {
 	g_return_val_if_fail (pHTML5Data != NULL, FALSE);
 	g_return_val_if_fail (srcfull != NULL, FALSE);
@@ -2602,11 +6251,11 @@ gboolean utils_add_folder_to_html5_data_file( FILE *pHTML5Data, const gchar* src
 			
 		if ( g_file_test( filepath, G_FILE_TEST_IS_DIR ) )
 		{
-			strcat( additional_folders_string, "Module[\"FS_createPath\"](\"" ); 
-			strcat( additional_folders_string, src ); 
-			strcat( additional_folders_string, "\", \"" );
-			strcat( additional_folders_string, filename );
-			strcat( additional_folders_string, "\", true, true);" );
+			g_string_append( additional_folders_string, "Module[\"FS_createPath\"](\"" );
+			utils_html5_append_escaped( additional_folders_string, src );
+			g_string_append( additional_folders_string, "\", \"" );
+			utils_html5_append_escaped( additional_folders_string, filename );
+			g_string_append( additional_folders_string, "\", true, true);" );
 
 			if ( !utils_add_folder_to_html5_data_file( pHTML5Data, filepath, shortfilepath, load_package_string, additional_folders_string, currpos ) ) 
 			{
@@ -2618,33 +6267,16 @@ gboolean utils_add_folder_to_html5_data_file( FILE *pHTML5Data, const gchar* src
 		}
 		else if ( g_file_test( filepath, G_FILE_TEST_IS_REGULAR ) )
 		{
-			gchar *contents = 0;
-			gsize length = 0;
-
-			if ( !g_file_get_contents( filepath, &contents, &length, NULL ) )
-			{
-				g_dir_close(dir);
-				g_free(filepath);
-				g_free(shortfilepath);
-				if ( contents ) g_free(contents);
+			gint64 length = 0;
 
-				g_critical (G_STRLOC ": Failed to open file '%s'", filepath);
-				return FALSE;
-			}
-			
-			if ( length > 0 && fwrite( contents, 1, length, pHTML5Data ) != length )
+			if ( !utils_html5_append_file( pHTML5Data, filepath, &length ) )
 			{
 				g_dir_close(dir);
 				g_free(filepath);
 				g_free(shortfilepath);
-				g_free(contents);
-
-				g_critical (G_STRLOC ": Failed to convert file '%s' to HTML5 data", filepath);
 				return FALSE;
 			}
 
-			g_free(contents);
-
 			int audio = 0;
 			gchar *ext = strrchr( filename, '.' );
 			if ( ext )
@@ -2656,12 +6288,11 @@ gboolean utils_add_folder_to_html5_data_file( FILE *pHTML5Data, const gchar* src
 			}
 
 			// append file data to load packing string
-			char str[ 30 ];
-			strcat( load_package_string, "{\"audio\":" ); strcat( load_package_string, audio ? "1" : "0" );
-			strcat( load_package_string, ",\"start\":" ); sprintf( str, "%d", *currpos ); strcat( load_package_string, str );
-			strcat( load_package_string, ",\"crunched\":0" ); 
-			strcat( load_package_string, ",\"end\":" ); sprintf( str, "%d", *currpos+length ); strcat( load_package_string, str );
-			strcat( load_package_string, ",\"filename\":\"" ); strcat( load_package_string, shortfilepath ); strcat( load_package_string, "\"}," );
+			g_string_append_printf( load_package_string, "{\"audio\":%d,\"start\":%" G_GINT64_FORMAT ",\"crunched\":0,\"end\":%" G_GINT64_FORMAT,
+				audio, *currpos, *currpos + length );
+			g_string_append( load_package_string, ",\"filename\":\"" );
+			utils_html5_append_escaped( load_package_string, shortfilepath );
+			g_string_append( load_package_string, "\"}," );
 
 			*currpos += length;
 		}
@@ -236,6 +236,9 @@ gchar *utils_get_current_time_string(void);
 GIOChannel *utils_set_up_io_channel(gint fd, GIOCondition cond, gboolean nblock,
 									GIOFunc func, gpointer data);
 
+GIOChannel *utils_set_up_io_channel_full(gint fd, GIOCondition cond, gboolean nblock,
+									GIOFunc func, gpointer data, GDestroyNotify notify);
+
 gchar **utils_read_file_in_array(const gchar *filename);
 
 gboolean utils_str_replace_escape(gchar *string, gboolean keep_backslash);
@@ -301,11 +304,166 @@ gboolean utils_copy_file (const gchar *src, const gchar *dst, gboolean overwrite
 
 gboolean utils_copy_folder ( const gchar* src, const gchar* dst, gboolean recursive, volatile gchar* progress );
 
+void utils_cache_touch( const gchar *path );
+
+void utils_cache_prune( const gchar *folder, gint64 max_size );
+
 gboolean utils_remove_folder_recursive ( const gchar* src );
 
+typedef gboolean (*UtilsTreeProgressFunc)( const gchar *path, guint done, guint total, gpointer user_data );
+
+gboolean utils_copy_folder_full( const gchar* src, const gchar* dst, gboolean recursive, UtilsTreeProgressFunc func, gpointer user_data, gchar **error );
+
+gboolean utils_remove_folder_full( const gchar* src, UtilsTreeProgressFunc func, gpointer user_data );
+
 gboolean utils_add_folder_to_zip ( mz_zip_archive *pZip, const gchar* src, const gchar* dst, gboolean recursive, gboolean selective_compress );
 
-gboolean utils_add_folder_to_html5_data_file( FILE *pHTML5Data, const gchar* srcfull, const gchar* src, gchar* load_package_string, gchar* additional_folders_string, int* currpos );
+guint utils_get_cpu_count(void);
+
+typedef struct UtilsBlobStore UtilsBlobStore;
+
+UtilsBlobStore *utils_blob_store_new( const gchar *folder );
+
+void utils_blob_store_free( UtilsBlobStore *store );
+
+gboolean utils_blob_store_flush( UtilsBlobStore *store );
+
+typedef struct UtilsZipQueue UtilsZipQueue;
+
+/* for utils_zip_queue_add_file(), picks the level from a sample of the file */
+#define UTILS_ZIP_LEVEL_AUTO -1
+
+typedef gboolean (*UtilsZipProgressFunc)( const gchar *archive_name, guint64 done, guint64 total, gpointer user_data );
+
+UtilsZipQueue *utils_zip_queue_new( mz_zip_archive *pZip );
+
+void utils_zip_queue_set_blob_store( UtilsZipQueue *queue, UtilsBlobStore *store );
+
+void utils_zip_queue_set_alignment( UtilsZipQueue *queue, guint alignment, guint lib_alignment );
+
+void utils_zip_queue_set_progress( UtilsZipQueue *queue, UtilsZipProgressFunc func, gpointer user_data );
+
+void utils_zip_queue_set_levels( UtilsZipQueue *queue, const gchar *overrides );
+
+void utils_zip_queue_set_log( UtilsZipQueue *queue, const gchar *log_file );
+
+void utils_zip_queue_add_file( UtilsZipQueue *queue, const gchar *archive_name, const gchar *src_path, gint level );
+
+gboolean utils_zip_queue_add_folder( UtilsZipQueue *queue, const gchar* src, const gchar* dst, gboolean recursive, gboolean selective_compress );
+
+gboolean utils_zip_queue_finish( UtilsZipQueue *queue );
+
+void utils_zip_queue_free( UtilsZipQueue *queue );
+
+gboolean utils_zip_check_alignment( const gchar *zip_path, guint alignment, guint lib_alignment, gchar **bad_entry );
+
+gboolean utils_zip_extract( const gchar *zip_path, const gchar *dest, const gchar **executables,
+                            UtilsZipProgressFunc func, gpointer user_data, gchar **error );
+
+typedef struct UtilsSizeEntry
+{
+	gchar *archive_name;
+	gchar *src_path;
+	gint level;					/* the level the export would use, 0 is stored, sampled when run */
+	guint64 size;
+	guint64 compressed_size;	/* as it would be in the archive */
+	gchar *sha1;
+	const struct UtilsSizeEntry *duplicate_of;	/* first file with the same contents, or NULL */
+	gboolean failed;			/* could not be read */
+	gboolean done;				/* internal, guarded by the report */
+} UtilsSizeEntry;
+
+typedef struct UtilsSizeReport UtilsSizeReport;
+
+UtilsSizeReport *utils_size_report_new( void );
+
+void utils_size_report_free( UtilsSizeReport *report );
+
+void utils_size_report_set_levels( UtilsSizeReport *report, const gchar *overrides );
+
+void utils_size_report_add_file( UtilsSizeReport *report, const gchar *archive_name, const gchar *src_path, gint level );
+
+gboolean utils_size_report_add_folder( UtilsSizeReport *report, const gchar* src, const gchar* dst, gboolean recursive, gboolean selective_compress );
+
+gboolean utils_size_report_run( UtilsSizeReport *report, UtilsZipProgressFunc func, gpointer user_data );
+
+guint utils_size_report_get_count( UtilsSizeReport *report );
+
+const UtilsSizeEntry *utils_size_report_get_entry( UtilsSizeReport *report, guint index );
+
+gboolean utils_size_report_write_csv( UtilsSizeReport *report, const gchar *filename, GError **error );
+
+typedef struct UtilsOverlay UtilsOverlay;
+
+UtilsOverlay *utils_overlay_new( const gchar *base_folder );
+
+void utils_overlay_free( UtilsOverlay *overlay );
+
+void utils_overlay_set_contents( UtilsOverlay *overlay, const gchar *path, const gchar *contents, gssize length );
+
+gboolean utils_overlay_get_contents( UtilsOverlay *overlay, const gchar *path, gchar **contents, gsize *length, GError **error );
+
+gboolean utils_overlay_write( UtilsOverlay *overlay, const gchar *path, const gchar *dst_path, GError **error );
+
+gboolean utils_overlay_materialize( UtilsOverlay *overlay, const gchar *path, const gchar *dst_folder, GError **error );
+
+typedef struct UtilsTemplate UtilsTemplate;
+
+UtilsTemplate *utils_template_new( void );
+
+void utils_template_free( UtilsTemplate *tmpl );
+
+void utils_template_add_key( UtilsTemplate *tmpl, const gchar *key );
+
+void utils_template_add_element( UtilsTemplate *tmpl, const gchar *open, const gchar *close );
+
+void utils_template_compile( UtilsTemplate *tmpl, const gchar *text, gssize length );
+
+gboolean utils_template_contains( UtilsTemplate *tmpl, const gchar *key );
+
+void utils_template_set( UtilsTemplate *tmpl, const gchar *key, const gchar *value );
+
+void utils_template_render( UtilsTemplate *tmpl, GString *output );
+
+gboolean utils_write_gzip_file( const gchar *src_path, const gchar *dst_path );
+
+typedef struct UtilsFingerprint UtilsFingerprint;
+
+UtilsFingerprint *utils_fingerprint_new( const gchar *record_file );
+
+void utils_fingerprint_free( UtilsFingerprint *fp );
+
+void utils_fingerprint_add_string( UtilsFingerprint *fp, const gchar *key, const gchar *value );
+
+void utils_fingerprint_add_int( UtilsFingerprint *fp, const gchar *key, gint value );
+
+void utils_fingerprint_add_file( UtilsFingerprint *fp, const gchar *key, const gchar *path );
+
+void utils_fingerprint_add_folder( UtilsFingerprint *fp, const gchar *key, const gchar *path );
+
+void utils_fingerprint_add_stamp( UtilsFingerprint *fp, const gchar *key, const gchar *path );
+
+gboolean utils_fingerprint_matches( UtilsFingerprint *fp );
+
+gchar **utils_fingerprint_get_changes( UtilsFingerprint *fp );
+
+void utils_fingerprint_add_output( UtilsFingerprint *fp, const gchar *path );
+
+gboolean utils_fingerprint_save( UtilsFingerprint *fp );
+
+typedef struct UtilsIconSet UtilsIconSet;
+
+UtilsIconSet *utils_icon_set_new( const gchar *src_path );
+
+void utils_icon_set_free( UtilsIconSet *set );
+
+void utils_icon_set_set_cgbi( UtilsIconSet *set, gboolean cgbi );
+
+void utils_icon_set_add( UtilsIconSet *set, gint width, gint height, const gchar *dst_path );
+
+gboolean utils_icon_set_write( UtilsIconSet *set, GError **error );
+
+gboolean utils_add_folder_to_html5_data_file( FILE *pHTML5Data, const gchar* srcfull, const gchar* src, GString* load_package_string, GString* additional_folders_string, gint64* currpos );
 
 gchar* utils_create_relative_path( const gchar* base_path, const gchar* path );
 
@@ -0,0 +1,183 @@
+/*
+ *      test_cgbi.c - this file is part of Geany, a fast and lightweight IDE
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License along
+ *      with this program; if not, write to the Free Software Foundation, Inc.,
+ *      51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Encodes a fixed image as a CgBI PNG and compares it with cgbi.png, then takes the output
+ * apart to check the chunks, their CRCs and the premultiplied BGRA rows on their own.
+ * Run with --write to replace cgbi.png after an intended change to the encoder.
+ */
+
+#include <string.h>
+#include <glib.h>
+
+#include "miniz.h"
+#include "pngutils.h"
+
+#define WIDTH 5
+#define HEIGHT 3
+#define ROWSTRIDE (WIDTH * 4 + 3)	/* padded, as GdkPixbuf rows can be */
+
+static gint failures = 0;
+
+#define CHECK(cond, ...) \
+	G_STMT_START { if (!(cond)) { g_printerr(__VA_ARGS__); g_printerr("\n"); failures++; } } G_STMT_END
+
+
+static guint32 get_uint32(const guint8 *p)
+{
+	return ((guint32) p[0] << 24) | ((guint32) p[1] << 16) | ((guint32) p[2] << 8) | p[3];
+}
+
+
+/* RGBA with opaque, transparent and partly transparent pixels */
+static void make_pixels(guint8 *pixels)
+{
+	gint x, y;
+
+	memset(pixels, 0xEE, ROWSTRIDE * HEIGHT);
+	for (y = 0; y < HEIGHT; y++)
+	{
+		for (x = 0; x < WIDTH; x++)
+		{
+			guint8 *p = pixels + y * ROWSTRIDE + x * 4;
+			p[0] = (guint8) (x * 60 + y * 7);
+			p[1] = (guint8) (255 - x * 40);
+			p[2] = (guint8) (y * 100 + 13);
+			p[3] = (guint8) ((x + y * WIDTH) * 255 / (WIDTH * HEIGHT - 1));
+		}
+	}
+}
+
+
+static void check_structure(const guint8 *png, size_t png_size, const guint8 *pixels)
+{
+	static const guint8 signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	static const gchar *order[] = { "CgBI", "IHDR", "IDAT", "IEND" };
+	const guint8 *idat = NULL;
+	guint32 idat_size = 0;
+	size_t pos = 8;
+	guint i;
+
+	CHECK(png_size > 8 && memcmp(png, signature, 8) == 0, "bad PNG signature");
+
+	for (i = 0; i < G_N_ELEMENTS(order); i++)
+	{
+		guint32 length;
+		mz_ulong crc;
+
+		if (pos + 12 > png_size)
+		{
+			CHECK(FALSE, "%s chunk missing", order[i]);
+			return;
+		}
+		length = get_uint32(png + pos);
+		CHECK(memcmp(png + pos + 4, order[i], 4) == 0, "chunk %u is not %s", i, order[i]);
+		CHECK(pos + 12 + length <= png_size, "%s chunk runs past the end", order[i]);
+		if (pos + 12 + length > png_size)
+			return;
+
+		crc = mz_crc32(MZ_CRC32_INIT, png + pos + 4, length + 4);
+		CHECK(get_uint32(png + pos + 8 + length) == (guint32) crc, "%s chunk has a bad CRC", order[i]);
+
+		if (i == 0)
+			CHECK(length == 4 && get_uint32(png + pos + 8) == 0x50002006, "unexpected CgBI chunk");
+		else if (i == 1)
+		{
+			const guint8 *ihdr = png + pos + 8;
+			CHECK(length == 13 && get_uint32(ihdr) == WIDTH && get_uint32(ihdr + 4) == HEIGHT &&
+				ihdr[8] == 8 && ihdr[9] == 6, "unexpected IHDR");
+		}
+		else if (i == 2)
+		{
+			idat = png + pos + 8;
+			idat_size = length;
+		}
+		pos += 12 + length;
+	}
+	CHECK(pos == png_size, "data after IEND");
+
+	if (idat)
+	{
+		// raw deflate, no zlib header or checksum
+		size_t raw_size = 0;
+		guint8 *raw = tinfl_decompress_mem_to_heap(idat, idat_size, &raw_size, 0);
+		gint x, y;
+
+		CHECK(raw != NULL && raw_size == (size_t) HEIGHT * (1 + WIDTH * 4), "IDAT doesn't inflate to the image");
+		if (raw == NULL || raw_size != (size_t) HEIGHT * (1 + WIDTH * 4))
+		{
+			mz_free(raw);
+			return;
+		}
+
+		for (y = 0; y < HEIGHT; y++)
+		{
+			const guint8 *row = raw + y * (1 + WIDTH * 4);
+
+			CHECK(row[0] == 0, "row %d is filtered", y);
+			for (x = 0; x < WIDTH; x++)
+			{
+				const guint8 *src = pixels + y * ROWSTRIDE + x * 4;
+				const guint8 *dst = row + 1 + x * 4;
+				guint a = src[3];
+
+				CHECK(dst[0] == (src[2] * a + 127) / 255 && dst[1] == (src[1] * a + 127) / 255 &&
+					dst[2] == (src[0] * a + 127) / 255 && dst[3] == a,
+					"pixel %d,%d is not premultiplied BGRA", x, y);
+			}
+		}
+		mz_free(raw);
+	}
+}
+
+
+int main(int argc, char **argv)
+{
+	guint8 pixels[ROWSTRIDE * HEIGHT];
+	gchar *golden = NULL;
+	gsize golden_size = 0;
+	size_t png_size = 0;
+	guint8 *png;
+
+	make_pixels(pixels);
+	png = pngutils_write_cgbi_in_memory(pixels, WIDTH, HEIGHT, 4, ROWSTRIDE, &png_size);
+	if (!png)
+	{
+		g_printerr("encoding failed\n");
+		return 1;
+	}
+
+	if (argc > 1 && strcmp(argv[1], "--write") == 0)
+	{
+		if (!g_file_set_contents(GOLDEN_PNG, (const gchar *) png, png_size, NULL))
+			return 1;
+		g_free(png);
+		return 0;
+	}
+
+	check_structure(png, png_size, pixels);
+
+	if (!g_file_get_contents(GOLDEN_PNG, &golden, &golden_size, NULL))
+		CHECK(FALSE, "can't read %s", GOLDEN_PNG);
+	else
+		CHECK(golden_size == png_size && memcmp(golden, png, png_size) == 0, "output differs from %s", GOLDEN_PNG);
+
+	g_free(golden);
+	g_free(png);
+	return failures ? 1 : 0;
+}